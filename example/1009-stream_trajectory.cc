@@ -0,0 +1,46 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+
+#include "xarm/wrapper/trajectory_streamer.h"
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        printf("Please enter IP address\n");
+        return 0;
+    }
+    std::string port(argv[1]);
+
+    XArmAPI *arm = new XArmAPI(port);
+    sleep_milliseconds(500);
+    if (arm->error_code != 0) arm->clean_error();
+    if (arm->warn_code != 0) arm->clean_warn();
+    arm->motion_enable(true);
+    arm->set_mode(0);
+    arm->set_state(0);
+    sleep_milliseconds(500);
+
+    printf("=========================================\n");
+
+    int ret;
+    arm->reset(true);
+    TrajectoryStreamer streamer(arm, 32, 8);
+    // a circle of 2000 blended waypoints
+    fp32 pose[6] = {400, 0, 200, 180, 0, 0};
+    for (int i = 0; i < 2000; i++) {
+        pose[0] = (fp32)(400 + 100 * cos(i * 2 * M_PI / 2000));
+        pose[1] = (fp32)(100 * sin(i * 2 * M_PI / 2000));
+        streamer.push_position(pose, 5, 100, 2000);
+    }
+    streamer.start();
+    ret = streamer.wait_finish(true);
+    printf("stream trajectory, ret=%d, acked=%lld\n", ret, streamer.acked());
+
+    arm->reset(true);
+    return 0;
+}
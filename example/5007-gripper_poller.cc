@@ -0,0 +1,56 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+
+#include "xarm/wrapper/gripper_poller.h"
+
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        printf("Please enter IP address\n");
+        return 0;
+    }
+    std::string port(argv[1]);
+
+    XArmAPI *arm = new XArmAPI(port);
+    sleep_milliseconds(500);
+    if (arm->error_code != 0) arm->clean_error();
+    if (arm->warn_code != 0) arm->clean_warn();
+    arm->motion_enable(true);
+    arm->set_mode(0);
+    arm->set_state(0);
+    sleep_milliseconds(500);
+
+    printf("=========================================\n");
+    int ret;
+
+    ret = arm->set_gripper_enable(true);
+    printf("set_gripper_enable, ret=%d\n", ret);
+    ret = arm->set_gripper_speed(5000);
+    printf("set_gripper_speed, ret=%d\n", ret);
+
+    // the waits of set_gripper_position use the samples of the poller
+    GripperPoller poller(arm);
+    ret = poller.start(100);
+    printf("poller start, ret=%d\n", ret);
+    fp32 pos;
+    int err;
+    for (int i = 0; i < 5 && arm->is_connected() && arm->error_code == 0; i++) {
+        long long start_time = get_system_time();
+        ret = arm->set_gripper_position(600, true);
+        printf("set_gripper_position, pos=600, ret=%d, %lld ms\n", ret, get_system_time() - start_time);
+        start_time = get_system_time();
+        ret = arm->set_gripper_position(200, true);
+        printf("set_gripper_position, pos=200, ret=%d, %lld ms\n", ret, get_system_time() - start_time);
+        ret = poller.get_snapshot(&pos, &err);
+        printf("snapshot, ret=%d, pos=%f, err=%d\n", ret, pos, err);
+    }
+    poller.stop();
+
+    return 0;
+}
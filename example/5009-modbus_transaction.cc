@@ -0,0 +1,47 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+
+#include "xarm/wrapper/modbus_transaction.h"
+#include "xarm/core/instruction/servo3_config.h"
+
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        printf("Please enter IP address\n");
+        return 0;
+    }
+    std::string port(argv[1]);
+
+    XArmAPI *arm = new XArmAPI(port);
+    sleep_milliseconds(500);
+    if (arm->error_code != 0) arm->clean_error();
+    if (arm->warn_code != 0) arm->clean_warn();
+    arm->motion_enable(true);
+    arm->set_mode(0);
+    arm->set_state(0);
+    sleep_milliseconds(500);
+
+    printf("=========================================\n");
+    int ret;
+
+    // enable, mode, speed and position of the gripper, enable and mode are one request
+    ModbusTransaction setup(UXBUS_CONF::GRIPPER_ID);
+    setup.write_u16(SERVO3_RG::CON_EN, 1);
+    setup.write_u16(SERVO3_RG::CON_MODE, 0);
+    setup.write_u16(SERVO3_RG::POS_SPD, 5000);
+    setup.write_u32(SERVO3_RG::TAGET_POS, 600);
+    int pos_op = setup.read_holding(SERVO3_RG::CURR_POS, 2);
+    int err_op = setup.read_holding(SERVO3_RG::ERR_CODE);
+    long long start_time = get_system_time();
+    ret = setup.execute(arm);
+    printf("execute, ret=%d, ops=%d, requests=%d, %lld ms\n", ret, setup.get_op_num(), setup.get_request_num(), get_system_time() - start_time);
+    printf("gripper pos=%d, err=%d\n", setup.get_i32(pos_op), setup.get_u16(err_op));
+
+    return 0;
+}
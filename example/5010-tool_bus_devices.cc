@@ -0,0 +1,58 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+
+#include "xarm/wrapper/tool_bus_scheduler.h"
+
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        printf("Please enter IP address\n");
+        return 0;
+    }
+    std::string port(argv[1]);
+
+    XArmAPI *arm = new XArmAPI(port);
+    sleep_milliseconds(500);
+    if (arm->error_code != 0) arm->clean_error();
+    if (arm->warn_code != 0) arm->clean_warn();
+    arm->motion_enable(true);
+    arm->set_mode(0);
+    arm->set_state(0);
+    sleep_milliseconds(500);
+
+    printf("=========================================\n");
+    int ret;
+
+    // a Robotiq 2F gripper (the tool gpio must be set to the baudrate of the gripper)
+    RobotiqGripperDevice gripper(9);
+    ToolBusScheduler scheduler(arm);
+    scheduler.add_device(&gripper);
+    ret = scheduler.start(20);
+    printf("scheduler start, ret=%d\n", ret);
+
+    gripper.activate();
+    int status[8];
+    for (int i = 0; i < 100; i++) {
+        sleep_milliseconds(50);
+        ret = gripper.get_status(status);
+        if (ret == 0 && status[2] == 3) break; // gSTA 3: activation completed
+    }
+    printf("activate, ret=%d, gACT=%d, gSTA=%d\n", ret, status[0], status[2]);
+
+    gripper.move(255, 255, 100);
+    for (int i = 0; i < 100; i++) {
+        sleep_milliseconds(50);
+        ret = gripper.get_status(status);
+        if (ret == 0 && status[3] != 0) break; // gOBJ: stopped on an object or at the position
+    }
+    printf("close, ret=%d, gOBJ=%d, position=%d, current=%d\n", ret, status[3], status[6], status[7]);
+
+    scheduler.stop();
+    return 0;
+}
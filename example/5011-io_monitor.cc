@@ -0,0 +1,52 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+
+#include "xarm/wrapper/io_monitor.h"
+
+XArmAPI *arm = NULL;
+
+void light_curtain(int pin, int level, long long time) {
+    // the curtain is interrupted
+    printf("DI%d falling at %lld, stop\n", pin - IoMonitor::DI0, time);
+    arm->set_state(4);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        printf("Please enter IP address\n");
+        return 0;
+    }
+    std::string port(argv[1]);
+
+    arm = new XArmAPI(port);
+    sleep_milliseconds(500);
+    if (arm->error_code != 0) arm->clean_error();
+    if (arm->warn_code != 0) arm->clean_warn();
+    arm->motion_enable(true);
+    arm->set_mode(0);
+    arm->set_state(0);
+    sleep_milliseconds(500);
+
+    printf("=========================================\n");
+    int ret;
+
+    IoMonitor monitor(arm);
+    monitor.set_debounce(-1, 10);
+    monitor.register_edge_callback(IoMonitor::DI0, IoMonitor::FALLING, light_curtain);
+    ret = monitor.start(200);
+    printf("monitor start, ret=%d\n", ret);
+
+    // wait for a part on the tool input 0
+    long long time;
+    ret = monitor.wait_edge(IoMonitor::TI0, IoMonitor::RISING, 30, &time);
+    printf("wait_edge TI0, ret=%d, time=%lld\n", ret, time);
+
+    monitor.stop();
+    return 0;
+}
@@ -0,0 +1,51 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+
+#include "xarm/wrapper/io_monitor.h"
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        printf("Please enter IP address\n");
+        return 0;
+    }
+    std::string port(argv[1]);
+
+    XArmAPI *arm = new XArmAPI(port);
+    sleep_milliseconds(500);
+    if (arm->error_code != 0) arm->clean_error();
+    if (arm->warn_code != 0) arm->clean_warn();
+    arm->motion_enable(true);
+    arm->set_mode(0);
+    arm->set_state(0);
+    sleep_milliseconds(500);
+
+    printf("=========================================\n");
+    int ret;
+
+    IoMonitor monitor(arm);
+    monitor.set_debounce(-1, 5);
+    ret = monitor.start(500);
+    printf("monitor start, ret=%d\n", ret);
+
+    // pick the part as soon as the sensor on the tool input 0 sees it
+    fp32 pick[6] = { 300, 0, 150, 180, 0, 0 };
+    ret = monitor.arm_position(IoMonitor::TI0, IoMonitor::RISING, pick, 200);
+    printf("arm_position, ret=%d\n", ret);
+
+    long long time;
+    ret = monitor.wait_edge(IoMonitor::TI0, IoMonitor::RISING, 30, &time);
+    printf("wait_edge TI0, ret=%d, time=%lld\n", ret, time);
+    sleep_milliseconds(100);
+    long long sent;
+    ret = monitor.get_trigger_state(IoMonitor::TI0, &sent);
+    printf("trigger state=%d, sent %lld ms after the edge\n", ret, sent - time);
+
+    monitor.stop();
+    return 0;
+}
@@ -0,0 +1,54 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+
+#include "xarm/wrapper/xarm_api.h"
+
+// publisher: ./5013-state_shm 192.168.1.100
+// reader (another process): ./5013-state_shm -r
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        printf("Please enter IP address, or -r to read the state of another process\n");
+        return 0;
+    }
+    std::string port(argv[1]);
+    int ret;
+
+    if (port == "-r") {
+        StateReader reader;
+        ret = reader.open("/xarm_state");
+        printf("reader open, ret=%d\n", ret);
+        if (ret != 0) return 0;
+        RobotState state;
+        for (int i = 0; i < 10; i++) {
+            ret = reader.get_latest(&state);
+            printf("ret=%d, seq=%lld, state=%d, position=[%f, %f, %f]\n", ret, state.seq, state.state, state.position[0], state.position[1], state.position[2]);
+            sleep_milliseconds(500);
+        }
+        RobotState recent[16];
+        int num = reader.get_recent(recent, 16);
+        printf("recent reports: %d\n", num);
+        return 0;
+    }
+
+    XArmAPI *arm = new XArmAPI(port);
+    sleep_milliseconds(500);
+
+    printf("=========================================\n");
+    StatePublisher publisher;
+    ret = publisher.open("/xarm_state");
+    printf("publisher open, ret=%d\n", ret);
+    arm->set_state_publisher(&publisher);
+
+    sleep_milliseconds(60000);
+
+    arm->set_state_publisher(NULL);
+    publisher.close();
+    arm->disconnect();
+    return 0;
+}
@@ -0,0 +1,54 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+
+#include "xarm/wrapper/command_broker.h"
+
+// broker: ./5014-command_broker 192.168.1.100
+// client (another process): ./5014-command_broker 192.168.1.100 -c
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        printf("Please enter IP address\n");
+        return 0;
+    }
+    std::string port(argv[1]);
+    int ret;
+
+    if (argc > 2 && std::string(argv[2]) == "-c") {
+        XArmAPI *arm = new XArmAPI("", false, true);
+        // the commands go through the broker, the reports come from the arm
+        arm->set_command_broker("/tmp/xarm_broker.sock", 200);
+        ret = arm->connect(port);
+        printf("connect, ret=%d\n", ret);
+        unsigned char version[40] = { 0 };
+        ret = arm->get_version(version);
+        printf("get_version, ret=%d, version=%s\n", ret, version);
+        int state;
+        ret = arm->get_state(&state);
+        printf("get_state, ret=%d, state=%d\n", ret, state);
+        arm->disconnect();
+        return 0;
+    }
+
+    XArmAPI *arm = new XArmAPI(port);
+    sleep_milliseconds(500);
+
+    printf("=========================================\n");
+    CommandBroker broker(arm);
+    ret = broker.start("/tmp/xarm_broker.sock");
+    printf("broker start, ret=%d\n", ret);
+
+    for (int i = 0; i < 60; i++) {
+        sleep_milliseconds(1000);
+        printf("clients=%d, requests=%lld, drops=%lld\n", broker.get_client_num(), broker.get_request_num(), broker.get_drop_num());
+    }
+
+    broker.stop();
+    arm->disconnect();
+    return 0;
+}
@@ -0,0 +1,62 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+
+#include "xarm/wrapper/arm_group.h"
+
+static XArmAPI *enable_arm(const std::string &port) {
+    XArmAPI *arm = new XArmAPI(port);
+    sleep_milliseconds(500);
+    if (arm->error_code != 0) arm->clean_error();
+    if (arm->warn_code != 0) arm->clean_warn();
+    arm->motion_enable(true);
+    arm->set_mode(0);
+    arm->set_state(0);
+    return arm;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        printf("Please enter the IP addresses of the two arms\n");
+        return 0;
+    }
+    XArmAPI *left = enable_arm(std::string(argv[1]));
+    XArmAPI *right = enable_arm(std::string(argv[2]));
+    sleep_milliseconds(500);
+
+    printf("=========================================\n");
+    int ret;
+
+    ArmGroup group;
+    int l = group.add_arm(left);
+    int r = group.add_arm(right);
+
+    // both arms move to the handover pose together
+    fp32 left_pose[6] = { 300, 100, 250, 180, 0, 0 };
+    fp32 right_pose[6] = { 300, -100, 250, 180, 0, 0 };
+    ret = group.stage_position(l, left_pose, 100);
+    printf("stage left, ret=%d\n", ret);
+    ret = group.stage_position(r, right_pose, 100);
+    printf("stage right, ret=%d\n", ret);
+
+    // released 10 ms from now, on the clock of both arms
+    int rets[ArmGroup::MAX_ARMS];
+    ret = group.release(get_steady_time_us() + 10000, rets);
+    printf("release, ret=%d, left=%d, right=%d\n", ret, rets[l], rets[r]);
+    printf("sent %lld us apart\n", group.get_send_time(r) - group.get_send_time(l));
+
+    long long starts[ArmGroup::MAX_ARMS];
+    ret = group.wait_motion_start(1, starts);
+    printf("wait_motion_start, ret=%d, started %lld us apart\n", ret, starts[r] - starts[l]);
+
+    ArmGroup::SkewStats send, start;
+    group.get_skew_stats(&send, &start);
+    printf("send skew: max=%lld us, mean=%.1f us\n", send.max, send.mean);
+    printf("start skew: max=%lld us, mean=%.1f us\n", start.max, start.mean);
+    return 0;
+}
@@ -0,0 +1,60 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+
+#include <stdio.h>
+#include <thread>
+#include "xarm/wrapper/xarm_c_api.h"
+
+static void drive(XArmHandle arm, float y) {
+    // every call names its arm, the two threads do not share a current instance
+    xarm_motion_enable(arm, 1, 8);
+    xarm_set_mode(arm, 0);
+    xarm_set_state(arm, 0);
+    float pose[6] = { 300, y, 250, 3.14159f, 0, 0 };
+    int ret = xarm_set_position(arm, pose, -1, 100, 2000, 0, 1, -1);
+    printf("set_position y=%.0f, ret=%d\n", y, ret);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        printf("Please enter the IP addresses of the two arms\n");
+        return 0;
+    }
+    XArmHandle arms[2];
+    arms[0] = xarm_create(argv[1], 1, 0, 1, 1, 1, 0, 1, 1);
+    arms[1] = xarm_create(argv[2], 1, 0, 1, 1, 1, 0, 1, 1);
+
+    printf("=========================================\n");
+    std::thread left(drive, arms[0], 100.0f);
+    std::thread right(drive, arms[1], -100.0f);
+    left.join();
+    right.join();
+
+    // the positions of both arms from their last reports, in one call
+    float poses[12];
+    int rets[2];
+    int num = xarm_get_positions(arms, 2, poses, rets);
+    printf("positions of %d arms: y=%.1f, y=%.1f\n", num, poses[1], poses[7]);
+
+    // the last report read in place
+    unsigned int lock;
+    const RobotState *state;
+    int report_state, cmd_num;
+    do {
+        state = xarm_get_latest_state(arms[0], &lock);
+        if (state == NULL) break;
+        report_state = state->state;
+        cmd_num = state->cmd_num;
+    } while (!xarm_is_state_current(arms[0], state, lock));
+    if (state != NULL) printf("left: state=%d, cmd_num=%d\n", report_state, cmd_num);
+
+    xarm_destroy(arms[0]);
+    xarm_destroy(arms[1]);
+    return 0;
+}
@@ -0,0 +1,49 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+
+#include "xarm/wrapper/modbus_transaction.h"
+
+// no arm needed: the ops that do not fit are refused with a negative code, never taken for an op index
+
+static int failed = 0;
+
+static void check(bool ok, const char *what) {
+    printf("%s: %s\n", ok ? "ok" : "FAILED", what);
+    if (!ok) failed += 1;
+}
+
+int main(int argc, char **argv) {
+    unsigned short values[200];
+    for (int i = 0; i < 200; i++) values[i] = (unsigned short)(0x1000 + i);
+
+    // one request per read, the request after MAX_REQUESTS is refused
+    ModbusTransaction full;
+    int ops[ModbusTransaction::MAX_REQUESTS];
+    for (int i = 0; i < ModbusTransaction::MAX_REQUESTS; i++) ops[i] = full.read_holding(i * 10, 2);
+    int op = full.read_holding(1000, 2);
+    check(op < 0, "a read past MAX_REQUESTS is refused");
+    op = full.write_regs(2000, values, 4);
+    check(op < 0, "a write past MAX_REQUESTS is refused");
+    check(full.get_op_num() == ModbusTransaction::MAX_REQUESTS && full.get_request_num() == ModbusTransaction::MAX_REQUESTS, "the refused ops are not queued");
+    bool untouched = true;
+    for (int i = 0; i < ModbusTransaction::MAX_REQUESTS; i++) {
+        untouched = untouched && ops[i] == i && full.get_u16(ops[i], 0) == 0 && full.get_u16(ops[i], 1) == 0;
+    }
+    check(untouched, "the registers of the queued ops are untouched");
+
+    // a write longer than a request can carry, nothing written
+    ModbusTransaction fresh;
+    check(fresh.write_regs(0, values, 200) < 0, "a write of 200 registers is refused");
+    check(fresh.read_holding(0, ModbusTransaction::MAX_READ_REGS + 1) < 0, "a read past MAX_READ_REGS is refused");
+    check(fresh.write_u16(0xFFFF, 1) == 0 && fresh.write_u32(0xFFFF, 1) < 0, "the registers past 0xFFFF are refused");
+    check(fresh.get_op_num() == 1, "only the valid op is queued");
+
+    printf("%s\n", failed == 0 ? "all passed" : "some failed");
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,60 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+
+#include "xarm/wrapper/online_trajectory_generator.h"
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		printf("Please enter IP address\n");
+		return 0;
+	}
+	std::string port(argv[1]);
+
+	XArmAPI *arm = new XArmAPI(port);
+	sleep_milliseconds(500);
+	if (arm->error_code != 0) arm->clean_error();
+	if (arm->warn_code != 0) arm->clean_warn();
+	arm->motion_enable(true);
+	arm->set_mode(0);
+	arm->set_state(0);
+	sleep_milliseconds(500);
+
+	printf("=========================================\n");
+
+	int ret;
+	arm->reset(true);
+
+	arm->set_mode(1);
+	arm->set_state(0);
+	sleep_milliseconds(100);
+
+	OnlineTrajectoryGenerator otg(arm, OnlineTrajectoryGenerator::JOINT_SPACE);
+	otg.set_limits(60, 300, 3000);
+	ret = otg.start();
+	printf("start, ret=%d\n", ret);
+
+	fp32 angles[7] = { 90, 0, 0, 0, 0, 0, 0 };
+	otg.set_target(angles);
+	sleep_milliseconds(500);
+	// change the target on the way, the motion goes on smoothly
+	angles[0] = -45;
+	otg.set_target(angles);
+	ret = otg.wait_reached();
+	printf("wait_reached, ret=%d\n", ret);
+
+	angles[0] = 0;
+	otg.set_target(angles);
+	ret = otg.wait_reached();
+	printf("wait_reached, ret=%d\n", ret);
+	otg.stop();
+
+	arm->set_mode(0);
+	arm->set_state(0);
+	return 0;
+}
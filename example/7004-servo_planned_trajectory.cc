@@ -0,0 +1,68 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+
+#include "xarm/wrapper/trajectory_planner.h"
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		printf("Please enter IP address\n");
+		return 0;
+	}
+	std::string port(argv[1]);
+
+	XArmAPI *arm = new XArmAPI(port);
+	sleep_milliseconds(500);
+	if (arm->error_code != 0) arm->clean_error();
+	if (arm->warn_code != 0) arm->clean_warn();
+	arm->motion_enable(true);
+	arm->set_mode(0);
+	arm->set_state(0);
+	sleep_milliseconds(500);
+
+	printf("=========================================\n");
+
+	int ret;
+	arm->reset(true);
+
+	// a square in the x-y plane, starting at the current position
+	fp32 pose[6];
+	arm->get_position(pose);
+	TrajectoryPlanner planner(TrajectoryPlanner::CARTESIAN_SPACE);
+	fp32 offsets[5][2] = { { 0, 0 }, { 100, 0 }, { 100, 100 }, { 0, 100 }, { 0, 0 } };
+	for (int i = 0; i < 5; i++) {
+		fp32 point[6] = { pose[0] + offsets[i][0], pose[1] + offsets[i][1], pose[2], pose[3], pose[4], pose[5] };
+		planner.add_waypoint(point);
+	}
+	fp32 speed[6] = { 100, 100, 100, 30, 30, 30 };
+	fp32 acc[6] = { 1000, 1000, 1000, 300, 300, 300 };
+	planner.set_limits(speed, acc);
+	planner.set_blend_radius(20);
+	ret = planner.plan(0.004);
+	printf("plan, ret=%d, setpoints=%d, duration=%f\n", ret, planner.get_setpoint_num(), planner.get_duration());
+
+	arm->set_mode(1);
+	arm->set_state(0);
+	sleep_milliseconds(100);
+	ret = planner.execute(arm);
+	printf("execute, ret=%d\n", ret);
+
+	arm->set_mode(0);
+	arm->set_state(0);
+	sleep_milliseconds(100);
+
+	// the same square as move_lineb segments
+	TrajectoryStreamer streamer(arm);
+	ret = planner.push_segments(&streamer, 0.1, 100, 1000);
+	printf("push_segments, segments=%d\n", ret);
+	streamer.start();
+	ret = streamer.wait_finish(true);
+	printf("wait_finish, ret=%d\n", ret);
+	streamer.stop();
+	return 0;
+}
@@ -0,0 +1,46 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+
+#include <stdio.h>
+#include "xarm/core/instruction/uxbus_cmd_config.h"
+#include "xarm/wrapper/collision_checker.h"
+
+// no arm needed: the arm stands on a table, which is only hit when the arm reaches down into it
+
+static int failed = 0;
+
+static void check(bool ok, int axis, const char *what) {
+    printf("%s: xArm%d %s\n", ok ? "ok" : "FAILED", axis, what);
+    if (!ok) failed += 1;
+}
+
+int main(int argc, char **argv) {
+    const float PI = 3.14159265f;
+    float table_min[3] = { -1000, -1000, -100 };
+    float table_max[3] = { 1000, 1000, 0 };
+    float post_min[3] = { 40, -20, 100 };
+    float post_max[3] = { 80, 20, 150 };
+    for (int axis = 5; axis <= 7; axis++) {
+        CollisionChecker checker(axis);
+        checker.add_box(table_min, table_max);
+        float home[7] = { 0 };
+        check(checker.check(home) == 0, axis, "at home over the table is free");
+        // the shoulder down to the table
+        float down[7] = { 0 };
+        down[1] = axis == 7 ? PI * 0.6f : PI * 0.75f;
+        if (axis == 7) down[3] = PI * 0.5f;
+        check(checker.check(down) == UXBUS_STATE::COLLISION, axis, "reaching into the table collides");
+        check(checker.check_path(home, down) == UXBUS_STATE::COLLISION, axis, "the path into the table collides");
+        // an obstacle against the base column is still seen
+        checker.add_box(post_min, post_max);
+        check(checker.check(home) == UXBUS_STATE::COLLISION, axis, "an obstacle against the base collides");
+    }
+    printf("%s\n", failed == 0 ? "all passed" : "some failed");
+    return failed == 0 ? 0 : 1;
+}
@@ -25,6 +25,11 @@ public:
 	char flush(void);
 	char push(void *data);
 	char pop(void *data);
+	/*
+	* A node with its time stamp, the stamp of a node pushed without one is 0
+	*/
+	char push(void *data, long long stamp);
+	char pop(void *data, long long *stamp);
 	char get(void *data);
 	long size(void);
 	long node_size(void);
@@ -39,6 +44,7 @@ private:
 	long head_;
 	long tail_;
 	char *buf_;
+	long long *stamps_;
 	//pthread_mutex_t mutex_;
 
 	std::thread report_thread_;
@@ -8,7 +8,9 @@
 #define CORE_DEBUG_DEBUG_PRINT_H_
 
 #include "xarm/core/common/data_type.h"
+#include "xarm/core/debug/logger.h"
 
+// written by the log thread at XARM_LOG_LEVEL_INFO, see logger.h
 void print_log(const char *format, ...);
 void print_nvect(const char *str, double vect[], int n);
 void print_nvect(const char *str, float *vect, int n);
@@ -0,0 +1,143 @@
+/* Copyright 2017 UFACTORY Inc. All Rights Reserved.
+ *
+ * Software License Agreement (BSD License)
+ *
+ * Author: Jimy Zhang <jimy92@163.com>
+ ============================================================================*/
+#ifndef CORE_DEBUG_LOGGER_H_
+#define CORE_DEBUG_LOGGER_H_
+
+#include <string>
+#include <type_traits>
+
+/*
+* The log of the library, written by a background thread
+* A call only copies the format (a string literal, kept by pointer) and the binary arguments into a lock-free
+*   ring, the formatting and the sink run in the thread, so a caller never waits for the terminal.
+* When the ring is full the record is dropped and counted (get_log_drop_num), a caller never blocks.
+* Compile-time filtering: define XARM_LOG_LEVEL (default XARM_LOG_LEVEL_DEBUG), the macros below it are empty.
+* Runtime filtering: set_log_level (default XARM_LOG_LEVEL_INFO), a record below it costs an atomic load.
+* The conversions of printf are supported without * width/precision: d i u o x X c f F e E g G a A s p %
+*/
+#define XARM_LOG_LEVEL_DEBUG 0
+#define XARM_LOG_LEVEL_INFO 1
+#define XARM_LOG_LEVEL_WARN 2
+#define XARM_LOG_LEVEL_ERROR 3
+#define XARM_LOG_LEVEL_NONE 4
+
+#ifndef XARM_LOG_LEVEL
+#define XARM_LOG_LEVEL XARM_LOG_LEVEL_DEBUG
+#endif
+
+#if XARM_LOG_LEVEL <= XARM_LOG_LEVEL_DEBUG
+#define XARM_LOG_DEBUG(...) xarm_log(XARM_LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define XARM_LOG_HEX(str, data, len) xarm_log_hex(XARM_LOG_LEVEL_DEBUG, str, data, len)
+#else
+#define XARM_LOG_DEBUG(...) ((void)0)
+#define XARM_LOG_HEX(str, data, len) ((void)0)
+#endif
+#if XARM_LOG_LEVEL <= XARM_LOG_LEVEL_INFO
+#define XARM_LOG_INFO(...) xarm_log(XARM_LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define XARM_LOG_INFO(...) ((void)0)
+#endif
+#if XARM_LOG_LEVEL <= XARM_LOG_LEVEL_WARN
+#define XARM_LOG_WARN(...) xarm_log(XARM_LOG_LEVEL_WARN, __VA_ARGS__)
+#else
+#define XARM_LOG_WARN(...) ((void)0)
+#endif
+#if XARM_LOG_LEVEL <= XARM_LOG_LEVEL_ERROR
+#define XARM_LOG_ERROR(...) xarm_log(XARM_LOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+#define XARM_LOG_ERROR(...) ((void)0)
+#endif
+
+/*
+* @param level: the records below it are not kept, XARM_LOG_LEVEL_NONE means none
+*/
+void set_log_level(int level);
+int get_log_level(void);
+
+/*
+* Where the lines go, called by the log thread one line at a time, without the end of line
+* @param sink: NULL means the default one, printf to the standard output
+*   time: microseconds since the epoch, when the record was made
+*/
+void set_log_sink(void(*sink)(int level, long long time, const char *line));
+
+/*
+* Wait until the records made before the call are written, at most timeout milliseconds
+*/
+void log_flush(int timeout = 1000);
+
+long long get_log_drop_num(void); // the records dropped because the ring was full
+
+/*
+* A record, written in place in the ring
+*/
+struct LogRecord {
+	static const int DATA_SIZE = 464;
+	static const int TEXT = 0; // data is a formatted line
+	static const int ARGS = 1; // data is the arguments of format
+	static const int HEX = 2; // data is a binary buffer, format the title
+
+	int level;
+	int kind;
+	long long time;
+	const char *format;
+	unsigned long long ticket; // the position in the ring
+	int size; // the bytes of data used
+	int truncated;
+	unsigned char data[DATA_SIZE];
+};
+
+LogRecord *log_reserve_(int level, int kind, const char *format);
+void log_commit_(LogRecord *rec);
+void log_put_int_(LogRecord *rec, long long value, bool is_signed);
+void log_put_double_(LogRecord *rec, double value);
+void log_put_str_(LogRecord *rec, const char *str);
+void log_put_ptr_(LogRecord *rec, const void *ptr);
+
+template<typename T>
+inline void log_put_arg_(LogRecord *rec, T value, typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type * = 0) {
+	log_put_int_(rec, (long long)value, std::is_signed<T>::value);
+}
+template<typename T>
+inline void log_put_arg_(LogRecord *rec, T value, typename std::enable_if<std::is_floating_point<T>::value>::type * = 0) {
+	log_put_double_(rec, (double)value);
+}
+template<typename T>
+inline void log_put_arg_(LogRecord *rec, T *ptr) { log_put_ptr_(rec, (const void *)ptr); }
+// the strings are copied, the caller may free them at once
+inline void log_put_arg_(LogRecord *rec, const char *str) { log_put_str_(rec, str); }
+inline void log_put_arg_(LogRecord *rec, char *str) { log_put_str_(rec, str); }
+inline void log_put_arg_(LogRecord *rec, const unsigned char *str) { log_put_str_(rec, (const char *)str); }
+inline void log_put_arg_(LogRecord *rec, unsigned char *str) { log_put_str_(rec, (const char *)str); }
+inline void log_put_arg_(LogRecord *rec, const std::string &str) { log_put_str_(rec, str.c_str()); }
+
+inline void log_put_args_(LogRecord *) {}
+template<typename T, typename... Args>
+inline void log_put_args_(LogRecord *rec, T value, Args... args) {
+	log_put_arg_(rec, value);
+	log_put_args_(rec, args...);
+}
+
+/*
+* @param format: a string literal, it is read by the log thread later
+*/
+template<typename... Args>
+inline void xarm_log(int level, const char *format, Args... args) {
+	if (level < get_log_level()) return;
+	LogRecord *rec = log_reserve_(level, LogRecord::ARGS, format);
+	if (rec == NULL) return;
+	log_put_args_(rec, args...);
+	log_commit_(rec);
+}
+
+/*
+* A buffer in hex, "<str> xx xx xx ...", truncated to LogRecord::DATA_SIZE bytes
+* @param str: a string literal
+*/
+void xarm_log_hex(int level, const char *str, const unsigned char *data, int len);
+
+#endif
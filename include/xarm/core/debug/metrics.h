@@ -0,0 +1,122 @@
+/* Copyright 2017 UFACTORY Inc. All Rights Reserved.
+ *
+ * Software License Agreement (BSD License)
+ *
+ * Author: Jimy Zhang <jimy92@163.com>
+ ============================================================================*/
+#ifndef CORE_DEBUG_METRICS_H_
+#define CORE_DEBUG_METRICS_H_
+
+#include <atomic>
+#include <string>
+
+/*
+* A histogram of latencies in microseconds, lock-free
+* The buckets are exact below 16us, then 8 per power of two (at most 12.5% wide), up to about 19 hours
+*/
+class LatencyHistogram {
+public:
+	static const int BUCKET_NUM = 16 + 8 * 32;
+
+	LatencyHistogram(void);
+
+	void record(long long us);
+	void reset(void);
+	/*
+	* @param counts: unsigned long long[BUCKET_NUM], out
+	*/
+	void copy(unsigned long long *counts);
+
+	static int bucket_of(long long us);
+	static long long bucket_upper(int index); // the largest value of the bucket
+
+private:
+	std::atomic<unsigned long long> counts_[BUCKET_NUM];
+};
+
+/*
+* The counters of a funcode (or all of them) at a time
+* The latency is from the write of a request to the take of its reply by the caller
+*/
+struct CommandStats {
+	int funcode; // -1: all the funcodes
+	long long sent; // requests written
+	long long replies; // replies taken
+	long long timeouts; // UXBUS_STATE::ERR_TOUT
+	long long err_num; // replies of a transaction id no caller claimed (late or unknown), dropped from the stash
+	long long err_leng; // UXBUS_STATE::ERR_LENG
+	long long err_fun; // UXBUS_STATE::ERR_FUN
+	long long err_prot; // UXBUS_STATE::ERR_PROT
+	long long bytes_out;
+	long long bytes_in;
+	long long min_us; // 0 without reply
+	long long max_us;
+	long long sum_us;
+	unsigned long long buckets[LatencyHistogram::BUCKET_NUM];
+
+	/*
+	* @param q: 0 ~ 1, 0.99 is the 99th percentile
+	* return: the upper bound of the bucket of the percentile (us), 0 without reply
+	*/
+	long long percentile(double q) const;
+	long long mean_us(void) const { return replies > 0 ? sum_us / replies : 0; }
+};
+
+/*
+* The counters of the commands of a connection, by funcode, recorded by the transport (UxbusCmd)
+* The records are lock-free, the counters of a funcode are allocated on its first record
+*/
+class CommandMetrics {
+public:
+	static const int FUNCODE_NUM = 256;
+
+	CommandMetrics(void);
+	~CommandMetrics(void);
+
+	void record_send(int funcode, int bytes);
+	/*
+	* @param state: the result of the check of the reply, 0 or UXBUS_STATE
+	*/
+	void record_reply(int funcode, long long latency_us, int bytes, int state);
+	void record_timeout(int funcode);
+	void record_drop(int funcode); // a reply nobody took, counted in err_num
+
+	/*
+	* @param funcode: -1 means the sum of all the funcodes
+	* return: 0: success, -1: nothing recorded for the funcode
+	*/
+	int get_stats(int funcode, CommandStats *stats);
+	/*
+	* The counters are zeroed one by one, a record at the same time may be split across the reset
+	*/
+	void reset(void);
+	/*
+	* The text exposition of the counters, one "name{labels} value" line per value
+	* @param conn: the label of the connection
+	*/
+	std::string dump(const char *conn);
+
+	static long long now_us(void); // the monotonic clock of the records
+
+private:
+	struct Slot_;
+	Slot_ *slot_(int funcode);
+
+	std::atomic<Slot_ *> slots_[FUNCODE_NUM];
+};
+
+/*
+* The registry of the metrics of the process, one entry per connection
+* The transports unregister themselves when they are deleted
+* @param name: the label of the connection in the dump, the ip or the serial port
+*/
+void metrics_register(const char *name, CommandMetrics *metrics);
+void metrics_unregister(CommandMetrics *metrics);
+/*
+* return: 0: success, -1: no connection of the name or nothing recorded for the funcode
+*/
+int metrics_get_stats(const char *name, int funcode, CommandStats *stats);
+void metrics_reset(void);
+std::string metrics_dump(void); // the text exposition of all the connections
+
+#endif
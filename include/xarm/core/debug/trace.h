@@ -0,0 +1,76 @@
+/* Copyright 2017 UFACTORY Inc. All Rights Reserved.
+ *
+ * Software License Agreement (BSD License)
+ *
+ * Author: Jimy Zhang <jimy92@163.com>
+ ============================================================================*/
+#ifndef CORE_DEBUG_TRACE_H_
+#define CORE_DEBUG_TRACE_H_
+
+#include <atomic>
+
+/*
+* The timeline of the library, saved as a Chrome trace (chrome://tracing, ui.perfetto.dev)
+* A span is recorded when it ends, into a buffer of its thread without a lock, the buffers are kept after
+*   their thread ends and reused by the next one, so the threads of the callbacks do not add buffers.
+* When the buffer of a thread is full its spans are dropped and counted (get_trace_drop_num).
+* Off by default, a span costs an atomic load then, define XARM_NO_TRACE to compile the spans out.
+*/
+#ifndef XARM_NO_TRACE
+#define XARM_TRACE_CONCAT_(a, b) a##b
+#define XARM_TRACE_NAME_(line) XARM_TRACE_CONCAT_(xarm_trace_span_, line)
+#define XARM_TRACE_SCOPE(name) TraceSpan XARM_TRACE_NAME_(__LINE__)(name)
+#define XARM_TRACE_SCOPE_ARG(name, arg) TraceSpan XARM_TRACE_NAME_(__LINE__)(name, arg)
+#else
+#define XARM_TRACE_SCOPE(name) ((void)0)
+#define XARM_TRACE_SCOPE_ARG(name, arg) ((void)0)
+#endif
+
+/*
+* Start a new trace, the spans of the previous one are discarded
+* @param events_per_thread: the spans kept per thread
+*/
+void trace_start(int events_per_thread = 65536);
+void trace_stop(void);
+
+/*
+* Write the spans of the current (or stopped) trace as a Chrome trace JSON
+* return: 0: success, -1: the file can not be written
+*/
+int trace_save(const char *path);
+
+/*
+* The name of the calling thread in the traces, the threads of the library name themselves when they start
+*/
+void trace_set_thread_name(const char *name);
+
+long long get_trace_drop_num(void); // the spans dropped because the buffer of their thread was full
+
+extern std::atomic<bool> trace_on_;
+void trace_record_(const char *name, long long start_us, int arg);
+long long trace_now_us_(void);
+
+/*
+* A span from its construction to its destruction
+* @param name: a string literal, it is read when the trace is saved
+* @param arg: shown as "arg" in the trace, -1 means none
+*/
+class TraceSpan {
+public:
+	TraceSpan(const char *name, int arg = -1) : name_(name), arg_(arg) {
+		start_us_ = trace_on_.load(std::memory_order_relaxed) ? trace_now_us_() : -1;
+	}
+	~TraceSpan(void) {
+		if (start_us_ >= 0) trace_record_(name_, start_us_, arg_);
+	}
+
+private:
+	TraceSpan(const TraceSpan &);
+	TraceSpan &operator=(const TraceSpan &);
+
+	const char *name_;
+	int arg_;
+	long long start_us_;
+};
+
+#endif
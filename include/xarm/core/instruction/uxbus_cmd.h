@@ -8,11 +8,14 @@
 #define CORE_INSTRUCTION_UXBUS_CMD_H_
 
 #include "xarm/core/common/data_type.h"
+#include "xarm/core/debug/metrics.h"
+#include "xarm/core/instruction/uxbus_cmd_config.h"
+#include "xarm/core/instruction/uxbus_cmd_desc.h"
 
 class UxbusCmd {
 public:
 	UxbusCmd(void);
-	~UxbusCmd(void);
+	virtual ~UxbusCmd(void);
 
 	int get_version(unsigned char rx_data[40]);
 	int get_robot_sn(unsigned char rx_data[40]);
@@ -102,8 +105,15 @@ public:
 	int tgpio_get_analog2(float *value);
 
 	int tgpio_set_modbus(unsigned char *modbus_t, int len_t, unsigned char *ret_data);
+	/*
+	* tgpio_set_modbus in two halves, so several requests can be in flight on the tcp port
+	* return: tgpio_post_modbus: the transaction id (>= 0), -1: sending failed
+	*/
+	int tgpio_post_modbus(unsigned char *modbus_t, int len_t);
+	int tgpio_pend_modbus(int trans_id, unsigned char *ret_data, int timeout = UXBUS_CONF::GET_TIMEOUT);
 	int gripper_modbus_w16s(int addr, float value, int len);
 	int gripper_modbus_r16s(int addr, int len, unsigned char *rx_data);
+	int gripper_modbus_post_r16s(int addr, int len);
 	int gripper_modbus_set_en(int value);
 	int gripper_modbus_set_mode(int value);
 	int gripper_modbus_set_zero(void);
@@ -131,12 +141,117 @@ public:
 	int cgpio_set_outfun(int num, int fun);
 	int cgpio_get_state(int *state, int *digit_io, float *analog, int *input_conf, int *output_conf);
 
+	/*
+	* Send several read requests back to back and collect the replies afterwards,
+	*   the whole burst costs one round trip on transports that route replies by transaction id
+	* @param count: number of requests
+	* @param funcodes: funcode of every request
+	* @param nums: reply length of every request
+	* @param rx_datas: reply buffer of every request
+	* @param rets: state of every reply
+	* return: 0: all requests were sent, UXBUS_STATE::ERR_NOTTCP: sending failed
+	*/
+	int get_nu8_pipelined(int count, const int funcodes[], const int nums[], unsigned char *rx_datas[], int rets[]);
+
+	/*
+	* Send a command described by UXBUS_CMD without waiting for its reply
+	* @param tx: CMD::tx_type[] of the request parameters, NULL if the command has no parameter
+	* return: the transaction id to pass to pend_cmd (>= 0), -1: sending failed
+	*/
+	template<class CMD>
+	int post_cmd(const typename CMD::tx_type *tx = NULL) {
+		unsigned char tx_data[CMD::tx_len + 1];
+		CMD::encode(tx, tx_data);
+		return send_xbus(CMD::funcode, tx_data, CMD::tx_len);
+	}
+
+	/*
+	* post_cmd ahead of the requests of the other threads waiting to be written, for stop and pause
+	* @param need_reply: false: the reply is dropped when it comes, so it never takes the room of the other replies
+	* return: the transaction id to pass to pend_cmd (>= 0), -1: sending failed
+	*/
+	template<class CMD>
+	int post_urgent(const typename CMD::tx_type *tx = NULL, bool need_reply = true) {
+		unsigned char tx_data[CMD::tx_len + 1];
+		CMD::encode(tx, tx_data);
+		return send_urgent(CMD::funcode, tx_data, CMD::tx_len, need_reply);
+	}
+
+	/*
+	* Wait for the reply of a command sent by post_cmd
+	* @param trans_id: the return of post_cmd
+	* @param rx: CMD::rx_type[] of the reply, NULL if the command has no reply, left as is without a reply (has_reply)
+	* @param timeout: milliseconds
+	*/
+	template<class CMD>
+	int pend_cmd(int trans_id, typename CMD::rx_type *rx = NULL, int timeout = CMD::timeout) {
+		unsigned char rx_data[CMD::rx_len + 1] = { 0 };
+		int ret = send_pend(CMD::funcode, CMD::rx_len, timeout, rx_data, trans_id);
+		if (has_reply(ret)) CMD::decode(rx_data, rx);
+		return ret;
+	}
+
+	/*
+	* Whether a state of a command comes with its reply: the reply is valid with an error or a warning of the arm
+	*/
+	static bool has_reply(int ret) { return ret == 0 || ret == UXBUS_STATE::ERR_CODE || ret == UXBUS_STATE::WAR_CODE; }
+
+	static const int MAX_FRAME_LEN = UXBUS_CONF::MAX_DATA_LEN + 8;
+
+	/*
+	* Encode a command described by UXBUS_CMD into a whole frame of the transport, to be sent later by send_frame
+	*   without encoding anything again
+	* @param frame: unsigned char[MAX_FRAME_LEN]
+	* return: the length of the frame (> 0), -1: the transport can not pre-encode frames
+	*/
+	template<class CMD>
+	int build_frame(const typename CMD::tx_type *tx, unsigned char *frame) {
+		unsigned char tx_data[CMD::tx_len + 1];
+		CMD::encode(tx, tx_data);
+		return encode_frame(CMD::funcode, tx_data, CMD::tx_len, frame);
+	}
+
+	/*
+	* Send a frame of build_frame, only the transaction id is written into it (tcp)
+	* return: the transaction id to pass to pend_cmd (>= 0), -1: sending failed
+	*/
+	virtual int send_frame(unsigned char *frame, int len);
+
+	/*
+	* Take the whole reply frame of a transaction as received, to relay it
+	* @param frame: unsigned char[MAX_FRAME_LEN]
+	* @param len: the length of the frame
+	* @param timeout: milliseconds, 0 means only the replies already received (not counted as a timeout in
+	*   the metrics, a caller polling counts the timeouts with get_metrics()->record_timeout)
+	* return: 0: success, UXBUS_STATE::ERR_TOUT: no reply yet, UXBUS_STATE::ERR_LENG: the frame is too long
+	*/
+	virtual int recv_frame(int trans_id, unsigned char *frame, int *len, int timeout = 0);
+
 	virtual void close(void);
 
+	/*
+	* The latencies and the errors of the commands of the connection, by funcode
+	*/
+	CommandMetrics *get_metrics(void) { return &metrics_; }
+
+protected:
+	CommandMetrics metrics_;
+
 private:
+	virtual int encode_frame(int funcode, unsigned char *datas, int num, unsigned char *frame);
 	virtual int check_xbus_prot(unsigned char *data, int funcode);
-	virtual int send_pend(int funcode, int num, int timeout, unsigned char *rx_data);
+	/*
+	* @param trans_id: transaction id returned by send_xbus, -1 means the last request
+	*/
+	virtual int send_pend(int funcode, int num, int timeout, unsigned char *rx_data, int trans_id = -1);
+	/*
+	* return: the transaction id of the request (>= 0), -1: failed
+	*/
 	virtual int send_xbus(int funcode, unsigned char *txdata, int num);
+	/*
+	* send_xbus ahead of the other requests, the transports without a queue just send it
+	*/
+	virtual int send_urgent(int funcode, unsigned char *txdata, int num, bool need_reply);
 	int set_nu8(int funcode, int *datas, int num);
 	int get_nu8(int funcode, int *rx_data, int num);
 	int get_nu8(int funcode, unsigned char *rx_data, int num);
@@ -147,6 +262,18 @@ private:
 	int get_nfp32(int funcode, float *rx_data, int num);
 	int swop_nfp32(int funcode, float tx_datas[], int txn, float *rx_data, int rxn);
 	int is_nfp32(int funcode, float datas[], int txn, int *value);
+
+	/*
+	* Send a command described by UXBUS_CMD, the request and the reply are encoded on the stack
+	* @param tx: CMD::tx_type[] of the request parameters, NULL if the command has no parameter
+	* @param rx: CMD::rx_type[] of the reply, NULL if the command has no reply
+	*/
+	template<class CMD>
+	int send_cmd(const typename CMD::tx_type *tx = NULL, typename CMD::rx_type *rx = NULL) {
+		int trans_id = post_cmd<CMD>(tx);
+		if (trans_id < 0) { return UXBUS_STATE::ERR_NOTTCP; }
+		return pend_cmd<CMD>(trans_id, rx);
+	}
 };
 
 #endif
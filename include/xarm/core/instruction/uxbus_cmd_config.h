@@ -126,6 +126,8 @@ public:
 	static const int EMERGENCY_STOP = -9;
 	static const int SERVO_NOT_EXIST = -10;
 	static const int CONVERT_FAILED = -11;
+	static const int COLLISION = -12;
+	static const int REPORT_STALE = -13;
 	static const int ERR_CODE = 1;
 	static const int WAR_CODE = 2;
 	static const int ERR_TOUT = 3;
@@ -163,6 +165,7 @@ public:
 
 	static const int SET_TIMEOUT = 1000;  // ms
 	static const int GET_TIMEOUT = 1000;  // ms
+	static const int MAX_DATA_LEN = 256;  // bytes of the parameters of a request or a reply
 	static const int GRIPPER_ID = 8;
 	static const int TGPIO_ID = 9;
 	static const int MASTER_ID = 0xAA;
@@ -0,0 +1,201 @@
+/* Copyright 2017 UFACTORY Inc. All Rights Reserved.
+ *
+ * Software License Agreement (BSD License)
+ *
+ * Author: Jimy Zhang <jimy92@163.com>
+ ============================================================================*/
+#ifndef CORE_INSTRUCTION_UXBUS_CMD_DESC_H_
+#define CORE_INSTRUCTION_UXBUS_CMD_DESC_H_
+
+#include "xarm/core/common/data_type.h"
+#include "xarm/core/instruction/uxbus_cmd_config.h"
+
+/*
+ * Field codecs: how the elements of a request/reply are laid out on the bus
+ */
+class UxbusU8 {
+public:
+	typedef int host_type;
+	static const int size = 1;
+	static void encode(const int *data, unsigned char *hex, int n) {
+		for (int i = 0; i < n; i++) { hex[i] = (unsigned char)data[i]; }
+	}
+	static void decode(unsigned char *hex, int *data, int n) {
+		for (int i = 0; i < n; i++) { data[i] = hex[i]; }
+	}
+};
+
+class UxbusBytes {
+public:
+	typedef unsigned char host_type;
+	static const int size = 1;
+	static void encode(const unsigned char *data, unsigned char *hex, int n) {
+		for (int i = 0; i < n; i++) { hex[i] = data[i]; }
+	}
+	static void decode(unsigned char *hex, unsigned char *data, int n) {
+		for (int i = 0; i < n; i++) { data[i] = hex[i]; }
+	}
+};
+
+class UxbusU16 {
+public:
+	typedef int host_type;
+	static const int size = 2;
+	static void encode(const int *data, unsigned char *hex, int n) {
+		for (int i = 0; i < n; i++) { bin16_to_8(data[i], &hex[i * 2]); }
+	}
+	static void decode(unsigned char *hex, int *data, int n) {
+		for (int i = 0; i < n; i++) { data[i] = bin8_to_16(&hex[i * 2]); }
+	}
+};
+
+class UxbusI32 {
+public:
+	typedef int host_type;
+	static const int size = 4;
+	static void encode(const int *data, unsigned char *hex, int n) {
+		for (int i = 0; i < n; i++) { int32_to_hex(data[i], &hex[i * 4]); }
+	}
+	static void decode(unsigned char *hex, int *data, int n) {
+		union _int32hex {
+			int data;
+			unsigned char datahex[4];
+		} int32hex;
+		for (int i = 0; i < n; i++) {
+			for (int j = 0; j < 4; j++) { int32hex.datahex[j] = hex[i * 4 + j]; }
+			data[i] = int32hex.data;
+		}
+	}
+};
+
+class UxbusFp32 {
+public:
+	typedef float host_type;
+	static const int size = 4;
+	static void encode(const float *data, unsigned char *hex, int n) {
+		for (int i = 0; i < n; i++) { fp32_to_hex(data[i], &hex[i * 4]); }
+	}
+	static void decode(unsigned char *hex, float *data, int n) {
+		hex_to_nfp32(hex, data, n);
+	}
+};
+
+/*
+ * Compile-time description of a command: funcode, request layout and reply length
+ * @param FUNCODE: see UXBUS_RG
+ * @param TX/RX: field codec of the request/reply elements
+ * @param TX_NUM/RX_NUM: number of request/reply elements
+ */
+template<int FUNCODE, class TX, int TX_NUM, class RX, int RX_NUM>
+class UxbusCmdDesc {
+public:
+	typedef typename TX::host_type tx_type;
+	typedef typename RX::host_type rx_type;
+	static const int funcode = FUNCODE;
+	static const int tx_len = TX_NUM * TX::size;
+	static const int rx_len = RX_NUM * RX::size;
+	static const int timeout = RX_NUM == 0 ? UXBUS_CONF::SET_TIMEOUT : UXBUS_CONF::GET_TIMEOUT;
+
+	static void encode(const tx_type *data, unsigned char *hex) { TX::encode(data, hex, TX_NUM); }
+	static void decode(unsigned char *hex, rx_type *data) { RX::decode(hex, data, RX_NUM); }
+};
+
+class UXBUS_CMD {
+public:
+	UXBUS_CMD(void) {}
+	~UXBUS_CMD(void) {}
+
+	typedef UxbusCmdDesc<UXBUS_RG::GET_VERSION, UxbusU8, 0, UxbusBytes, 40> GET_VERSION;
+	typedef UxbusCmdDesc<UXBUS_RG::GET_ROBOT_SN, UxbusU8, 0, UxbusBytes, 40> GET_ROBOT_SN;
+	typedef UxbusCmdDesc<UXBUS_RG::CHECK_VERIFY, UxbusU8, 0, UxbusU8, 1> CHECK_VERIFY;
+	typedef UxbusCmdDesc<UXBUS_RG::RELOAD_DYNAMICS, UxbusU8, 0, UxbusU8, 0> RELOAD_DYNAMICS;
+	typedef UxbusCmdDesc<UXBUS_RG::SHUTDOWN_SYSTEM, UxbusU8, 1, UxbusU8, 0> SHUTDOWN_SYSTEM;
+
+	typedef UxbusCmdDesc<UXBUS_RG::MOTION_EN, UxbusU8, 2, UxbusU8, 0> MOTION_EN;
+	typedef UxbusCmdDesc<UXBUS_RG::SET_STATE, UxbusU8, 1, UxbusU8, 0> SET_STATE;
+	typedef UxbusCmdDesc<UXBUS_RG::GET_STATE, UxbusU8, 0, UxbusU8, 1> GET_STATE;
+	typedef UxbusCmdDesc<UXBUS_RG::GET_CMDNUM, UxbusU8, 0, UxbusU16, 1> GET_CMDNUM;
+	typedef UxbusCmdDesc<UXBUS_RG::GET_ERROR, UxbusU8, 0, UxbusU8, 2> GET_ERROR;
+	typedef UxbusCmdDesc<UXBUS_RG::CLEAN_ERR, UxbusU8, 0, UxbusU8, 0> CLEAN_ERR;
+	typedef UxbusCmdDesc<UXBUS_RG::CLEAN_WAR, UxbusU8, 0, UxbusU8, 0> CLEAN_WAR;
+	typedef UxbusCmdDesc<UXBUS_RG::SET_BRAKE, UxbusU8, 2, UxbusU8, 0> SET_BRAKE;
+	typedef UxbusCmdDesc<UXBUS_RG::SET_MODE, UxbusU8, 1, UxbusU8, 0> SET_MODE;
+
+	typedef UxbusCmdDesc<UXBUS_RG::MOVE_LINE, UxbusFp32, 9, UxbusU8, 0> MOVE_LINE;
+	typedef UxbusCmdDesc<UXBUS_RG::MOVE_LINEB, UxbusFp32, 10, UxbusU8, 0> MOVE_LINEB;
+	typedef UxbusCmdDesc<UXBUS_RG::MOVE_JOINT, UxbusFp32, 10, UxbusU8, 0> MOVE_JOINT;
+	typedef UxbusCmdDesc<UXBUS_RG::MOVE_HOME, UxbusFp32, 3, UxbusU8, 0> MOVE_HOME;
+	typedef UxbusCmdDesc<UXBUS_RG::SLEEP_INSTT, UxbusFp32, 1, UxbusU8, 0> SLEEP_INSTT;
+	typedef UxbusCmdDesc<UXBUS_RG::MOVE_CIRCLE, UxbusFp32, 16, UxbusU8, 0> MOVE_CIRCLE;
+	typedef UxbusCmdDesc<UXBUS_RG::MOVE_LINE_TOOL, UxbusFp32, 9, UxbusU8, 0> MOVE_LINE_TOOL;
+	typedef UxbusCmdDesc<UXBUS_RG::MOVE_SERVOJ, UxbusFp32, 10, UxbusU8, 0> MOVE_SERVOJ;
+	typedef UxbusCmdDesc<UXBUS_RG::MOVE_SERVO_CART, UxbusFp32, 9, UxbusU8, 0> MOVE_SERVO_CART;
+
+	typedef UxbusCmdDesc<UXBUS_RG::SET_TCP_JERK, UxbusFp32, 1, UxbusU8, 0> SET_TCP_JERK;
+	typedef UxbusCmdDesc<UXBUS_RG::SET_TCP_MAXACC, UxbusFp32, 1, UxbusU8, 0> SET_TCP_MAXACC;
+	typedef UxbusCmdDesc<UXBUS_RG::SET_JOINT_JERK, UxbusFp32, 1, UxbusU8, 0> SET_JOINT_JERK;
+	typedef UxbusCmdDesc<UXBUS_RG::SET_JOINT_MAXACC, UxbusFp32, 1, UxbusU8, 0> SET_JOINT_MAXACC;
+	typedef UxbusCmdDesc<UXBUS_RG::SET_TCP_OFFSET, UxbusFp32, 6, UxbusU8, 0> SET_TCP_OFFSET;
+	typedef UxbusCmdDesc<UXBUS_RG::SET_LOAD_PARAM, UxbusFp32, 4, UxbusU8, 0> SET_LOAD_PARAM;
+	typedef UxbusCmdDesc<UXBUS_RG::SET_COLLIS_SENS, UxbusU8, 1, UxbusU8, 0> SET_COLLIS_SENS;
+	typedef UxbusCmdDesc<UXBUS_RG::SET_TEACH_SENS, UxbusU8, 1, UxbusU8, 0> SET_TEACH_SENS;
+	typedef UxbusCmdDesc<UXBUS_RG::CLEAN_CONF, UxbusU8, 0, UxbusU8, 0> CLEAN_CONF;
+	typedef UxbusCmdDesc<UXBUS_RG::SAVE_CONF, UxbusU8, 0, UxbusU8, 0> SAVE_CONF;
+
+	typedef UxbusCmdDesc<UXBUS_RG::GET_TCP_POSE, UxbusU8, 0, UxbusFp32, 6> GET_TCP_POSE;
+	typedef UxbusCmdDesc<UXBUS_RG::GET_JOINT_POS, UxbusU8, 0, UxbusFp32, 7> GET_JOINT_POS;
+	typedef UxbusCmdDesc<UXBUS_RG::GET_IK, UxbusFp32, 6, UxbusFp32, 7> GET_IK;
+	typedef UxbusCmdDesc<UXBUS_RG::GET_FK, UxbusFp32, 7, UxbusFp32, 6> GET_FK;
+	typedef UxbusCmdDesc<UXBUS_RG::IS_JOINT_LIMIT, UxbusFp32, 7, UxbusU8, 1> IS_JOINT_LIMIT;
+	typedef UxbusCmdDesc<UXBUS_RG::IS_TCP_LIMIT, UxbusFp32, 6, UxbusU8, 1> IS_TCP_LIMIT;
+
+	typedef UxbusCmdDesc<UXBUS_RG::SET_REDUCED_TRSV, UxbusFp32, 1, UxbusU8, 0> SET_REDUCED_TRSV;
+	typedef UxbusCmdDesc<UXBUS_RG::SET_REDUCED_P2PV, UxbusFp32, 1, UxbusU8, 0> SET_REDUCED_P2PV;
+	typedef UxbusCmdDesc<UXBUS_RG::GET_REDUCED_MODE, UxbusU8, 0, UxbusU8, 1> GET_REDUCED_MODE;
+	typedef UxbusCmdDesc<UXBUS_RG::SET_REDUCED_MODE, UxbusU8, 1, UxbusU8, 0> SET_REDUCED_MODE;
+	typedef UxbusCmdDesc<UXBUS_RG::SET_GRAVITY_DIR, UxbusFp32, 3, UxbusU8, 0> SET_GRAVITY_DIR;
+	typedef UxbusCmdDesc<UXBUS_RG::SET_LIMIT_XYZ, UxbusI32, 6, UxbusU8, 0> SET_LIMIT_XYZ;
+	typedef UxbusCmdDesc<UXBUS_RG::GET_REDUCED_STATE, UxbusU8, 0, UxbusBytes, 21> GET_REDUCED_STATE;
+	typedef UxbusCmdDesc<UXBUS_RG::GET_REDUCED_STATE, UxbusU8, 0, UxbusBytes, 79> GET_REDUCED_STATE_EXT; // firmware >= 1.2.11
+
+	typedef UxbusCmdDesc<UXBUS_RG::SET_SERVOT, UxbusFp32, 7, UxbusU8, 0> SET_SERVOT;
+	typedef UxbusCmdDesc<UXBUS_RG::GET_JOINT_TAU, UxbusU8, 0, UxbusFp32, 7> GET_JOINT_TAU;
+	typedef UxbusCmdDesc<UXBUS_RG::SET_SAFE_LEVEL, UxbusU8, 1, UxbusU8, 0> SET_SAFE_LEVEL;
+	typedef UxbusCmdDesc<UXBUS_RG::GET_SAFE_LEVEL, UxbusU8, 0, UxbusU8, 1> GET_SAFE_LEVEL;
+
+	typedef UxbusCmdDesc<UXBUS_RG::SET_REDUCED_JRANGE, UxbusFp32, 14, UxbusU8, 0> SET_REDUCED_JRANGE;
+	typedef UxbusCmdDesc<UXBUS_RG::SET_FENSE_ON, UxbusU8, 1, UxbusU8, 0> SET_FENSE_ON;
+	typedef UxbusCmdDesc<UXBUS_RG::SET_COLLIS_REB, UxbusU8, 1, UxbusU8, 0> SET_COLLIS_REB;
+
+	typedef UxbusCmdDesc<UXBUS_RG::SET_TRAJ_RECORD, UxbusU8, 1, UxbusU8, 0> SET_TRAJ_RECORD;
+	typedef UxbusCmdDesc<UXBUS_RG::SAVE_TRAJ, UxbusBytes, 81, UxbusU8, 0> SAVE_TRAJ;
+	typedef UxbusCmdDesc<UXBUS_RG::LOAD_TRAJ, UxbusBytes, 81, UxbusU8, 0> LOAD_TRAJ;
+	typedef UxbusCmdDesc<UXBUS_RG::PLAY_TRAJ, UxbusI32, 2, UxbusU8, 0> PLAY_TRAJ;
+	typedef UxbusCmdDesc<UXBUS_RG::PLAY_TRAJ, UxbusI32, 1, UxbusU8, 0> PLAY_TRAJ_OLD;
+	typedef UxbusCmdDesc<UXBUS_RG::GET_TRAJ_RW_STATUS, UxbusU8, 0, UxbusU8, 1> GET_TRAJ_RW_STATUS;
+
+	typedef UxbusCmdDesc<UXBUS_RG::SET_WORLD_OFFSET, UxbusFp32, 6, UxbusU8, 0> SET_WORLD_OFFSET;
+	typedef UxbusCmdDesc<UXBUS_RG::CNTER_RESET, UxbusU8, 0, UxbusU8, 0> CNTER_RESET;
+	typedef UxbusCmdDesc<UXBUS_RG::CNTER_PLUS, UxbusU8, 0, UxbusU8, 0> CNTER_PLUS;
+
+	typedef UxbusCmdDesc<UXBUS_RG::TGPIO_ERR, UxbusU8, 0, UxbusU8, 2> TGPIO_ERR;
+	// {TGPIO_ID, address high, address low} -> 32-bit value
+	typedef UxbusCmdDesc<UXBUS_RG::TGPIO_R16B, UxbusBytes, 3, UxbusBytes, 4> TGPIO_R16B;
+
+	typedef UxbusCmdDesc<UXBUS_RG::CGPIO_GET_DIGIT, UxbusU8, 0, UxbusU16, 1> CGPIO_GET_DIGIT;
+	typedef UxbusCmdDesc<UXBUS_RG::CGPIO_GET_ANALOG1, UxbusU8, 0, UxbusU16, 1> CGPIO_GET_ANALOG1;
+	typedef UxbusCmdDesc<UXBUS_RG::CGPIO_GET_ANALOG2, UxbusU8, 0, UxbusU16, 1> CGPIO_GET_ANALOG2;
+	typedef UxbusCmdDesc<UXBUS_RG::CGPIO_SET_DIGIT, UxbusU16, 1, UxbusU8, 0> CGPIO_SET_DIGIT;
+	typedef UxbusCmdDesc<UXBUS_RG::CGPIO_SET_ANALOG1, UxbusU16, 1, UxbusU8, 0> CGPIO_SET_ANALOG1;
+	typedef UxbusCmdDesc<UXBUS_RG::CGPIO_SET_ANALOG2, UxbusU16, 1, UxbusU8, 0> CGPIO_SET_ANALOG2;
+	typedef UxbusCmdDesc<UXBUS_RG::CGPIO_SET_IN_FUN, UxbusU8, 2, UxbusU8, 0> CGPIO_SET_IN_FUN;
+	typedef UxbusCmdDesc<UXBUS_RG::CGPIO_SET_OUT_FUN, UxbusU8, 2, UxbusU8, 0> CGPIO_SET_OUT_FUN;
+	typedef UxbusCmdDesc<UXBUS_RG::CGPIO_GET_STATE, UxbusU8, 0, UxbusBytes, 34> CGPIO_GET_STATE;
+
+	typedef UxbusCmdDesc<UXBUS_RG::SERVO_ZERO, UxbusU8, 1, UxbusU8, 0> SERVO_ZERO;
+	typedef UxbusCmdDesc<UXBUS_RG::SERVO_DBMSG, UxbusU8, 0, UxbusU8, 16> SERVO_DBMSG;
+
+	typedef UxbusCmdDesc<UXBUS_RG::GET_HD_TYPES, UxbusU8, 0, UxbusU8, 2> GET_HD_TYPES;
+};
+
+#endif
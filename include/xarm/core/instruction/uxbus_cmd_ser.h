@@ -7,21 +7,31 @@
 #ifndef CORE_INSTRUCTION_UXBUS_CMD_SER_H_
 #define CORE_INSTRUCTION_UXBUS_CMD_SER_H_
 
+#include <atomic>
 #include "xarm/core/instruction/uxbus_cmd.h"
+#include "xarm/core/instruction/uxbus_cmd_config.h"
 #include "xarm/core/port/ser.h"
 
+/*
+* The replies of the serial port are not routed by transaction id, so one request can be in flight at a time,
+*   from one thread: a request of another thread would flush (send_frame) or take the reply of the caller.
+*/
 class UxbusCmdSer : public UxbusCmd {
 public:
 	UxbusCmdSer(SerialPort *arm_port);
 	~UxbusCmdSer(void);
 
 	int check_xbus_prot(unsigned char *datas, int funcode);
-	int send_pend(int funcode, int num, int timeout, unsigned char *ret_data);
+	int send_pend(int funcode, int num, int timeout, unsigned char *ret_data, int trans_id = -1);
 	int send_xbus(int funcode, unsigned char *datas, int num);
+	int encode_frame(int funcode, unsigned char *datas, int num, unsigned char *frame);
+	int send_frame(unsigned char *frame, int len);
 	void close(void);
 
 private:
 	SerialPort *arm_port_;
+	std::atomic<long long> sent_us_; // the write time of the last request, one is in flight at a time
+	static const int RX_MAXLEN_ = UXBUS_CONF::MAX_DATA_LEN + 6;  // the largest reply frame read on the stack
 };
 
 #endif
@@ -7,7 +7,10 @@
 #ifndef CORE_INSTRUCTION_UXBUS_CMD_TCP_H_
 #define CORE_INSTRUCTION_UXBUS_CMD_TCP_H_
 
+#include <mutex>
+#include <atomic>
 #include "xarm/core/instruction/uxbus_cmd.h"
+#include "xarm/core/instruction/uxbus_cmd_config.h"
 #include "xarm/core/port/socket.h"
 
 class UxbusCmdTcp : public UxbusCmd {
@@ -16,15 +19,44 @@ public:
 	~UxbusCmdTcp(void);
 
 	int check_xbus_prot(unsigned char *datas, int funcode);
-	int send_pend(int funcode, int num, int timeout, unsigned char *ret_data);
+	int send_pend(int funcode, int num, int timeout, unsigned char *ret_data, int trans_id = -1);
 	int send_xbus(int funcode, unsigned char *datas, int num);
+	int send_urgent(int funcode, unsigned char *datas, int num, bool need_reply);
+	int encode_frame(int funcode, unsigned char *datas, int num, unsigned char *frame);
+	int send_frame(unsigned char *frame, int len);
+	int recv_frame(int trans_id, unsigned char *frame, int *len, int timeout = 0);
 	void close(void);
 
 
+private:
+	int take_reply_(int trans_id, unsigned char *rx_data);
+	long long latency_(int trans_id);
+
 private:
 	SocketPort *arm_port_;
 	int bus_flag_;
 	int prot_flag_;
+	std::mutex tx_mutex_;
+	std::mutex rx_mutex_;
+	// the writers queue on queue_mutex_, so only one of them competes with the urgent requests
+	//   for next_mutex_: an urgent request waits for the write in progress and one more at most
+	std::mutex queue_mutex_;
+	std::mutex next_mutex_;
+	// replies read while waiting for another transaction, kept until their owner asks for them
+	static const int STASH_NUM_ = 16;
+	unsigned char *stash_;
+	int stash_ids_[STASH_NUM_];
+	int stash_next_;
+	// the replies nobody waits for, dropped instead of stashed until they are older than a reply can be,
+	//   then the id may be used again; room for the retries of emergency_stop within that time
+	static const int DISCARD_NUM_ = 64;
+	int discard_ids_[DISCARD_NUM_];
+	long long discard_us_[DISCARD_NUM_];
+	// the write time of every transaction id (CommandMetrics::now_us), for the latency of its reply
+	std::atomic<long long> *sent_us_;
+	// the funcode of every transaction id, for the timeouts of recv_frame
+	std::atomic<unsigned char> *sent_funcodes_;
+	static const int RX_MAXLEN_ = UXBUS_CONF::MAX_DATA_LEN + 12;  // the largest reply frame read on the stack
 	int TX2_PROT_CON_ = 2;         // tcp cmd prot
 	int TX2_PROT_HEAT_ = 1;        // tcp heat prot
 	int TX2_BUS_FLAG_MIN_ = 1;     // the min cmd num
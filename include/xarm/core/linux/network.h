@@ -11,6 +11,26 @@
 
 int socket_init(char *local_ip, int port, int is_server);
 int socket_send_data(int client_fp, unsigned char *data, int len);
-int socket_connect_server(int *socket, char server_ip[], int server_port);
+/*
+* Connect the socket to the server
+* @param timeout_ms: connect deadline in milliseconds, <= 0 means blocking connect
+*/
+int socket_connect_server(int *socket, char server_ip[], int server_port, int timeout_ms = -1);
+/*
+* Connect to a unix domain socket, like the one of a local CommandBroker (not available on windows)
+* return: the socket, -1: failed
+*/
+int socket_connect_unix(char path[]);
+/*
+* Have the kernel stamp the received data (SO_TIMESTAMPING software receive stamps, not available on windows)
+* return: 0: success, -1: not available
+*/
+int socket_set_recv_stamp(int fp, bool on);
+/*
+* recv, with the kernel receive stamp of the data when socket_set_recv_stamp is on
+* @param stamp_us: out, the stamp on the monotonic clock (microseconds), 0 if the kernel gave none
+*/
+int socket_recv_stamped(int fp, unsigned char *data, int len, long long *stamp_us);
+void socket_close(int fp);
 
 #endif
@@ -8,7 +8,10 @@
 #define CORE_PORT_SOCKET_H_
 
 #include <iostream>
+#include <string>
 #include <thread>
+#include <mutex>
+#include <atomic>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -20,23 +23,65 @@
 
 class SocketPort {
 public:
-	SocketPort(char *server_ip, int server_port, int que_num, int que_maxlen);
+	/*
+	* @param server_ip: the ip of the server, or "unix:<path>" for a unix domain socket (the port is ignored)
+	* @param conn_timeout_ms: connect deadline in milliseconds, <= 0 means blocking connect
+	*/
+	SocketPort(char *server_ip, int server_port, int que_num, int que_maxlen, int conn_timeout_ms = -1);
 	~SocketPort(void);
 	int is_ok(void);
 	void flush(void);
 	void recv_proc(void);
 	int write_frame(unsigned char *data, int len);
-	int read_frame(unsigned char *data);
+	/*
+	* @param recv_us: out, when the frame was received (microseconds of the monotonic clock), NULL if not needed
+	*/
+	int read_frame(unsigned char *data, long long *recv_us = NULL);
 	void close_port(void);
+	/*
+	* Close the current connection (if any) and connect to the same server again
+	* return: 0: success, -1: failed
+	*/
+	int reconnect(int conn_timeout_ms = -1);
+	/*
+	* Split the received stream into uxbus frames, so every queue node holds exactly one reply
+	*   (several replies may arrive in one segment when requests are pipelined)
+	*/
+	void set_uxbus_framing(bool on);
+	/*
+	* The frames dropped because the receive queue was full, since the port was created
+	*/
+	long long get_drop_num(void);
+	/*
+	* Take the receive stamps of the frames from the kernel instead of the receive thread,
+	*   free of the scheduling delay of the thread, kept across reconnects
+	* return: 0: success, -1: not available (the stamps stay those of the receive thread)
+	*/
+	int set_recv_stamp(bool on);
+	/*
+	* Whether the stamp of the last frame came from the kernel
+	*/
+	bool is_kernel_stamped(void);
 	int que_maxlen_;
 
 private:
+	int connect_server_(int conn_timeout_ms);
+	int recv_(int fp, unsigned char *data, int len, long long *recv_us);
+
+private:
+	std::string server_ip_;
+	int server_port_;
 	int fp_;
 	int state_;
 	int que_num_;
+	bool uxbus_framing_;
 	QueueMemcpy *rx_que_;
+	std::atomic<long long> drop_num_;
+	std::atomic<bool> recv_stamp_;
+	std::atomic<bool> kernel_stamped_;
 	//pthread_t thread_id_;
 	std::thread thread_id_;
+	std::mutex mutex_;
 };
 
 #endif
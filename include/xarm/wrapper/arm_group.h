@@ -0,0 +1,114 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+#ifndef WRAPPER_ARM_GROUP_H_
+#define WRAPPER_ARM_GROUP_H_
+
+#include <mutex>
+#include "xarm/wrapper/xarm_api.h"
+
+/*
+* Starts the moves of several arms together, for the dual arm tasks (handovers, shared payloads).
+* The moves are staged per arm, checked against the limits and encoded at once, then release sends all the
+*   frames back to back from one thread, only the transaction ids are written, so the arms are apart by the
+*   time of a write, not by the scheduling of one thread per arm.
+* The times are the ones of the monotonic clock of the process (get_steady_time_us), common to all the arms:
+*   the send time of each arm, the time its reports are received and the report which showed it starting to move,
+*   with the skew statistics of the releases.
+*/
+class ArmGroup {
+public:
+	static const int MAX_ARMS = 8;
+
+	/*
+	* The spread (latest - earliest) between the arms of a release, microseconds
+	*/
+	struct SkewStats {
+		long long count;
+		long long last;
+		long long max;
+		double mean;
+	};
+
+	ArmGroup(void);
+	~ArmGroup(void);
+
+	/*
+	* @param arm: a connected XArmAPI, the group does not own it
+	* return: the index of the arm in the group, UXBUS_STATE::ERR_PARAM: NULL or the group is full
+	*/
+	int add_arm(XArmAPI *arm);
+	int get_arm_num(void);
+
+	/*
+	* Stage the move of an arm for the next release, it replaces the staged one
+	* The move is checked and encoded now, its parameters are the ones of XArmAPI::_encode_move
+	* return: 0: success, -1: the arm is not connected, UXBUS_STATE::ERR_PARAM: index out of range,
+	*   UXBUS_STATE::TCP_LIMIT/JOINT_LIMIT/COLLISION: the move is rejected,
+	*   UXBUS_STATE::REPORT_STALE: a servo move while the servo setpoints are held
+	*/
+	int stage_position(int index, fp32 pose[6], fp32 speed = 0, fp32 acc = 0, fp32 mvtime = 0);
+	int stage_servo_angle(int index, fp32 angles[7], fp32 speed = 0, fp32 acc = 0, fp32 mvtime = 0);
+	int stage_servo_angle_j(int index, fp32 angles[7], fp32 speed = 0, fp32 acc = 0, fp32 mvtime = 0);
+	void clear_staged(void);
+
+	/*
+	* Send the staged moves, then wait for their replies
+	* @param at: when to send (get_steady_time_us), 0 means now, the caller sleeps then spins the last millisecond
+	* @param rets: the state of the reply of each arm, int[MAX_ARMS], UXBUS_STATE::NOT_READY: nothing staged,
+	*   UXBUS_STATE::REPORT_STALE: a servo move not sent, the servo setpoints of the arm are held, NULL if not needed
+	* return: 0: success, -1: nothing staged or an arm is not connected (nothing is sent, the moves stay staged),
+	*   otherwise the first non zero state of the replies
+	*/
+	int release(long long at = 0, int *rets = NULL);
+
+	/*
+	* Wait for the report of each arm of the last release showing it starting to move (state 1)
+	* The arms must not be moving when released, the start of a queued move is not seen.
+	* @param timeout: seconds, <= 0 means no timeout
+	* @param starts: the receive time of the report of each arm, long long[MAX_ARMS], 0: not released, NULL if not needed
+	* return: 0: success, UXBUS_STATE::ERR_TOUT: timeout, -1: nothing released
+	*/
+	int wait_motion_start(fp32 timeout, long long *starts = NULL);
+
+	/*
+	* The send time of the arm in the last release, 0: not released
+	*/
+	long long get_send_time(int index);
+
+	/*
+	* The receive time of the last report of the arm, 0: none yet
+	*/
+	long long get_report_time(int index);
+
+	/*
+	* send: between the writes of a release, start: between the reports of wait_motion_start
+	*/
+	void get_skew_stats(SkewStats *send, SkewStats *start);
+	void reset_skew_stats(void);
+
+private:
+	struct Staged {
+		int funcode; // 0: nothing staged
+		unsigned char frame[UxbusCmd::MAX_FRAME_LEN];
+		int len;
+	};
+	int _stage(int index, int funcode, fp32 *target, fp32 speed, fp32 acc, fp32 mvtime);
+	static void _add_skew(SkewStats *stats, long long skew);
+
+private:
+	std::mutex mutex_;
+	XArmAPI *arms_[MAX_ARMS];
+	int arm_num_;
+	Staged staged_[MAX_ARMS];
+	long long send_us_[MAX_ARMS];
+	SkewStats send_skew_;
+	SkewStats start_skew_;
+};
+
+#endif
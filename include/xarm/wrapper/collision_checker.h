@@ -0,0 +1,120 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+#ifndef WRAPPER_COLLISION_CHECKER_H_
+#define WRAPPER_COLLISION_CHECKER_H_
+
+#include <vector>
+#include <mutex>
+
+/*
+* Local geometric check of joint configurations before they are sent:
+*   the links of the xArm5/6/7 are capsules around the segments between the joint frames
+*   (standard DH parameters of the models), plus an optional tool capsule along the flange z axis.
+*   The base link starts one radius above the mounting plane (z = 0), the obstacles below it are free.
+*   A configuration collides if two links at least 3 apart touch, or a link touches an obstacle.
+* The static obstacles (spheres, capsules, axis-aligned boxes) are kept in a bounding volume
+*   hierarchy, built again when they change. A check does not allocate.
+* The methods may be called from any thread, a change waits for the check in progress.
+* Angles in radians, lengths in mm, obstacles in the base frame of the arm.
+*/
+class CollisionChecker {
+public:
+	static const int MAX_LINKS = 8;
+
+	/*
+	* @param axis: 5, 6 or 7 (XArmAPI::axis)
+	*/
+	CollisionChecker(int axis = 7);
+
+	/*
+	* The links of the model, the radii set by set_link_radius are kept, the others are 50mm
+	*/
+	void set_axis(int axis);
+	int get_axis(void);
+
+	/*
+	* @param link: [0, get_link_num()), from the base to the flange, the tool is the last one
+	* @param radius: mm, < 0 means the default one
+	*/
+	void set_link_radius(int link, float radius);
+	int get_link_num(void);
+
+	/*
+	* @param length: the tool capsule from the flange along its z axis, 0 means no tool
+	*/
+	void set_tool(float length, float radius);
+
+	/*
+	* Add a static obstacle, the hierarchy is built again
+	* return: 0
+	*/
+	int add_sphere(const float center[3], float radius);
+	int add_capsule(const float p0[3], const float p1[3], float radius);
+	int add_box(const float min[3], const float max[3]);
+	void clear_obstacles(void);
+	int get_obstacle_num(void);
+
+	/*
+	* Check a configuration
+	* @param angles: float[7] joint angles (radians)
+	* return: 0: free, UXBUS_STATE::COLLISION: self-collision or collision with an obstacle
+	*/
+	int check(const float angles[7]);
+
+	/*
+	* Check the configurations on the straight joint path between two configurations
+	* @param step: max joint move between two checked configurations (radians)
+	* return: 0: free, UXBUS_STATE::COLLISION
+	*/
+	int check_path(const float from[7], const float to[7], float step = 0.01f);
+
+	/*
+	* Compute the link segments of a configuration
+	* @param points: float[MAX_LINKS + 1][3], the end points of the links (mm), NULL if not needed
+	* return: the number of links
+	*/
+	int forward(const float angles[7], float points[][3]);
+
+private:
+	struct Obstacle {
+		int type;
+		float p0[3];
+		float p1[3]; // capsule: the other end, box: the max corner
+		float radius;
+		float min[3];
+		float max[3];
+	};
+	struct Node {
+		float min[3];
+		float max[3];
+		int first; // leaf: the first obstacle, inner node: the right child (the left child is the next node)
+		int count; // leaf: the number of obstacles, inner node: 0
+	};
+
+	void _build(void);
+	int _build_node(int first, int count);
+	bool _hit_obstacles(const float *p0, const float *p1, float radius);
+	int _forward(const float angles[7], float points[][3]);
+	int _check(const float angles[7]);
+
+private:
+	std::mutex mutex_;
+	int axis_;
+	double dh_[7][4]; // {theta offset, d, alpha, a}
+	int link_num_;
+	int link_frame_[MAX_LINKS]; // the link goes from the origin of frame i to the one of frame i + 1
+	float link_radius_[MAX_LINKS];
+	float user_radius_[MAX_LINKS]; // set by set_link_radius, < 0: the default one
+	float tool_length_;
+	float tool_radius_;
+	std::vector<Obstacle> obstacles_;
+	std::vector<Node> nodes_;
+};
+
+#endif
@@ -0,0 +1,120 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+#ifndef WRAPPER_COMMAND_BROKER_H_
+#define WRAPPER_COMMAND_BROKER_H_
+
+#include <string>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include "xarm/wrapper/xarm_api.h"
+
+/*
+* Shares the control connection of an XArmAPI with the other processes of the machine.
+* The clients connect to a unix domain socket and speak the protocol of the control port, so a XArmAPI
+*   (set_command_broker) or a UxbusCmdTcp on a SocketPort("unix:<path>") is a client.
+* The requests of all the clients are pipelined on the control connection, the higher priority first,
+*   with a new transaction id, and the replies are sent back with the id of the client.
+* Stop and pause (set_state 4/3) go before everything else, even when MAX_IN_FLIGHT requests are in flight.
+* A client not reading its replies is closed when its socket buffer is full, the others are not held up.
+* Not available on Windows (start returns -1).
+*/
+class CommandBroker {
+public:
+	static const int MAX_CLIENTS = 16;
+	static const int MAX_QUEUED = 64; // requests waiting to be sent, of all the clients
+	static const int MAX_IN_FLIGHT = 8;
+	// the urgent requests above MAX_IN_FLIGHT, the total stays below the replies UxbusCmdTcp stashes (16),
+	//   the rest is left to the commands of the XArmAPI itself
+	static const int MAX_URGENT = 2;
+	static const int URGENT_PRIORITY = 256; // stop and pause, above any client
+	static const int REPLY_TIMEOUT = 5000; // ms, then the request is dropped, the client times out by itself
+
+	/*
+	* A frame with this protocol is for the broker itself and has no reply, funcode SET_PRIORITY: data[0] is the
+	*   priority of the client, [0, 255], higher first
+	*/
+	static const int PROT_BROKER = 0xB0;
+	static const int SET_PRIORITY = 1;
+
+	/*
+	* @param arm: an XArmAPI connected by tcp, its own commands keep working
+	*/
+	CommandBroker(XArmAPI *arm);
+	~CommandBroker(void);
+
+	/*
+	* @param path: the path of the socket, an old file there is removed
+	* return: 0: success, -1: the arm is not connected by tcp, -2: the socket can not be created
+	*/
+	int start(const std::string &path);
+	void stop(void);
+	bool is_running(void);
+
+	/*
+	* The priority of the clients which did not set one, [0, 255], default is 100
+	*/
+	void set_default_priority(int priority);
+
+	int get_client_num(void);
+	long long get_request_num(void); // requests relayed to the controller
+	long long get_drop_num(void); // requests not queued (queue full, too long) or without reply
+
+private:
+	struct Client {
+		int fd; // -1: free
+		int gen; // incremented when the slot is reused, so a late reply is not sent to a new client
+		int priority;
+		unsigned char buf[UxbusCmd::MAX_FRAME_LEN * 2];
+		int pending;
+	};
+	struct Request {
+		int client;
+		int gen;
+		int priority;
+		long long seq;
+		int client_trans_id;
+		unsigned char frame[UxbusCmd::MAX_FRAME_LEN];
+		int len;
+	};
+	struct InFlight {
+		int client;
+		int gen;
+		int client_trans_id;
+		int trans_id;
+		int funcode;
+		long long time;
+	};
+	void _accept(void);
+	bool _recv(int client);
+	void _close_client(int client);
+	void _dispatch(UxbusCmd *core);
+	void _collect(UxbusCmd *core);
+	void _loop(void);
+
+private:
+	XArmAPI *arm_;
+	std::string path_;
+	int listen_fd_;
+	std::thread thread_;
+	std::mutex mutex_;
+	std::atomic<bool> is_running_;
+	int default_priority_;
+	Client clients_[MAX_CLIENTS];
+	int client_num_;
+	Request queue_[MAX_QUEUED];
+	int queue_num_;
+	long long queue_seq_;
+	InFlight in_flight_[MAX_IN_FLIGHT + MAX_URGENT];
+	int in_flight_num_;
+	long long request_num_;
+	long long drop_num_;
+};
+
+#endif
@@ -0,0 +1,72 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+#ifndef WRAPPER_COMMON_POLL_THREAD_H_
+#define WRAPPER_COMMON_POLL_THREAD_H_
+
+#include <functional>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include "xarm/core/debug/trace.h"
+
+/*
+* A thread calling a task at a fixed period until stop, the periods are counted from the start
+*/
+class PollThread {
+public:
+	PollThread(void) : is_running_(false) {}
+	~PollThread(void) { stop(); }
+
+	/*
+	* @param name: the name of the thread in the traces, a literal
+	* @param period_us: microseconds between two calls, the first call is right away
+	*/
+	void start(const char *name, long long period_us, std::function<void()> task) {
+		if (is_running_) return;
+		if (thread_.joinable()) thread_.join();
+		is_running_ = true;
+		thread_ = std::thread([this, name, period_us, task]() {
+			trace_set_thread_name(name);
+			std::chrono::steady_clock::time_point next_time = std::chrono::steady_clock::now();
+			while (is_running_) {
+				task();
+				next_time += std::chrono::microseconds(period_us);
+				std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+				// a slow call delays the next one instead of causing a burst
+				if (next_time < now) next_time = now;
+				std::unique_lock<std::mutex> locker(mutex_);
+				cond_.wait_until(locker, next_time, [this] { return !is_running_; });
+			}
+		});
+	}
+
+	/*
+	* Wakes the thread and waits for the call in progress, not from the task
+	*/
+	void stop(void) {
+		{
+			std::lock_guard<std::mutex> locker(mutex_);
+			is_running_ = false;
+			cond_.notify_all();
+		}
+		if (thread_.joinable()) thread_.join();
+	}
+
+	bool is_running(void) { return is_running_; }
+
+private:
+	std::thread thread_;
+	std::mutex mutex_;
+	std::condition_variable cond_;
+	std::atomic<bool> is_running_;
+};
+
+#endif
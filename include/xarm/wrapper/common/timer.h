@@ -16,6 +16,7 @@
 #include <memory>
 #include <mutex>
 #include <condition_variable>
+#include "xarm/core/debug/trace.h"
 
 class Timer {
 public:
@@ -86,6 +87,7 @@ public:
 
 		std::thread([after, task]() {
 			std::this_thread::sleep_for(std::chrono::milliseconds(after));
+			XARM_TRACE_SCOPE("callback");
 			task();
 		}).detach();
 	}
@@ -9,6 +9,7 @@
 #ifndef WRAPPER_COMMON_UTILS_H_
 #define WRAPPER_COMMON_UTILS_H_
 #include <sys/timeb.h>
+#include <chrono>
 #ifdef _WIN32
 #include <windows.h>
 #else
@@ -30,6 +31,12 @@ inline long long get_system_time()
 	return 1000 * t.time + t.millitm;
 }
 
+// microseconds of the monotonic clock, the common time base of the arms of a process
+inline long long get_steady_time_us()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 inline std::vector<std::string> split(const std::string &str, const std::string &pattern)
 {
 
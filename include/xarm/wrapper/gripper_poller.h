@@ -0,0 +1,93 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+#ifndef WRAPPER_GRIPPER_POLLER_H_
+#define WRAPPER_GRIPPER_POLLER_H_
+
+#include <mutex>
+#include <condition_variable>
+#include "xarm/wrapper/xarm_api.h"
+#include "xarm/wrapper/common/poll_thread.h"
+
+/*
+* Reads the position and the error code of the gripper at a fixed rate in the background
+*   (both reads in flight together on the tcp port) and publishes them as a snapshot.
+* While it runs, XArmAPI::set_gripper_position(wait=true) waits on the snapshots instead of polling.
+*/
+class GripperPoller {
+	friend class XArmAPI;
+public:
+	/*
+	* @param arm: a connected XArmAPI
+	*/
+	GripperPoller(XArmAPI *arm);
+	~GripperPoller(void);
+
+	/*
+	* Start polling, the poller is used by the waits of the arm until stop, only available in socket way
+	* @param freq: samples per second, (0, 250]
+	* return: 0: success, -1: the arm is not connected, 12: freq out of range, UXBUS_STATE::ERR_NOTTCP: serial port
+	*/
+	int start(fp32 freq = 50);
+	void stop(void);
+	bool is_running(void);
+
+	/*
+	* The last sample
+	* @param pos: the gripper position
+	* @param err: the gripper error code
+	* @param time: the time of the sample (milliseconds, get_system_time), NULL if not needed
+	* return: the state of the last read, 0: success, -1: no sample yet,
+	*   UXBUS_STATE::ERR_CODE/WAR_CODE: read while the arm has an error or a warning, the sample is valid
+	*/
+	int get_snapshot(fp32 *pos, int *err, long long *time = NULL);
+
+	/*
+	* The number of samples since start, to pass to wait_sample
+	*/
+	long long get_sample_num(void);
+
+	/*
+	* Wait for a sample after the given one
+	* @param sample_num: the return of get_sample_num
+	* @param timeout: seconds
+	* return: 0: success, UXBUS_STATE::ERR_TOUT: timeout
+	*/
+	int wait_sample(long long sample_num, fp32 timeout);
+
+	/*
+	* Wait until the gripper reaches or crosses a position, or stops on the way (an object is gripped)
+	* @param pos: the target position
+	* @param tolerance: the target is reached within it
+	* @param timeout: seconds
+	* @param stall_time: seconds without progress to consider the gripper stopped
+	* return: 0: reached or stopped, UXBUS_STATE::ERR_TOUT: timeout,
+	*   else: the failed read or the gripper error code
+	*/
+	int wait_position(fp32 pos, fp32 tolerance = 1, fp32 timeout = 10, fp32 stall_time = 0.3);
+
+private:
+	int _read(UxbusCmd *core, fp32 *pos, int *err);
+	void _poll(void);
+
+private:
+	XArmAPI *arm_;
+	PollThread poller_;
+	std::mutex mutex_;
+	std::condition_variable cond_; // a new sample or stop
+	long long sample_num_;
+	int ret_;
+	fp32 pos_;
+	int err_;
+	long long time_;
+	// the waits of the arm on the poller, under XArmAPI::gripper_poller_mutex_, stop waits for them to leave
+	int wait_num_;
+	std::condition_variable wait_cond_;
+};
+
+#endif
@@ -0,0 +1,150 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+#ifndef WRAPPER_IO_MONITOR_H_
+#define WRAPPER_IO_MONITOR_H_
+
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include "xarm/wrapper/xarm_api.h"
+#include "xarm/wrapper/common/poll_thread.h"
+
+/*
+* Polls the digital inputs of the controller (CGPIO_GET_STATE) and of the tool (TGPIO) in the background,
+*   both reads in flight together on the tcp port, and turns the changes into debounced edges.
+* The edge callbacks are dispatched like the report callbacks of XArmAPI, with the time of the change.
+* Pins: CI0-CI7 (functional inputs of the controller), DI0-DI7 (configurable inputs of the controller),
+*   TI0-TI1 (digital inputs of the tool), the raw bits as get_cgpio_state/get_tgpio_digital.
+* A move can be armed against an edge: it is encoded when armed and sent by the polling thread as soon as
+*   the edge is detected, before the callbacks, so the latency is one sample at most plus the debounce.
+*/
+class IoMonitor {
+public:
+	static const int CI0 = 0;
+	static const int DI0 = 8;
+	static const int TI0 = 16;
+	static const int PIN_NUM = 18;
+
+	static const int RISING = 1;
+	static const int FALLING = 2;
+	static const int BOTH = 3;
+
+	/*
+	* @param arm: a connected XArmAPI
+	*/
+	IoMonitor(XArmAPI *arm);
+	~IoMonitor(void);
+
+	/*
+	* Only available in socket way
+	* @param freq: samples per second, (0, 500]
+	* @param tgpio: also poll the inputs of the tool
+	* return: 0: success, -1: the arm is not connected, 12: freq out of range, UXBUS_STATE::ERR_NOTTCP: serial port
+	*/
+	int start(fp32 freq = 100, bool tgpio = true);
+	void stop(void);
+	bool is_running(void);
+
+	/*
+	* The time a new level must be stable before the edge is reported
+	* @param pin: [0, PIN_NUM), -1 means all the pins
+	* @param debounce: milliseconds, 0 means no debounce
+	*/
+	int set_debounce(int pin, int debounce);
+
+	/*
+	* Register/release an edge callback
+	* @param edge: RISING, FALLING or BOTH
+	* @param callback: called with the pin, the new level and the time of the change (milliseconds, get_system_time),
+	*   release: NULL means all the callbacks of the pin
+	*/
+	int register_edge_callback(int pin, int edge, void(*callback)(int pin, int level, long long time));
+	int release_edge_callback(int pin, void(*callback)(int pin, int level, long long time) = NULL);
+
+	/*
+	* The debounced level of a pin
+	* return: 0/1, -1: not read yet or out of range
+	*/
+	int get_level(int pin);
+
+	/*
+	* Wait for an edge after the call
+	* @param timeout: seconds
+	* @param time: the time of the change, NULL if not needed
+	* return: 0: success, UXBUS_STATE::ERR_TOUT: timeout, UXBUS_STATE::ERR_PARAM: pin out of range
+	*/
+	int wait_edge(int pin, int edge, fp32 timeout, long long *time = NULL);
+
+	/*
+	* Arm a move against an edge of a pin, sent once when the edge is detected, then the pin is disarmed
+	* The move is checked and encoded now, its parameters are the ones of XArmAPI::_encode_move
+	* Arming a pin again replaces its move
+	* return: 0: success, -1: the arm is not connected, UXBUS_STATE::ERR_PARAM: pin or edge out of range,
+	*   UXBUS_STATE::TCP_LIMIT/JOINT_LIMIT/COLLISION: the move is rejected,
+	*   UXBUS_STATE::REPORT_STALE: a servo move while the servo setpoints are held
+	*/
+	int arm_position(int pin, int edge, fp32 pose[6], fp32 speed = 0, fp32 acc = 0, fp32 mvtime = 0);
+	int arm_servo_angle(int pin, int edge, fp32 angles[7], fp32 speed = 0, fp32 acc = 0, fp32 mvtime = 0);
+	int arm_servo_angle_j(int pin, int edge, fp32 angles[7], fp32 speed = 0, fp32 acc = 0, fp32 mvtime = 0);
+	void disarm(int pin);
+	bool is_armed(int pin);
+
+	/*
+	* The state of the last move sent by the trigger of a pin
+	* @param time: the time it was sent (milliseconds, get_system_time), NULL if not needed
+	* return: the state of the reply of the move, UXBUS_STATE::NOT_READY: not sent or not replied yet,
+	*   UXBUS_STATE::REPORT_STALE: a servo move not sent at the edge, the servo setpoints were held
+	*/
+	int get_trigger_state(int pin, long long *time = NULL);
+
+	long long get_sample_num(void); // samples since start
+	int get_last_state(void); // the state of the last read, 0: success
+
+private:
+	struct Callback {
+		int edge;
+		void(*callback)(int, int, long long);
+	};
+	struct Trigger {
+		bool armed;
+		int edge;
+		int funcode;
+		unsigned char frame[UxbusCmd::MAX_FRAME_LEN];
+		int len;
+		int trans_id;
+		int ret;
+		long long time;
+	};
+	int _read(UxbusCmd *core, int raw[PIN_NUM]);
+	int _arm(int pin, int edge, int funcode, fp32 *target, fp32 speed, fp32 acc, fp32 mvtime);
+	/*
+	* return: the number of the triggers sent, their pins in fired
+	*/
+	int _update(UxbusCmd *core, const int raw[PIN_NUM], long long now, int fired[PIN_NUM]);
+	void _poll(void);
+
+private:
+	XArmAPI *arm_;
+	bool tgpio_;
+	PollThread poller_;
+	std::mutex mutex_;
+	std::condition_variable cond_; // a new sample or stop
+	long long sample_num_;
+	int last_state_;
+	int level_[PIN_NUM]; // -1: unknown
+	int candidate_[PIN_NUM]; // the new level being debounced, -1: none
+	long long candidate_time_[PIN_NUM];
+	int debounce_[PIN_NUM];
+	long long edge_num_[PIN_NUM][2]; // rising, falling
+	long long edge_time_[PIN_NUM][2];
+	std::vector<Callback> callbacks_[PIN_NUM];
+	Trigger triggers_[PIN_NUM];
+};
+
+#endif
@@ -0,0 +1,74 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+#ifndef WRAPPER_LIMIT_VALIDATOR_H_
+#define WRAPPER_LIMIT_VALIDATOR_H_
+
+#include <mutex>
+
+/*
+* Local copy of the joint ranges, the safety boundary and the reduced mode settings, so a target
+*   can be checked before it is sent, instead of asking the controller (is_joint_limit/is_tcp_limit)
+*   or letting it stop on an error.
+* All values in controller units (rad, mm).
+*/
+class LimitValidator {
+public:
+	LimitValidator(void);
+
+	/*
+	* The joint ranges of the model (xArm5/6/7), other axis numbers are not checked
+	*/
+	void set_axis(int axis);
+	int get_axis(void);
+
+	/*
+	* Store the states of the reduced mode (get_reduced_states)
+	* @param jrange: float[14]{joint-1-min, joint-1-max, ...}, NULL if not reported by the firmware
+	*/
+	void update(int reduced_on, const int xyz_list[6], float tcp_speed, float joint_speed, const float *jrange, int fense_on);
+
+	/*
+	* The cached states must be loaded again (a setting was changed or the arm reconnected)
+	*/
+	void invalidate(void);
+	bool is_valid(void);
+
+	/*
+	* @param angles: float[7] target angles
+	* return: 0 or UXBUS_STATE::JOINT_LIMIT
+	*/
+	int check_joints(const float angles[7]);
+
+	/*
+	* @param pose: float[6] target tcp pose
+	* return: 0 or UXBUS_STATE::TCP_LIMIT
+	*/
+	int check_pose(const float pose[6]);
+
+	/*
+	* The speed clamped to the max of the reduced mode, as the controller does
+	*/
+	float clamp_joint_speed(float speed);
+	float clamp_tcp_speed(float speed);
+
+private:
+	std::mutex mutex_;
+	bool is_valid_;
+	int axis_;
+	float joint_range_[7][2]; // the range of the model
+	bool reduced_on_;
+	bool fense_on_;
+	bool has_jrange_;
+	float reduced_jrange_[7][2];
+	float boundary_[6]; // {x_max, x_min, y_max, y_min, z_max, z_min}
+	float reduced_tcp_speed_;
+	float reduced_joint_speed_;
+};
+
+#endif
@@ -0,0 +1,145 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+#ifndef WRAPPER_MODBUS_DEVICE_H_
+#define WRAPPER_MODBUS_DEVICE_H_
+
+#include <mutex>
+#include "xarm/core/instruction/uxbus_cmd_config.h"
+
+/*
+* A modbus rtu device on the tool gpio, described by its register map: the register blocks
+*   read periodically by a ToolBusScheduler into a cached image, and the register writes queued
+*   for its next cycle. The image is read without waiting for the bus.
+* Use it as is for any device (vacuum generator, force sensor, ...) with the blocks of its manual,
+*   or derive a typed device from it.
+*/
+class ModbusDevice {
+	friend class ToolBusScheduler;
+public:
+	static const int MAX_BLOCKS = 8;
+	static const int MAX_IMAGE_REGS = 128;
+	static const int MAX_WRITES = 8;
+	static const int MAX_WRITE_REGS = 64;
+
+	/*
+	* @param slave_id: the modbus id of the device
+	*/
+	ModbusDevice(int slave_id);
+	virtual ~ModbusDevice(void) {}
+
+	int get_slave_id(void);
+
+	/*
+	* Add a block of the register map, read every period by the scheduler
+	* @param funcode: 0x03 (holding registers) or 0x04 (input registers)
+	* @param num: at most ModbusTransaction::MAX_READ_REGS
+	* @param period: milliseconds, 0 means every cycle of the scheduler
+	* return: 0: success, UXBUS_STATE::ERR_PARAM: too many blocks or registers
+	*/
+	int add_block(int funcode, int addr, int num, int period = 0);
+
+	/*
+	* Registers from the cached image
+	* @param funcode: 0x03 or 0x04, the function of the block
+	* @param time: the time of the read of the block (milliseconds, get_system_time), NULL if not needed
+	* return: the state of the last read of the block, UXBUS_STATE::NOT_READY: not read yet,
+	*   UXBUS_STATE::ERR_PARAM: not in a block
+	*/
+	int get_regs(int funcode, int addr, unsigned short *values, int num = 1, long long *time = NULL);
+
+	/*
+	* Queue a write of registers (function 0x10), sent before the reads of the next cycle
+	* return: 0: success, UXBUS_STATE::ERR_PARAM: too many writes queued or registers
+	*/
+	int write_regs(int addr, const unsigned short *values, int num);
+
+	/*
+	* The state of the last write, UXBUS_STATE::NOT_READY: queued and not sent yet
+	*/
+	int get_write_state(void);
+
+private:
+	struct Block {
+		int funcode;
+		int addr;
+		int num;
+		int period;
+		int offset; // of the registers in image_
+		long long next_time;
+		long long time;
+		int ret;
+	};
+	struct Write {
+		int addr;
+		int num;
+		int offset; // of the registers in write_regs_
+	};
+
+private:
+	int slave_id_;
+	std::mutex mutex_;
+	Block blocks_[MAX_BLOCKS];
+	int block_num_;
+	unsigned short image_[MAX_IMAGE_REGS];
+	int image_num_;
+	Write writes_[MAX_WRITES];
+	int write_num_;
+	unsigned short write_regs_[MAX_WRITE_REGS];
+	int write_reg_num_;
+	int write_ret_;
+};
+
+/*
+* The UFACTORY gripper (SERVO3_RG registers), position every cycle and error code every 100ms
+*/
+class UfactoryGripperDevice : public ModbusDevice {
+public:
+	UfactoryGripperDevice(int slave_id = UXBUS_CONF::GRIPPER_ID);
+
+	int set_enable(bool enable);
+	int set_mode(int mode);
+	int set_speed(int speed);
+	int set_position(int pos);
+
+	/*
+	* return: the state of the last read, see ModbusDevice::get_regs
+	*/
+	int get_position(int *pos);
+	int get_err_code(int *err);
+};
+
+/*
+* The Robotiq 2F-85/2F-140 gripper (Modbus RTU): the robot output registers from 0x03E8 are written,
+*   the gripper status registers from 0x07D0 are read every cycle (function 0x04)
+*/
+class RobotiqGripperDevice : public ModbusDevice {
+public:
+	RobotiqGripperDevice(int slave_id = 9);
+
+	/*
+	* Clear rACT then set it, the gripper calibrates itself
+	*/
+	int activate(void);
+	int reset(void);
+
+	/*
+	* Go to a position (rGTO)
+	* @param pos/speed/force: [0, 255], pos 0 is open and 255 is closed
+	*/
+	int move(int pos, int speed = 255, int force = 255);
+
+	/*
+	* The gripper status
+	* @param status: {gACT, gGTO, gSTA, gOBJ, gFLT, gPR, gPO, gCU}, gOBJ 1/2: object detected while opening/closing, 3: at the position
+	* return: the state of the last read, see ModbusDevice::get_regs
+	*/
+	int get_status(int status[8]);
+};
+
+#endif
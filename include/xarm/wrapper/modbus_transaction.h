@@ -0,0 +1,113 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+#ifndef WRAPPER_MODBUS_TRANSACTION_H_
+#define WRAPPER_MODBUS_TRANSACTION_H_
+
+#include "xarm/wrapper/xarm_api.h"
+
+/*
+* Register reads and writes of a modbus device behind the tool gpio (the gripper by default),
+*   the ops are queued, coalesced into as few requests as possible and sent together.
+* Consecutive ops of the same device and function on contiguous registers become one request (in queue order,
+*   so a read after a write still sees it), the requests are pipelined on the tcp port.
+* The registers and the results are kept in fixed buffers, nothing is allocated.
+*/
+class ModbusTransaction {
+public:
+	static const int MAX_OPS = 32;
+	static const int MAX_REQUESTS = 16;
+	static const int MAX_REGS = 512; // registers of all the ops
+	// a read reply takes 12 + 2 * num bytes, the control port frames up to 128 - 4 (XArmAPI::connect)
+	static const int MAX_READ_REGS = (128 - 4 - 12) / 2;
+
+	/*
+	* @param slave_id: the modbus id of the device, UXBUS_CONF::GRIPPER_ID for the gripper
+	*/
+	ModbusTransaction(int slave_id = UXBUS_CONF::GRIPPER_ID);
+
+	/*
+	* Remove all the ops, the slave id is back to the one of the constructor
+	*/
+	void clear(void);
+
+	/*
+	* The modbus id of the device of the next ops, so one transaction can reach several devices
+	*/
+	void select_slave(int slave_id);
+
+	/*
+	* Queue a read of holding registers (function 0x03) or input registers (function 0x04)
+	* @param num: at most MAX_READ_REGS
+	* return: the index of the op (>= 0), UXBUS_STATE::OUT_OF_RANGE (< 0): too many ops, requests or registers,
+	*   or the registers are out of range
+	*/
+	int read_holding(int addr, int num = 1);
+	int read_input(int addr, int num = 1);
+
+	/*
+	* Queue a write of registers (function 0x10), a 32-bit value takes two registers, the high word first
+	* return: the index of the op (>= 0), UXBUS_STATE::OUT_OF_RANGE (< 0): too many ops, requests or registers,
+	*   or the registers are out of range
+	*/
+	int write_u16(int addr, int value);
+	int write_u32(int addr, int value);
+	int write_regs(int addr, const unsigned short *values, int num);
+
+	/*
+	* Send the queued ops, they can be sent again
+	* return: 0: success, else: the first failed state, see get_state for every op
+	*/
+	int execute(XArmAPI *arm);
+
+	int get_op_num(void);
+	int get_request_num(void); // the requests of the ops after coalescing
+
+	/*
+	* The results of the last execute
+	* @param op: the return of read_xxx/write_xxx
+	* @param index: the register of the op
+	* get_state return: the state of the request of the op, UXBUS_STATE::NOT_READY: not executed yet
+	*/
+	int get_state(int op);
+	int get_u16(int op, int index = 0);
+	int get_i16(int op, int index = 0);
+	int get_i32(int op, int index = 0); // registers index and index + 1, the high word first
+
+private:
+	struct Op {
+		unsigned char funcode;
+		unsigned short addr;
+		unsigned short num;
+		unsigned short offset; // of the registers in regs_
+		unsigned char request;
+	};
+	struct Request {
+		unsigned char slave_id;
+		unsigned char funcode;
+		unsigned short addr;
+		unsigned short num;
+		unsigned short offset;
+		int ret;
+	};
+	int _add(int funcode, int addr, int num);
+	int _encode(const Request &req, unsigned char *tx);
+	int _decode(const Request &req, const unsigned char *rx);
+
+private:
+	int default_slave_id_;
+	int slave_id_;
+	Op ops_[MAX_OPS];
+	int op_num_;
+	unsigned short regs_[MAX_REGS];
+	int reg_num_;
+	Request requests_[MAX_REQUESTS];
+	int request_num_;
+};
+
+#endif
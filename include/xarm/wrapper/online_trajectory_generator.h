@@ -0,0 +1,117 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+#ifndef WRAPPER_ONLINE_TRAJECTORY_GENERATOR_H_
+#define WRAPPER_ONLINE_TRAJECTORY_GENERATOR_H_
+
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include "xarm/wrapper/xarm_api.h"
+
+/*
+* Generates jerk-limited setpoints towards a target every cycle and sends them in servo mode
+*   (set_servo_angle_j / set_servo_cartesian), the target can be changed at any time.
+* Every cycle each axis takes the largest jerk that still lets it stop at the target within
+*   the speed/acc/jerk limits, so the motion is time-optimal up to the cycle time.
+* The axes of a group are scaled to the share of their distance, so they finish together
+*   (joint space: all the joints, cartesian space: x/y/z and roll/pitch/yaw).
+*/
+class OnlineTrajectoryGenerator {
+public:
+	static const int JOINT_SPACE = 0;
+	static const int CARTESIAN_SPACE = 1;
+
+	/*
+	* @param arm: a connected XArmAPI, in servo mode (set_mode(1)) and ready (set_state(0))
+	* @param space: JOINT_SPACE or CARTESIAN_SPACE
+	* @param cycle_time: seconds between two setpoints
+	*/
+	OnlineTrajectoryGenerator(XArmAPI *arm, int space = JOINT_SPACE, fp32 cycle_time = 0.004);
+	~OnlineTrajectoryGenerator(void);
+
+	/*
+	* Start the servo loop from the current joint angles (or tcp pose) of the arm, at rest
+	* return: see the API code documentation for details.
+	*/
+	int start(void);
+
+	/*
+	* Stop the servo loop, the arm holds the last setpoint
+	*/
+	void stop(void);
+
+	/*
+	* Set (or change) the target, the motion continues smoothly from the current setpoint
+	* @param target: joint space: fp32[7] angles, cartesian space: fp32[6]{x, y, z, roll, pitch, yaw},
+	*   in the units of the arm (default_is_radian)
+	* return: 0, UXBUS_STATE::JOINT_LIMIT/TCP_LIMIT: the target is out of the limits, it is not changed,
+	*   UXBUS_STATE::COLLISION: the joint path to the target collides (joint space, see XArmAPI::set_collision_checker)
+	*/
+	int set_target(fp32 target[7]);
+
+	/*
+	* Override the limits reported by the controller, 0 means use the reported one
+	*   joint space: speed/acc/jerk of the joints, in the units of the arm
+	*   cartesian space: speed/acc/jerk of the translation (mm), the rotation has its own (set_rot_limits)
+	*/
+	void set_limits(fp32 speed = 0, fp32 acc = 0, fp32 jerk = 0);
+
+	/*
+	* The limits of the rotation (roll/pitch/yaw) in cartesian space, in the units of the arm
+	*   0 means the default: 180 degrees (pi rad) per second, the reported max_rot_acc and rot_jerk
+	*/
+	void set_rot_limits(fp32 speed = 0, fp32 acc = 0, fp32 jerk = 0);
+
+	bool is_reached(void);
+
+	/*
+	* @param timeout: seconds, NO_TIMEOUT means wait forever
+	* return: 0: reached, UXBUS_STATE::ERR_TOUT: timeout, else: the error that stopped the servo loop
+	*/
+	int wait_reached(fp32 timeout = NO_TIMEOUT);
+
+	/*
+	* The last setpoint sent, in the units of the arm
+	* @param pos/vel/acc: fp32[7], NULL if not needed
+	*/
+	void get_setpoint(fp32 pos[7], fp32 *vel = NULL, fp32 *acc = NULL);
+
+	int last_error(void); // the error that stopped the servo loop, 0 if none
+
+private:
+	void _get_limits(double vmax[7], double amax[7], double jmax[7]);
+	void _update_scales(void);
+	void _step(void);
+	void _servo_loop(void);
+
+private:
+	XArmAPI *arm_;
+	int space_;
+	int axis_num_;
+	double cycle_time_;
+	std::thread thread_;
+	std::mutex mutex_;
+	std::atomic<bool> is_running_;
+	std::atomic<int> last_error_;
+	bool is_reached_;
+	fp32 speed_;
+	fp32 acc_;
+	fp32 jerk_;
+	fp32 rot_speed_;
+	fp32 rot_acc_;
+	fp32 rot_jerk_;
+	// controller units (rad, mm)
+	double pos_[7];
+	double vel_[7];
+	double acc_state_[7];
+	double target_[7];
+	double scale_[7]; // share of the group limits of every axis
+};
+
+#endif
@@ -0,0 +1,87 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+#ifndef WRAPPER_REPORT_CLOCK_H_
+#define WRAPPER_REPORT_CLOCK_H_
+
+#include <mutex>
+
+/*
+* The clock of the controller seen from the host, all times on the host monotonic clock (get_steady_time_us)
+* The controller time is counted in report periods from the first report of the estimation:
+*   host_us = offset_us + ctrl_us * (1 + drift_ppm / 1e6)
+*/
+struct ClockEstimate {
+	bool valid; // enough reports to estimate
+	bool kernel_stamp; // the arrivals are stamped by the kernel, not by the receive thread
+	long long sample_num; // the reports of the estimation window
+	long long reset_num; // the estimation restarted (reconnect, long outage, the reports came faster than the fit)
+	double period_us; // the report period measured on the host clock
+	double nominal_period_us; // the report period on the controller clock (period_us rounded to the millisecond)
+	double drift_ppm; // host microseconds per controller second above 1e6, > 0: the controller clock is slow
+	long long offset_us; // the host time of the controller time 0 (the acquisition of the first report)
+	long long path_delay_us; // subtracted from the earliest arrivals to get the acquisitions
+	long long queue_delay_us; // the mean delay of the arrivals over the earliest possible ones (the jitter)
+	long long last_arrival_us;
+	long long last_acquire_us; // the estimated acquisition of the last report
+};
+
+/*
+* Estimates when the reports were measured from when they arrive
+* The reports leave the controller at a fixed period, so the arrivals of report k lie above the line
+*   offset + path_delay + k * period and touch it when the report was not delayed. The line is fitted as the
+*   lower envelope of the arrivals of the last WINDOW_NUM reports (the lower convex hull edge under the
+*   mean index, which minimizes the sum of the delays over the line), the delays of the host or the network
+*   only lift points above it.
+* The index of a report comes from the fitted line, so the dropped reports do not shift the clock, a report
+*   delayed into the next period is moved back when the report of that period comes.
+* The path delay (the network and the send of the controller) can not be seen from one way arrivals,
+*   it is given with set_path_delay_us.
+*/
+class ReportClockEstimator {
+public:
+	static const int WINDOW_NUM = 512;
+	static const int MIN_NUM = 8; // the reports before the first estimate
+
+	ReportClockEstimator(void);
+
+	void reset(void);
+	void set_path_delay_us(long long path_delay_us);
+	/*
+	* A report arrived
+	* @param arrival_us: its arrival, kernel_stamp: the arrival is a kernel stamp
+	* return: the estimated acquisition of the report, 0 before the first estimate
+	*/
+	long long on_report(long long arrival_us, bool kernel_stamp);
+	void get_estimate(ClockEstimate *estimate);
+
+private:
+	void _restart(void);
+	bool _shift_back(long long index); // make room for a report of the index, false if too many reports move
+	void _fit(void);
+
+	std::mutex mutex_;
+	long long index_[WINDOW_NUM]; // the report indexes of the window, increasing
+	long long arrival_[WINDOW_NUM];
+	int hull_[WINDOW_NUM];
+	int next_;
+	int count_;
+	long long last_index_;
+	long long last_arrival_us_;
+	long long last_acquire_us_;
+	long long path_delay_us_;
+	long long reset_num_;
+	bool kernel_stamp_;
+	bool fitted_;
+	// the envelope, arrival = base_us_ + slope_ * index
+	double base_us_;
+	double slope_;
+	double queue_delay_us_;
+};
+
+#endif
@@ -0,0 +1,92 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+#ifndef WRAPPER_REPORT_HEALTH_H_
+#define WRAPPER_REPORT_HEALTH_H_
+
+#include <mutex>
+#include <atomic>
+
+/*
+* The health of the report stream, all times in microseconds
+* The interval statistics are over the last ReportHealthMonitor::WINDOW_NUM reports
+*/
+struct ReportHealth {
+	long long report_num; // reports received since the connection
+	long long drop_num; // reports dropped because the receive queue was full
+	long long gap_num; // intervals longer than twice the mean interval
+	long long stale_num; // times the state became stale
+	long long age_us; // since the arrival of the last report, -1 means no report yet
+	long long delay_us; // from the arrival of the last report to its decoding
+	long long last_interval_us;
+	long long mean_interval_us;
+	long long min_interval_us;
+	long long max_interval_us;
+	long long std_interval_us;
+	long long jitter_us; // smoothed difference of consecutive intervals (as RFC 3550)
+	long long max_gap_us; // the longest interval since the connection
+	bool stale; // age_us is over the staleness threshold
+};
+
+/*
+* Timestamps every report on arrival and keeps rolling statistics of the intervals,
+*   cheap enough for every report (a few additions under an uncontended lock)
+* The staleness is computed from the age of the last report whenever asked, so it is exact even when
+*   no report comes to update it.
+*/
+class ReportHealthMonitor {
+public:
+	static const int WINDOW_NUM = 128;
+
+	ReportHealthMonitor(void);
+
+	void reset(void);
+	/*
+	* @param stale_us: the age of the last report above which the state is stale, <= 0 means never
+	*/
+	void set_stale_threshold(long long stale_us);
+	long long get_stale_threshold(void);
+
+	/*
+	* A report was decoded
+	* @param recv_us: its arrival, now_us: its decoding (get_steady_time_us)
+	* return: true if the state was stale before it (fresh again)
+	*/
+	bool on_report(long long recv_us, long long now_us);
+	/*
+	* return: true if the state became stale since the last call (once per staleness)
+	*/
+	bool check(long long now_us);
+
+	bool is_stale(long long now_us);
+	long long get_age_us(long long now_us);
+	/*
+	* @param drop_num: the drops of the receive queue
+	*/
+	void get_health(ReportHealth *health, long long now_us, long long drop_num);
+
+private:
+	std::mutex mutex_;
+	std::atomic<long long> last_recv_us_; // 0 means no report yet
+	std::atomic<long long> stale_us_;
+	bool stale_; // the staleness already signaled
+	long long intervals_[WINDOW_NUM];
+	int next_;
+	int count_;
+	long long sum_; // of the intervals of the window
+	long long sum_sq_;
+	long long report_num_;
+	long long gap_num_;
+	long long stale_num_;
+	long long delay_us_;
+	long long last_interval_us_;
+	long long jitter_us_;
+	long long max_gap_us_;
+};
+
+#endif
@@ -0,0 +1,57 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+#ifndef WRAPPER_ROBOT_STATE_H_
+#define WRAPPER_ROBOT_STATE_H_
+
+/*
+* A decoded report of the arm, plain C data so it can live in shared memory and cross the C API
+* The units are fixed whatever default_is_radian of the publisher: mm, rad, mm/s, rad/s
+*/
+typedef struct RobotState {
+	long long seq; // the report sequence number of the publisher, from 1
+	long long time; // the receive time of the report (milliseconds, get_system_time)
+	long long acquire_us; // the estimated acquisition of the report (microseconds, get_steady_time_us), 0: not estimated yet
+	int state;
+	int mode;
+	int cmd_num;
+	int error_code;
+	int warn_code;
+	int axis;
+	int mt_brake; // bit i: the brake of joint i + 1
+	int mt_able;  // bit i: joint i + 1 enabled
+	int count;
+	float temperatures[7];
+	float angles[7];
+	float position[6];
+	float joints_torque[7];
+	float tcp_offset[6];
+	float tcp_load[4];
+	float realtime_tcp_speed;
+	float realtime_joint_speeds[7];
+	float world_offset[6];
+} RobotState;
+
+/*
+* The state of the arm extrapolated from the last reports to a time (StatePredictor), in the units of RobotState
+*/
+typedef struct PredictedState {
+	long long time_us; // the time of the prediction (microseconds, get_steady_time_us)
+	long long report_us; // the acquisition of the last report, its arrival before the clock is estimated
+	long long horizon_us; // time_us - report_us, clamped to the horizon of the predictor
+	int clamped; // 1: the time is beyond the horizon, the state is the one at the horizon
+	int measured_speeds; // 1: the joint speeds come from the reports, 0: from the angles of the last reports
+	float angles[7];
+	float joint_speeds[7];
+	float position[6];
+	float tcp_speeds[6];
+	float joint_error; // the largest joint error of the predictions over the last reports (rad, one report ahead)
+	float tcp_error; // the largest position error of the predictions over the last reports (mm, one report ahead)
+} PredictedState;
+
+#endif
@@ -0,0 +1,83 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+#ifndef WRAPPER_STATE_PREDICTOR_H_
+#define WRAPPER_STATE_PREDICTOR_H_
+
+#include <atomic>
+#include "xarm/wrapper/robot_state.h"
+
+/*
+* Extrapolates the joints and the tool between the reports, for the loops faster than the reports
+* Every report updates the speeds and the accelerations (the reported joint speeds when the report has them,
+*   else the differences of the last reports), a prediction is the second order extrapolation from the
+*   last report: p + v * dt + a * dt^2 / 2, with dt clamped to the horizon so the error stays bounded
+*   when the reports stop.
+* The extrapolation of each report is checked against the next report, the largest errors of the last
+*   ERROR_NUM reports are given with the predictions.
+* One thread updates, any number of threads predict without lock: the model is published under a seqlock,
+*   a prediction copies it (retried only if an update was written meanwhile) and costs a few multiplications.
+*/
+class StatePredictor {
+public:
+	static const int ERROR_NUM = 32;
+
+	StatePredictor(void);
+
+	void reset(void); // by the thread of the reports, or before it starts
+	/*
+	* @param horizon_us: the longest extrapolation, default 20000 (two reports at 100Hz)
+	*/
+	void set_horizon_us(long long horizon_us);
+	long long get_horizon_us(void);
+
+	/*
+	* A report, called by the thread of the reports only
+	* @param report_us: the acquisition of the report (get_steady_time_us)
+	* @param acquired: report_us is an acquisition estimate, not an arrival (a change restarts the differences)
+	* @param angles: rad, position: mm and rad
+	* @param joint_speeds: rad/s, NULL if the report has none
+	*/
+	void update(long long report_us, bool acquired, const float *angles, const float *position, const float *joint_speeds);
+
+	/*
+	* @param time_us: the time of the prediction (get_steady_time_us)
+	* return: 0: success, UXBUS_STATE::NOT_READY: no report yet
+	*/
+	int predict(long long time_us, PredictedState *state);
+
+private:
+	struct Model_ {
+		long long report_us;
+		bool valid;
+		bool measured_speeds;
+		float angles[7];
+		float joint_speeds[7];
+		float joint_acc[7];
+		float position[6];
+		float tcp_speeds[6];
+		float tcp_acc[6];
+		float joint_error;
+		float tcp_error;
+	};
+
+	static void _extrapolate(const Model_ &model, double dt, float *angles, float *joint_speeds, float *position, float *tcp_speeds);
+
+	std::atomic<unsigned int> lock_; // odd while the model is written
+	std::atomic<long long> horizon_us_;
+	Model_ model_; // published
+	Model_ last_; // the model of the writer
+	int history_; // the reports since the differences restarted
+	bool acquired_;
+	float joint_errors_[ERROR_NUM];
+	float tcp_errors_[ERROR_NUM];
+	int error_next_;
+	int error_num_;
+};
+
+#endif
@@ -0,0 +1,134 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+#ifndef WRAPPER_STATE_SHM_H_
+#define WRAPPER_STATE_SHM_H_
+
+#include <atomic>
+#include <string>
+#include "xarm/wrapper/robot_state.h"
+
+/*
+* The layout of the shared memory: a header then a ring of the last reports, each slot guarded by a seqlock
+*/
+struct RobotStateShm {
+	static const unsigned int MAGIC = 0x58535441; // "XSTA"
+	static const unsigned int VERSION = 2;
+
+	unsigned int magic;
+	unsigned int version;
+	unsigned int state_size; // sizeof(RobotState) of the publisher
+	unsigned int slot_num;
+	std::atomic<long long> seq; // the last published report, in slot (seq - 1) % slot_num
+	struct Slot {
+		std::atomic<unsigned int> lock; // odd while written
+		RobotState state;
+	} slots[1]; // slot_num slots
+};
+
+/*
+* Publishes the reports of an XArmAPI (set_state_publisher) into a POSIX shared memory segment,
+*   so other processes can read the state of the arm without a connection of their own
+* Not available on Windows (open returns -1).
+*/
+class StatePublisher {
+public:
+	StatePublisher(void);
+	~StatePublisher(void);
+
+	/*
+	* Create (or take over) the segment
+	* @param name: the name of the segment, like "/xarm_192.168.1.100"
+	* @param slot_num: the reports kept, [1, 1024]
+	* return: 0: success, -1: the segment can not be created, UXBUS_STATE::ERR_PARAM: slot_num out of range
+	*/
+	int open(const std::string &name, int slot_num = 16);
+
+	/*
+	* The same ring in the memory of the process, for the readers of the process (peek), on Windows too
+	* return: 0: success, -1: out of memory, UXBUS_STATE::ERR_PARAM: slot_num out of range
+	*/
+	int open_local(int slot_num = 16);
+
+	/*
+	* Unmap and remove the segment, the readers keep their mapping
+	*/
+	void close(void);
+	bool is_open(void);
+
+	/*
+	* Called by XArmAPI for every report, state.seq is set here
+	*/
+	void publish(RobotState &state);
+
+	/*
+	* The last report in place, without a copy, NULL: none yet or not open
+	* The slot is rewritten after slot_num reports, the fields read are valid if is_current(state, lock) is true after the read
+	* @param lock: the lock of the slot, for is_current
+	*/
+	const RobotState *peek(unsigned int *lock);
+	bool is_current(const RobotState *state, unsigned int lock);
+
+private:
+	void _init_segment(void *addr, size_t size, int slot_num);
+
+private:
+	std::string name_;
+	bool is_local_;
+	RobotStateShm *shm_;
+	size_t size_;
+	long long seq_;
+};
+
+/*
+* Reads the segment of a StatePublisher of another process
+* The segment is mapped read only. The reads never block the publisher, a read only retries when its slot
+*   was rewritten meanwhile, which takes slot_num reports
+*/
+class StateReader {
+public:
+	StateReader(void);
+	~StateReader(void);
+
+	/*
+	* return: 0: success, -1: no such segment, UXBUS_STATE::ERR_PARAM: not a segment of this layout
+	*/
+	int open(const std::string &name);
+	void close(void);
+	bool is_open(void);
+
+	/*
+	* The sequence number of the last report, 0: none yet
+	*/
+	long long get_seq(void);
+
+	/*
+	* The last report, or the last one read before when the ring was rewritten during every read
+	*   (the reader is starved, state->seq tells which report it is)
+	* return: 0: success, UXBUS_STATE::NOT_READY: none yet, -1: not open,
+	*   UXBUS_STATE::ERR_TOUT: starved before the first read
+	*/
+	int get_latest(RobotState *state);
+
+	/*
+	* The last reports, the newest first
+	* @param states: RobotState[num]
+	* return: the number of the reports copied
+	*/
+	int get_recent(RobotState *states, int num);
+
+private:
+	bool _read_slot(long long seq, RobotState *state);
+
+private:
+	RobotStateShm *shm_;
+	size_t size_;
+	RobotState last_; // the last report of get_latest, seq 0: none
+};
+
+#endif
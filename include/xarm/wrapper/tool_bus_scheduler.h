@@ -0,0 +1,73 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+#ifndef WRAPPER_TOOL_BUS_SCHEDULER_H_
+#define WRAPPER_TOOL_BUS_SCHEDULER_H_
+
+#include <mutex>
+#include <atomic>
+#include "xarm/wrapper/modbus_transaction.h"
+#include "xarm/wrapper/modbus_device.h"
+#include "xarm/wrapper/common/poll_thread.h"
+
+/*
+* Polls the ModbusDevices of the tool gpio in the background: every cycle the queued writes and
+*   the due register blocks of all the devices are packed into one ModbusTransaction
+*   (coalesced and pipelined), and the replies are copied into the images of the devices.
+* What does not fit in a cycle is sent in the next one, the writes of a device keep their order.
+*/
+class ToolBusScheduler {
+public:
+	static const int MAX_DEVICES = 8;
+
+	/*
+	* @param arm: a connected XArmAPI
+	*/
+	ToolBusScheduler(XArmAPI *arm);
+	~ToolBusScheduler(void);
+
+	/*
+	* The devices are not owned, remove a device (or stop) before deleting it
+	* return: 0: success, UXBUS_STATE::ERR_PARAM: too many devices
+	*/
+	int add_device(ModbusDevice *device);
+	void remove_device(ModbusDevice *device);
+
+	/*
+	* Only available in socket way
+	* @param cycle: milliseconds between two cycles, > 0
+	* return: 0: success, -1: the arm is not connected, 12: cycle out of range, UXBUS_STATE::ERR_NOTTCP: serial port
+	*/
+	int start(int cycle = 20);
+	void stop(void);
+	bool is_running(void);
+
+	long long get_cycle_num(void); // cycles since start
+	int get_last_state(void); // the state of the last cycle, 0: success
+	int get_last_request_num(void); // the requests of the last cycle after coalescing
+
+private:
+	void _cycle(void);
+	void _poll(void);
+
+private:
+	XArmAPI *arm_;
+	PollThread poller_;
+	std::mutex mutex_; // the devices, held during a cycle
+	ModbusDevice *devices_[MAX_DEVICES];
+	int device_num_;
+	ModbusTransaction trans_;
+	int block_ops_[MAX_DEVICES][ModbusDevice::MAX_BLOCKS]; // the ops of the blocks in the cycle, -1 if not due
+	int write_ops_[MAX_DEVICES][ModbusDevice::MAX_WRITES];
+	int write_op_num_[MAX_DEVICES];
+	std::atomic<long long> cycle_num_;
+	std::atomic<int> last_state_;
+	std::atomic<int> last_request_num_;
+};
+
+#endif
@@ -0,0 +1,140 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+#ifndef WRAPPER_TRAJECTORY_PLANNER_H_
+#define WRAPPER_TRAJECTORY_PLANNER_H_
+
+#include <vector>
+#include "xarm/wrapper/xarm_api.h"
+#include "xarm/wrapper/trajectory_streamer.h"
+
+/*
+* Offline planning of a waypoint list (joint angles or tcp poses):
+*   the corners are smoothed with blends of at most blend_radius (quadratic bezier, the same
+*   tangent points as move_lineb), the path is time-parameterized with a forward/backward pass
+*   under the speed/acc limits of every axis, and sampled at the servo cycle.
+* The points are stored per axis (one contiguous array each), the units are the ones of the
+*   waypoints and the limits.
+* Cartesian space: roll/pitch/yaw are unwrapped between the waypoints (the short way round) and wrapped
+*   back in the setpoints. The linear and the angular part of the path are limited apart, so a segment
+*   takes the time of the slower of the two, the blends are in mm with a rotation counting as the mm the
+*   linear speed covers while the angular speed turns it.
+*/
+class TrajectoryPlanner {
+public:
+	static const int JOINT_SPACE = 0;
+	static const int CARTESIAN_SPACE = 1;
+
+	/*
+	* @param space: JOINT_SPACE (7 axes) or CARTESIAN_SPACE (6 axes, {x, y, z, roll, pitch, yaw})
+	* @param is_radian: the angles of the waypoints are radians, else degrees (for the unwrapping)
+	*/
+	TrajectoryPlanner(int space = JOINT_SPACE, bool is_radian = DEFAULT_IS_RADIAN);
+
+	void clear(void);
+
+	/*
+	* @param point: fp32[7] joint angles or fp32[6] tcp pose, repeated points are skipped
+	*/
+	int add_waypoint(const fp32 *point);
+	int get_waypoint_num(void);
+
+	/*
+	* @param speed: fp32[7] (or fp32[6]) max speed of every axis
+	* @param acc: fp32[7] (or fp32[6]) max acc of every axis
+	*   cartesian space: the smallest of x/y/z (roll/pitch/yaw) limits the linear (angular) part along the path too
+	*/
+	void set_limits(const fp32 *speed, const fp32 *acc);
+
+	/*
+	* @param radius: max blending radius of the corners, 0 means stop at every corner
+	*/
+	void set_blend_radius(fp32 radius);
+
+	/*
+	* Time-parameterize the waypoints and sample the setpoints
+	* @param cycle_time: seconds between two setpoints
+	* return: 0: success, UXBUS_STATE::ERR_PARAM: less than 2 waypoints or a limit is not set
+	*/
+	int plan(fp32 cycle_time = 0.004);
+
+	fp32 get_duration(void); // seconds
+	int get_setpoint_num(void);
+
+	/*
+	* @param axis: [0, 7)
+	* return: the setpoints of one axis, get_setpoint_num() values
+	*/
+	const fp32 *get_axis_setpoints(int axis);
+	int get_setpoint(int index, fp32 point[7]);
+
+	/*
+	* Send the setpoints with set_servo_angle_j (joint space) or set_servo_cartesian (cartesian space),
+	*   the arm must be in servo mode and at the first waypoint, the waypoints in the units of the arm
+	*   all the setpoints are checked against the limits of the arm before the first one is sent
+	*   it stops with UXBUS_STATE::REPORT_STALE while the servo setpoints are held (set_report_staleness)
+	* return: see the API code documentation for details.
+	*/
+	int execute(XArmAPI *arm);
+
+	/*
+	* Push the fewest segments that stay within tolerance of the path to a TrajectoryStreamer,
+	*   cartesian space: move_lineb segments with radius min(blend_radius, half of the adjacent segments)
+	*   joint space: joint segments (move_joint does not blend)
+	* @param tolerance: max distance from the dropped waypoints to the kept segments
+	* @param speed/acc: the speed/acc of the segments, 0 means the one of the arm
+	* return: the number of segments pushed, UXBUS_STATE::JOINT_LIMIT/TCP_LIMIT: a segment is out of the limits,
+	*   the segments before it are pushed
+	*/
+	int push_segments(TrajectoryStreamer *streamer, fp32 tolerance = 0, fp32 speed = 0, fp32 acc = 0);
+
+private:
+	void _add_sample(const double *q, const double *dq, const double *ddq, double ds, int blend, double tau, double dtau);
+	void _eval_blend(int blend, double tau, double *q, double *d1, double *d2);
+	void _build_path(void);
+	double _wrap_angle(double angle);
+	int _limit_axes(int index, double *dq, double *ddq, double *speed, double *acc);
+	double _reach_speed(int index, double v);
+	void _interval_speed(int index, double v0, double v1, double *peak, double *acc);
+	double _interval_time(int index, double v0, double v1);
+	double _interval_dist(int index, double v0, double v1, double t);
+	void _simplify(int first, int last, double tolerance, std::vector<char> &keep);
+
+private:
+	int space_;
+	int axis_num_;
+	double blend_radius_;
+	double cycle_time_;
+	double duration_;
+	double speed_[7];
+	double acc_[7];
+	double part_speed_[2]; // cartesian space: the linear and the angular limits along the path
+	double part_acc_[2];
+	double scale_[7]; // of the axes in the path, cartesian space: the angles in mm
+	double angle_period_;
+	bool has_limits_;
+	std::vector<fp32> waypoints_[7];
+	// blends: bezier control points of every axis
+	std::vector<double> bp0_[7];
+	std::vector<double> bp1_[7];
+	std::vector<double> bp2_[7];
+	std::vector<double> bdtau0_; // dtau/ds at the start
+	// path samples: position, |dq/ds| and |d2q/ds2| of every axis, distance to the previous sample,
+	//   blend of the interval ending at the sample (-1: line), its bezier parameter and dtau/ds
+	std::vector<double> sq_[7];
+	std::vector<double> sdq_[7];
+	std::vector<double> sddq_[7];
+	std::vector<double> sds_;
+	std::vector<int> sblend_;
+	std::vector<double> stau_;
+	std::vector<double> sdtau_;
+	std::vector<double> svel_;
+	std::vector<fp32> setpoints_[7];
+};
+
+#endif
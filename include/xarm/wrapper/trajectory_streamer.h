@@ -0,0 +1,110 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+#ifndef WRAPPER_TRAJECTORY_STREAMER_H_
+#define WRAPPER_TRAJECTORY_STREAMER_H_
+
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include "xarm/wrapper/xarm_api.h"
+
+/*
+* Uploads a long list of motion segments while keeping the command cache of the controller
+*   filled to a target depth, the sends are pipelined ahead of their acks.
+* The depth is the cmd_num of the last report plus the segments the report could not count yet.
+*/
+class TrajectoryStreamer {
+public:
+	/*
+	* @param arm: a connected XArmAPI
+	* @param target_depth: number of segments to keep in the controller's command cache
+	* @param max_in_flight: max number of segments sent but not acked yet, [1, 16]
+	*/
+	TrajectoryStreamer(XArmAPI *arm, int target_depth = 32, int max_in_flight = 8);
+	~TrajectoryStreamer(void);
+
+	/*
+	* Queue a linear segment, same units and defaults as XArmAPI::set_position
+	*   the speed is clamped to the tcp speed limit of the safety boundary, as set_position
+	* @param radius: blending radius of MOVE_LINEB, < 0 means MOVE_LINE (no blending)
+	* return: 0, UXBUS_STATE::TCP_LIMIT: out of the safety boundary, not queued
+	*/
+	int push_position(fp32 pose[6], fp32 radius = 0, fp32 speed = 0, fp32 acc = 0, fp32 mvtime = 0);
+
+	/*
+	* Queue a joint segment, same units and defaults as XArmAPI::set_servo_angle
+	*   the joint path from the last joint segment (or from the current angles) is checked for collision
+	*   the speed is clamped to the joint speed limit, as set_servo_angle
+	* return: 0, UXBUS_STATE::JOINT_LIMIT/COLLISION: out of the joint ranges or colliding, not queued
+	*/
+	int push_angles(fp32 angles[7], fp32 speed = 0, fp32 acc = 0, fp32 mvtime = 0);
+
+	/*
+	* Start uploading the queued (and later pushed) segments
+	* return: 0: success, -1: the arm is not connected
+	*/
+	int start(void);
+
+	/*
+	* Wait until every queued segment is uploaded and acked
+	* @param wait_motion: also wait until the arm stops moving, with the report of the tcp port
+	*   until a report after the last ack shows the command cache empty and the arm not moving
+	* @param timeout: seconds, NO_TIMEOUT means wait forever
+	* return: 0: success, UXBUS_STATE::ERR_TOUT: timeout, else: the first error of the upload
+	*/
+	int wait_finish(bool wait_motion = false, fp32 timeout = NO_TIMEOUT);
+
+	/*
+	* Stop uploading and drop the segments not sent yet, the segments already in the controller are not touched
+	*/
+	void stop(void);
+
+	int pending(void); // segments not sent yet
+	int in_flight(void); // segments sent but not acked yet
+	long long acked(void); // segments acked since start
+	int last_error(void); // the first error of the upload, 0 if none
+
+private:
+	struct Segment {
+		int funcode;
+		float data[10];
+	};
+	struct InFlight {
+		int funcode;
+		int trans_id;
+	};
+	int _push(const Segment &seg);
+	int _post(UxbusCmd *core, const Segment &seg);
+	int _reap(UxbusCmd *core);
+	int _depth(UxbusCmd *core);
+	void _fail(int code);
+	void _stream_loop(void);
+
+private:
+	XArmAPI *arm_;
+	int target_depth_;
+	int max_in_flight_;
+	std::thread thread_;
+	std::mutex mutex_;
+	std::condition_variable cond_;
+	std::atomic<bool> is_running_;
+	std::deque<Segment> pending_;
+	std::deque<InFlight> in_flight_; // in the order they were sent
+	std::deque<long long> ack_times_; // acks not counted by a report yet
+	std::atomic<long long> acked_;
+	std::atomic<long long> last_ack_time_; // get_system_time, a report after it counts every acked segment
+	std::atomic<int> last_error_;
+	// the target of the last joint segment pushed, the start of the collision path of the next one
+	float last_angles_[7];
+	bool has_last_angles_;
+};
+
+#endif
@@ -13,6 +13,7 @@
 #include <functional>
 #include <thread>
 #include <vector>
+#include <atomic>
 #include <assert.h>
 #include <cmath>
 #include "xarm/core/common/data_type.h"
@@ -23,8 +24,15 @@
 #include "xarm/core/instruction/uxbus_cmd_tcp.h"
 #include "xarm/core/instruction/uxbus_cmd_config.h"
 #include "xarm/core/debug/debug_print.h"
+#include "xarm/core/debug/trace.h"
 #include "xarm/wrapper/common/utils.h"
 #include "xarm/wrapper/common/timer.h"
+#include "xarm/wrapper/limit_validator.h"
+#include "xarm/wrapper/collision_checker.h"
+#include "xarm/wrapper/state_shm.h"
+#include "xarm/wrapper/report_health.h"
+#include "xarm/wrapper/report_clock.h"
+#include "xarm/wrapper/state_predictor.h"
 
 #define DEFAULT_IS_RADIAN false
 #define RAD_DEGREE 57.295779513082320876798154814105
@@ -35,15 +43,43 @@
 typedef unsigned int u32;
 typedef float fp32;
 
+/*
+* Connection quality counters of the tcp channels, all times are in milliseconds
+*/
+struct ConnectionStats {
+	int control_drops; // times the control channel was lost
+	int report_drops; // times the report channel was lost
+	int report_idle_timeouts; // report drops caused by no report within report_idle_timeout_ms
+	int reconnect_attempts;
+	int reconnect_failures;
+	int reconnect_successes;
+	long long last_drop_time; // system time of the last drop, 0 means never
+	long long last_reconnect_time; // system time of the last successful reconnection, 0 means never
+	long long last_downtime; // duration of the last outage
+	long long total_downtime; // sum of all outages of both channels
+	long long connected_since; // system time since both channels are up, 0 means not connected
+};
+
+class GripperPoller;
+
 class XArmAPI {
+	friend class TrajectoryStreamer;
+	friend class OnlineTrajectoryGenerator;
+	friend class TrajectoryPlanner;
+	friend class GripperPoller;
+	friend class ModbusTransaction;
+	friend class IoMonitor;
+	friend class CommandBroker;
+	friend class ArmGroup;
+	friend class ToolBusScheduler;
 public:
 	/*
 	* @param port: ip-address(such as "192.168.1.185")
 	*   Note: this parameter is required if parameter do_not_open is False
 	* @param is_radian: set the default unit is radians or not, default is False
 	* @param do_not_open: do not open, default is False, if true, you need to manually call the connect interface.
-	* @param check_tcp_limit: reversed
-	* @param check_joint_limit: reversed
+	* @param check_tcp_limit: check the tcp targets against the safety boundary before sending them, default is false
+	* @param check_joint_limit: check the joint targets against the joint ranges before sending them (once a report gave the model), default is false
 	* @param check_cmdnum_limit: reversed
 	* @param check_robot_sn: reversed
 	* @param check_is_ready: check robot is ready to move or not, default is true
@@ -52,8 +88,8 @@ public:
 	XArmAPI(const std::string &port = "",
 		bool is_radian = DEFAULT_IS_RADIAN,
 		bool do_not_open = false,
-		bool check_tcp_limit = true,
-		bool check_joint_limit = true,
+		bool check_tcp_limit = false,
+		bool check_joint_limit = false,
 		bool check_cmdnum_limit = true,
 		bool check_robot_sn = false,
 		bool check_is_ready = true,
@@ -154,6 +190,120 @@ public:
 	/*no use please*/
 	void _recv_report_data(void);
 
+	/*no use please*/
+	void _supervise_connection(void);
+
+	/*
+	* Turn on/off the automatic reconnection of the tcp control and report channels, only available in socket way
+	* Lost channels are reconnected with exponential backoff, the last mode set by set_mode is restored after the control channel is back,
+	*   the state is never changed, so the robot will not move again by itself.
+	* @param enable: enable or not, default is true
+	* @param connect_timeout_ms: deadline of every connect attempt, <= 0 means blocking connect, default is 1000
+	* @param min_backoff_ms: the delay before the second attempt, default is 100
+	* @param max_backoff_ms: the delay is doubled after every failed attempt up to this value, default is 5000
+	* @param report_idle_timeout_ms: the report channel is considered lost if no report arrives within this time, <= 0 means never, default is 3000
+	* return: 0
+	*/
+	int set_auto_reconnect(bool enable, int connect_timeout_ms = 1000, int min_backoff_ms = 100, int max_backoff_ms = 5000, int report_idle_timeout_ms = 3000);
+
+	/*
+	* Turn on/off the fast connect mode, only available in socket way
+	* The control and report channels are opened concurrently, the version and sn are queried in one pipelined burst,
+	*   and the parsed capabilities are cached on disk per robot address (the sn is not known before probing),
+	*   so the next connect skips the probing.
+	*   The cache is checked against the version in the first report and probed again if the firmware changed,
+	*   another arm at the address with the same firmware has the same capabilities.
+	* @param enable: enable or not
+	* @param cache_dir: directory of the capability cache, default is $XARM_CACHE_DIR, then $HOME/.xarm
+	* return: 0
+	*/
+	int set_fast_connect(bool enable, const std::string &cache_dir = "");
+
+	/*
+	* Send the commands through the CommandBroker of another process instead of a control connection of its own,
+	*   the reports are still received from the arm, takes effect on the next connect, only available in socket way
+	* @param path: the unix domain socket of the broker, "" means a control connection of its own
+	* @param priority: the priority of the commands in the broker, [0, 255], -1 means the default one of the broker
+	* return: 0
+	*/
+	int set_command_broker(const std::string &path, int priority = -1);
+
+	/*
+	* Get the connection quality counters
+	* @param stats: the counters
+	* return: 0
+	*/
+	int get_connection_stats(ConnectionStats *stats);
+
+	/*
+	* Get the latency and error counters of the commands of the current connection,
+	*   the connection is also in the metrics registry (metrics_dump) under the port
+	* @param funcode: the funcode of UXBUS_RG, -1 means all the commands
+	* @param stats: the counters
+	* return: 0: success, -1: not connected or nothing recorded for the funcode
+	*/
+	int get_command_stats(int funcode, CommandStats *stats);
+
+	/*
+	* Set the staleness threshold of the reported state, only available in socket way
+	* The state is stale when the last report is older than the threshold (or no report came yet),
+	*   the report stale callbacks are called when it becomes stale and when a report comes again.
+	* @param stale_ms: the threshold in milliseconds, <= 0 means never stale (default)
+	* @param hold_servo: while the state is stale, set_servo_angle_j and set_servo_cartesian return
+	*   UXBUS_STATE::REPORT_STALE without sending, and OnlineTrajectoryGenerator holds its setpoint,
+	*   TrajectoryPlanner::execute stops, the servo moves of ArmGroup and IoMonitor are not staged, armed or sent
+	* return: 0: success, UXBUS_STATE::ERR_NOTTCP: serial port
+	*/
+	int set_report_staleness(int stale_ms, bool hold_servo = false);
+
+	/*
+	* Is the last report older than the staleness threshold
+	*/
+	bool is_report_stale(void);
+
+	/*
+	* Get the health of the report stream: the age of the last report, the intervals, jitter, gaps and drops
+	* @param health: the statistics, in microseconds
+	* return: 0
+	*/
+	int get_report_health(ReportHealth *health);
+
+	/*
+	* Set the delay from the acquisition of a report to its earliest arrival, only available in socket way
+	* The acquisition times of the reports (RobotState::acquire_us, get_clock_estimate) are the fitted
+	*   earliest arrivals minus this delay.
+	* @param path_delay_us: microseconds, < 0 means half the shortest round trip of the commands (default)
+	* return: 0
+	*/
+	int set_report_path_delay(int path_delay_us = -1);
+
+	/*
+	* Get the estimate of the controller clock on the host monotonic clock (get_steady_time_us):
+	*   the offset, the drift and the acquisition time of the last report, see ReportClockEstimator
+	* The arrivals are stamped by the kernel where available (SO_TIMESTAMPING on linux).
+	* @param estimate: the estimate, estimate->valid is false until enough reports came
+	* return: 0
+	*/
+	int get_clock_estimate(ClockEstimate *estimate);
+
+	/*
+	* Get the state of the arm extrapolated from the last reports to a time, without lock nor command,
+	*   for the loops faster than the reports, see StatePredictor
+	* The joint speeds are the reported ones when the reports have them, the times are the acquisitions
+	*   of the reports once the clock is estimated (get_clock_estimate).
+	* @param state: the predicted state, always in mm and rad whatever is_radian
+	* @param time_us: the time of the prediction (microseconds, get_steady_time_us), 0 means now
+	* return: 0: success, UXBUS_STATE::NOT_READY: no report yet
+	*/
+	int get_predicted_state(PredictedState *state, long long time_us = 0);
+
+	/*
+	* Set the longest extrapolation of get_predicted_state, a later time gives the state at the horizon
+	* @param horizon_us: microseconds, default 20000
+	* return: 0
+	*/
+	int set_prediction_horizon(int horizon_us);
+
 	/*
 	* Get the xArm version
 	* @param version:
@@ -231,7 +381,8 @@ public:
 		0: sport state
 		3: pause state
 		4: stop state
-	* return: see the API code documentation for details.
+	*   the pause is sent again every 20 ms until the report shows it (or the stop), 3 s at most
+	* return: see the API code documentation for details, UXBUS_STATE::ERR_TOUT: the pause is not reported
 	*/
 	int set_state(int state);
 
@@ -447,6 +598,8 @@ public:
 
 	/*
 	* Emergency stop
+	* The stop is written ahead of the requests of the other threads and sent again every 20ms
+	*   until a report shows it (3s at most), without waiting for the replies
 	*/
 	void emergency_stop(void);
 
@@ -569,6 +722,7 @@ public:
 	* @param pos: gripper position
 	* @param wait: wait or not, default is false
 	* @param timeout: maximum waiting time(unit: second), default is 10s, only valid if wait is true
+	*   the wait uses the samples of a running GripperPoller if any, else it polls the position every 200ms
 	* return: see the API code documentation for details.
 	*/
 	int set_gripper_position(fp32 pos, bool wait = false, fp32 timeout = 10);
@@ -751,6 +905,13 @@ public:
 	*/
 	int register_count_changed_callback(void(*callback)(int count));
 
+	/*
+	* Register the report stale callback, see set_report_staleness
+	* @param callback: stale: true when the state became stale, false when a report came again,
+	*   age_ms: the age of the last report, when it came again the time without report
+	*/
+	int register_report_stale_callback(void(*callback)(bool stale, int age_ms));
+
 	/*
 	* Release the location report callback
 	* @param callback: NULL means to release all callbacks;
@@ -805,6 +966,12 @@ public:
 	*/
 	int release_count_changed_callback(void(*callback)(int count) = NULL);
 
+	/*
+	* Release the report stale callback
+	* @param callback: NULL means to release all callbacks for the same event
+	*/
+	int release_report_stale_callback(void(*callback)(bool stale, int age_ms) = NULL);
+
 	/*
 	* Get suction cup state
 	* @param val:
@@ -932,6 +1099,19 @@ public:
 	*/
 	int set_collision_rebound(bool on);
 
+	/*
+	* Check the joint targets with a local collision checker before they are sent,
+	*   set_servo_angle: the joint path from the current angles, set_servo_angle_j: the target
+	* @param checker: the checker (not owned, it takes the axis of the reports), NULL to disable
+	*/
+	void set_collision_checker(CollisionChecker *checker);
+
+	/*
+	* Publish every report into the shared memory of a publisher, read by StateReader in other processes
+	* @param publisher: an open publisher (not owned), NULL to stop publishing
+	*/
+	void set_state_publisher(StatePublisher *publisher);
+
 	/*
 	* Set the base coordinate system offset at the end
 	* @param pose_offset: tcp offset, like [x(mm), y(mm), z(mm), roll(rad or °), pitch(rad or °), yaw(rad or °)]
@@ -1016,11 +1196,25 @@ public:
 private:
 	void _init(void);
 	void _check_version(void);
+	void _fast_check_version(void);
+	void _parse_version(const unsigned char *version_);
+	bool _load_capability_cache(void);
+	void _save_capability_cache(void);
+	void _check_capability_cache(void);
+	void _probe_capabilities(long long now); // one step of the version probe of CAPS_CHECK_STALE, by the supervisor
 	bool version_is_ge(int major = 1, int minor = 2, int revision = 11);
+	bool _version_ge(int major, int minor, int revision);
+	void _update_capabilities(void);
 	void _check_is_pause(void);
 	void _wait_stop(fp32 timeout);
+	bool _is_state_reported(void); // the report of the tcp port is up, the state is confirmed by it
+	void _post_urgent_state(int value); // one urgent set_state, then wait for the report up to STOP_RETRY_INTERVAL
 	void _update_old(unsigned char *data);
+	template<bool TCP_LOAD_MM>
+	void _update_new(unsigned char *data);
 	void _update(unsigned char *data);
+	void _publish_state(long long recv_time, long long acquire_us);
+	void _update_predictor(long long report_us, bool acquired, int sizeof_data);
 	template<typename callable_vector, typename callable>
 	inline int _register_event_callback(callable_vector&& callbacks, callable&& f);
 	template<typename callable_vector, typename callable>
@@ -1034,17 +1228,45 @@ private:
 	inline void _report_cmdnum_changed_callback(void);
 	inline void _report_temperature_changed_callback(void);
 	inline void _report_count_changed_callback(void);
+	inline void _report_stale_changed_callback(bool stale, int age_ms);
+	bool _is_servo_held(void); // hold_servo_on_stale_ and the state is stale
+	void _release_tcp_ports(void);
+	void _record_drop(bool is_control, long long now);
+	bool _try_reconnect(SocketPort *port, long long down_since, int *backoff_ms, long long *next_try_time);
+	void _refresh_limits(void);
+	int _check_joint_limit(fp32 angles[7]);
+	int _check_tcp_limit(fp32 pose[6]);
+	int _check_collision(fp32 angles[7], bool from_current);
+	void _sync_collision_axis(void);
+	/*
+	* A move checked against the limits and encoded into a whole frame, to be sent later by send_frame
+	* The parameters are the ones of set_position (linear, no radius)/set_servo_angle/set_servo_angle_j
+	*   in the units of the arm, the speed and acceleration default to the last used ones of the arm
+	* The joint moves are checked for collision at the target only, the start is not known yet
+	* A servo move is refused with UXBUS_STATE::REPORT_STALE while the servo setpoints are held (set_report_staleness)
+	* @param funcode: UXBUS_RG::MOVE_LINE (pose[6]), MOVE_JOINT or MOVE_SERVOJ (angles[7]), in the units of the arm
+	* @param len: the length of the frame, <= 0: the port can not encode it
+	*/
+	int _encode_move(int funcode, fp32 *target, fp32 speed, fp32 acc, fp32 mvtime, unsigned char *frame, int *len);
+	int _pend_move(UxbusCmd *core, int funcode, int trans_id);
+	/*
+	* Whether a background thread can send requests of its own, only on the tcp port (see UxbusCmdSer)
+	* return: 0: yes, -1: not connected, UXBUS_STATE::ERR_NOTTCP: serial port
+	*/
+	int _check_background_port(void);
 
 private:
 	std::string port_;
 	bool check_tcp_limit_;
 	bool check_joint_limit_;
+	std::atomic<bool> axis_reported_; // the axis is the one of the arm, not the default
 	bool check_cmdnum_limit_;
 	bool check_robot_sn_;
 	bool check_is_ready_;
 	bool check_is_pause_;
 	// pthread_t report_thread_;
 	std::thread report_thread_;
+	std::thread supervisor_thread_;
 	std::mutex mutex_;
 	std::condition_variable cond_;
 	bool is_ready_;
@@ -1053,15 +1275,61 @@ private:
 	bool is_old_protocol_;
 	bool is_first_report_;
 	bool is_sync_;
+	std::atomic<bool> is_closed_;
+
+	bool auto_reconnect_;
+	int reconnect_timeout_ms_;
+	int min_backoff_ms_;
+	int max_backoff_ms_;
+	int report_idle_timeout_ms_;
+	int last_set_mode_;
+	std::atomic<long long> last_report_time_;
+	std::atomic<long long> last_report_us_; // get_steady_time_us of the last report
+	std::atomic<long long> move_start_us_; // get_steady_time_us of the last report which showed the arm starting to move
+	std::mutex stats_mutex_;
+	ConnectionStats conn_stats_;
+	ReportHealthMonitor report_health_;
+	bool hold_servo_on_stale_;
+	ReportClockEstimator report_clock_;
+	int report_path_delay_us_; // < 0: half the shortest command round trip
+	StatePredictor state_predictor_;
+
+	bool fast_connect_;
+	std::string broker_path_;
+	int broker_priority_;
+	std::string cache_dir_;
+	std::string cached_version_;
+	std::string cached_report_version_;
+	static const int CAPS_CHECK_DONE = 0;
+	static const int CAPS_CHECK_PENDING = 1; // compare the cache with the first report
+	static const int CAPS_CHECK_STALE = 2; // the cache is outdated, probe again
+	static const int CAPS_CHECK_REPORTED = 3; // the first report came, reported_version_ is compared by the supervisor
+	std::atomic<int> caps_check_;
+	unsigned char reported_version_[30]; // written by the report thread before CAPS_CHECK_REPORTED
+	int caps_probe_id_; // the transaction of the version probe, -1 if none in flight
+	int caps_probe_tries_;
+	long long caps_probe_time_;
 
 	int major_version_number_;
 	int minor_version_number_;
 	int revision_version_number_;
 
+	// firmware capabilities, computed once the version is known
+	static const unsigned int CAP_OLD_PROTOCOL = 0x01; // report layout before 2019-02
+	static const unsigned int CAP_TCP_LOAD_MM = 0x02; // tcp load center of gravity in mm (firmware > 0.2.0)
+	static const unsigned int CAP_REDUCED_STATES_EXT = 0x04; // 79 bytes reduced states with jrange (firmware >= 1.2.11)
+	std::atomic<unsigned int> caps_; // published whole, read by the report thread for every report
+	unsigned int report_caps_; // the ones of the report being decoded, by the report thread only
+
 	long long sleep_finish_time_;
 
 	int mt_brake_;
 	int mt_able_;
+	LimitValidator limit_validator_;
+	std::atomic<CollisionChecker *> collision_checker_; // its axis follows the reports
+	StatePublisher *state_publisher_;
+	GripperPoller *gripper_poller_; // set by a running GripperPoller
+	std::mutex gripper_poller_mutex_; // guards gripper_poller_ and the count of the waits on it
 	fp32 min_tcp_speed_;
 	fp32 max_tcp_speed_;
 	fp32 min_tcp_acc_;
@@ -1092,6 +1360,7 @@ private:
 	std::vector<void(*)(int)> cmdnum_changed_callbacks_;
 	std::vector<void(*)(const fp32*)> temperature_changed_callbacks_;
 	std::vector<void(*)(int)> count_changed_callbacks_;
+	std::vector<void(*)(bool, int)> report_stale_callbacks_;
 };
 
 #endif
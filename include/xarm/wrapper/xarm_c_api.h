@@ -0,0 +1,147 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+#ifndef WRAPPER_XARM_C_API_H_
+#define WRAPPER_XARM_C_API_H_
+
+#include "xarm/wrapper/robot_state.h"
+
+/*
+* A C API where every call takes the handle of its arm, so several threads can drive several arms
+*   without the current instance of XArmWrapper (switch_xarm).
+* The calls of one handle are as thread safe as the methods of XArmAPI, the handles are independent.
+* The return codes are the ones of XArmAPI, -1 also means a NULL handle.
+* The getters xarm_get_report, xarm_get_joint_states, xarm_get_tcp_states, xarm_get_positions and
+*   xarm_get_servo_angles read the last report, without a request to the controller, and all the values
+*   of one call come from the same report, in the units of RobotState (mm, rad).
+*/
+#ifdef _WIN32
+#define XARM_C_API __declspec(dllexport)
+#define XARM_CALL __stdcall
+#else
+#define XARM_C_API __attribute__((visibility("default")))
+#define XARM_CALL
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct XArmInstance *XArmHandle;
+
+/*
+* @param port: the ip of the arm or the serial port, "" with do_not_open
+* The flags are the ones of the constructor of XArmAPI, 0/1
+* return: the handle
+*/
+XARM_C_API XArmHandle XARM_CALL xarm_create(const char *port, int is_radian, int do_not_open,
+	int check_tcp_limit, int check_joint_limit, int check_cmdnum_limit,
+	int check_robot_sn, int check_is_ready, int check_is_pause);
+/*
+* Disconnect and free the arm, the handle is invalid after
+*/
+XARM_C_API void XARM_CALL xarm_destroy(XArmHandle arm);
+
+XARM_C_API int XARM_CALL xarm_connect(XArmHandle arm, const char *port);
+XARM_C_API int XARM_CALL xarm_disconnect(XArmHandle arm);
+XARM_C_API int XARM_CALL xarm_is_connected(XArmHandle arm);
+
+XARM_C_API int XARM_CALL xarm_motion_enable(XArmHandle arm, int enable, int servo_id);
+XARM_C_API int XARM_CALL xarm_set_mode(XArmHandle arm, int mode);
+XARM_C_API int XARM_CALL xarm_set_state(XArmHandle arm, int state);
+XARM_C_API int XARM_CALL xarm_clean_warn(XArmHandle arm);
+XARM_C_API int XARM_CALL xarm_clean_error(XArmHandle arm);
+XARM_C_API int XARM_CALL xarm_emergency_stop(XArmHandle arm);
+XARM_C_API int XARM_CALL xarm_reset(XArmHandle arm, int wait, float timeout);
+
+/*
+* The moves of XArmAPI, timeout: seconds, -1 means no timeout
+*/
+XARM_C_API int XARM_CALL xarm_set_position(XArmHandle arm, float pose[6], float radius, float speed, float acc, float mvtime, int wait, float timeout);
+XARM_C_API int XARM_CALL xarm_set_tool_position(XArmHandle arm, float pose[6], float speed, float acc, float mvtime, int wait, float timeout);
+XARM_C_API int XARM_CALL xarm_set_servo_angle(XArmHandle arm, float angles[7], float speed, float acc, float mvtime, int wait, float timeout);
+XARM_C_API int XARM_CALL xarm_set_servo_angle_j(XArmHandle arm, float angles[7], float speed, float acc, float mvtime);
+XARM_C_API int XARM_CALL xarm_set_servo_cartesian(XArmHandle arm, float pose[6], float speed, float acc, float mvtime);
+XARM_C_API int XARM_CALL xarm_move_gohome(XArmHandle arm, float speed, float acc, float mvtime, int wait, float timeout);
+
+XARM_C_API int XARM_CALL xarm_set_tcp_offset(XArmHandle arm, float pose_offset[6]);
+XARM_C_API int XARM_CALL xarm_set_tcp_load(XArmHandle arm, float weight, float center_of_gravity[3]);
+
+XARM_C_API int XARM_CALL xarm_set_gripper_enable(XArmHandle arm, int enable);
+XARM_C_API int XARM_CALL xarm_set_gripper_mode(XArmHandle arm, int mode);
+XARM_C_API int XARM_CALL xarm_set_gripper_speed(XArmHandle arm, float speed);
+XARM_C_API int XARM_CALL xarm_set_gripper_position(XArmHandle arm, float pos, int wait, float timeout);
+XARM_C_API int XARM_CALL xarm_get_gripper_position(XArmHandle arm, float *pos);
+
+XARM_C_API int XARM_CALL xarm_get_tgpio_digital(XArmHandle arm, int *io0_value, int *io1_value);
+XARM_C_API int XARM_CALL xarm_set_tgpio_digital(XArmHandle arm, int ionum, int value);
+XARM_C_API int XARM_CALL xarm_get_cgpio_digital(XArmHandle arm, int *digitals);
+XARM_C_API int XARM_CALL xarm_get_cgpio_analog(XArmHandle arm, int ionum, float *value);
+XARM_C_API int XARM_CALL xarm_set_cgpio_digital(XArmHandle arm, int ionum, int value);
+XARM_C_API int XARM_CALL xarm_set_cgpio_analog(XArmHandle arm, int ionum, int value);
+
+/*
+* Requests to the controller
+*/
+XARM_C_API int XARM_CALL xarm_get_version(XArmHandle arm, unsigned char version[40]);
+XARM_C_API int XARM_CALL xarm_get_state(XArmHandle arm, int *state);
+XARM_C_API int XARM_CALL xarm_get_cmdnum(XArmHandle arm, int *cmdnum);
+XARM_C_API int XARM_CALL xarm_get_err_warn_code(XArmHandle arm, int err_warn[2]);
+XARM_C_API int XARM_CALL xarm_get_position(XArmHandle arm, float pose[6]);
+XARM_C_API int XARM_CALL xarm_get_servo_angle(XArmHandle arm, float angles[7]);
+
+/*
+* A copy of the last report
+* return: 0: success, -2: no report yet, -1: NULL handle
+*/
+XARM_C_API int XARM_CALL xarm_get_report(XArmHandle arm, RobotState *state);
+
+/*
+* The joints of the last report, NULL for the arrays not needed
+* return: 0: success, -2: no report yet, -1: NULL handle
+*/
+XARM_C_API int XARM_CALL xarm_get_joint_states(XArmHandle arm, float angles[7], float speeds[7], float torques[7], float temperatures[7]);
+
+/*
+* The tool of the last report, NULL for the values not needed
+* return: 0: success, -2: no report yet, -1: NULL handle
+*/
+XARM_C_API int XARM_CALL xarm_get_tcp_states(XArmHandle arm, float position[6], float *speed, float offset[6], float load[4]);
+
+/*
+* The last reports of several arms
+* @param poses: float[num * 6], angles: float[num * 7], arm i at [i * 6]/[i * 7]
+* @param rets: int[num], the result of each arm as xarm_get_report, NULL if not needed
+* return: the number of the arms filled
+*/
+XARM_C_API int XARM_CALL xarm_get_positions(XArmHandle *arms, int num, float *poses, int *rets);
+XARM_C_API int XARM_CALL xarm_get_servo_angles(XArmHandle *arms, int num, float *angles, int *rets);
+
+/*
+* The state extrapolated from the last reports to a time, without lock (see XArmAPI::get_predicted_state)
+* @param time_us: microseconds of the monotonic clock of the library, 0 means now
+* return: 0: success, -2: no report yet, -1: NULL handle
+*/
+XARM_C_API int XARM_CALL xarm_get_predicted_state(XArmHandle arm, long long time_us, PredictedState *state);
+
+/*
+* The last report in place, without a copy
+* The report is rewritten after 16 newer ones, so the values read are valid only if xarm_is_state_current
+*   is true after they are read, otherwise read again:
+*     do { state = xarm_get_latest_state(arm, &lock); ...read... } while (state != NULL && !xarm_is_state_current(arm, state, lock));
+* @param lock: out, for xarm_is_state_current
+* return: the report, NULL: no report yet or NULL handle
+*/
+XARM_C_API const RobotState * XARM_CALL xarm_get_latest_state(XArmHandle arm, unsigned int *lock);
+XARM_C_API int XARM_CALL xarm_is_state_current(XArmHandle arm, const RobotState *state, unsigned int lock);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
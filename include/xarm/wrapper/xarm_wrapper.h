@@ -6,8 +6,8 @@ namespace XArmWrapper {
 		char* port="", 
 		bool is_radian = DEFAULT_IS_RADIAN,
 		bool do_not_open = false,
-		bool check_tcp_limit = true,
-		bool check_joint_limit = true,
+		bool check_tcp_limit = false,
+		bool check_joint_limit = false,
 		bool check_cmdnum_limit = true,
 		bool check_robot_sn = false,
 		bool check_is_ready = true,
@@ -11,18 +11,23 @@ QueueMemcpy::QueueMemcpy(long n, long n_size) {
 	total_ = n;
 	annode_size_ = n_size;
 	buf_ = new char[total_ * annode_size_];
+	stamps_ = new long long[total_];
 	//pthread_mutex_init(&mutex_, NULL);
 	//init_lock();
 	flush();
 }
 
-QueueMemcpy::~QueueMemcpy(void) { delete[] buf_; }
+QueueMemcpy::~QueueMemcpy(void) {
+	delete[] buf_;
+	delete[] stamps_;
+}
 
 char QueueMemcpy::flush(void) {
 	cnt_ = 0;
 	head_ = 0;
 	tail_ = 0;
 	memset(buf_, 0, annode_size_ * total_);
+	memset(stamps_, 0, sizeof(long long) * total_);
 
 	return 0;
 }
@@ -38,7 +43,9 @@ int QueueMemcpy::is_full(void) {
 
 long QueueMemcpy::node_size(void) { return annode_size_; }
 
-char QueueMemcpy::pop(void *data) {
+char QueueMemcpy::pop(void *data) { return pop(data, NULL); }
+
+char QueueMemcpy::pop(void *data, long long *stamp) {
 	//pthread_mutex_lock(&mutex_);
 	//lock();
 	std::unique_lock<std::mutex> locker(mutex_);
@@ -51,6 +58,7 @@ char QueueMemcpy::pop(void *data) {
 	if (total_ <= tail_) tail_ = 0;
 
 	memcpy(data, &buf_[tail_ * annode_size_], annode_size_);
+	if (stamp != NULL) *stamp = stamps_[tail_];
 	tail_++;
 	cnt_--;
 	//pthread_mutex_unlock(&mutex_);
@@ -79,7 +87,9 @@ char QueueMemcpy::get(void *data) {
 	return 0;
 }
 
-char QueueMemcpy::push(void *data) {
+char QueueMemcpy::push(void *data) { return push(data, 0); }
+
+char QueueMemcpy::push(void *data, long long stamp) {
 	//pthread_mutex_lock(&mutex_);
 	std::unique_lock<std::mutex> locker(mutex_);
 	if (total_ <= cnt_) {
@@ -90,6 +100,7 @@ char QueueMemcpy::push(void *data) {
 	if (total_ <= head_) head_ = 0;
 
 	memcpy(&buf_[head_ * annode_size_], data, annode_size_);
+	stamps_[head_] = stamp;
 	head_++;
 	cnt_++;
 	//pthread_mutex_unlock(&mutex_);
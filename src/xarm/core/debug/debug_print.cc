@@ -6,53 +6,50 @@
  ============================================================================*/
 #define _CRT_SECURE_NO_WARNINGS
 
+#include <stdio.h>
 #include <stdarg.h>
 #include "xarm/core/debug/debug_print.h"
 #include "xarm/core/common/data_type.h"
 
 #define DB_FLG "[deprint ] "
-#define PRINTF_NUM_MAX 128
-#define log_put printf
 
+// formatted here, only the output is deferred, the new code uses xarm_log which also defers the formatting
 void print_log(const char *format, ...) {
-	char buffer[PRINTF_NUM_MAX] = { 0 };
+	if (XARM_LOG_LEVEL_INFO < get_log_level()) return;
+	LogRecord *rec = log_reserve_(XARM_LOG_LEVEL_INFO, LogRecord::TEXT, NULL);
+	if (rec == NULL) return;
 	va_list arg;
 	va_start(arg, format);
-	vsnprintf(buffer, PRINTF_NUM_MAX, format, arg);
-	printf("%s", buffer);
+	vsnprintf((char *)rec->data, LogRecord::DATA_SIZE, format, arg);
 	va_end(arg);
+	log_commit_(rec);
+}
+
+// a vector is one line
+template<typename T>
+static void print_nvect_(const char *str, T vect[], int n, const char *format) {
+	char buffer[LogRecord::DATA_SIZE] = { 0 };
+	int len = snprintf(buffer, sizeof(buffer), "%s", str);
+	for (int i = 0; i < n && len < (int)sizeof(buffer); ++i) { len += snprintf(&buffer[len], sizeof(buffer) - len, format, vect[i]); }
+	print_log("%s", buffer);
 }
 
 void print_nvect(const char *str, double vect[], int n) {
-	print_log("%s", str);
-	for (int i = 0; i < n; ++i) { print_log("%0.3f ", vect[i]); }
-	print_log("\n");
+	print_nvect_(str, vect, n, "%0.3f ");
 }
 
 void print_nvect(const char *str, float *vect, int n) {
-	print_log("%s", str);
-	for (int i = 0; i < n; ++i) { print_log("%0.3f ", vect[i]); }
-	print_log("\n");
+	print_nvect_(str, vect, n, "%0.3f ");
 }
 
 void print_nvect(const char *str, unsigned char vect[], int n) {
-	print_log("%s", str);
-	for (int i = 0; i < n; ++i) { print_log("%d ", vect[i]); }
-	print_log("\n");
+	print_nvect_(str, vect, n, "%d ");
 }
 
 void print_nvect(const char *str, int vect[], int n) {
-	print_log("%s", str);
-	for (int i = 0; i < n; ++i) { print_log("%d ", vect[i]); }
-	print_log("\n");
+	print_nvect_(str, vect, n, "%d ");
 }
 
 void print_hex(const char *str, unsigned char *hex, int len) {
-	// char buf[len * 3 + 1] = {'\0'};
-	char *buf = new char[len * 3 + 1];
-	long i;
-	for (i = 0; i < len; ++i) { sprintf((char *)&buf[i * 3], "%02x ", hex[i]); }
-
-	printf("%s %s\n", str, buf);
-	delete buf;
+	xarm_log_hex(XARM_LOG_LEVEL_INFO, str, hex, len);
 }
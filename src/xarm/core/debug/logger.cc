@@ -0,0 +1,308 @@
+/* Copyright 2017 UFACTORY Inc. All Rights Reserved.
+ *
+ * Software License Agreement (BSD License)
+ *
+ * Author: Jimy Zhang <jimy92@163.com>
+ ============================================================================*/
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include "xarm/core/debug/logger.h"
+
+#define LOG_RING_NUM 1024 // a power of 2
+#define LOG_LINE_MAX 2048
+
+static std::atomic<int> log_level_(XARM_LOG_LEVEL_INFO);
+
+static void default_sink_(int, long long, const char *line) {
+	printf("%s\n", line);
+}
+
+// a bounded ring of many producers and one consumer, each cell tells by its sequence if it is free, written or read
+struct LogCore {
+	struct Cell {
+		std::atomic<unsigned long long> seq;
+		LogRecord rec;
+	};
+	std::atomic<unsigned long long> enqueue_pos;
+	std::atomic<unsigned long long> dequeue_pos;
+	std::atomic<long long> drop_num;
+	std::atomic<void(*)(int, long long, const char *)> sink;
+	Cell cells[LOG_RING_NUM];
+};
+
+static void log_loop_(LogCore *core);
+static void log_exit_flush_(void) { log_flush(); }
+
+static LogCore *log_create_(void) {
+	LogCore *core = new LogCore;
+	core->enqueue_pos = 0;
+	core->dequeue_pos = 0;
+	core->drop_num = 0;
+	core->sink = default_sink_;
+	for (unsigned long long i = 0; i < LOG_RING_NUM; i++) core->cells[i].seq.store(i, std::memory_order_relaxed);
+	std::thread(log_loop_, core).detach();
+	atexit(log_exit_flush_);
+	return core;
+}
+
+// created on the first record and never freed, the threads of the arms may still log while the process exits
+static LogCore *log_core_(void) {
+	static LogCore *core = log_create_();
+	return core;
+}
+
+void set_log_level(int level) {
+	log_level_ = level;
+}
+
+int get_log_level(void) {
+	return log_level_.load(std::memory_order_relaxed);
+}
+
+void set_log_sink(void(*sink)(int level, long long time, const char *line)) {
+	log_core_()->sink = sink == NULL ? default_sink_ : sink;
+}
+
+long long get_log_drop_num(void) {
+	return log_core_()->drop_num;
+}
+
+void log_flush(int timeout) {
+	LogCore *core = log_core_();
+	unsigned long long pos = core->enqueue_pos.load(std::memory_order_acquire);
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+	while (core->dequeue_pos.load(std::memory_order_acquire) < pos && std::chrono::steady_clock::now() < end) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
+LogRecord *log_reserve_(int level, int kind, const char *format) {
+	LogCore *core = log_core_();
+	LogCore::Cell *cell;
+	unsigned long long pos = core->enqueue_pos.load(std::memory_order_relaxed);
+	while (true) {
+		cell = &core->cells[pos & (LOG_RING_NUM - 1)];
+		unsigned long long seq = cell->seq.load(std::memory_order_acquire);
+		long long dif = (long long)(seq - pos);
+		if (dif == 0) {
+			if (core->enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+		}
+		else if (dif < 0) {
+			// full, the caller does not wait for the log thread
+			core->drop_num += 1;
+			return NULL;
+		}
+		else {
+			pos = core->enqueue_pos.load(std::memory_order_relaxed);
+		}
+	}
+	LogRecord *rec = &cell->rec;
+	rec->level = level;
+	rec->kind = kind;
+	rec->time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	rec->format = format;
+	rec->ticket = pos;
+	rec->size = 0;
+	rec->truncated = 0;
+	return rec;
+}
+
+void log_commit_(LogRecord *rec) {
+	LogCore *core = log_core_();
+	core->cells[rec->ticket & (LOG_RING_NUM - 1)].seq.store(rec->ticket + 1, std::memory_order_release);
+}
+
+// [tag][value], tag: 'i' long long, 'u' unsigned long long, 'f' double, 'p' pointer, 's' a string with its end
+static unsigned char *log_put_(LogRecord *rec, char tag, int len) {
+	if (rec->truncated || rec->size + 1 + len > LogRecord::DATA_SIZE) {
+		rec->truncated = 1;
+		return NULL;
+	}
+	unsigned char *p = &rec->data[rec->size];
+	p[0] = (unsigned char)tag;
+	rec->size += 1 + len;
+	return p + 1;
+}
+
+void log_put_int_(LogRecord *rec, long long value, bool is_signed) {
+	unsigned char *p = log_put_(rec, is_signed ? 'i' : 'u', sizeof(value));
+	if (p != NULL) memcpy(p, &value, sizeof(value));
+}
+
+void log_put_double_(LogRecord *rec, double value) {
+	unsigned char *p = log_put_(rec, 'f', sizeof(value));
+	if (p != NULL) memcpy(p, &value, sizeof(value));
+}
+
+void log_put_str_(LogRecord *rec, const char *str) {
+	if (str == NULL) str = "(null)";
+	int len = (int)strlen(str);
+	int room = LogRecord::DATA_SIZE - rec->size - 2;
+	// a long string is cut, the arguments after it are lost
+	if (len > room && room > 0) len = room;
+	unsigned char *p = log_put_(rec, 's', len + 1);
+	if (p == NULL) return;
+	memcpy(p, str, len);
+	p[len] = '\0';
+}
+
+void log_put_ptr_(LogRecord *rec, const void *ptr) {
+	unsigned char *p = log_put_(rec, 'p', sizeof(ptr));
+	if (p != NULL) memcpy(p, &ptr, sizeof(ptr));
+}
+
+void xarm_log_hex(int level, const char *str, const unsigned char *data, int len) {
+	if (level < get_log_level()) return;
+	LogRecord *rec = log_reserve_(level, LogRecord::HEX, str);
+	if (rec == NULL) return;
+	if (len > LogRecord::DATA_SIZE) {
+		len = LogRecord::DATA_SIZE;
+		rec->truncated = 1;
+	}
+	if (len > 0) memcpy(rec->data, data, len);
+	rec->size = len > 0 ? len : 0;
+	log_commit_(rec);
+}
+
+struct LogArg {
+	char tag; // 0: missing
+	long long i;
+	double f;
+	const char *s;
+	const void *p;
+};
+
+static void log_next_arg_(const LogRecord &rec, int *offset, LogArg *arg) {
+	arg->tag = 0;
+	if (*offset >= rec.size) return;
+	const unsigned char *p = &rec.data[*offset];
+	arg->tag = (char)p[0];
+	switch (arg->tag) {
+	case 'i': case 'u':
+		memcpy(&arg->i, p + 1, sizeof(arg->i));
+		*offset += 1 + sizeof(arg->i);
+		break;
+	case 'f':
+		memcpy(&arg->f, p + 1, sizeof(arg->f));
+		*offset += 1 + sizeof(arg->f);
+		break;
+	case 'p':
+		memcpy(&arg->p, p + 1, sizeof(arg->p));
+		*offset += 1 + sizeof(arg->p);
+		break;
+	default:
+		arg->tag = 's';
+		arg->s = (const char *)(p + 1);
+		*offset += 1 + (int)strlen(arg->s) + 1;
+		break;
+	}
+}
+
+// one conversion of the format with its argument, the length modifiers of the caller are replaced by the stored types
+static int log_format_arg_(char *out, int size, const char *flags, int flags_len, char conv, const LogArg &arg) {
+	char spec[32];
+	if (flags_len > (int)sizeof(spec) - 4) flags_len = sizeof(spec) - 4;
+	spec[0] = '%';
+	memcpy(&spec[1], flags, flags_len);
+	int n = 1 + flags_len;
+	if (arg.tag == 0) return snprintf(out, size, "?");
+	bool is_num = arg.tag == 'i' || arg.tag == 'u';
+	switch (conv) {
+	case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+		if (arg.tag == 's') return snprintf(out, size, "%s", arg.s);
+		spec[n++] = 'l'; spec[n++] = 'l'; spec[n++] = conv; spec[n] = '\0';
+		if (conv == 'd' || conv == 'i') return snprintf(out, size, spec, arg.tag == 'f' ? (long long)arg.f : arg.tag == 'p' ? (long long)(size_t)arg.p : arg.i);
+		return snprintf(out, size, spec, arg.tag == 'f' ? (unsigned long long)arg.f : arg.tag == 'p' ? (unsigned long long)(size_t)arg.p : (unsigned long long)arg.i);
+	case 'c':
+		spec[n++] = 'c'; spec[n] = '\0';
+		return snprintf(out, size, spec, is_num ? (int)arg.i : '?');
+	case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+		if (arg.tag == 's') return snprintf(out, size, "%s", arg.s);
+		spec[n++] = conv; spec[n] = '\0';
+		return snprintf(out, size, spec, arg.tag == 'f' ? arg.f : arg.tag == 'u' ? (double)(unsigned long long)arg.i : (double)arg.i);
+	case 's':
+		if (arg.tag == 'f') return snprintf(out, size, "%g", arg.f);
+		if (arg.tag == 'p') return snprintf(out, size, "%p", arg.p);
+		if (is_num) return snprintf(out, size, arg.tag == 'u' ? "%llu" : "%lld", arg.i);
+		spec[n++] = 's'; spec[n] = '\0';
+		return snprintf(out, size, spec, arg.s);
+	default: // p
+		if (arg.tag == 's') return snprintf(out, size, "%s", arg.s);
+		return snprintf(out, size, "%p", arg.tag == 'p' ? arg.p : (const void *)(size_t)arg.i);
+	}
+}
+
+static void log_format_(const LogRecord &rec, char *line, int size) {
+	int n = 0;
+	line[0] = '\0';
+	if (rec.kind == LogRecord::TEXT) {
+		n = snprintf(line, size, "%s", (const char *)rec.data);
+	}
+	else if (rec.kind == LogRecord::HEX) {
+		n = snprintf(line, size, "%s", rec.format);
+		for (int i = 0; i < rec.size && n < size - 4; i++) n += snprintf(&line[n], size - n, " %02x", rec.data[i]);
+		if (rec.truncated && n < size - 5) n += snprintf(&line[n], size - n, " ...");
+	}
+	else {
+		const char *f = rec.format;
+		int offset = 0;
+		LogArg arg;
+		while (*f != '\0' && n < size - 1) {
+			if (*f != '%') {
+				line[n++] = *f++;
+				continue;
+			}
+			if (f[1] == '%') {
+				line[n++] = '%';
+				f += 2;
+				continue;
+			}
+			// %[flags][width][.precision][length]conversion
+			const char *flags = f + 1;
+			const char *p = flags;
+			while (*p != '\0' && strchr("-+ #0123456789.", *p) != NULL) p++;
+			int flags_len = (int)(p - flags);
+			while (*p != '\0' && strchr("hlLqjzt", *p) != NULL) p++;
+			if (*p == '\0' || strchr("diuoxXcfFeEgGaAsp", *p) == NULL) {
+				// not supported (like *), written as is
+				line[n++] = *f++;
+				continue;
+			}
+			log_next_arg_(rec, &offset, &arg);
+			int len = log_format_arg_(&line[n], size - n, flags, flags_len, *p, arg);
+			if (len > 0) n += len;
+			if (n > size - 1) n = size - 1;
+			f = p + 1;
+		}
+		line[n] = '\0';
+	}
+	if (n > size - 1) n = size - 1;
+	// the lines of the sink have no end of line, the ones of the printf era had one
+	while (n > 0 && (line[n - 1] == '\n' || line[n - 1] == '\r')) line[--n] = '\0';
+}
+
+static void log_loop_(LogCore *core) {
+	char line[LOG_LINE_MAX];
+	while (true) {
+		unsigned long long pos = core->dequeue_pos.load(std::memory_order_relaxed);
+		LogCore::Cell &cell = core->cells[pos & (LOG_RING_NUM - 1)];
+		if (cell.seq.load(std::memory_order_acquire) != pos + 1) {
+			// nothing to write, the producers never wake the thread up, it is polled
+			std::this_thread::sleep_for(std::chrono::milliseconds(2));
+			continue;
+		}
+		log_format_(cell.rec, line, sizeof(line));
+		int level = cell.rec.level;
+		long long time = cell.rec.time;
+		cell.seq.store(pos + LOG_RING_NUM, std::memory_order_release);
+		void(*sink)(int, long long, const char *) = core->sink;
+		sink(level, time, line);
+		core->dequeue_pos.store(pos + 1, std::memory_order_release);
+	}
+}
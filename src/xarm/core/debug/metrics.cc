@@ -0,0 +1,292 @@
+/* Copyright 2017 UFACTORY Inc. All Rights Reserved.
+ *
+ * Software License Agreement (BSD License)
+ *
+ * Author: Jimy Zhang <jimy92@163.com>
+ ============================================================================*/
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include "xarm/core/debug/metrics.h"
+#include "xarm/core/instruction/uxbus_cmd_config.h"
+
+/*******************************************************
+ * LatencyHistogram
+ *******************************************************/
+
+LatencyHistogram::LatencyHistogram(void) { reset(); }
+
+int LatencyHistogram::bucket_of(long long us) {
+	if (us < 16) return us < 0 ? 0 : (int)us;
+	int shift = 1;
+	while ((us >> shift) >= 16) shift++;
+	int index = 16 + (shift - 1) * 8 + (int)((us >> shift) - 8);
+	return index < BUCKET_NUM ? index : BUCKET_NUM - 1;
+}
+
+long long LatencyHistogram::bucket_upper(int index) {
+	if (index < 16) return index;
+	int shift = (index - 16) / 8 + 1;
+	long long sub = (index - 16) % 8 + 8;
+	return ((sub + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(long long us) {
+	counts_[bucket_of(us)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void LatencyHistogram::reset(void) {
+	for (int i = 0; i < BUCKET_NUM; i++) counts_[i].store(0, std::memory_order_relaxed);
+}
+
+void LatencyHistogram::copy(unsigned long long *counts) {
+	for (int i = 0; i < BUCKET_NUM; i++) counts[i] = counts_[i].load(std::memory_order_relaxed);
+}
+
+long long CommandStats::percentile(double q) const {
+	unsigned long long total = 0;
+	for (int i = 0; i < LatencyHistogram::BUCKET_NUM; i++) total += buckets[i];
+	if (total == 0) return 0;
+	unsigned long long rank = (unsigned long long)(q * total + 0.5);
+	if (rank < 1) rank = 1;
+	if (rank > total) rank = total;
+	unsigned long long seen = 0;
+	for (int i = 0; i < LatencyHistogram::BUCKET_NUM; i++) {
+		seen += buckets[i];
+		if (seen >= rank) {
+			long long upper = LatencyHistogram::bucket_upper(i);
+			// the top bucket is wider than the values seen
+			return upper < max_us ? upper : max_us;
+		}
+	}
+	return max_us;
+}
+
+/*******************************************************
+ * CommandMetrics
+ *******************************************************/
+
+struct CommandMetrics::Slot_ {
+	std::atomic<long long> sent;
+	std::atomic<long long> replies;
+	std::atomic<long long> timeouts;
+	std::atomic<long long> err_num;
+	std::atomic<long long> err_leng;
+	std::atomic<long long> err_fun;
+	std::atomic<long long> err_prot;
+	std::atomic<long long> bytes_out;
+	std::atomic<long long> bytes_in;
+	std::atomic<long long> min_us;
+	std::atomic<long long> max_us;
+	std::atomic<long long> sum_us;
+	LatencyHistogram latency;
+
+	Slot_(void) { reset(); }
+	void reset(void) {
+		sent = 0; replies = 0; timeouts = 0;
+		err_num = 0; err_leng = 0; err_fun = 0; err_prot = 0;
+		bytes_out = 0; bytes_in = 0;
+		min_us = -1; max_us = 0; sum_us = 0;
+		latency.reset();
+	}
+};
+
+CommandMetrics::CommandMetrics(void) {
+	for (int i = 0; i < FUNCODE_NUM; i++) slots_[i] = NULL;
+}
+
+CommandMetrics::~CommandMetrics(void) {
+	for (int i = 0; i < FUNCODE_NUM; i++) delete slots_[i].load();
+}
+
+long long CommandMetrics::now_us(void) {
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+CommandMetrics::Slot_ *CommandMetrics::slot_(int funcode) {
+	std::atomic<Slot_ *> &ptr = slots_[funcode & (FUNCODE_NUM - 1)];
+	Slot_ *slot = ptr.load(std::memory_order_acquire);
+	if (slot != NULL) return slot;
+	// the first record of the funcode, the loser of a race frees its slot
+	Slot_ *created = new Slot_;
+	if (ptr.compare_exchange_strong(slot, created, std::memory_order_acq_rel)) return created;
+	delete created;
+	return slot;
+}
+
+void CommandMetrics::record_send(int funcode, int bytes) {
+	Slot_ *slot = slot_(funcode);
+	slot->sent.fetch_add(1, std::memory_order_relaxed);
+	slot->bytes_out.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void CommandMetrics::record_reply(int funcode, long long latency_us, int bytes, int state) {
+	Slot_ *slot = slot_(funcode);
+	if (latency_us < 0) latency_us = 0;
+	slot->replies.fetch_add(1, std::memory_order_relaxed);
+	slot->bytes_in.fetch_add(bytes, std::memory_order_relaxed);
+	slot->sum_us.fetch_add(latency_us, std::memory_order_relaxed);
+	slot->latency.record(latency_us);
+	long long min_us = slot->min_us.load(std::memory_order_relaxed);
+	while ((min_us < 0 || latency_us < min_us) && !slot->min_us.compare_exchange_weak(min_us, latency_us, std::memory_order_relaxed)) {}
+	long long max_us = slot->max_us.load(std::memory_order_relaxed);
+	while (latency_us > max_us && !slot->max_us.compare_exchange_weak(max_us, latency_us, std::memory_order_relaxed)) {}
+
+	if (state == UXBUS_STATE::ERR_LENG) slot->err_leng.fetch_add(1, std::memory_order_relaxed);
+	else if (state == UXBUS_STATE::ERR_FUN) slot->err_fun.fetch_add(1, std::memory_order_relaxed);
+	else if (state == UXBUS_STATE::ERR_PROT) slot->err_prot.fetch_add(1, std::memory_order_relaxed);
+}
+
+void CommandMetrics::record_timeout(int funcode) {
+	slot_(funcode)->timeouts.fetch_add(1, std::memory_order_relaxed);
+}
+
+void CommandMetrics::record_drop(int funcode) {
+	slot_(funcode)->err_num.fetch_add(1, std::memory_order_relaxed);
+}
+
+static void add_slot_(CommandStats *stats, long long sent, long long replies, long long timeouts,
+	long long err_num, long long err_leng, long long err_fun, long long err_prot,
+	long long bytes_out, long long bytes_in, long long min_us, long long max_us, long long sum_us) {
+	stats->sent += sent;
+	stats->replies += replies;
+	stats->timeouts += timeouts;
+	stats->err_num += err_num;
+	stats->err_leng += err_leng;
+	stats->err_fun += err_fun;
+	stats->err_prot += err_prot;
+	stats->bytes_out += bytes_out;
+	stats->bytes_in += bytes_in;
+	stats->sum_us += sum_us;
+	if (min_us >= 0 && (stats->min_us == 0 || min_us < stats->min_us)) stats->min_us = min_us;
+	if (max_us > stats->max_us) stats->max_us = max_us;
+}
+
+int CommandMetrics::get_stats(int funcode, CommandStats *stats) {
+	memset(stats, 0, sizeof(CommandStats));
+	stats->funcode = funcode;
+	int found = 0;
+	unsigned long long counts[LatencyHistogram::BUCKET_NUM];
+	for (int i = 0; i < FUNCODE_NUM; i++) {
+		if (funcode >= 0 && i != funcode) continue;
+		Slot_ *slot = slots_[i].load(std::memory_order_acquire);
+		if (slot == NULL) continue;
+		found += 1;
+		add_slot_(stats, slot->sent, slot->replies, slot->timeouts,
+			slot->err_num, slot->err_leng, slot->err_fun, slot->err_prot,
+			slot->bytes_out, slot->bytes_in, slot->min_us, slot->max_us, slot->sum_us);
+		slot->latency.copy(counts);
+		for (int j = 0; j < LatencyHistogram::BUCKET_NUM; j++) stats->buckets[j] += counts[j];
+	}
+	return found > 0 ? 0 : -1;
+}
+
+void CommandMetrics::reset(void) {
+	for (int i = 0; i < FUNCODE_NUM; i++) {
+		Slot_ *slot = slots_[i].load(std::memory_order_acquire);
+		if (slot != NULL) slot->reset();
+	}
+}
+
+static void dump_line_(std::string &out, const char *name, const char *conn, int funcode, const char *extra, long long value) {
+	char line[256];
+	snprintf(line, sizeof(line), "xarm_cmd_%s{conn=\"%s\",funcode=\"%d\"%s} %lld\n", name, conn, funcode, extra, value);
+	out += line;
+}
+
+std::string CommandMetrics::dump(const char *conn) {
+	std::string out;
+	CommandStats stats;
+	for (int i = 0; i < FUNCODE_NUM; i++) {
+		if (get_stats(i, &stats) != 0) continue;
+		dump_line_(out, "sent_total", conn, i, "", stats.sent);
+		dump_line_(out, "replies_total", conn, i, "", stats.replies);
+		dump_line_(out, "timeouts_total", conn, i, "", stats.timeouts);
+		dump_line_(out, "errors_total", conn, i, ",error=\"num\"", stats.err_num);
+		dump_line_(out, "errors_total", conn, i, ",error=\"leng\"", stats.err_leng);
+		dump_line_(out, "errors_total", conn, i, ",error=\"fun\"", stats.err_fun);
+		dump_line_(out, "errors_total", conn, i, ",error=\"prot\"", stats.err_prot);
+		dump_line_(out, "bytes_out_total", conn, i, "", stats.bytes_out);
+		dump_line_(out, "bytes_in_total", conn, i, "", stats.bytes_in);
+		if (stats.replies == 0) continue;
+		dump_line_(out, "latency_us", conn, i, ",quantile=\"0.5\"", stats.percentile(0.5));
+		dump_line_(out, "latency_us", conn, i, ",quantile=\"0.9\"", stats.percentile(0.9));
+		dump_line_(out, "latency_us", conn, i, ",quantile=\"0.99\"", stats.percentile(0.99));
+		dump_line_(out, "latency_us", conn, i, ",quantile=\"0.999\"", stats.percentile(0.999));
+		dump_line_(out, "latency_us_min", conn, i, "", stats.min_us);
+		dump_line_(out, "latency_us_max", conn, i, "", stats.max_us);
+		dump_line_(out, "latency_us_mean", conn, i, "", stats.mean_us());
+	}
+	return out;
+}
+
+/*******************************************************
+ * Registry
+ *******************************************************/
+
+struct MetricsEntry_ {
+	std::string name;
+	CommandMetrics *metrics;
+};
+
+// never freed, a transport may unregister itself in a static destructor
+static std::mutex &registry_mutex_(void) {
+	static std::mutex *mutex = new std::mutex;
+	return *mutex;
+}
+
+static std::vector<MetricsEntry_> &registry_(void) {
+	static std::vector<MetricsEntry_> *entries = new std::vector<MetricsEntry_>;
+	return *entries;
+}
+
+void metrics_register(const char *name, CommandMetrics *metrics) {
+	std::lock_guard<std::mutex> locker(registry_mutex_());
+	std::vector<MetricsEntry_> &entries = registry_();
+	for (size_t i = 0; i < entries.size(); i++) {
+		if (entries[i].metrics == metrics) {
+			entries[i].name = name;
+			return;
+		}
+	}
+	MetricsEntry_ entry;
+	entry.name = name;
+	entry.metrics = metrics;
+	entries.push_back(entry);
+}
+
+void metrics_unregister(CommandMetrics *metrics) {
+	std::lock_guard<std::mutex> locker(registry_mutex_());
+	std::vector<MetricsEntry_> &entries = registry_();
+	for (size_t i = 0; i < entries.size(); i++) {
+		if (entries[i].metrics == metrics) {
+			entries.erase(entries.begin() + i);
+			return;
+		}
+	}
+}
+
+int metrics_get_stats(const char *name, int funcode, CommandStats *stats) {
+	std::lock_guard<std::mutex> locker(registry_mutex_());
+	std::vector<MetricsEntry_> &entries = registry_();
+	for (size_t i = 0; i < entries.size(); i++) {
+		if (entries[i].name == name) return entries[i].metrics->get_stats(funcode, stats);
+	}
+	return -1;
+}
+
+void metrics_reset(void) {
+	std::lock_guard<std::mutex> locker(registry_mutex_());
+	std::vector<MetricsEntry_> &entries = registry_();
+	for (size_t i = 0; i < entries.size(); i++) entries[i].metrics->reset();
+}
+
+std::string metrics_dump(void) {
+	std::lock_guard<std::mutex> locker(registry_mutex_());
+	std::vector<MetricsEntry_> &entries = registry_();
+	std::string out;
+	for (size_t i = 0; i < entries.size(); i++) out += entries[i].metrics->dump(entries[i].name.c_str());
+	return out;
+}
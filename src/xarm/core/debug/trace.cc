@@ -0,0 +1,204 @@
+/* Copyright 2017 UFACTORY Inc. All Rights Reserved.
+ *
+ * Software License Agreement (BSD License)
+ *
+ * Author: Jimy Zhang <jimy92@163.com>
+ ============================================================================*/
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdio.h>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "xarm/core/debug/trace.h"
+
+std::atomic<bool> trace_on_(false);
+
+struct TraceEvent {
+	const char *name;
+	long long start_us;
+	long long dur_us;
+	int tid;
+	int arg;
+};
+
+// written by one thread at a time, count is only reset while no thread owns the buffer
+struct TraceBuffer {
+	TraceEvent *events;
+	int capacity;
+	std::atomic<int> count;
+	std::atomic<unsigned int> generation; // the trace the events belong to
+	std::atomic<bool> in_use;
+};
+
+struct TraceCore {
+	std::mutex mutex;
+	std::vector<TraceBuffer *> buffers;
+	std::vector<std::pair<int, std::string> > thread_names;
+	std::atomic<unsigned int> generation;
+	std::atomic<int> capacity;
+	std::atomic<long long> drop_num;
+	std::atomic<int> next_tid;
+	long long origin_us;
+};
+
+// never freed, the threads of the arms may still trace while the process exits
+static TraceCore *trace_core_(void) {
+	static TraceCore *core = NULL;
+	static std::once_flag once;
+	std::call_once(once, [] {
+		core = new TraceCore;
+		core->generation = 0;
+		core->capacity = 0;
+		core->drop_num = 0;
+		core->next_tid = 1;
+		core->origin_us = 0;
+	});
+	return core;
+}
+
+// the buffer of the thread goes back to the pool when the thread ends
+struct TraceThread {
+	TraceBuffer *buffer;
+	int tid;
+	TraceThread(void) : buffer(NULL), tid(0) {}
+	~TraceThread(void) { if (buffer != NULL) buffer->in_use.store(false, std::memory_order_release); }
+};
+
+static thread_local TraceThread trace_thread_;
+
+long long trace_now_us_(void) {
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// a free buffer of the current trace, or a new one
+static TraceBuffer *trace_acquire_(TraceCore *core, unsigned int generation) {
+	std::lock_guard<std::mutex> locker(core->mutex);
+	int capacity = core->capacity;
+	for (size_t i = 0; i < core->buffers.size(); i++) {
+		TraceBuffer *buf = core->buffers[i];
+		if (buf->capacity != capacity || buf->in_use.load(std::memory_order_acquire)) continue;
+		buf->in_use = true;
+		if (buf->generation != generation) {
+			buf->count = 0;
+			buf->generation = generation;
+		}
+		return buf;
+	}
+	TraceBuffer *buf = new TraceBuffer;
+	buf->events = new TraceEvent[capacity];
+	buf->capacity = capacity;
+	buf->count = 0;
+	buf->generation = generation;
+	buf->in_use = true;
+	core->buffers.push_back(buf);
+	return buf;
+}
+
+void trace_record_(const char *name, long long start_us, int arg) {
+	long long end_us = trace_now_us_();
+	if (!trace_on_.load(std::memory_order_relaxed)) return;
+	TraceCore *core = trace_core_();
+	TraceThread &thread = trace_thread_;
+	unsigned int generation = core->generation.load(std::memory_order_acquire);
+	TraceBuffer *buf = thread.buffer;
+	if (buf == NULL || buf->generation.load(std::memory_order_relaxed) != generation) {
+		// the first span of the thread in this trace
+		if (buf != NULL) buf->in_use.store(false, std::memory_order_release);
+		buf = trace_acquire_(core, generation);
+		thread.buffer = buf;
+	}
+	if (thread.tid == 0) thread.tid = core->next_tid.fetch_add(1);
+	int count = buf->count.load(std::memory_order_relaxed);
+	if (count >= buf->capacity) {
+		core->drop_num.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	TraceEvent &event = buf->events[count];
+	event.name = name;
+	event.start_us = start_us;
+	event.dur_us = end_us - start_us;
+	event.tid = thread.tid;
+	event.arg = arg;
+	buf->count.store(count + 1, std::memory_order_release);
+}
+
+void trace_start(int events_per_thread) {
+	TraceCore *core = trace_core_();
+	{
+		std::lock_guard<std::mutex> locker(core->mutex);
+		core->capacity = events_per_thread > 0 ? events_per_thread : 65536;
+		core->origin_us = trace_now_us_();
+		core->drop_num = 0;
+		// the buffers of the previous trace are emptied by their next owner
+		core->generation.fetch_add(1, std::memory_order_acq_rel);
+	}
+	trace_on_ = true;
+}
+
+void trace_stop(void) {
+	trace_on_ = false;
+}
+
+void trace_set_thread_name(const char *name) {
+	TraceCore *core = trace_core_();
+	TraceThread &thread = trace_thread_;
+	if (thread.tid == 0) thread.tid = core->next_tid.fetch_add(1);
+	std::lock_guard<std::mutex> locker(core->mutex);
+	for (size_t i = 0; i < core->thread_names.size(); i++) {
+		if (core->thread_names[i].first == thread.tid) {
+			core->thread_names[i].second = name;
+			return;
+		}
+	}
+	core->thread_names.push_back(std::make_pair(thread.tid, std::string(name)));
+}
+
+long long get_trace_drop_num(void) {
+	return trace_core_()->drop_num.load(std::memory_order_relaxed);
+}
+
+static void write_json_str_(FILE *fp, const char *str) {
+	fputc('"', fp);
+	for (; *str != 0; str++) {
+		if (*str == '"' || *str == '\\') fputc('\\', fp);
+		if ((unsigned char)*str >= 0x20) fputc(*str, fp);
+	}
+	fputc('"', fp);
+}
+
+int trace_save(const char *path) {
+	FILE *fp = fopen(path, "w");
+	if (fp == NULL) return -1;
+	TraceCore *core = trace_core_();
+	// the lock keeps the trace from restarting, the spans recorded meanwhile are appended after the count read
+	std::lock_guard<std::mutex> locker(core->mutex);
+	unsigned int generation = core->generation;
+	bool first = true;
+	fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	for (size_t i = 0; i < core->thread_names.size(); i++) {
+		fprintf(fp, "%s{\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"name\":\"thread_name\",\"args\":{\"name\":", first ? "" : ",\n", core->thread_names[i].first);
+		write_json_str_(fp, core->thread_names[i].second.c_str());
+		fprintf(fp, "}}");
+		first = false;
+	}
+	for (size_t i = 0; i < core->buffers.size(); i++) {
+		TraceBuffer *buf = core->buffers[i];
+		if (buf->generation.load(std::memory_order_acquire) != generation) continue;
+		int count = buf->count.load(std::memory_order_acquire);
+		for (int j = 0; j < count; j++) {
+			const TraceEvent &event = buf->events[j];
+			fprintf(fp, "%s{\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%lld,\"dur\":%lld,\"name\":", first ? "" : ",\n",
+				event.tid, event.start_us - core->origin_us, event.dur_us);
+			write_json_str_(fp, event.name);
+			if (event.arg >= 0) fprintf(fp, ",\"args\":{\"arg\":%d}", event.arg);
+			fprintf(fp, "}");
+			first = false;
+		}
+	}
+	fprintf(fp, "\n]}\n");
+	int ret = ferror(fp) ? -1 : 0;
+	fclose(fp);
+	return ret;
+}
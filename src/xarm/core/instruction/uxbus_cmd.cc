@@ -11,15 +11,19 @@
 
 UxbusCmd::UxbusCmd(void) {}
 
-UxbusCmd::~UxbusCmd(void) {}
+UxbusCmd::~UxbusCmd(void) { metrics_unregister(&metrics_); }
 
 int UxbusCmd::check_xbus_prot(unsigned char *data, int funcode) { return -11; }
 
-int UxbusCmd::send_pend(int funcode, int num, int timeout, unsigned char *rx_data) {
+int UxbusCmd::send_pend(int funcode, int num, int timeout, unsigned char *rx_data, int trans_id) {
 	return -11;
 }
 
 int UxbusCmd::send_xbus(int funcode, unsigned char *txdata, int num) { return -11; }
+int UxbusCmd::send_urgent(int funcode, unsigned char *txdata, int num, bool need_reply) { return send_xbus(funcode, txdata, num); }
+int UxbusCmd::encode_frame(int funcode, unsigned char *datas, int num, unsigned char *frame) { return -1; }
+int UxbusCmd::send_frame(unsigned char *frame, int len) { return -1; }
+int UxbusCmd::recv_frame(int trans_id, unsigned char *frame, int *len, int timeout) { return UXBUS_STATE::ERR_NOTTCP; }
 
 void UxbusCmd::close(void) {}
 
@@ -29,298 +33,291 @@ void UxbusCmd::close(void) {}
  *******************************************************/
 
 int UxbusCmd::set_nu8(int funcode, int *datas, int num) {
-	//unsigned char send_data[num];
-	unsigned char *send_data = new unsigned char[num];
+	unsigned char send_data[UXBUS_CONF::MAX_DATA_LEN];
+	if (num > UXBUS_CONF::MAX_DATA_LEN) { return UXBUS_STATE::ERR_PARAM; }
 	for (int i = 0; i < num; i++)
 	{
 		send_data[i] = (unsigned char)datas[i];
 	}
 
-	int ret = send_xbus(funcode, send_data, num);
-	delete send_data;
-	if (ret != 0) { return UXBUS_STATE::ERR_NOTTCP; }
-	ret = send_pend(funcode, 0, UXBUS_CONF::SET_TIMEOUT, NULL);
+	int trans_id = send_xbus(funcode, send_data, num);
+	if (trans_id < 0) { return UXBUS_STATE::ERR_NOTTCP; }
+	int ret = send_pend(funcode, 0, UXBUS_CONF::SET_TIMEOUT, NULL, trans_id);
 
 	return ret;
 }
 
 int UxbusCmd::get_nu8(int funcode, int *rx_data, int num) {
-	// unsigned char secv_data[num];
-	unsigned char *send_data = new unsigned char[num];
-	int ret = get_nu8(funcode, send_data, num);
+	unsigned char datas[UXBUS_CONF::MAX_DATA_LEN];
+	if (num > UXBUS_CONF::MAX_DATA_LEN) { return UXBUS_STATE::ERR_PARAM; }
+	int ret = get_nu8(funcode, datas, num);
 
 	for (int i = 0; i < num; i++) {
-		rx_data[i] = send_data[i];
+		rx_data[i] = datas[i];
 	}
-	delete send_data;
 	return ret;
 }
 
 int UxbusCmd::get_nu8(int funcode, unsigned char *rx_data, int num) {
-	int ret = send_xbus(funcode, 0, 0);
-	if (ret != 0) { return UXBUS_STATE::ERR_NOTTCP; }
-	return send_pend(funcode, num, UXBUS_CONF::GET_TIMEOUT, rx_data);
+	int trans_id = send_xbus(funcode, 0, 0);
+	if (trans_id < 0) { return UXBUS_STATE::ERR_NOTTCP; }
+	return send_pend(funcode, num, UXBUS_CONF::GET_TIMEOUT, rx_data, trans_id);
 }
 
 int UxbusCmd::set_nu16(int funcode, int *datas, int num) {
-
-	//unsigned char send_data[num * 2];
-	unsigned char *send_data = new unsigned char[num * 2];
+	unsigned char send_data[UXBUS_CONF::MAX_DATA_LEN];
+	if (num * 2 > UXBUS_CONF::MAX_DATA_LEN) { return UXBUS_STATE::ERR_PARAM; }
 	for (int i = 0; i < num; i++) {
 		bin16_to_8(datas[i], &send_data[i * 2]);
 	}
-	int ret = send_xbus(funcode, send_data, num * 2);
-	delete send_data;
-	if (ret != 0) { return UXBUS_STATE::ERR_NOTTCP; }
-	ret = send_pend(funcode, 0, UXBUS_CONF::SET_TIMEOUT, NULL);
+	int trans_id = send_xbus(funcode, send_data, num * 2);
+	if (trans_id < 0) { return UXBUS_STATE::ERR_NOTTCP; }
+	int ret = send_pend(funcode, 0, UXBUS_CONF::SET_TIMEOUT, NULL, trans_id);
 
 	return ret;
 }
 int UxbusCmd::get_nu16(int funcode, int *rx_data, int num) {
-	//unsigned char datas[num * 2];
-	unsigned char *datas = new unsigned char[num * 2];
-	int ret = send_xbus(funcode, 0, 0);
-	if (ret != 0) {
-		delete datas;
-		return UXBUS_STATE::ERR_NOTTCP;
-	}
+	unsigned char datas[UXBUS_CONF::MAX_DATA_LEN];
+	if (num * 2 > UXBUS_CONF::MAX_DATA_LEN) { return UXBUS_STATE::ERR_PARAM; }
+	int trans_id = send_xbus(funcode, 0, 0);
+	if (trans_id < 0) { return UXBUS_STATE::ERR_NOTTCP; }
 
-	ret = send_pend(funcode, num * 2, UXBUS_CONF::GET_TIMEOUT, datas);
+	int ret = send_pend(funcode, num * 2, UXBUS_CONF::GET_TIMEOUT, datas, trans_id);
 	for (int i = 0; i < num; i++) {
 		rx_data[i] = bin8_to_16(&datas[i * 2]);
 	}
-	delete datas;
 
 	return ret;
 }
 
 int UxbusCmd::set_nfp32(int funcode, float *datas, int num) {
-	// unsigned char hexdata[num * 4] = {0};
-	unsigned char *hexdata = new unsigned char[num * 4];
+	unsigned char hexdata[UXBUS_CONF::MAX_DATA_LEN];
+	if (num * 4 > UXBUS_CONF::MAX_DATA_LEN) { return UXBUS_STATE::ERR_PARAM; }
 	nfp32_to_hex(datas, hexdata, num);
-	int ret = send_xbus(funcode, hexdata, num * 4);
-	delete hexdata;
-	if (0 != ret) { return UXBUS_STATE::ERR_NOTTCP; }
-	ret = send_pend(funcode, 0, UXBUS_CONF::SET_TIMEOUT, NULL);
+	int trans_id = send_xbus(funcode, hexdata, num * 4);
+	if (trans_id < 0) { return UXBUS_STATE::ERR_NOTTCP; }
+	int ret = send_pend(funcode, 0, UXBUS_CONF::SET_TIMEOUT, NULL, trans_id);
 
 	return ret;
 }
 
 int UxbusCmd::set_nint32(int funcode, int *datas, int num) {
-	//unsigned char hexdata[num * 4] = {0};  \\??
-	unsigned char *hexdata = new unsigned char[num * 4];
+	unsigned char hexdata[UXBUS_CONF::MAX_DATA_LEN];
+	if (num * 4 > UXBUS_CONF::MAX_DATA_LEN) { return UXBUS_STATE::ERR_PARAM; }
 	nint32_to_hex(datas, hexdata, num);
-	int ret = send_xbus(funcode, hexdata, num * 4);
-	delete hexdata;
-	if (0 != ret) { return UXBUS_STATE::ERR_NOTTCP; }
-	ret = send_pend(funcode, 0, UXBUS_CONF::SET_TIMEOUT, NULL);
+	int trans_id = send_xbus(funcode, hexdata, num * 4);
+	if (trans_id < 0) { return UXBUS_STATE::ERR_NOTTCP; }
+	int ret = send_pend(funcode, 0, UXBUS_CONF::SET_TIMEOUT, NULL, trans_id);
 
 	return ret;
 }
 
 int UxbusCmd::get_nfp32(int funcode, float *rx_data, int num) {
-	//unsigned char datas[num * 4] = {0};
-	unsigned char *datas = new unsigned char[num * 4];
-	int ret = send_xbus(funcode, 0, 0);
-	if (0 != ret) {
-		delete datas;
-		return UXBUS_STATE::ERR_NOTTCP;
-	}
-	ret = send_pend(funcode, num * 4, UXBUS_CONF::GET_TIMEOUT, datas);
+	unsigned char datas[UXBUS_CONF::MAX_DATA_LEN];
+	if (num * 4 > UXBUS_CONF::MAX_DATA_LEN) { return UXBUS_STATE::ERR_PARAM; }
+	int trans_id = send_xbus(funcode, 0, 0);
+	if (trans_id < 0) { return UXBUS_STATE::ERR_NOTTCP; }
+	int ret = send_pend(funcode, num * 4, UXBUS_CONF::GET_TIMEOUT, datas, trans_id);
 	hex_to_nfp32(datas, rx_data, num);
-	delete datas;
 	return ret;
 }
 
 int UxbusCmd::swop_nfp32(int funcode, float tx_datas[], int txn, float *rx_data, int rxn) {
-	unsigned char hexdata[128] = { 0 };
+	unsigned char hexdata[UXBUS_CONF::MAX_DATA_LEN] = { 0 };
+	if (txn * 4 > UXBUS_CONF::MAX_DATA_LEN || rxn * 4 > UXBUS_CONF::MAX_DATA_LEN) { return UXBUS_STATE::ERR_PARAM; }
 
 	nfp32_to_hex(tx_datas, hexdata, txn);
-	int ret = send_xbus(funcode, hexdata, txn * 4);
-	if (0 != ret) { return UXBUS_STATE::ERR_NOTTCP; }
-	ret = send_pend(funcode, rxn * 4, UXBUS_CONF::GET_TIMEOUT, hexdata);
+	int trans_id = send_xbus(funcode, hexdata, txn * 4);
+	if (trans_id < 0) { return UXBUS_STATE::ERR_NOTTCP; }
+	int ret = send_pend(funcode, rxn * 4, UXBUS_CONF::GET_TIMEOUT, hexdata, trans_id);
 	hex_to_nfp32(hexdata, rx_data, rxn);
 
 	return ret;
 }
 
 int UxbusCmd::is_nfp32(int funcode, float datas[], int txn, int *value) {
-	//unsigned char hexdata[txn * 4] = {0};
-	unsigned char *hexdata = new unsigned char[txn * 4];
+	unsigned char hexdata[UXBUS_CONF::MAX_DATA_LEN];
+	if (txn * 4 > UXBUS_CONF::MAX_DATA_LEN) { return UXBUS_STATE::ERR_PARAM; }
 
 	nfp32_to_hex(datas, hexdata, txn);
-	int ret = send_xbus(funcode, hexdata, txn * 4);
-	if (0 != ret) {
-		delete hexdata;
-		return UXBUS_STATE::ERR_NOTTCP;
-	}
-	ret = send_pend(funcode, 1, UXBUS_CONF::GET_TIMEOUT, hexdata);
+	int trans_id = send_xbus(funcode, hexdata, txn * 4);
+	if (trans_id < 0) { return UXBUS_STATE::ERR_NOTTCP; }
+	int ret = send_pend(funcode, 1, UXBUS_CONF::GET_TIMEOUT, hexdata, trans_id);
 	*value = hexdata[0];
-	delete hexdata;
 
 	return ret;
 }
 
+int UxbusCmd::get_nu8_pipelined(int count, const int funcodes[], const int nums[], unsigned char *rx_datas[], int rets[]) {
+	int ids[16];
+	if (count > 16) { return UXBUS_STATE::ERR_PARAM; }
+	for (int i = 0; i < count; i++) {
+		ids[i] = send_xbus(funcodes[i], 0, 0);
+		if (ids[i] < 0) { return UXBUS_STATE::ERR_NOTTCP; }
+	}
+	for (int i = 0; i < count; i++) {
+		rets[i] = send_pend(funcodes[i], nums[i], UXBUS_CONF::GET_TIMEOUT, rx_datas[i], ids[i]);
+	}
+	return 0;
+}
+
 /*******************************************************
  * controler setting
  *******************************************************/
 int UxbusCmd::get_version(unsigned char rx_data[40]) {
-	return get_nu8(UXBUS_RG::GET_VERSION, rx_data, 40);
+	return send_cmd<UXBUS_CMD::GET_VERSION>(NULL, rx_data);
 }
 
 int UxbusCmd::get_robot_sn(unsigned char rx_data[40]) {
-	return get_nu8(UXBUS_RG::GET_ROBOT_SN, rx_data, 40);
+	return send_cmd<UXBUS_CMD::GET_ROBOT_SN>(NULL, rx_data);
 }
 
 int UxbusCmd::check_verification(int *rx_data) {
-	return get_nu8(UXBUS_RG::CHECK_VERIFY, rx_data, 1);
+	return send_cmd<UXBUS_CMD::CHECK_VERIFY>(NULL, rx_data);
 }
 
 int UxbusCmd::shutdown_system(int value) {
-	return set_nu8(UXBUS_RG::SHUTDOWN_SYSTEM, &value, 1);
+	return send_cmd<UXBUS_CMD::SHUTDOWN_SYSTEM>(&value);
 }
 
 int UxbusCmd::set_record_traj(int value) {
-	int txdata[1] = { value };
-	return set_nu8(UXBUS_RG::SET_TRAJ_RECORD, txdata, 1);
+	return send_cmd<UXBUS_CMD::SET_TRAJ_RECORD>(&value);
 }
 
 int UxbusCmd::playback_traj(int times, int spdx) {
 	int txdata[2] = { times, spdx };
-	return set_nint32(UXBUS_RG::PLAY_TRAJ, txdata, 2);
+	return send_cmd<UXBUS_CMD::PLAY_TRAJ>(txdata);
 }
 
 int UxbusCmd::playback_traj_old(int times) {
-	int txdata[1] = { times };
-	return set_nint32(UXBUS_RG::PLAY_TRAJ, txdata, 1);
+	return send_cmd<UXBUS_CMD::PLAY_TRAJ_OLD>(&times);
 }
 
 int UxbusCmd::save_traj(char filename[81]) {
-	return set_nu8(UXBUS_RG::SAVE_TRAJ, (int *)filename, 81);
+	return send_cmd<UXBUS_CMD::SAVE_TRAJ>((unsigned char *)filename);
 }
 
 int UxbusCmd::load_traj(char filename[81]) {
-	return set_nu8(UXBUS_RG::LOAD_TRAJ, (int *)filename, 81);
+	return send_cmd<UXBUS_CMD::LOAD_TRAJ>((unsigned char *)filename);
 }
 
 int UxbusCmd::get_traj_rw_status(int *rx_data) {
-	return get_nu8(UXBUS_RG::GET_TRAJ_RW_STATUS, rx_data, 1);
+	return send_cmd<UXBUS_CMD::GET_TRAJ_RW_STATUS>(NULL, rx_data);
 }
 
 int UxbusCmd::set_reduced_mode(int on_off) {
-	int txdata[1] = { on_off };
-	return set_nu8(UXBUS_RG::SET_REDUCED_MODE, txdata, 1);
+	return send_cmd<UXBUS_CMD::SET_REDUCED_MODE>(&on_off);
 }
 
 int UxbusCmd::set_reduced_linespeed(float lspd_mm) {
-	float txdata[1] = { lspd_mm };
-	return set_nfp32(UXBUS_RG::SET_REDUCED_TRSV, txdata, 1);
+	return send_cmd<UXBUS_CMD::SET_REDUCED_TRSV>(&lspd_mm);
 }
 
 int UxbusCmd::set_reduced_jointspeed(float jspd_rad) {
-	float txdata[1] = { jspd_rad };
-	return set_nfp32(UXBUS_RG::SET_REDUCED_P2PV, txdata, 1);
+	return send_cmd<UXBUS_CMD::SET_REDUCED_P2PV>(&jspd_rad);
 }
 
 int UxbusCmd::get_reduced_mode(int *rx_data) {
-	return get_nu8(UXBUS_RG::GET_REDUCED_MODE, rx_data, 1);
+	return send_cmd<UXBUS_CMD::GET_REDUCED_MODE>(NULL, rx_data);
 }
 
 int UxbusCmd::get_reduced_states(int *on, int xyz_list[6], float *tcp_speed, float *joint_speed, float jrange_rad[14], int *fense_is_on, int *collision_rebound_is_on, int length) {
-	//unsigned char rx_data[length] = {0};
-	unsigned char *rx_data = new unsigned char[length];
-	int ret = get_nu8(UXBUS_RG::GET_REDUCED_STATE, rx_data, length);
+	unsigned char rx_data[UXBUS_CMD::GET_REDUCED_STATE_EXT::rx_len] = { 0 };
+	int ret;
+	if (length == UXBUS_CMD::GET_REDUCED_STATE_EXT::rx_len)
+		ret = send_cmd<UXBUS_CMD::GET_REDUCED_STATE_EXT>(NULL, rx_data);
+	else
+		ret = send_cmd<UXBUS_CMD::GET_REDUCED_STATE>(NULL, rx_data);
 	*on = rx_data[0];
 	bin8_to_ns16(&rx_data[1], xyz_list, 6);
 	*tcp_speed = hex_to_fp32(&rx_data[13]);
 	*joint_speed = hex_to_fp32(&rx_data[17]);
-	if (length == 79) {
+	if (length == UXBUS_CMD::GET_REDUCED_STATE_EXT::rx_len) {
 		if (jrange_rad != NULL) { hex_to_nfp32(&rx_data[21], jrange_rad, 14); }
 		if (fense_is_on != NULL) { *fense_is_on = rx_data[77]; }
 		if (collision_rebound_is_on != NULL) { *collision_rebound_is_on = rx_data[78]; }
 	}
-	delete rx_data;
 	return ret;
 }
 
 int UxbusCmd::set_xyz_limits(int xyz_list[6]) {
-	return set_nint32(UXBUS_RG::SET_LIMIT_XYZ, xyz_list, 6);
+	return send_cmd<UXBUS_CMD::SET_LIMIT_XYZ>(xyz_list);
 }
 
 int UxbusCmd::set_world_offset(float pose_offset[6]) {
-	return set_nfp32(UXBUS_RG::SET_WORLD_OFFSET, pose_offset, 6);
+	return send_cmd<UXBUS_CMD::SET_WORLD_OFFSET>(pose_offset);
 }
 
 int UxbusCmd::cnter_reset(void) {
-	return set_nu8(UXBUS_RG::CNTER_RESET, 0, 0);
+	return send_cmd<UXBUS_CMD::CNTER_RESET>();
 }
 
 int UxbusCmd::cnter_plus(void) {
-	return set_nu8(UXBUS_RG::CNTER_PLUS, 0, 0);
+	return send_cmd<UXBUS_CMD::CNTER_PLUS>();
 }
 
 int UxbusCmd::set_reduced_jrange(float jrange_rad[14]) {
-	return set_nfp32(UXBUS_RG::SET_REDUCED_JRANGE, jrange_rad, 14);
+	return send_cmd<UXBUS_CMD::SET_REDUCED_JRANGE>(jrange_rad);
 }
 
 int UxbusCmd::set_fense_on(int on_off) {
-	int txdata[1] = { on_off };
-	return set_nu8(UXBUS_RG::SET_FENSE_ON, txdata, 1);
+	return send_cmd<UXBUS_CMD::SET_FENSE_ON>(&on_off);
 }
 
 int UxbusCmd::set_collis_reb(int on_off) {
-	int txdata[1] = { on_off };
-	return set_nu8(UXBUS_RG::SET_COLLIS_REB, txdata, 1);
+	return send_cmd<UXBUS_CMD::SET_COLLIS_REB>(&on_off);
 }
 
 int UxbusCmd::motion_en(int id, int value) {
 	int txdata[2] = { id, value };
-	return set_nu8(UXBUS_RG::MOTION_EN, txdata, 2);
+	return send_cmd<UXBUS_CMD::MOTION_EN>(txdata);
 }
 
 int UxbusCmd::set_state(int value) {
-	return set_nu8(UXBUS_RG::SET_STATE, &value, 1);
+	// pause and stop are written ahead of the requests of the other threads
+	if (value == 3 || value == 4) {
+		int trans_id = post_urgent<UXBUS_CMD::SET_STATE>(&value);
+		if (trans_id < 0) { return UXBUS_STATE::ERR_NOTTCP; }
+		return pend_cmd<UXBUS_CMD::SET_STATE>(trans_id);
+	}
+	return send_cmd<UXBUS_CMD::SET_STATE>(&value);
 }
 
 int UxbusCmd::get_state(int *rx_data) {
-	return get_nu8(UXBUS_RG::GET_STATE, rx_data, 1);
+	return send_cmd<UXBUS_CMD::GET_STATE>(NULL, rx_data);
 }
 
 int UxbusCmd::get_cmdnum(int *rx_data) {
-	return get_nu16(UXBUS_RG::GET_CMDNUM, rx_data, 1);
+	return send_cmd<UXBUS_CMD::GET_CMDNUM>(NULL, rx_data);
 }
 
 int UxbusCmd::get_err_code(int * rx_data) {
-	return get_nu8(UXBUS_RG::GET_ERROR, rx_data, 2);
+	return send_cmd<UXBUS_CMD::GET_ERROR>(NULL, rx_data);
 }
 
 int UxbusCmd::get_hd_types(int *rx_data) {
-	return get_nu8(UXBUS_RG::GET_HD_TYPES, rx_data, 2);
+	return send_cmd<UXBUS_CMD::GET_HD_TYPES>(NULL, rx_data);
 }
 
 int UxbusCmd::reload_dynamics(void) {
-	int txdata[1] = { 0 };
-	return set_nu8(UXBUS_RG::RELOAD_DYNAMICS, txdata, 0);
+	return send_cmd<UXBUS_CMD::RELOAD_DYNAMICS>();
 }
 
 int UxbusCmd::clean_err(void) {
-	int txdata[1] = { 0 };
-	return set_nu8(UXBUS_RG::CLEAN_ERR, txdata, 0);
+	return send_cmd<UXBUS_CMD::CLEAN_ERR>();
 }
 
 int UxbusCmd::clean_war(void) {
-	int txdata[1] = { 0 };
-	return set_nu8(UXBUS_RG::CLEAN_WAR, txdata, 0);
+	return send_cmd<UXBUS_CMD::CLEAN_WAR>();
 }
 
 int UxbusCmd::set_brake(int axis, int en) {
 	int txdata[2] = { axis, en };
-	return set_nu8(UXBUS_RG::SET_BRAKE, txdata, 2);
+	return send_cmd<UXBUS_CMD::SET_BRAKE>(txdata);
 }
 
 int UxbusCmd::set_mode(int value) {
-	int txdata[1] = { value };
-	return set_nu8(UXBUS_RG::SET_MODE, txdata, 1);
+	return send_cmd<UXBUS_CMD::SET_MODE>(&value);
 }
 
 /*******************************************************
@@ -332,7 +329,7 @@ int UxbusCmd::move_line(float mvpose[6], float mvvelo, float mvacc, float mvtime
 	txdata[6] = mvvelo;
 	txdata[7] = mvacc;
 	txdata[8] = mvtime;
-	return set_nfp32(UXBUS_RG::MOVE_LINE, txdata, 9);
+	return send_cmd<UXBUS_CMD::MOVE_LINE>(txdata);
 }
 
 int UxbusCmd::move_lineb(float mvpose[6], float mvvelo, float mvacc, float mvtime,
@@ -344,7 +341,7 @@ int UxbusCmd::move_lineb(float mvpose[6], float mvvelo, float mvacc, float mvtim
 	txdata[8] = mvtime;
 	txdata[9] = mvradii;
 
-	return set_nfp32(UXBUS_RG::MOVE_LINEB, txdata, 10);
+	return send_cmd<UXBUS_CMD::MOVE_LINEB>(txdata);
 }
 
 int UxbusCmd::move_joint(float mvjoint[7], float mvvelo, float mvacc,
@@ -354,7 +351,7 @@ int UxbusCmd::move_joint(float mvjoint[7], float mvvelo, float mvacc,
 	txdata[7] = mvvelo;
 	txdata[8] = mvacc;
 	txdata[9] = mvtime;
-	return set_nfp32(UXBUS_RG::MOVE_JOINT, txdata, 10);
+	return send_cmd<UXBUS_CMD::MOVE_JOINT>(txdata);
 }
 
 int UxbusCmd::move_line_tool(float mvpose[6], float mvvelo, float mvacc, float mvtime) {
@@ -363,7 +360,7 @@ int UxbusCmd::move_line_tool(float mvpose[6], float mvvelo, float mvacc, float m
 	txdata[6] = mvvelo;
 	txdata[7] = mvacc;
 	txdata[8] = mvtime;
-	return set_nfp32(UXBUS_RG::MOVE_LINE_TOOL, txdata, 9);
+	return send_cmd<UXBUS_CMD::MOVE_LINE_TOOL>(txdata);
 }
 
 int UxbusCmd::move_gohome(float mvvelo, float mvacc, float mvtime) {
@@ -371,7 +368,7 @@ int UxbusCmd::move_gohome(float mvvelo, float mvacc, float mvtime) {
 	txdata[0] = mvvelo;
 	txdata[1] = mvacc;
 	txdata[2] = mvtime;
-	return set_nfp32(UXBUS_RG::MOVE_HOME, txdata, 3);
+	return send_cmd<UXBUS_CMD::MOVE_HOME>(txdata);
 }
 
 int UxbusCmd::move_servoj(float mvjoint[7], float mvvelo, float mvacc, float mvtime) {
@@ -380,7 +377,7 @@ int UxbusCmd::move_servoj(float mvjoint[7], float mvvelo, float mvacc, float mvt
 	txdata[7] = mvvelo;
 	txdata[8] = mvacc;
 	txdata[9] = mvtime;
-	return set_nfp32(UXBUS_RG::MOVE_SERVOJ, txdata, 10);
+	return send_cmd<UXBUS_CMD::MOVE_SERVOJ>(txdata);
 }
 
 int UxbusCmd::move_servo_cartesian(float mvpose[6], float mvvelo, float mvacc, float mvtime) {
@@ -389,31 +386,27 @@ int UxbusCmd::move_servo_cartesian(float mvpose[6], float mvvelo, float mvacc, f
 	txdata[6] = mvvelo;
 	txdata[7] = mvacc;
 	txdata[8] = mvtime;
-	return set_nfp32(UXBUS_RG::MOVE_SERVO_CART, txdata, 9);
+	return send_cmd<UXBUS_CMD::MOVE_SERVO_CART>(txdata);
 }
 
 int UxbusCmd::set_servot(float jnt_taus[7]) {
-	float txdata[7] = { 0 };
-	for (int i = 0; i < 7; i++) { txdata[i] = jnt_taus[i]; }
-	return set_nfp32(UXBUS_RG::SET_SERVOT, txdata, 7);
+	return send_cmd<UXBUS_CMD::SET_SERVOT>(jnt_taus);
 }
 
 int UxbusCmd::get_joint_tau(float jnt_taus[7]) {
-	return get_nfp32(UXBUS_RG::GET_JOINT_TAU, jnt_taus, 7);
+	return send_cmd<UXBUS_CMD::GET_JOINT_TAU>(NULL, jnt_taus);
 }
 
 int UxbusCmd::set_safe_level(int level) {
-	int txdata[1] = { level };
-	return set_nu8(UXBUS_RG::SET_SAFE_LEVEL, txdata, 1);
+	return send_cmd<UXBUS_CMD::SET_SAFE_LEVEL>(&level);
 }
 
 int UxbusCmd::get_safe_level(int *level) {
-	return get_nu8(UXBUS_RG::GET_SAFE_LEVEL, level, 1);
+	return send_cmd<UXBUS_CMD::GET_SAFE_LEVEL>(NULL, level);
 }
 
 int UxbusCmd::sleep_instruction(float sltime) {
-	float txdata[1] = { sltime };
-	return set_nfp32(UXBUS_RG::SLEEP_INSTT, txdata, 1);
+	return send_cmd<UXBUS_CMD::SLEEP_INSTT>(&sltime);
 }
 
 int UxbusCmd::move_circle(float pose1[6], float pose2[6], float mvvelo, float mvacc, float mvtime, float percent) {
@@ -428,80 +421,76 @@ int UxbusCmd::move_circle(float pose1[6], float pose2[6], float mvvelo, float mv
 	txdata[14] = mvtime;
 	txdata[15] = percent;
 
-	return set_nfp32(UXBUS_RG::MOVE_CIRCLE, txdata, 16);
+	return send_cmd<UXBUS_CMD::MOVE_CIRCLE>(txdata);
 }
 
 int UxbusCmd::set_tcp_jerk(float jerk) {
-	float txdata[1] = { jerk };
-	return set_nfp32(UXBUS_RG::SET_TCP_JERK, txdata, 1);
+	return send_cmd<UXBUS_CMD::SET_TCP_JERK>(&jerk);
 }
 
 int UxbusCmd::set_tcp_maxacc(float maxacc) {
-	float txdata[1] = { maxacc };
-	return set_nfp32(UXBUS_RG::SET_TCP_MAXACC, txdata, 1);
+	return send_cmd<UXBUS_CMD::SET_TCP_MAXACC>(&maxacc);
 }
 
 int UxbusCmd::set_joint_jerk(float jerk) {
-	float txdata[1] = { jerk };
-	return set_nfp32(UXBUS_RG::SET_JOINT_JERK, txdata, 1);
+	return send_cmd<UXBUS_CMD::SET_JOINT_JERK>(&jerk);
 }
 
 int UxbusCmd::set_joint_maxacc(float maxacc) {
-	float txdata[1] = { maxacc };
-	return set_nfp32(UXBUS_RG::SET_JOINT_MAXACC, txdata, 1);
+	return send_cmd<UXBUS_CMD::SET_JOINT_MAXACC>(&maxacc);
 }
 
 int UxbusCmd::set_tcp_offset(float pose_offset[6]) {
-	return set_nfp32(UXBUS_RG::SET_TCP_OFFSET, pose_offset, 6);
+	return send_cmd<UXBUS_CMD::SET_TCP_OFFSET>(pose_offset);
 }
 
 int UxbusCmd::set_tcp_load(float mass, float load_offset[3]) {
 	float txdata[4] = { mass, load_offset[0], load_offset[1], load_offset[2] };
-	return set_nfp32(UXBUS_RG::SET_LOAD_PARAM, txdata, 4);
+	return send_cmd<UXBUS_CMD::SET_LOAD_PARAM>(txdata);
 }
 
 int UxbusCmd::set_collis_sens(int value) {
-	return set_nu8(UXBUS_RG::SET_TEACH_SENS, &value, 1);
+	return send_cmd<UXBUS_CMD::SET_COLLIS_SENS>(&value);
 }
 
 int UxbusCmd::set_teach_sens(int value) {
-	return set_nu8(UXBUS_RG::SET_TEACH_SENS, &value, 1);
+	return send_cmd<UXBUS_CMD::SET_TEACH_SENS>(&value);
 }
 
 int UxbusCmd::set_gravity_dir(float gravity_dir[3]) {
-	return set_nfp32(UXBUS_RG::SET_GRAVITY_DIR, gravity_dir, 3);
+	return send_cmd<UXBUS_CMD::SET_GRAVITY_DIR>(gravity_dir);
 }
 
 int UxbusCmd::clean_conf() {
-	return set_nu8(UXBUS_RG::CLEAN_CONF, 0, 0);
+	return send_cmd<UXBUS_CMD::CLEAN_CONF>();
 }
 
 int UxbusCmd::save_conf() {
-	return set_nu8(UXBUS_RG::SAVE_CONF, 0, 0);
+	return send_cmd<UXBUS_CMD::SAVE_CONF>();
 }
 
 int UxbusCmd::get_tcp_pose(float pose[6]) {
-	return get_nfp32(UXBUS_RG::GET_TCP_POSE, pose, 6);
+	return send_cmd<UXBUS_CMD::GET_TCP_POSE>(NULL, pose);
 }
 
 int UxbusCmd::get_joint_pose(float angles[7]) {
-	return get_nfp32(UXBUS_RG::GET_JOINT_POS, angles, 7);
+	return send_cmd<UXBUS_CMD::GET_JOINT_POS>(NULL, angles);
 }
 
 int UxbusCmd::get_ik(float pose[6], float angles[7]) {
-	return swop_nfp32(UXBUS_RG::GET_IK, pose, 6, angles, 7);
+	return send_cmd<UXBUS_CMD::GET_IK>(pose, angles);
 }
 
 int UxbusCmd::get_fk(float angles[7], float pose[6]) {
-	return swop_nfp32(UXBUS_RG::GET_FK, angles, 7, pose, 6);
+	return send_cmd<UXBUS_CMD::GET_FK>(angles, pose);
 }
 
 int UxbusCmd::is_joint_limit(float joint[7], int *value) {
-	return is_nfp32(UXBUS_RG::IS_JOINT_LIMIT, joint, 7, value);
+	return send_cmd<UXBUS_CMD::IS_JOINT_LIMIT>(joint, value);
 }
 
 int UxbusCmd::is_tcp_limit(float pose[6], int *value) {
-	return is_nfp32(UXBUS_RG::IS_TCP_LIMIT, pose, 6, value);
+	return send_cmd<UXBUS_CMD::IS_TCP_LIMIT>(pose, value);
 }
 
 /*******************************************************
@@ -512,20 +501,20 @@ int UxbusCmd::gripper_addr_w16(int addr, float value) {
 	txdata[0] = UXBUS_CONF::GRIPPER_ID;
 	bin16_to_8(addr, &txdata[1]);
 	fp32_to_hex(value, &txdata[3]);
-	int ret = send_xbus(UXBUS_RG::TGPIO_W16B, txdata, 7);
-	if (0 != ret) { return UXBUS_STATE::ERR_NOTTCP; }
+	int trans_id = send_xbus(UXBUS_RG::TGPIO_W16B, txdata, 7);
+	if (trans_id < 0) { return UXBUS_STATE::ERR_NOTTCP; }
 
-	return send_pend(UXBUS_RG::TGPIO_W16B, 0, UXBUS_CONF::GET_TIMEOUT, NULL);
+	return send_pend(UXBUS_RG::TGPIO_W16B, 0, UXBUS_CONF::GET_TIMEOUT, NULL, trans_id);
 }
 
 int UxbusCmd::gripper_addr_r16(int addr, float *value) {
 	unsigned char txdata[3], rx_data[4];
 	txdata[0] = UXBUS_CONF::GRIPPER_ID;
 	bin16_to_8(addr, &txdata[1]);
-	int ret = send_xbus(UXBUS_RG::TGPIO_R16B, txdata, 3);
-	if (0 != ret) { return UXBUS_STATE::ERR_NOTTCP; }
+	int trans_id = send_xbus(UXBUS_RG::TGPIO_R16B, txdata, 3);
+	if (trans_id < 0) { return UXBUS_STATE::ERR_NOTTCP; }
 
-	return send_pend(UXBUS_RG::TGPIO_R16B, 4, UXBUS_CONF::GET_TIMEOUT, rx_data);
+	int ret = send_pend(UXBUS_RG::TGPIO_R16B, 4, UXBUS_CONF::GET_TIMEOUT, rx_data, trans_id);
 	*value = (float)bin8_to_32(rx_data);
 	return ret;
 }
@@ -535,20 +524,20 @@ int UxbusCmd::gripper_addr_w32(int addr, float value) {
 	txdata[0] = UXBUS_CONF::GRIPPER_ID;
 	bin16_to_8(addr, &txdata[1]);
 	fp32_to_hex(value, &txdata[3]);
-	int ret = send_xbus(UXBUS_RG::TGPIO_W32B, txdata, 7);
-	if (0 != ret) { return UXBUS_STATE::ERR_NOTTCP; }
+	int trans_id = send_xbus(UXBUS_RG::TGPIO_W32B, txdata, 7);
+	if (trans_id < 0) { return UXBUS_STATE::ERR_NOTTCP; }
 
-	return send_pend(UXBUS_RG::TGPIO_W32B, 0, UXBUS_CONF::GET_TIMEOUT, NULL);
+	return send_pend(UXBUS_RG::TGPIO_W32B, 0, UXBUS_CONF::GET_TIMEOUT, NULL, trans_id);
 }
 
 int UxbusCmd::gripper_addr_r32(int addr, float *value) {
 	unsigned char txdata[3], rx_data[4];
 	txdata[0] = UXBUS_CONF::GRIPPER_ID;
 	bin16_to_8(addr, &txdata[1]);
-	int ret = send_xbus(UXBUS_RG::TGPIO_R32B, txdata, 3);
-	if (0 != ret) { return UXBUS_STATE::ERR_NOTTCP; }
+	int trans_id = send_xbus(UXBUS_RG::TGPIO_R32B, txdata, 3);
+	if (trans_id < 0) { return UXBUS_STATE::ERR_NOTTCP; }
 
-	ret = send_pend(UXBUS_RG::TGPIO_R32B, 4, UXBUS_CONF::GET_TIMEOUT, rx_data);
+	int ret = send_pend(UXBUS_RG::TGPIO_R32B, 4, UXBUS_CONF::GET_TIMEOUT, rx_data, trans_id);
 	*value = (float)bin8_to_32(rx_data);
 	return ret;
 }
@@ -578,7 +567,7 @@ int UxbusCmd::gripper_set_posspd(float speed) {
 }
 
 int UxbusCmd::gripper_get_errcode(int rx_data[2]) {
-	return get_nu8(UXBUS_RG::TGPIO_ERR, rx_data, 2);
+	return send_cmd<UXBUS_CMD::TGPIO_ERR>(NULL, rx_data);
 }
 
 int UxbusCmd::gripper_clean_err() {
@@ -593,20 +582,17 @@ int UxbusCmd::tgpio_addr_w16(int addr, float value) {
 	txdata[0] = UXBUS_CONF::TGPIO_ID;
 	bin16_to_8(addr, &txdata[1]);
 	fp32_to_hex(value, &txdata[3]);
-	int ret = send_xbus(UXBUS_RG::TGPIO_W16B, txdata, 7);
-	if (0 != ret) { return UXBUS_STATE::ERR_NOTTCP; }
+	int trans_id = send_xbus(UXBUS_RG::TGPIO_W16B, txdata, 7);
+	if (trans_id < 0) { return UXBUS_STATE::ERR_NOTTCP; }
 
-	return send_pend(UXBUS_RG::TGPIO_W16B, 0, UXBUS_CONF::GET_TIMEOUT, NULL);
+	return send_pend(UXBUS_RG::TGPIO_W16B, 0, UXBUS_CONF::GET_TIMEOUT, NULL, trans_id);
 }
 
 int UxbusCmd::tgpio_addr_r16(int addr, float *value) {
 	unsigned char txdata[3], rx_data[4];
 	txdata[0] = UXBUS_CONF::TGPIO_ID;
 	bin16_to_8(addr, &txdata[1]);
-	int ret = send_xbus(UXBUS_RG::TGPIO_R16B, txdata, 3);
-	if (0 != ret) { return UXBUS_STATE::ERR_NOTTCP; }
-
-	ret = send_pend(UXBUS_RG::TGPIO_R16B, 4, UXBUS_CONF::GET_TIMEOUT, rx_data);
+	int ret = send_cmd<UXBUS_CMD::TGPIO_R16B>(txdata, rx_data);
 	*value = (float)bin8_to_32(rx_data);
 	return ret;
 }
@@ -615,20 +601,20 @@ int UxbusCmd::tgpio_addr_w32(int addr, float value) {
 	txdata[0] = UXBUS_CONF::TGPIO_ID;
 	bin16_to_8(addr, &txdata[1]);
 	fp32_to_hex(value, &txdata[3]);
-	int ret = send_xbus(UXBUS_RG::TGPIO_W32B, txdata, 7);
-	if (0 != ret) { return UXBUS_STATE::ERR_NOTTCP; }
+	int trans_id = send_xbus(UXBUS_RG::TGPIO_W32B, txdata, 7);
+	if (trans_id < 0) { return UXBUS_STATE::ERR_NOTTCP; }
 
-	return send_pend(UXBUS_RG::TGPIO_W32B, 0, UXBUS_CONF::GET_TIMEOUT, NULL);
+	return send_pend(UXBUS_RG::TGPIO_W32B, 0, UXBUS_CONF::GET_TIMEOUT, NULL, trans_id);
 }
 
 int UxbusCmd::tgpio_addr_r32(int addr, float *value) {
 	unsigned char txdata[3], rx_data[4];
 	txdata[0] = UXBUS_CONF::TGPIO_ID;
 	bin16_to_8(addr, &txdata[1]);
-	int ret = send_xbus(UXBUS_RG::TGPIO_R32B, txdata, 3);
-	if (0 != ret) { return UXBUS_STATE::ERR_NOTTCP; }
+	int trans_id = send_xbus(UXBUS_RG::TGPIO_R32B, txdata, 3);
+	if (trans_id < 0) { return UXBUS_STATE::ERR_NOTTCP; }
 
-	return send_pend(UXBUS_RG::TGPIO_R32B, 4, UXBUS_CONF::GET_TIMEOUT, rx_data);
+	int ret = send_pend(UXBUS_RG::TGPIO_R32B, 4, UXBUS_CONF::GET_TIMEOUT, rx_data, trans_id);
 	*value = (float)bin8_to_32(rx_data);
 	return ret;
 }
@@ -683,21 +669,27 @@ int UxbusCmd::tgpio_get_analog2(float * value) {
 /*******************************************************
  * tgpio modbus
  *******************************************************/
-int UxbusCmd::tgpio_set_modbus(unsigned char *modbus_t, int len_t, unsigned char *rx_data) {
-	//unsigned char txdata[len_t + 1];
-	unsigned char *txdata = new unsigned char[len_t + 1];
+int UxbusCmd::tgpio_post_modbus(unsigned char *modbus_t, int len_t) {
+	unsigned char txdata[UXBUS_CONF::MAX_DATA_LEN];
+	if (len_t + 1 > UXBUS_CONF::MAX_DATA_LEN) { return -1; }
 	txdata[0] = UXBUS_CONF::TGPIO_ID;
 	for (int i = 0; i < len_t; i++) { txdata[i + 1] = modbus_t[i]; }
-	int ret = send_xbus(UXBUS_RG::TGPIO_MODBUS, txdata, len_t + 1);
-	delete txdata;
-	if (0 != ret) { return UXBUS_STATE::ERR_NOTTCP; }
+	return send_xbus(UXBUS_RG::TGPIO_MODBUS, txdata, len_t + 1);
+}
 
-	ret = send_pend(UXBUS_RG::TGPIO_MODBUS, -1, UXBUS_CONF::GET_TIMEOUT, rx_data);
-	return ret;
+int UxbusCmd::tgpio_pend_modbus(int trans_id, unsigned char *rx_data, int timeout) {
+	return send_pend(UXBUS_RG::TGPIO_MODBUS, -1, timeout, rx_data, trans_id);
+}
+
+int UxbusCmd::tgpio_set_modbus(unsigned char *modbus_t, int len_t, unsigned char *rx_data) {
+	if (len_t + 1 > UXBUS_CONF::MAX_DATA_LEN) { return UXBUS_STATE::ERR_PARAM; }
+	int trans_id = tgpio_post_modbus(modbus_t, len_t);
+	if (trans_id < 0) { return UXBUS_STATE::ERR_NOTTCP; }
+	return tgpio_pend_modbus(trans_id, rx_data);
 }
 
 int UxbusCmd::gripper_modbus_w16s(int addr, float value, int len) {
-	unsigned char txdata[9], rx_data[254];
+	unsigned char txdata[11], rx_data[254];
 	txdata[0] = UXBUS_CONF::GRIPPER_ID;
 	txdata[1] = 0x10;
 	bin16_to_8(addr, &txdata[2]);
@@ -708,12 +700,18 @@ int UxbusCmd::gripper_modbus_w16s(int addr, float value, int len) {
 }
 
 int UxbusCmd::gripper_modbus_r16s(int addr, int len, unsigned char *rx_data) {
+	int trans_id = gripper_modbus_post_r16s(addr, len);
+	if (trans_id < 0) { return UXBUS_STATE::ERR_NOTTCP; }
+	return tgpio_pend_modbus(trans_id, rx_data);
+}
+
+int UxbusCmd::gripper_modbus_post_r16s(int addr, int len) {
 	unsigned char txdata[9];
 	txdata[0] = UXBUS_CONF::GRIPPER_ID;
 	txdata[1] = 0x03;
 	bin16_to_8(addr, &txdata[2]);
 	bin16_to_8(len, &txdata[4]);
-	return tgpio_set_modbus(txdata, 6, rx_data);
+	return tgpio_post_modbus(txdata, 6);
 }
 
 int UxbusCmd::gripper_modbus_set_en(int value) {
@@ -773,11 +771,11 @@ int UxbusCmd::gripper_modbus_clean_err(void) {
  * uservo
  *******************************************************/
 int UxbusCmd::servo_set_zero(int id) {
-	return set_nu8(UXBUS_RG::SERVO_ZERO, &id, 1);
+	return send_cmd<UXBUS_CMD::SERVO_ZERO>(&id);
 }
 
 int UxbusCmd::servo_get_dbmsg(int rx_data[16]) {
-	return get_nu8(UXBUS_RG::SERVO_DBMSG, rx_data, 16);
+	return send_cmd<UXBUS_CMD::SERVO_DBMSG>(NULL, rx_data);
 }
 
 int UxbusCmd::servo_addr_w16(int id, int addr, float value) {
@@ -785,20 +783,20 @@ int UxbusCmd::servo_addr_w16(int id, int addr, float value) {
 	txdata[0] = id;
 	bin16_to_8(addr, &txdata[1]);
 	fp32_to_hex(value, &txdata[3]);
-	int ret = send_xbus(UXBUS_RG::SERVO_W16B, txdata, 7);
-	if (0 != ret) { return UXBUS_STATE::ERR_NOTTCP; }
+	int trans_id = send_xbus(UXBUS_RG::SERVO_W16B, txdata, 7);
+	if (trans_id < 0) { return UXBUS_STATE::ERR_NOTTCP; }
 
-	return send_pend(UXBUS_RG::SERVO_W16B, 0, UXBUS_CONF::GET_TIMEOUT, NULL);
+	return send_pend(UXBUS_RG::SERVO_W16B, 0, UXBUS_CONF::GET_TIMEOUT, NULL, trans_id);
 }
 
 int UxbusCmd::servo_addr_r16(int id, int addr, float *value) {
 	unsigned char txdata[3], rx_data[4];
 	txdata[0] = id;
 	bin16_to_8(addr, &txdata[1]);
-	int ret = send_xbus(UXBUS_RG::SERVO_R16B, txdata, 3);
-	if (0 != ret) { return UXBUS_STATE::ERR_NOTTCP; }
+	int trans_id = send_xbus(UXBUS_RG::SERVO_R16B, txdata, 3);
+	if (trans_id < 0) { return UXBUS_STATE::ERR_NOTTCP; }
 
-	ret = send_pend(UXBUS_RG::SERVO_R16B, 4, UXBUS_CONF::GET_TIMEOUT, rx_data);
+	int ret = send_pend(UXBUS_RG::SERVO_R16B, 4, UXBUS_CONF::GET_TIMEOUT, rx_data, trans_id);
 	*value = (float)bin8_to_32(rx_data);
 	return ret;
 }
@@ -808,20 +806,20 @@ int UxbusCmd::servo_addr_w32(int id, int addr, float value) {
 	txdata[0] = id;
 	bin16_to_8(addr, &txdata[1]);
 	fp32_to_hex(value, &txdata[3]);
-	int ret = send_xbus(UXBUS_RG::SERVO_W32B, txdata, 7);
-	if (0 != ret) { return UXBUS_STATE::ERR_NOTTCP; }
+	int trans_id = send_xbus(UXBUS_RG::SERVO_W32B, txdata, 7);
+	if (trans_id < 0) { return UXBUS_STATE::ERR_NOTTCP; }
 
-	return send_pend(UXBUS_RG::SERVO_W32B, 0, UXBUS_CONF::GET_TIMEOUT, NULL);
+	return send_pend(UXBUS_RG::SERVO_W32B, 0, UXBUS_CONF::GET_TIMEOUT, NULL, trans_id);
 }
 
 int UxbusCmd::servo_addr_r32(int id, int addr, float *value) {
 	unsigned char txdata[3], rx_data[4];
 	txdata[0] = id;
 	bin16_to_8(addr, &txdata[1]);
-	int ret = send_xbus(UXBUS_RG::SERVO_R32B, txdata, 3);
-	if (0 != ret) { return UXBUS_STATE::ERR_NOTTCP; }
+	int trans_id = send_xbus(UXBUS_RG::SERVO_R32B, txdata, 3);
+	if (trans_id < 0) { return UXBUS_STATE::ERR_NOTTCP; }
 
-	ret = send_pend(UXBUS_RG::SERVO_R32B, 4, UXBUS_CONF::GET_TIMEOUT, rx_data);
+	int ret = send_pend(UXBUS_RG::SERVO_R32B, 4, UXBUS_CONF::GET_TIMEOUT, rx_data, trans_id);
 	*value = (float)bin8_to_32(rx_data);
 	return ret;
 }
@@ -832,17 +830,17 @@ int UxbusCmd::servo_addr_r32(int id, int addr, float *value) {
  * controler gpio
  *******************************************************/
 int UxbusCmd::cgpio_get_auxdigit(int *value) {
-	return get_nu16(UXBUS_RG::CGPIO_GET_DIGIT, value, 1);
+	return send_cmd<UXBUS_CMD::CGPIO_GET_DIGIT>(NULL, value);
 }
 int UxbusCmd::cgpio_get_analog1(float *value) {
 	int tmp;
-	int ret = get_nu16(UXBUS_RG::CGPIO_GET_ANALOG1, &tmp, 1);
+	int ret = send_cmd<UXBUS_CMD::CGPIO_GET_ANALOG1>(NULL, &tmp);
 	*value = (float)(tmp * 10.0 / 4096.0);
 	return ret;
 }
 int UxbusCmd::cgpio_get_analog2(float *value) {
 	int tmp;
-	int ret = get_nu16(UXBUS_RG::CGPIO_GET_ANALOG2, &tmp, 1);
+	int ret = send_cmd<UXBUS_CMD::CGPIO_GET_ANALOG2>(NULL, &tmp);
 	*value = (float)(tmp * 10.0 / 4096.0);
 	return ret;
 }
@@ -866,24 +864,24 @@ int UxbusCmd::cgpio_set_auxdigit(int ionum, int value) {
 	{
 		tmp = tmp | (0x0001 << ionum);
 	}
-	return set_nu16(UXBUS_RG::CGPIO_SET_DIGIT, &tmp, 1);
+	return send_cmd<UXBUS_CMD::CGPIO_SET_DIGIT>(&tmp);
 }
 int UxbusCmd::cgpio_set_analog1(int value) {
 	value = (int)(value / 10.0 * 4096.0);
-	return set_nu16(UXBUS_RG::CGPIO_SET_ANALOG1, &value, 1);
+	return send_cmd<UXBUS_CMD::CGPIO_SET_ANALOG1>(&value);
 }
 int UxbusCmd::cgpio_set_analog2(int value) {
 	value = (int)(value / 10.0 * 4096.0);
-	return set_nu16(UXBUS_RG::CGPIO_SET_ANALOG2, &value, 1);
+	return send_cmd<UXBUS_CMD::CGPIO_SET_ANALOG2>(&value);
 }
 
 int UxbusCmd::cgpio_set_infun(int num, int fun) {
 	int txdata[2] = { num, fun };
-	return set_nu8(UXBUS_RG::CGPIO_SET_IN_FUN, txdata, 2);
+	return send_cmd<UXBUS_CMD::CGPIO_SET_IN_FUN>(txdata);
 }
 int UxbusCmd::cgpio_set_outfun(int num, int fun) {
 	int txdata[2] = { num, fun };
-	return set_nu8(UXBUS_RG::CGPIO_SET_OUT_FUN, txdata, 2);
+	return send_cmd<UXBUS_CMD::CGPIO_SET_OUT_FUN>(txdata);
 }
 
 /**
@@ -905,7 +903,7 @@ int UxbusCmd::cgpio_set_outfun(int num, int fun) {
 
 int UxbusCmd::cgpio_get_state(int *state, int *digit_io, float *analog, int *input_conf, int *output_conf) {
 	unsigned char rx_data[34] = { 0 };
-	int ret = get_nu8(UXBUS_RG::CGPIO_GET_STATE, rx_data, 34);
+	int ret = send_cmd<UXBUS_CMD::CGPIO_GET_STATE>(NULL, rx_data);
 
 	state[0] = rx_data[0];
 	state[1] = rx_data[1];
@@ -14,9 +14,13 @@
 #include "xarm/core/instruction/uxbus_cmd_ser.h"
 #include "xarm/core/common/crc16.h"
 #include "xarm/core/debug/debug_print.h"
+#include "xarm/core/debug/trace.h"
 #include "xarm/core/instruction/uxbus_cmd_config.h"
 
-UxbusCmdSer::UxbusCmdSer(SerialPort *arm_port) { arm_port_ = arm_port; }
+UxbusCmdSer::UxbusCmdSer(SerialPort *arm_port) {
+	arm_port_ = arm_port;
+	sent_us_ = 0;
+}
 UxbusCmdSer::~UxbusCmdSer(void) {}
 
 int UxbusCmdSer::check_xbus_prot(unsigned char *datas, int funcode) {
@@ -35,18 +39,25 @@ int UxbusCmdSer::check_xbus_prot(unsigned char *datas, int funcode) {
 		}
 }
 
-int UxbusCmdSer::send_pend(int funcode, int num, int timeout, unsigned char *ret_data) {
+int UxbusCmdSer::send_pend(int funcode, int num, int timeout, unsigned char *ret_data, int trans_id) {
+	XARM_TRACE_SCOPE_ARG("send_pend", funcode);
 	int ret;
-	// unsigned char rx_data[arm_port_->que_maxlen_] = {0};
-	unsigned char *rx_data = new unsigned char[arm_port_->que_maxlen_];
+	unsigned char rx_data[RX_MAXLEN_];
+	if (arm_port_->que_maxlen_ > RX_MAXLEN_) { return UXBUS_STATE::ERR_LENG; }
 	int times = timeout;
 	while (times) {
 		times -= 1;
 		ret = arm_port_->read_frame(rx_data);
 		if (ret != -1) {
 			ret = check_xbus_prot(rx_data, funcode);
-			for (int i = 0; i < num; i++) { ret_data[i] = rx_data[i + 4]; }
-			delete rx_data;
+			metrics_.record_reply(funcode, CommandMetrics::now_us() - sent_us_, rx_data[2] + 5, ret);
+			int n = num;
+			if (num == -1) {
+				// the length of the reply counts the state byte
+				n = rx_data[2] - 1;
+				if (n > RX_MAXLEN_ - 4) { n = RX_MAXLEN_ - 4; }
+			}
+			for (int i = 0; i < n; i++) { ret_data[i] = rx_data[i + 4]; }
 			return ret;
 		}
 		//usleep(1000);
@@ -56,28 +67,39 @@ int UxbusCmdSer::send_pend(int funcode, int num, int timeout, unsigned char *ret
 		usleep(1000); // 1000us
 #endif
 	}
-	delete rx_data;
+	metrics_.record_timeout(funcode);
 	return UXBUS_STATE::ERR_TOUT;
 }
 
 int UxbusCmdSer::send_xbus(int funcode, unsigned char *datas, int num) {
+	unsigned char send_data[UXBUS_CONF::MAX_DATA_LEN + 6];
+	int len = encode_frame(funcode, datas, num, send_data);
+	if (len < 0) { return -1; }
+	return send_frame(send_data, len);
+}
+
+int UxbusCmdSer::encode_frame(int funcode, unsigned char *datas, int num, unsigned char *frame) {
 	int i;
-	// unsigned char send_data[num + 4];
-	unsigned char *send_data = new unsigned char[num + 4];
+	if (num > UXBUS_CONF::MAX_DATA_LEN) { return -1; }
 
-	send_data[0] = UXBUS_CONF::MASTER_ID;
-	send_data[1] = UXBUS_CONF::SLAVE_ID;
-	send_data[2] = num + 1;
-	send_data[3] = funcode;
-	for (i = 0; i < num; i++) { send_data[4 + i] = datas[i]; }
+	frame[0] = UXBUS_CONF::MASTER_ID;
+	frame[1] = UXBUS_CONF::SLAVE_ID;
+	frame[2] = num + 1;
+	frame[3] = funcode;
+	for (i = 0; i < num; i++) { frame[4 + i] = datas[i]; }
 
-	int crc = modbus_crc(send_data, 4 + num);
-	send_data[4 + num] = (unsigned char)(crc & 0xFF);
-	send_data[5 + num] = (unsigned char)((crc >> 8) & 0xFF);
+	int crc = modbus_crc(frame, 4 + num);
+	frame[4 + num] = (unsigned char)(crc & 0xFF);
+	frame[5 + num] = (unsigned char)((crc >> 8) & 0xFF);
+	return num + 6;
+}
 
+int UxbusCmdSer::send_frame(unsigned char *frame, int len) {
+	XARM_TRACE_SCOPE_ARG("send_frame", frame[3]);
 	arm_port_->flush();
-	int ret = arm_port_->write_frame(send_data, num + 6);
-	delete send_data;
+	sent_us_ = CommandMetrics::now_us();
+	int ret = arm_port_->write_frame(frame, len);
+	if (ret == len) { metrics_.record_send(frame[3], len); }
 	return ret;
 }
 
@@ -11,17 +11,38 @@
 #else
 #include <unistd.h>
 #endif
+#include <string.h>
 #include "xarm/core/instruction/uxbus_cmd_tcp.h"
 #include "xarm/core/debug/debug_print.h"
+#include "xarm/core/debug/trace.h"
 #include "xarm/core/instruction/uxbus_cmd_config.h"
 
+// a reply later than the longest wait for it is a late reply whatever its id
+#define DISCARD_AGE_US (UXBUS_CONF::SET_TIMEOUT * 1000LL)
+
 UxbusCmdTcp::UxbusCmdTcp(SocketPort *arm_port) {
 	arm_port_ = arm_port;
+	arm_port_->set_uxbus_framing(true);
 	bus_flag_ = TX2_BUS_FLAG_MIN_;
 	prot_flag_ = TX2_PROT_CON_;
+	stash_ = new unsigned char[STASH_NUM_ * arm_port_->que_maxlen_];
+	for (int i = 0; i < STASH_NUM_; i++) { stash_ids_[i] = -1; }
+	stash_next_ = 0;
+	for (int i = 0; i < DISCARD_NUM_; i++) {
+		discard_ids_[i] = -1;
+		discard_us_[i] = 0;
+	}
+	sent_us_ = new std::atomic<long long>[TX2_BUS_FLAG_MAX_ + 1];
+	for (int i = 0; i <= TX2_BUS_FLAG_MAX_; i++) { sent_us_[i] = 0; }
+	sent_funcodes_ = new std::atomic<unsigned char>[TX2_BUS_FLAG_MAX_ + 1];
+	for (int i = 0; i <= TX2_BUS_FLAG_MAX_; i++) { sent_funcodes_[i] = 0; }
 }
 
-UxbusCmdTcp::~UxbusCmdTcp(void) {}
+UxbusCmdTcp::~UxbusCmdTcp(void) {
+	delete[] stash_;
+	delete[] sent_us_;
+	delete[] sent_funcodes_;
+}
 
 int UxbusCmdTcp::check_xbus_prot(unsigned char *datas, int funcode) {
 	unsigned char *data_fp = &datas[4];
@@ -32,23 +53,12 @@ int UxbusCmdTcp::check_xbus_prot(unsigned char *datas, int funcode) {
 		return UXBUS_STATE::ERR_LENG;
 	}
 
-	int num = bin8_to_16(&data_fp[0]);
+	// the transaction id was already matched by take_reply_
 	int prot = bin8_to_16(&data_fp[2]);
 	int len = bin8_to_16(&data_fp[4]);
 	int fun = data_fp[6];
 	int state = data_fp[7];
 
-	int bus_flag = bus_flag_;
-	if (bus_flag == TX2_BUS_FLAG_MIN_)
-	{
-		bus_flag = TX2_BUS_FLAG_MAX_;
-	}
-	else
-	{
-		bus_flag -= 1;
-	}
-
-	if (num != bus_flag) { return UXBUS_STATE::ERR_NUM; }
 	if (prot != TX2_PROT_CON_) { return UXBUS_STATE::ERR_PROT; }
 	if (fun != funcode) { return UXBUS_STATE::ERR_FUN; }
 	if (state & 0x40) { return UXBUS_STATE::ERR_CODE; }
@@ -57,26 +67,66 @@ int UxbusCmdTcp::check_xbus_prot(unsigned char *datas, int funcode) {
 	return 0;
 }
 
-int UxbusCmdTcp::send_pend(int funcode, int num, int timeout, unsigned char *ret_data) {
+int UxbusCmdTcp::take_reply_(int trans_id, unsigned char *rx_data) {
+	int maxlen = arm_port_->que_maxlen_;
+	std::lock_guard<std::mutex> locker(rx_mutex_);
+	for (int i = 0; i < STASH_NUM_; i++) {
+		if (stash_ids_[i] == trans_id) {
+			memcpy(rx_data, &stash_[i * maxlen], maxlen);
+			stash_ids_[i] = -1;
+			return 0;
+		}
+	}
+	while (arm_port_->read_frame(rx_data) != -1) {
+		int num = bin8_to_16(&rx_data[4]);
+		if (num == trans_id) { return 0; }
+		bool discard = false;
+		long long now = CommandMetrics::now_us();
+		for (int i = 0; i < DISCARD_NUM_ && !discard; i++) {
+			if (discard_ids_[i] != num) { continue; }
+			discard_ids_[i] = -1;
+			discard = now - discard_us_[i] <= DISCARD_AGE_US;
+		}
+		if (discard) { continue; }
+		// a reply of another caller (or a late one), the oldest stashed reply is dropped if full
+		if (stash_ids_[stash_next_] >= 0) { metrics_.record_drop(stash_[stash_next_ * maxlen + 10]); }
+		memcpy(&stash_[stash_next_ * maxlen], rx_data, maxlen);
+		stash_ids_[stash_next_] = num;
+		stash_next_ = (stash_next_ + 1) % STASH_NUM_;
+	}
+	return -1;
+}
+
+long long UxbusCmdTcp::latency_(int trans_id) {
+	if (trans_id < 0 || trans_id > TX2_BUS_FLAG_MAX_) { return 0; }
+	return CommandMetrics::now_us() - sent_us_[trans_id].load(std::memory_order_relaxed);
+}
+
+int UxbusCmdTcp::send_pend(int funcode, int num, int timeout, unsigned char *ret_data, int trans_id) {
+	XARM_TRACE_SCOPE_ARG("send_pend", funcode);
 	int i;
 	int ret;
-	// unsigned char rx_data[arm_port_->que_maxlen_] = {0};
-	unsigned char *rx_data = new unsigned char[arm_port_->que_maxlen_];
+	unsigned char rx_data[RX_MAXLEN_];
+	if (arm_port_->que_maxlen_ > RX_MAXLEN_) { return UXBUS_STATE::ERR_LENG; }
+
+	if (trans_id < 0) {
+		std::lock_guard<std::mutex> locker(tx_mutex_);
+		trans_id = bus_flag_ == TX2_BUS_FLAG_MIN_ ? TX2_BUS_FLAG_MAX_ : bus_flag_ - 1;
+	}
 
 	int times = timeout;
 	while (times) {
 		times -= 1;
-		ret = arm_port_->read_frame(rx_data);
+		ret = take_reply_(trans_id, rx_data);
 		if (ret != -1) {
-			// print_hex("recv:", rx_data, arm_port_->que_maxlen_);
+			XARM_LOG_HEX("recv:", &rx_data[4], bin8_to_32(rx_data));
 			ret = check_xbus_prot(rx_data, funcode);
+			metrics_.record_reply(funcode, latency_(trans_id), bin8_to_32(rx_data), ret);
 			int n = num;
 			if (num == -1) {
 				n = rx_data[9] - 2;
 			}
 			for (i = 0; i < n; i++) { ret_data[i] = rx_data[i + 8 + 4]; }
-			delete rx_data;
-			// print_hex(" 3", rx_data, num + 8 + 4);
 			return ret;
 		}
 		//usleep(1000);
@@ -86,31 +136,129 @@ int UxbusCmdTcp::send_pend(int funcode, int num, int timeout, unsigned char *ret
 		usleep(1000); // 1000us
 #endif
 	}
-	delete rx_data;
+	metrics_.record_timeout(funcode);
+	return UXBUS_STATE::ERR_TOUT;
+}
+
+int UxbusCmdTcp::recv_frame(int trans_id, unsigned char *frame, int *len, int timeout) {
+	unsigned char rx_data[RX_MAXLEN_];
+	if (arm_port_->que_maxlen_ > RX_MAXLEN_) { return UXBUS_STATE::ERR_LENG; }
+
+	int times = timeout;
+	while (true) {
+		if (take_reply_(trans_id, rx_data) != -1) {
+			*len = bin8_to_32(rx_data);
+			if (*len > MAX_FRAME_LEN || *len > arm_port_->que_maxlen_ - 4) {
+				metrics_.record_reply(rx_data[10], latency_(trans_id), *len, UXBUS_STATE::ERR_LENG);
+				return UXBUS_STATE::ERR_LENG;
+			}
+			memcpy(frame, &rx_data[4], *len);
+			// the relayed replies are checked by their requester, the check only feeds the counters
+			metrics_.record_reply(rx_data[10], latency_(trans_id), *len, check_xbus_prot(rx_data, rx_data[10]));
+			return 0;
+		}
+		if (times <= 0) { break; }
+		times -= 1;
+#ifdef _WIN32
+		Sleep(1); // 1 ms
+#else
+		usleep(1000); // 1000us
+#endif
+	}
+	// a poll without wait is not a timeout, the caller waiting by polling counts its own
+	if (timeout > 0 && trans_id >= 0 && trans_id <= TX2_BUS_FLAG_MAX_) { metrics_.record_timeout(sent_funcodes_[trans_id]); }
 	return UXBUS_STATE::ERR_TOUT;
 }
 
 int UxbusCmdTcp::send_xbus(int funcode, unsigned char *datas, int num) {
-	int len = num + 7;
-	// unsigned char send_data[len];
-	unsigned char *send_data = new unsigned char[len];
-
-	bin16_to_8(bus_flag_, &send_data[0]);
-	bin16_to_8(prot_flag_, &send_data[2]);
-	bin16_to_8(num + 1, &send_data[4]);
-	send_data[6] = funcode;
-
-	for (int i = 0; i < num; i++) { send_data[7 + i] = datas[i]; }
-	arm_port_->flush();
-	// print_hex("send:", send_data, num + 7);
+	unsigned char send_data[UXBUS_CONF::MAX_DATA_LEN + 7];
+	int len = encode_frame(funcode, datas, num, send_data);
+	if (len < 0) { return -1; }
+	return send_frame(send_data, len);
+}
+
+int UxbusCmdTcp::encode_frame(int funcode, unsigned char *datas, int num, unsigned char *frame) {
+	if (num > UXBUS_CONF::MAX_DATA_LEN) { return -1; }
+
+	bin16_to_8(0, &frame[0]);
+	bin16_to_8(prot_flag_, &frame[2]);
+	bin16_to_8(num + 1, &frame[4]);
+	frame[6] = funcode;
+
+	for (int i = 0; i < num; i++) { frame[7 + i] = datas[i]; }
+	return num + 7;
+}
+
+int UxbusCmdTcp::send_urgent(int funcode, unsigned char *datas, int num, bool need_reply) {
+	XARM_TRACE_SCOPE_ARG("send_urgent", funcode);
+	unsigned char send_data[UXBUS_CONF::MAX_DATA_LEN + 7];
+	int len = encode_frame(funcode, datas, num, send_data);
+	if (len < 0) { return -1; }
+
+	// ahead of the writers waiting on queue_mutex_
+	std::unique_lock<std::mutex> next_locker(next_mutex_);
+	std::lock_guard<std::mutex> locker(tx_mutex_);
+	next_locker.unlock();
+	int trans_id = bus_flag_;
+	if (!need_reply) {
+		// registered before the write, the reply may come before this returns
+		std::lock_guard<std::mutex> rx_locker(rx_mutex_);
+		long long now = CommandMetrics::now_us();
+		int slot = 0;
+		for (int i = 0; i < DISCARD_NUM_; i++) {
+			// a free or expired slot, else the oldest
+			if (discard_ids_[i] < 0 || now - discard_us_[i] > DISCARD_AGE_US) {
+				slot = i;
+				break;
+			}
+			if (discard_us_[i] < discard_us_[slot]) { slot = i; }
+		}
+		discard_ids_[slot] = trans_id;
+		discard_us_[slot] = now;
+	}
+	bin16_to_8(trans_id, &send_data[0]);
+	sent_us_[trans_id] = CommandMetrics::now_us();
+	sent_funcodes_[trans_id] = funcode;
 	int ret = arm_port_->write_frame(send_data, len);
-	delete send_data;
+	if (ret != len) {
+		// the id is used again by the next request
+		if (!need_reply) {
+			std::lock_guard<std::mutex> rx_locker(rx_mutex_);
+			for (int i = 0; i < DISCARD_NUM_; i++) {
+				if (discard_ids_[i] == trans_id) { discard_ids_[i] = -1; }
+			}
+		}
+		return -1;
+	}
+	metrics_.record_send(funcode, len);
+
+	bus_flag_ += 1;
+	if (bus_flag_ > TX2_BUS_FLAG_MAX_) { bus_flag_ = TX2_BUS_FLAG_MIN_; }
+
+	return trans_id;
+}
+
+int UxbusCmdTcp::send_frame(unsigned char *frame, int len) {
+	XARM_TRACE_SCOPE_ARG("send_frame", frame[6]);
+	// an urgent request takes next_mutex_ before the writers queued behind this one
+	std::lock_guard<std::mutex> queue_locker(queue_mutex_);
+	std::unique_lock<std::mutex> next_locker(next_mutex_);
+	// the id and the write are atomic, so the replies can be routed by id whatever the caller thread
+	std::lock_guard<std::mutex> locker(tx_mutex_);
+	next_locker.unlock();
+	int trans_id = bus_flag_;
+	bin16_to_8(trans_id, &frame[0]);
+	XARM_LOG_HEX("send:", frame, len);
+	sent_us_[trans_id] = CommandMetrics::now_us();
+	sent_funcodes_[trans_id] = frame[6];
+	int ret = arm_port_->write_frame(frame, len);
 	if (ret != len) { return -1; }
+	metrics_.record_send(frame[6], len);
 
 	bus_flag_ += 1;
 	if (bus_flag_ > TX2_BUS_FLAG_MAX_) { bus_flag_ = TX2_BUS_FLAG_MIN_; }
 
-	return 0;
+	return trans_id;
 }
 
 void UxbusCmdTcp::close(void) { arm_port_->close_port(); }
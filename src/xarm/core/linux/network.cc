@@ -18,10 +18,18 @@
 #include<ws2tcpip.h>
 #else
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/select.h>
 #include <arpa/inet.h>
 #include <net/if.h>
 #include <netinet/tcp.h>
 #include <sys/ioctl.h>
+#include <sys/un.h>
+#include <sys/socket.h>
+#include <time.h>
+#ifdef __linux__
+#include <linux/net_tstamp.h>
+#endif
 #endif
 
 #ifdef _WIN32
@@ -98,15 +106,44 @@ int socket_init(char *local_ip, int port, int is_server) {
 	return sockfd;
 }
 
-int socket_connect_server(int *socket, char server_ip[], int server_port) {
+int socket_connect_server(int *socket, char server_ip[], int server_port, int timeout_ms) {
 	struct sockaddr_in server_addr;
 	server_addr.sin_family = AF_INET;
 	server_addr.sin_port = htons(server_port);
 	//inet_aton(server_ip, &server_addr.sin_addr);
 	inet_pton(AF_INET, server_ip, &server_addr.sin_addr);
 	//InetPton(AF_INET, server_ip, &server_addr.sin_addr);
-	int ret =
-		connect(*socket, (struct sockaddr *)&server_addr, sizeof(server_addr));
+	if (timeout_ms <= 0) {
+		int ret =
+			connect(*socket, (struct sockaddr *)&server_addr, sizeof(server_addr));
+		PERRNO(ret, DB_FLG, "error: connect");
+		return 0;
+	}
+
+	// non-blocking connect, wait for the socket to become writable until the deadline
+	u_long mode = 1;
+	ioctlsocket(*socket, FIONBIO, &mode);
+	int ret = connect(*socket, (struct sockaddr *)&server_addr, sizeof(server_addr));
+	if (ret == SOCKET_ERROR && WSAGetLastError() == WSAEWOULDBLOCK) {
+		fd_set wset, eset;
+		FD_ZERO(&wset);
+		FD_ZERO(&eset);
+		FD_SET(*socket, &wset);
+		FD_SET(*socket, &eset);
+		struct timeval tv = { timeout_ms / 1000, (timeout_ms % 1000) * 1000 };
+		ret = select(0, NULL, &wset, &eset, &tv);
+		if (ret > 0 && FD_ISSET(*socket, &wset)) {
+			int err = 0;
+			int len = sizeof(err);
+			getsockopt(*socket, SOL_SOCKET, SO_ERROR, (char *)&err, &len);
+			ret = err == 0 ? 0 : -1;
+		}
+		else {
+			ret = -1;
+		}
+	}
+	mode = 0;
+	ioctlsocket(*socket, FIONBIO, &mode);
 	PERRNO(ret, DB_FLG, "error: connect");
 	return 0;
 }
@@ -117,6 +154,24 @@ int socket_send_data(int client_fp, unsigned char *data, int len) {
 	return ret;
 }
 
+int socket_connect_unix(char path[]) {
+	return -1;
+}
+
+int socket_set_recv_stamp(int fp, bool on) {
+	return -1;
+}
+
+int socket_recv_stamped(int fp, unsigned char *data, int len, long long *stamp_us) {
+	*stamp_us = 0;
+	return recv(fp, (char *)data, len, 0);
+}
+
+void socket_close(int fp) {
+	shutdown(fp, SD_BOTH);
+	closesocket(fp);
+}
+
 #else
 
 int socket_init(char *local_ip, int port, int is_server) {
@@ -163,13 +218,39 @@ int socket_init(char *local_ip, int port, int is_server) {
 	return sockfd;
 }
 
-int socket_connect_server(int *socket, char server_ip[], int server_port) {
+int socket_connect_server(int *socket, char server_ip[], int server_port, int timeout_ms) {
 	struct sockaddr_in server_addr;
 	server_addr.sin_family = AF_INET;
 	server_addr.sin_port = htons(server_port);
 	inet_aton(server_ip, &server_addr.sin_addr);
-	int ret =
-		connect(*socket, (struct sockaddr *)&server_addr, sizeof(server_addr));
+	if (timeout_ms <= 0) {
+		int ret =
+			connect(*socket, (struct sockaddr *)&server_addr, sizeof(server_addr));
+		PERRNO(ret, DB_FLG, "error: connect");
+		return 0;
+	}
+
+	// non-blocking connect, wait for the socket to become writable until the deadline
+	int flags = fcntl(*socket, F_GETFL, 0);
+	fcntl(*socket, F_SETFL, flags | O_NONBLOCK);
+	int ret = connect(*socket, (struct sockaddr *)&server_addr, sizeof(server_addr));
+	if (ret == -1 && errno == EINPROGRESS) {
+		fd_set wset;
+		FD_ZERO(&wset);
+		FD_SET(*socket, &wset);
+		struct timeval tv = { timeout_ms / 1000, (timeout_ms % 1000) * 1000 };
+		ret = select(*socket + 1, NULL, &wset, NULL, &tv);
+		if (ret > 0) {
+			int err = 0;
+			socklen_t len = sizeof(err);
+			getsockopt(*socket, SOL_SOCKET, SO_ERROR, (void *)&err, &len);
+			ret = err == 0 ? 0 : -1;
+		}
+		else {
+			ret = -1;
+		}
+	}
+	fcntl(*socket, F_SETFL, flags);
 	PERRNO(ret, DB_FLG, "error: connect");
 	return 0;
 }
@@ -180,4 +261,73 @@ int socket_send_data(int client_fp, unsigned char *data, int len) {
 	return ret;
 }
 
+int socket_connect_unix(char path[]) {
+	struct sockaddr_un server_addr;
+	if (strlen(path) >= sizeof(server_addr.sun_path)) { return -1; }
+	int sockfd = socket(AF_UNIX, SOCK_STREAM, 0);
+	PERRNO(sockfd, DB_FLG, "error: socket");
+	memset(&server_addr, 0, sizeof(server_addr));
+	server_addr.sun_family = AF_UNIX;
+	strcpy(server_addr.sun_path, path);
+	if (connect(sockfd, (struct sockaddr *)&server_addr, sizeof(server_addr)) == -1) {
+		close(sockfd);
+		PRINT_ERR(DB_FLG "error: connect\n");
+		return -1;
+	}
+	return sockfd;
+}
+
+int socket_set_recv_stamp(int fp, bool on) {
+#ifdef __linux__
+	int flags = on ? SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE : 0;
+	return setsockopt(fp, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) == 0 ? 0 : -1;
+#else
+	return -1;
+#endif
+}
+
+int socket_recv_stamped(int fp, unsigned char *data, int len, long long *stamp_us) {
+	*stamp_us = 0;
+#ifdef __linux__
+	struct iovec iov;
+	struct msghdr msg;
+	char control[256];
+	iov.iov_base = data;
+	iov.iov_len = len;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+	int ret = recvmsg(fp, &msg, 0);
+	if (ret <= 0) { return ret; }
+	for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_TIMESTAMPING) { continue; }
+		// struct scm_timestamping, the software stamp is the first one, on the realtime clock
+		struct timespec stamp;
+		memcpy(&stamp, CMSG_DATA(cmsg), sizeof(stamp));
+		if (stamp.tv_sec == 0 && stamp.tv_nsec == 0) { break; }
+		struct timespec real, mono;
+		clock_gettime(CLOCK_REALTIME, &real);
+		clock_gettime(CLOCK_MONOTONIC, &mono);
+		// moved to the monotonic clock by the current difference of the two clocks
+		long long real_ns = (long long)real.tv_sec * 1000000000LL + real.tv_nsec;
+		long long mono_ns = (long long)mono.tv_sec * 1000000000LL + mono.tv_nsec;
+		long long stamp_ns = (long long)stamp.tv_sec * 1000000000LL + stamp.tv_nsec;
+		long long age_ns = real_ns - stamp_ns;
+		// a stamp from the future or older than a second means the realtime clock was stepped
+		if (age_ns >= 0 && age_ns < 1000000000LL) { *stamp_us = (mono_ns - age_ns) / 1000; }
+		break;
+	}
+	return ret;
+#else
+	return recv(fp, (void *)data, len, 0);
+#endif
+}
+
+void socket_close(int fp) {
+	shutdown(fp, SHUT_RDWR);
+	close(fp);
+}
+
 #endif
@@ -5,6 +5,7 @@
  * Author: Jimy Zhang <jimy92@163.com>
  ============================================================================*/
 #include <string.h>
+#include <chrono>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -17,33 +18,74 @@
 #include "xarm/core/port/socket.h"
 #include "xarm/core/linux/network.h"
 #include "xarm/core/linux/thread.h"
+#include "xarm/core/debug/logger.h"
+#include "xarm/core/debug/trace.h"
+
+// the time base of the arrival stamps, the one of get_steady_time_us
+static long long recv_time_us_(void) {
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int SocketPort::recv_(int fp, unsigned char *data, int len, long long *recv_us) {
+	long long stamp_us = 0;
+	int num = recv_stamp_ ? socket_recv_stamped(fp, data, len, &stamp_us) : recv(fp, (char *)data, len, 0);
+	*recv_us = stamp_us > 0 ? stamp_us : recv_time_us_();
+	kernel_stamped_ = stamp_us > 0;
+	return num;
+}
 
 void SocketPort::recv_proc(void) {
 
 	int num;
+	int fp = fp_;
+	int frame_len;
+	long long recv_us;
+	int pending = 0;
+	int stream_size = que_maxlen_ * 2;
 	// unsigned char recv_data[que_maxlen_];
 	unsigned char *recv_data = new unsigned char[que_maxlen_];
+	unsigned char *stream_data = new unsigned char[stream_size];
 	while (state_ == 0) {
-	//bzero(recv_data, que_maxlen_); // 
-	memset(recv_data, 0, que_maxlen_);
-	// num = recv(fp_, (void *)&recv_data[4], que_maxlen_ - 1, 0);
-	num = recv(fp_, (char *)&recv_data[4], que_maxlen_ - 1, 0);
-	if (num <= 0) {
-		// close(fp_);
-		close_port();
-		printf("SocketPort::recv_proc exit, %d\n", fp_);
-		// pthread_exit(0);
-	}
-	bin32_to_8(num, &recv_data[0]);
-	rx_que_->push(recv_data);
+		if (!uxbus_framing_) {
+			memset(recv_data, 0, que_maxlen_);
+			num = recv_(fp, &recv_data[4], que_maxlen_ - 4, &recv_us);
+			if (num <= 0) { break; }
+			XARM_TRACE_SCOPE("socket_recv");
+			bin32_to_8(num, &recv_data[0]);
+			if (rx_que_->push(recv_data, recv_us) != 0) { drop_num_ += 1; }
+			continue;
+		}
+
+		// [num u16][prot u16][len u16][len bytes]
+		num = recv_(fp, &stream_data[pending], stream_size - pending, &recv_us);
+		if (num <= 0) { break; }
+		XARM_TRACE_SCOPE("socket_recv");
+		pending += num;
+		while (pending >= 6) {
+			frame_len = bin8_to_16(&stream_data[4]) + 6;
+			if (frame_len > que_maxlen_ - 4) {
+				// not a frame boundary, drop everything and wait for the next reply
+				pending = 0;
+				break;
+			}
+			if (pending < frame_len) { break; }
+			memset(recv_data, 0, que_maxlen_);
+			memcpy(&recv_data[4], stream_data, frame_len);
+			bin32_to_8(frame_len, &recv_data[0]);
+			if (rx_que_->push(recv_data, recv_us) != 0) { drop_num_ += 1; }
+			pending -= frame_len;
+			memmove(stream_data, &stream_data[frame_len], pending);
+		}
 	}
-	delete recv_data;
-	thread_id_.join();
-
+	if (state_ == 0) { XARM_LOG_WARN("SocketPort::recv_proc exit, %d", fp); }
+	state_ = -1;
+	delete[] stream_data;
+	delete[] recv_data;
 }
 
 static void recv_proc_(void *arg) {
 	SocketPort *my_this = (SocketPort *)arg;
+	trace_set_thread_name("socket_recv");
 
 	my_this->recv_proc();
 
@@ -51,52 +93,101 @@ static void recv_proc_(void *arg) {
 }
 
 SocketPort::SocketPort(char *server_ip, int server_port, int que_num,
-	int que_maxlen) {
+	int que_maxlen, int conn_timeout_ms) {
+	server_ip_ = server_ip;
+	server_port_ = server_port;
 	que_num_ = que_num;
 	que_maxlen_ = que_maxlen;
+	fp_ = -1;
 	state_ = -1;
+	uxbus_framing_ = false;
+	drop_num_ = 0;
+	recv_stamp_ = false;
+	kernel_stamped_ = false;
 	rx_que_ = new QueueMemcpy(que_num_, que_maxlen_);
-	fp_ = socket_init((char *)" ", 0, 0);
-	if (fp_ == -1) { return; }
+	connect_server_(conn_timeout_ms);
+}
 
-	int ret = socket_connect_server(&fp_, server_ip, server_port);
-	if (ret == -1) { return; }
+SocketPort::~SocketPort(void) {
+	close_port();
+	delete rx_que_;
+}
 
-	state_ = 0;
+int SocketPort::connect_server_(int conn_timeout_ms) {
+	int fp;
+	if (server_ip_.compare(0, 5, "unix:") == 0) {
+		fp = socket_connect_unix((char *)server_ip_.substr(5).c_str());
+		if (fp == -1) { return -1; }
+	}
+	else {
+		fp = socket_init((char *)" ", 0, 0);
+		if (fp == -1) { return -1; }
+
+		int ret = socket_connect_server(&fp, (char *)server_ip_.data(), server_port_, conn_timeout_ms);
+		if (ret == -1) {
+			socket_close(fp);
+			return -1;
+		}
+	}
+
+	if (recv_stamp_) { socket_set_recv_stamp(fp, true); }
+
+	std::lock_guard<std::mutex> locker(mutex_);
+	fp_ = fp;
 	flush();
+	state_ = 0;
 	thread_id_ = std::thread(recv_proc_, this);
-	thread_id_.detach();
+	return 0;
 }
 
-SocketPort::~SocketPort(void) {
-	state_ = -1;
-	delete rx_que_;
+int SocketPort::reconnect(int conn_timeout_ms) {
+	close_port();
+	return connect_server_(conn_timeout_ms);
 }
 
 int SocketPort::is_ok(void) { return state_; }
 
+void SocketPort::set_uxbus_framing(bool on) { uxbus_framing_ = on; }
+
 void SocketPort::flush(void) { rx_que_->flush(); }
 
-int SocketPort::read_frame(unsigned char *data) {
+long long SocketPort::get_drop_num(void) { return drop_num_; }
+
+int SocketPort::set_recv_stamp(bool on) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	int ret = fp_ == -1 ? 0 : socket_set_recv_stamp(fp_, on);
+	if (ret != 0) { return -1; }
+	recv_stamp_ = on;
+	return 0;
+}
+
+bool SocketPort::is_kernel_stamped(void) { return kernel_stamped_; }
+
+int SocketPort::read_frame(unsigned char *data, long long *recv_us) {
 	if (state_ != 0) { return -1; }
 
 	if (rx_que_->size() == 0) { return -1; }
 
-	rx_que_->pop(data);
+	rx_que_->pop(data, recv_us);
 	return 0;
 }
 
 int SocketPort::write_frame(unsigned char *data, int len) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	if (fp_ == -1) { return -1; }
 	int ret = socket_send_data(fp_, data, len);
 	return ret;
 }
 
 void SocketPort::close_port(void) {
-#ifdef _WIN32
-	closesocket(fp_);
-#else
-	close(fp_);
-#endif
+	std::lock_guard<std::mutex> locker(mutex_);
 	state_ = -1;
-	delete rx_que_;
+	if (fp_ != -1) {
+		socket_close(fp_);
+		fp_ = -1;
+	}
+	// the receive thread exits as soon as the socket is shut down
+	if (thread_id_.joinable() && thread_id_.get_id() != std::this_thread::get_id()) {
+		thread_id_.join();
+	}
 }
@@ -0,0 +1,226 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+#include <string.h>
+#include "xarm/wrapper/arm_group.h"
+
+static const long long MIN_REPORT_PERIOD_US = 4000; // 250Hz, the fastest report, until the period is measured
+
+ArmGroup::ArmGroup(void) {
+	arm_num_ = 0;
+	for (int i = 0; i < MAX_ARMS; i++) {
+		arms_[i] = NULL;
+		staged_[i].funcode = 0;
+		send_us_[i] = 0;
+	}
+	reset_skew_stats();
+}
+
+ArmGroup::~ArmGroup(void) {}
+
+int ArmGroup::add_arm(XArmAPI *arm) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	if (arm == NULL || arm_num_ >= MAX_ARMS) return UXBUS_STATE::ERR_PARAM;
+	arms_[arm_num_] = arm;
+	return arm_num_++;
+}
+
+int ArmGroup::get_arm_num(void) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	return arm_num_;
+}
+
+int ArmGroup::stage_position(int index, fp32 pose[6], fp32 speed, fp32 acc, fp32 mvtime) {
+	return _stage(index, UXBUS_RG::MOVE_LINE, pose, speed, acc, mvtime);
+}
+
+int ArmGroup::stage_servo_angle(int index, fp32 angles[7], fp32 speed, fp32 acc, fp32 mvtime) {
+	return _stage(index, UXBUS_RG::MOVE_JOINT, angles, speed, acc, mvtime);
+}
+
+int ArmGroup::stage_servo_angle_j(int index, fp32 angles[7], fp32 speed, fp32 acc, fp32 mvtime) {
+	return _stage(index, UXBUS_RG::MOVE_SERVOJ, angles, speed, acc, mvtime);
+}
+
+void ArmGroup::clear_staged(void) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	for (int i = 0; i < MAX_ARMS; i++) staged_[i].funcode = 0;
+}
+
+int ArmGroup::release(long long at, int *rets) {
+	Staged staged[MAX_ARMS];
+	XArmAPI *arms[MAX_ARMS];
+	int arm_num = 0;
+	{
+		std::lock_guard<std::mutex> locker(mutex_);
+		bool has_staged = false;
+		for (int i = 0; i < arm_num_; i++) {
+			if (staged_[i].funcode == 0) continue;
+			if (!arms_[i]->is_connected()) return -1;
+			has_staged = true;
+		}
+		if (!has_staged) return -1;
+		arm_num = arm_num_;
+		for (int i = 0; i < arm_num; i++) {
+			arms[i] = arms_[i];
+			staged[i].funcode = staged_[i].funcode;
+			if (staged[i].funcode == 0) continue;
+			memcpy(staged[i].frame, staged_[i].frame, staged_[i].len);
+			staged[i].len = staged_[i].len;
+			staged_[i].funcode = 0;
+		}
+	}
+	if (at > 0) {
+		long long now = get_steady_time_us();
+		if (at - now > 1000) sleep_milliseconds((unsigned long)((at - now) / 1000 - 1));
+		// the wake up of a sleep is late by up to a scheduler tick, the last millisecond is spun
+		while (get_steady_time_us() < at) std::this_thread::yield();
+	}
+	int trans_ids[MAX_ARMS];
+	long long send_us[MAX_ARMS];
+	for (int i = 0; i < arm_num; i++) {
+		trans_ids[i] = -1;
+		send_us[i] = 0;
+		if (staged[i].funcode == 0) continue;
+		// the report may have gone stale since staged, a held servo setpoint is not sent
+		if (staged[i].funcode == UXBUS_RG::MOVE_SERVOJ && arms[i]->_is_servo_held()) continue;
+		UxbusCmd *core = arms[i]->is_tcp_ ? (UxbusCmd *)arms[i]->cmd_tcp_ : (UxbusCmd *)arms[i]->cmd_ser_;
+		trans_ids[i] = core->send_frame(staged[i].frame, staged[i].len);
+		send_us[i] = get_steady_time_us();
+	}
+	// all the moves are on the way, the replies come back in parallel
+	int ret = 0;
+	long long first_us = 0, last_us = 0;
+	for (int i = 0; i < arm_num; i++) {
+		int state = UXBUS_STATE::NOT_READY;
+		if (staged[i].funcode != 0) {
+			UxbusCmd *core = arms[i]->is_tcp_ ? (UxbusCmd *)arms[i]->cmd_tcp_ : (UxbusCmd *)arms[i]->cmd_ser_;
+			if (send_us[i] == 0) state = UXBUS_STATE::REPORT_STALE;
+			else state = trans_ids[i] < 0 ? UXBUS_STATE::ERR_NOTTCP : arms[i]->_pend_move(core, staged[i].funcode, trans_ids[i]);
+			if (ret == 0) ret = state;
+			if (send_us[i] != 0 && (first_us == 0 || send_us[i] < first_us)) first_us = send_us[i];
+			if (send_us[i] > last_us) last_us = send_us[i];
+		}
+		if (rets != NULL) rets[i] = state;
+	}
+	std::lock_guard<std::mutex> locker(mutex_);
+	for (int i = 0; i < MAX_ARMS; i++) send_us_[i] = i < arm_num ? send_us[i] : 0;
+	_add_skew(&send_skew_, last_us - first_us);
+	return ret;
+}
+
+int ArmGroup::wait_motion_start(fp32 timeout, long long *starts) {
+	XArmAPI *arms[MAX_ARMS];
+	long long send_us[MAX_ARMS], start_us[MAX_ARMS];
+	int arm_num = 0;
+	bool released = false;
+	{
+		std::lock_guard<std::mutex> locker(mutex_);
+		arm_num = arm_num_;
+		for (int i = 0; i < arm_num; i++) {
+			arms[i] = arms_[i];
+			send_us[i] = send_us_[i];
+			start_us[i] = 0;
+			if (send_us[i] != 0) released = true;
+		}
+	}
+	if (!released) return -1;
+	// the starts are the times of the reports, not of the wake ups: half of the shortest report period
+	//   of the arms only delays the return
+	long long period_us = 0;
+	for (int i = 0; i < arm_num; i++) {
+		if (send_us[i] == 0) continue;
+		ClockEstimate estimate;
+		arms[i]->get_clock_estimate(&estimate);
+		long long arm_period_us = estimate.valid ? (long long)estimate.period_us : MIN_REPORT_PERIOD_US;
+		if (period_us == 0 || arm_period_us < period_us) period_us = arm_period_us;
+	}
+	long long begin = get_steady_time_us();
+	int ret = 0;
+	while (true) {
+		bool done = true;
+		for (int i = 0; i < arm_num; i++) {
+			if (send_us[i] == 0 || start_us[i] != 0) continue;
+			// a report received before the send is the start of an older move
+			long long t = arms[i]->move_start_us_;
+			if (t >= send_us[i]) start_us[i] = t;
+			else done = false;
+		}
+		if (done) break;
+		if (timeout > 0 && get_steady_time_us() - begin > (long long)(timeout * 1000000)) {
+			ret = UXBUS_STATE::ERR_TOUT;
+			break;
+		}
+		std::this_thread::sleep_for(std::chrono::microseconds(period_us / 2));
+	}
+	if (starts != NULL) {
+		for (int i = 0; i < MAX_ARMS; i++) starts[i] = i < arm_num ? start_us[i] : 0;
+	}
+	if (ret != 0) return ret;
+	long long first_us = 0, last_us = 0;
+	for (int i = 0; i < arm_num; i++) {
+		if (start_us[i] == 0) continue;
+		if (first_us == 0 || start_us[i] < first_us) first_us = start_us[i];
+		if (start_us[i] > last_us) last_us = start_us[i];
+	}
+	std::lock_guard<std::mutex> locker(mutex_);
+	_add_skew(&start_skew_, last_us - first_us);
+	return 0;
+}
+
+long long ArmGroup::get_send_time(int index) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	if (index < 0 || index >= arm_num_) return 0;
+	return send_us_[index];
+}
+
+long long ArmGroup::get_report_time(int index) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	if (index < 0 || index >= arm_num_) return 0;
+	return arms_[index]->last_report_us_;
+}
+
+void ArmGroup::get_skew_stats(SkewStats *send, SkewStats *start) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	if (send != NULL) *send = send_skew_;
+	if (start != NULL) *start = start_skew_;
+}
+
+void ArmGroup::reset_skew_stats(void) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	memset(&send_skew_, 0, sizeof(send_skew_));
+	memset(&start_skew_, 0, sizeof(start_skew_));
+}
+
+int ArmGroup::_stage(int index, int funcode, fp32 *target, fp32 speed, fp32 acc, fp32 mvtime) {
+	XArmAPI *arm = NULL;
+	{
+		std::lock_guard<std::mutex> locker(mutex_);
+		if (index < 0 || index >= arm_num_) return UXBUS_STATE::ERR_PARAM;
+		arm = arms_[index];
+	}
+	if (!arm->is_connected()) return -1;
+	unsigned char frame[UxbusCmd::MAX_FRAME_LEN];
+	int len = 0;
+	int ret = arm->_encode_move(funcode, target, speed, acc, mvtime, frame, &len);
+	if (ret != 0) return ret;
+	if (len <= 0) return UXBUS_STATE::ERR_NOTTCP;
+	std::lock_guard<std::mutex> locker(mutex_);
+	Staged &staged = staged_[index];
+	memcpy(staged.frame, frame, len);
+	staged.len = len;
+	staged.funcode = funcode;
+	return 0;
+}
+
+void ArmGroup::_add_skew(SkewStats *stats, long long skew) {
+	stats->count += 1;
+	stats->last = skew;
+	if (skew > stats->max) stats->max = skew;
+	stats->mean += (skew - stats->mean) / stats->count;
+}
@@ -0,0 +1,371 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+#include <cmath>
+#include <algorithm>
+#include "xarm/core/instruction/uxbus_cmd_config.h"
+#include "xarm/wrapper/collision_checker.h"
+
+static const double PI = 3.14159265358979323846;
+static const int OBSTACLE_CAPSULE = 0; // a sphere is a capsule with both ends at the center
+static const int OBSTACLE_BOX = 1;
+static const int LEAF_SIZE = 4;
+static const int STACK_SIZE = 64;
+static const float DEFAULT_RADIUS = 50;
+
+static inline float dot3(const float *a, const float *b) {
+	return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static inline float clamp01(float v) {
+	return v < 0 ? 0 : (v > 1 ? 1 : v);
+}
+
+// squared distance between the segments p0-p1 and q0-q1
+static float segment_dist2(const float *p0, const float *p1, const float *q0, const float *q1) {
+	float d1[3], d2[3], r[3];
+	for (int i = 0; i < 3; i++) {
+		d1[i] = p1[i] - p0[i];
+		d2[i] = q1[i] - q0[i];
+		r[i] = p0[i] - q0[i];
+	}
+	float a = dot3(d1, d1), e = dot3(d2, d2), f = dot3(d2, r);
+	float s, t;
+	if (a <= 1e-9f && e <= 1e-9f) {
+		s = t = 0;
+	}
+	else if (a <= 1e-9f) {
+		s = 0;
+		t = clamp01(f / e);
+	}
+	else {
+		float c = dot3(d1, r);
+		if (e <= 1e-9f) {
+			t = 0;
+			s = clamp01(-c / a);
+		}
+		else {
+			float b = dot3(d1, d2);
+			float denom = a * e - b * b;
+			s = denom > 1e-9f ? clamp01((b * f - c * e) / denom) : 0;
+			t = (b * s + f) / e;
+			if (t < 0) {
+				t = 0;
+				s = clamp01(-c / a);
+			}
+			else if (t > 1) {
+				t = 1;
+				s = clamp01((b - c) / a);
+			}
+		}
+	}
+	float dist2 = 0;
+	for (int i = 0; i < 3; i++) {
+		float d = (p0[i] + d1[i] * s) - (q0[i] + d2[i] * t);
+		dist2 += d * d;
+	}
+	return dist2;
+}
+
+static inline float box_dist2(const float *p, const float *min, const float *max) {
+	float dist2 = 0;
+	for (int i = 0; i < 3; i++) {
+		float d = p[i] < min[i] ? min[i] - p[i] : (p[i] > max[i] ? p[i] - max[i] : 0);
+		dist2 += d * d;
+	}
+	return dist2;
+}
+
+// squared distance between the segment p0-p1 and a box, the distance to a box is convex along the segment
+static float segment_box_dist2(const float *p0, const float *p1, const float *min, const float *max) {
+	float lo = 0, hi = 1, p[3];
+	for (int n = 0; n < 24; n++) {
+		float m1 = lo + (hi - lo) / 3, m2 = hi - (hi - lo) / 3;
+		float q[3];
+		for (int i = 0; i < 3; i++) {
+			p[i] = p0[i] + (p1[i] - p0[i]) * m1;
+			q[i] = p0[i] + (p1[i] - p0[i]) * m2;
+		}
+		if (box_dist2(p, min, max) <= box_dist2(q, min, max)) hi = m2;
+		else lo = m1;
+	}
+	for (int i = 0; i < 3; i++) p[i] = p0[i] + (p1[i] - p0[i]) * (lo + hi) / 2;
+	return box_dist2(p, min, max);
+}
+
+CollisionChecker::CollisionChecker(int axis) {
+	tool_length_ = 0;
+	tool_radius_ = 0;
+	for (int i = 0; i < MAX_LINKS; i++) user_radius_[i] = -1;
+	set_axis(axis);
+}
+
+void CollisionChecker::set_axis(int axis) {
+	// standard DH parameters {theta offset, d, alpha, a}
+	static const double XARM7_DH[7][4] = {
+		{ 0, 267, -PI / 2, 0 },
+		{ 0, 0, PI / 2, 0 },
+		{ 0, 293, PI / 2, 52.5 },
+		{ 0, 0, PI / 2, 77.5 },
+		{ 0, 342.5, PI / 2, 0 },
+		{ 0, 0, -PI / 2, 76 },
+		{ 0, 97, 0, 0 }
+	};
+	static const double XARM6_DH[6][4] = {
+		{ 0, 267, -PI / 2, 0 },
+		{ -1.3849179, 0, 0, 289.48866 },
+		{ 1.3849179, 0, -PI / 2, 77.5 },
+		{ 0, 342.5, PI / 2, 0 },
+		{ 0, 0, -PI / 2, 76 },
+		{ 0, 97, 0, 0 }
+	};
+	static const double XARM5_DH[5][4] = {
+		{ 0, 267, -PI / 2, 0 },
+		{ -1.3849179, 0, 0, 289.48866 },
+		{ 2.7331843, 0, 0, 351.158796 },
+		{ -1.3482664, 0, -PI / 2, 76 },
+		{ 0, 97, 0, 0 }
+	};
+	std::lock_guard<std::mutex> locker(mutex_);
+	axis_ = (axis == 5 || axis == 6) ? axis : 7;
+	const double (*dh)[4] = axis_ == 5 ? XARM5_DH : (axis_ == 6 ? XARM6_DH : XARM7_DH);
+	link_num_ = 0;
+	for (int i = 0; i < axis_; i++) {
+		for (int j = 0; j < 4; j++) dh_[i][j] = dh[i][j];
+		// the joints with a common origin make one link
+		if (sqrt(dh_[i][1] * dh_[i][1] + dh_[i][3] * dh_[i][3]) > 1e-3) link_frame_[link_num_++] = i;
+	}
+	// the tool
+	link_frame_[link_num_++] = axis_;
+	for (int i = 0; i < MAX_LINKS; i++) link_radius_[i] = user_radius_[i] >= 0 ? user_radius_[i] : DEFAULT_RADIUS;
+	link_radius_[link_num_ - 1] = tool_radius_;
+}
+
+int CollisionChecker::get_axis(void) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	return axis_;
+}
+
+void CollisionChecker::set_link_radius(int link, float radius) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	if (link < 0 || link >= link_num_) return;
+	if (link == link_num_ - 1) {
+		tool_radius_ = radius > 0 ? radius : 0;
+		link_radius_[link] = tool_radius_;
+		return;
+	}
+	// kept by the index of the link when the axis changes
+	user_radius_[link] = radius < 0 ? -1 : radius;
+	link_radius_[link] = radius < 0 ? DEFAULT_RADIUS : radius;
+}
+
+int CollisionChecker::get_link_num(void) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	return link_num_;
+}
+
+void CollisionChecker::set_tool(float length, float radius) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	tool_length_ = length > 0 ? length : 0;
+	tool_radius_ = radius > 0 ? radius : 0;
+	link_radius_[link_num_ - 1] = tool_radius_;
+}
+
+int CollisionChecker::add_sphere(const float center[3], float radius) {
+	return add_capsule(center, center, radius);
+}
+
+int CollisionChecker::add_capsule(const float p0[3], const float p1[3], float radius) {
+	Obstacle obs;
+	obs.type = OBSTACLE_CAPSULE;
+	obs.radius = radius > 0 ? radius : 0;
+	for (int i = 0; i < 3; i++) {
+		obs.p0[i] = p0[i];
+		obs.p1[i] = p1[i];
+		obs.min[i] = std::min(p0[i], p1[i]) - obs.radius;
+		obs.max[i] = std::max(p0[i], p1[i]) + obs.radius;
+	}
+	std::lock_guard<std::mutex> locker(mutex_);
+	obstacles_.push_back(obs);
+	_build();
+	return 0;
+}
+
+int CollisionChecker::add_box(const float min[3], const float max[3]) {
+	Obstacle obs;
+	obs.type = OBSTACLE_BOX;
+	obs.radius = 0;
+	for (int i = 0; i < 3; i++) {
+		obs.min[i] = obs.p0[i] = std::min(min[i], max[i]);
+		obs.max[i] = obs.p1[i] = std::max(min[i], max[i]);
+	}
+	std::lock_guard<std::mutex> locker(mutex_);
+	obstacles_.push_back(obs);
+	_build();
+	return 0;
+}
+
+void CollisionChecker::clear_obstacles(void) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	obstacles_.clear();
+	nodes_.clear();
+}
+
+int CollisionChecker::get_obstacle_num(void) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	return (int)obstacles_.size();
+}
+
+// top-down, split at the median of the longest axis of the node
+int CollisionChecker::_build_node(int first, int count) {
+	int index = (int)nodes_.size();
+	nodes_.push_back(Node());
+	Node node;
+	for (int i = 0; i < 3; i++) {
+		node.min[i] = obstacles_[first].min[i];
+		node.max[i] = obstacles_[first].max[i];
+	}
+	for (int n = first + 1; n < first + count; n++) {
+		for (int i = 0; i < 3; i++) {
+			node.min[i] = std::min(node.min[i], obstacles_[n].min[i]);
+			node.max[i] = std::max(node.max[i], obstacles_[n].max[i]);
+		}
+	}
+	if (count <= LEAF_SIZE) {
+		node.first = first;
+		node.count = count;
+		nodes_[index] = node;
+		return index;
+	}
+	int axis = 0;
+	for (int i = 1; i < 3; i++) {
+		if (node.max[i] - node.min[i] > node.max[axis] - node.min[axis]) axis = i;
+	}
+	int half = count / 2;
+	std::nth_element(obstacles_.begin() + first, obstacles_.begin() + first + half, obstacles_.begin() + first + count,
+		[axis](const Obstacle &a, const Obstacle &b) { return a.min[axis] + a.max[axis] < b.min[axis] + b.max[axis]; });
+	_build_node(first, half);
+	node.first = _build_node(first + half, count - half);
+	node.count = 0;
+	nodes_[index] = node;
+	return index;
+}
+
+void CollisionChecker::_build(void) {
+	nodes_.clear();
+	if (!obstacles_.empty()) _build_node(0, (int)obstacles_.size());
+}
+
+bool CollisionChecker::_hit_obstacles(const float *p0, const float *p1, float radius) {
+	if (nodes_.empty()) return false;
+	float min[3], max[3];
+	for (int i = 0; i < 3; i++) {
+		min[i] = std::min(p0[i], p1[i]) - radius;
+		max[i] = std::max(p0[i], p1[i]) + radius;
+	}
+	int stack[STACK_SIZE];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		int index = stack[--top];
+		const Node &node = nodes_[index];
+		if (node.min[0] > max[0] || node.max[0] < min[0] || node.min[1] > max[1] || node.max[1] < min[1]
+			|| node.min[2] > max[2] || node.max[2] < min[2]) continue;
+		if (node.count == 0) {
+			// the tree is balanced, its depth is far below the stack size
+			if (top + 2 > STACK_SIZE) return true;
+			stack[top++] = node.first;
+			stack[top++] = index + 1;
+			continue;
+		}
+		for (int n = node.first; n < node.first + node.count; n++) {
+			const Obstacle &obs = obstacles_[n];
+			float r = radius + obs.radius;
+			float dist2 = obs.type == OBSTACLE_BOX ? segment_box_dist2(p0, p1, obs.min, obs.max) : segment_dist2(p0, p1, obs.p0, obs.p1);
+			if (dist2 < r * r) return true;
+		}
+	}
+	return false;
+}
+
+int CollisionChecker::forward(const float angles[7], float points[][3]) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	return _forward(angles, points);
+}
+
+int CollisionChecker::_forward(const float angles[7], float points[][3]) {
+	double t[3][4] = { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 } };
+	double origin[8][3];
+	origin[0][0] = origin[0][1] = origin[0][2] = 0;
+	for (int i = 0; i < axis_; i++) {
+		double theta = angles[i] + dh_[i][0], d = dh_[i][1], alpha = dh_[i][2], a = dh_[i][3];
+		double ct = cos(theta), st = sin(theta), ca = cos(alpha), sa = sin(alpha);
+		double m[3][4] = {
+			{ ct, -st * ca, st * sa, a * ct },
+			{ st, ct * ca, -ct * sa, a * st },
+			{ 0, sa, ca, d }
+		};
+		double r[3][4];
+		for (int row = 0; row < 3; row++) {
+			for (int col = 0; col < 4; col++) {
+				r[row][col] = t[row][0] * m[0][col] + t[row][1] * m[1][col] + t[row][2] * m[2][col] + (col == 3 ? t[row][3] : 0);
+			}
+		}
+		for (int row = 0; row < 3; row++) {
+			for (int col = 0; col < 4; col++) t[row][col] = r[row][col];
+			origin[i + 1][row] = t[row][3];
+		}
+	}
+	if (points != NULL) {
+		for (int l = 0; l < link_num_; l++) {
+			for (int k = 0; k < 3; k++) points[l][k] = (float)origin[link_frame_[l]][k];
+		}
+		// the tool goes along the z axis of the flange
+		for (int k = 0; k < 3; k++) points[link_num_][k] = (float)(origin[axis_][k] + t[k][2] * tool_length_);
+	}
+	return link_num_;
+}
+
+int CollisionChecker::check(const float angles[7]) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	return _check(angles);
+}
+
+int CollisionChecker::_check(const float angles[7]) {
+	float points[MAX_LINKS + 1][3];
+	_forward(angles, points);
+	// the base link starts one radius above the mounting plane, so the table under the arm is not hit
+	points[0][2] = std::min(link_radius_[0], points[1][2]);
+	// link l goes from points[l] to points[l + 1]
+	int num = tool_length_ > 0 ? link_num_ : link_num_ - 1;
+	for (int i = 0; i < num; i++) {
+		for (int j = i + 3; j < num; j++) {
+			float r = link_radius_[i] + link_radius_[j];
+			if (segment_dist2(points[i], points[i + 1], points[j], points[j + 1]) < r * r) return UXBUS_STATE::COLLISION;
+		}
+	}
+	for (int i = 0; i < num; i++) {
+		if (_hit_obstacles(points[i], points[i + 1], link_radius_[i])) return UXBUS_STATE::COLLISION;
+	}
+	return 0;
+}
+
+int CollisionChecker::check_path(const float from[7], const float to[7], float step) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	float max_move = 0;
+	for (int i = 0; i < axis_; i++) max_move = std::max(max_move, (float)fabs(to[i] - from[i]));
+	int num = step > 0 ? (int)ceil(max_move / step) : 1;
+	if (num < 1) num = 1;
+	float angles[7] = { 0 };
+	for (int n = 0; n <= num; n++) {
+		for (int i = 0; i < axis_; i++) angles[i] = from[i] + (to[i] - from[i]) * n / num;
+		int ret = _check(angles);
+		if (ret != 0) return ret;
+	}
+	return 0;
+}
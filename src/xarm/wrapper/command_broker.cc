@@ -0,0 +1,286 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+#include <string.h>
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+#include "xarm/wrapper/command_broker.h"
+
+CommandBroker::CommandBroker(XArmAPI *arm) {
+	arm_ = arm;
+	listen_fd_ = -1;
+	is_running_ = false;
+	default_priority_ = 100;
+	for (int i = 0; i < MAX_CLIENTS; i++) {
+		clients_[i].fd = -1;
+		clients_[i].gen = 0;
+	}
+	client_num_ = 0;
+	queue_num_ = 0;
+	queue_seq_ = 0;
+	in_flight_num_ = 0;
+	request_num_ = 0;
+	drop_num_ = 0;
+}
+
+CommandBroker::~CommandBroker(void) {
+	stop();
+}
+
+int CommandBroker::start(const std::string &path) {
+#ifdef _WIN32
+	return -1;
+#else
+	if (!arm_->is_connected() || !arm_->is_tcp_) return -1;
+	if (is_running_) return 0;
+	if (thread_.joinable()) thread_.join();
+	struct sockaddr_un addr;
+	if (path.size() >= sizeof(addr.sun_path)) return -2;
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) return -2;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path.c_str());
+	unlink(path.c_str());
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, MAX_CLIENTS) != 0) {
+		close(fd);
+		return -2;
+	}
+	path_ = path;
+	listen_fd_ = fd;
+	queue_num_ = 0;
+	in_flight_num_ = 0;
+	is_running_ = true;
+	thread_ = std::thread(&CommandBroker::_loop, this);
+	return 0;
+#endif
+}
+
+void CommandBroker::stop(void) {
+	is_running_ = false;
+	if (thread_.joinable()) thread_.join();
+#ifndef _WIN32
+	if (listen_fd_ >= 0) {
+		close(listen_fd_);
+		listen_fd_ = -1;
+		unlink(path_.c_str());
+	}
+	for (int i = 0; i < MAX_CLIENTS; i++) {
+		if (clients_[i].fd >= 0) _close_client(i);
+	}
+#endif
+}
+
+bool CommandBroker::is_running(void) {
+	return is_running_;
+}
+
+void CommandBroker::set_default_priority(int priority) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	default_priority_ = priority < 0 ? 0 : priority > 255 ? 255 : priority;
+}
+
+int CommandBroker::get_client_num(void) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	return client_num_;
+}
+
+long long CommandBroker::get_request_num(void) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	return request_num_;
+}
+
+long long CommandBroker::get_drop_num(void) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	return drop_num_;
+}
+
+#ifndef _WIN32
+void CommandBroker::_accept(void) {
+	int fd = accept(listen_fd_, NULL, NULL);
+	if (fd < 0) return;
+	// the replies are not waited for, a client not reading its socket is closed (see _collect)
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+	std::lock_guard<std::mutex> locker(mutex_);
+	for (int i = 0; i < MAX_CLIENTS; i++) {
+		if (clients_[i].fd >= 0) continue;
+		clients_[i].fd = fd;
+		clients_[i].gen += 1;
+		clients_[i].priority = default_priority_;
+		clients_[i].pending = 0;
+		client_num_ += 1;
+		return;
+	}
+	close(fd);
+}
+
+void CommandBroker::_close_client(int client) {
+	close(clients_[client].fd);
+	std::lock_guard<std::mutex> locker(mutex_);
+	clients_[client].fd = -1;
+	client_num_ -= 1;
+	// the queued requests of the client are not sent, the ones in flight are collected and dropped
+	int n = 0;
+	for (int i = 0; i < queue_num_; i++) {
+		if (queue_[i].client != client) queue_[n++] = queue_[i];
+	}
+	queue_num_ = n;
+}
+
+bool CommandBroker::_recv(int client) {
+	Client &c = clients_[client];
+	int num = recv(c.fd, (char *)&c.buf[c.pending], sizeof(c.buf) - c.pending, 0);
+	if (num < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) return true;
+	if (num <= 0) return false;
+	c.pending += num;
+	// [trans id u16][prot u16][len u16][len bytes], the framing of the control port
+	while (c.pending >= 6) {
+		int len = bin8_to_16(&c.buf[4]) + 6;
+		if (len > UxbusCmd::MAX_FRAME_LEN) return false; // not a client of this protocol
+		if (c.pending < len) break;
+		int prot = bin8_to_16(&c.buf[2]);
+		if (prot == PROT_BROKER) {
+			if (c.buf[6] == SET_PRIORITY && len > 7) c.priority = c.buf[7];
+		}
+		else if (queue_num_ < MAX_QUEUED) {
+			Request &req = queue_[queue_num_++];
+			req.client = client;
+			req.gen = c.gen;
+			bool urgent = c.buf[6] == UXBUS_RG::SET_STATE && len > 7 && (c.buf[7] == 3 || c.buf[7] == 4);
+			req.priority = urgent ? URGENT_PRIORITY : c.priority;
+			req.seq = queue_seq_++;
+			req.client_trans_id = bin8_to_16(c.buf);
+			memcpy(req.frame, c.buf, len);
+			req.len = len;
+		}
+		else {
+			std::lock_guard<std::mutex> locker(mutex_);
+			drop_num_ += 1;
+		}
+		c.pending -= len;
+		memmove(c.buf, &c.buf[len], c.pending);
+	}
+	return true;
+}
+
+void CommandBroker::_dispatch(UxbusCmd *core) {
+	while (queue_num_ > 0 && in_flight_num_ < MAX_IN_FLIGHT + MAX_URGENT) {
+		// the highest priority, then the oldest
+		int best = 0;
+		for (int i = 1; i < queue_num_; i++) {
+			if (queue_[i].priority > queue_[best].priority
+				|| (queue_[i].priority == queue_[best].priority && queue_[i].seq < queue_[best].seq)) best = i;
+		}
+		Request &req = queue_[best];
+		if (in_flight_num_ >= MAX_IN_FLIGHT && req.priority != URGENT_PRIORITY) break;
+		// only the transaction id is written, the frame of the client is sent as is
+		int trans_id = core->send_frame(req.frame, req.len);
+		if (trans_id >= 0) {
+			InFlight &f = in_flight_[in_flight_num_++];
+			f.client = req.client;
+			f.gen = req.gen;
+			f.client_trans_id = req.client_trans_id;
+			f.trans_id = trans_id;
+			f.funcode = req.frame[6];
+			f.time = get_system_time();
+		}
+		{
+			std::lock_guard<std::mutex> locker(mutex_);
+			if (trans_id >= 0) request_num_ += 1;
+			else drop_num_ += 1;
+		}
+		queue_[best] = queue_[--queue_num_];
+	}
+}
+
+void CommandBroker::_collect(UxbusCmd *core) {
+	unsigned char frame[UxbusCmd::MAX_FRAME_LEN];
+	long long now = get_system_time();
+	int n = 0;
+	for (int i = 0; i < in_flight_num_; i++) {
+		InFlight &f = in_flight_[i];
+		int len = 0;
+		int ret = core->recv_frame(f.trans_id, frame, &len, 0);
+		if (ret != UXBUS_STATE::ERR_TOUT) {
+			// a reply too long for the queue of the port is dropped
+			if (ret != 0) {
+				std::lock_guard<std::mutex> locker(mutex_);
+				drop_num_ += 1;
+				continue;
+			}
+			Client &c = clients_[f.client];
+			if (c.fd >= 0 && c.gen == f.gen) {
+				bin16_to_8(f.client_trans_id, frame);
+				// the socket buffer of the client is full, a part of a frame would break its stream
+				if (send(c.fd, (char *)frame, len, MSG_NOSIGNAL | MSG_DONTWAIT) != len) {
+					_close_client(f.client);
+					std::lock_guard<std::mutex> locker(mutex_);
+					drop_num_ += 1;
+				}
+			}
+			continue;
+		}
+		if (now - f.time > REPLY_TIMEOUT) {
+			// recv_frame polls without wait, the timeout is counted here
+			core->get_metrics()->record_timeout(f.funcode);
+			std::lock_guard<std::mutex> locker(mutex_);
+			drop_num_ += 1;
+			continue;
+		}
+		in_flight_[n++] = f;
+	}
+	in_flight_num_ = n;
+}
+
+void CommandBroker::_loop(void) {
+	trace_set_thread_name("command_broker");
+	UxbusCmd *core = (UxbusCmd *)arm_->cmd_tcp_;
+	struct pollfd fds[MAX_CLIENTS + 1];
+	int fd_clients[MAX_CLIENTS + 1];
+	while (is_running_) {
+		int nfds = 0;
+		fds[nfds].fd = listen_fd_;
+		fds[nfds].events = POLLIN;
+		fd_clients[nfds++] = -1;
+		for (int i = 0; i < MAX_CLIENTS; i++) {
+			if (clients_[i].fd < 0) continue;
+			fds[nfds].fd = clients_[i].fd;
+			fds[nfds].events = POLLIN;
+			fd_clients[nfds++] = i;
+		}
+		// the replies are polled like send_pend does, every millisecond while some are awaited
+		int ret = poll(fds, nfds, in_flight_num_ > 0 ? 1 : 10);
+		if (ret > 0) {
+			if (fds[0].revents & POLLIN) _accept();
+			for (int i = 1; i < nfds; i++) {
+				if (fds[i].revents == 0) continue;
+				if (!_recv(fd_clients[i])) _close_client(fd_clients[i]);
+			}
+		}
+		_dispatch(core);
+		if (in_flight_num_ > 0) {
+			_collect(core);
+			// the room made by the replies is used at once
+			_dispatch(core);
+		}
+	}
+}
+#else
+void CommandBroker::_accept(void) {}
+void CommandBroker::_close_client(int client) {}
+bool CommandBroker::_recv(int client) { return false; }
+void CommandBroker::_dispatch(UxbusCmd *core) {}
+void CommandBroker::_collect(UxbusCmd *core) {}
+void CommandBroker::_loop(void) {}
+#endif
@@ -0,0 +1,145 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+#include "xarm/core/instruction/servo3_config.h"
+#include "xarm/wrapper/gripper_poller.h"
+
+GripperPoller::GripperPoller(XArmAPI *arm) {
+	arm_ = arm;
+	sample_num_ = 0;
+	ret_ = -1;
+	pos_ = 0;
+	err_ = 0;
+	time_ = 0;
+	wait_num_ = 0;
+}
+
+GripperPoller::~GripperPoller(void) {
+	stop();
+}
+
+int GripperPoller::start(fp32 freq) {
+	int ret = arm_->_check_background_port();
+	if (ret != 0) return ret;
+	if (freq <= 0 || freq > 250) return UXBUS_STATE::ERR_PARAM;
+	if (poller_.is_running()) return 0;
+	{
+		std::lock_guard<std::mutex> locker(mutex_);
+		sample_num_ = 0;
+		ret_ = -1;
+	}
+	poller_.start("gripper_poller", (long long)(1000000 / freq), std::bind(&GripperPoller::_poll, this));
+	std::lock_guard<std::mutex> locker(arm_->gripper_poller_mutex_);
+	arm_->gripper_poller_ = this;
+	return 0;
+}
+
+void GripperPoller::stop(void) {
+	poller_.stop();
+	{
+		std::lock_guard<std::mutex> locker(mutex_);
+		cond_.notify_all();
+	}
+	// the waits of the arm on the poller end as it stopped, it is not deleted under them
+	std::unique_lock<std::mutex> locker(arm_->gripper_poller_mutex_);
+	if (arm_->gripper_poller_ == this) arm_->gripper_poller_ = NULL;
+	wait_cond_.wait(locker, [this] { return wait_num_ == 0; });
+}
+
+bool GripperPoller::is_running(void) {
+	return poller_.is_running();
+}
+
+int GripperPoller::get_snapshot(fp32 *pos, int *err, long long *time) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	*pos = pos_;
+	*err = err_;
+	if (time != NULL) *time = time_;
+	return ret_;
+}
+
+long long GripperPoller::get_sample_num(void) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	return sample_num_;
+}
+
+int GripperPoller::wait_sample(long long sample_num, fp32 timeout) {
+	std::unique_lock<std::mutex> locker(mutex_);
+	bool ok = cond_.wait_for(locker, std::chrono::microseconds((long long)(timeout * 1000000)), [this, sample_num] { return sample_num_ > sample_num || !poller_.is_running(); });
+	return ok && sample_num_ > sample_num ? 0 : UXBUS_STATE::ERR_TOUT;
+}
+
+int GripperPoller::wait_position(fp32 pos, fp32 tolerance, fp32 timeout, fp32 stall_time) {
+	long long start_time = get_system_time();
+	long long timeout_ms = (long long)(timeout * 1000);
+	long long stall_ms = (long long)(stall_time * 1000);
+	int dir = 0;
+	fp32 best_pos = 0;
+	long long progress_time = 0;
+	std::unique_lock<std::mutex> locker(mutex_);
+	long long sample_num = sample_num_;
+	while (poller_.is_running()) {
+		long long now = get_system_time();
+		if (now - start_time >= timeout_ms) break;
+		if (sample_num_ == sample_num) {
+			cond_.wait_for(locker, std::chrono::milliseconds(20));
+			continue;
+		}
+		sample_num = sample_num_;
+		if (!UxbusCmd::has_reply(ret_)) return ret_;
+		if (err_ != 0) return err_;
+		if (fabs(pos - pos_) <= tolerance) return 0;
+		if (dir == 0) {
+			// the first sample may be read before the command, it only gives the direction
+			dir = pos > pos_ ? 1 : -1;
+			best_pos = pos_;
+			progress_time = now;
+			continue;
+		}
+		if ((pos - pos_) * dir <= 0) return 0; // crossed the target
+		if ((pos_ - best_pos) * dir > 0) {
+			best_pos = pos_;
+			progress_time = now;
+		}
+		else if (now - progress_time >= stall_ms) {
+			return 0;
+		}
+	}
+	return UXBUS_STATE::ERR_TOUT;
+}
+
+int GripperPoller::_read(UxbusCmd *core, fp32 *pos, int *err) {
+	XARM_TRACE_SCOPE("gripper_poll");
+	unsigned char pos_data[254], err_data[254];
+	int pos_id = core->gripper_modbus_post_r16s(SERVO3_RG::CURR_POS, 2);
+	if (pos_id < 0) return UXBUS_STATE::ERR_NOTTCP;
+	int err_id = core->gripper_modbus_post_r16s(SERVO3_RG::ERR_CODE, 1);
+	int ret = core->tgpio_pend_modbus(pos_id, pos_data);
+	int ret2 = err_id < 0 ? UXBUS_STATE::ERR_NOTTCP : core->tgpio_pend_modbus(err_id, err_data);
+	// a reply with the error or warning bit of the arm still carries the registers
+	if (!UxbusCmd::has_reply(ret)) return ret;
+	if (!UxbusCmd::has_reply(ret2)) return ret2;
+	*pos = (fp32)bin8_to_32(&pos_data[4]);
+	*err = bin8_to_16(&err_data[4]);
+	return ret != 0 ? ret : ret2;
+}
+
+void GripperPoller::_poll(void) {
+	fp32 pos = 0;
+	int err = 0;
+	int ret = arm_->is_connected() ? _read(arm_->cmd_tcp_, &pos, &err) : UXBUS_STATE::NOT_CONNECTED;
+	std::lock_guard<std::mutex> locker(mutex_);
+	ret_ = ret;
+	if (UxbusCmd::has_reply(ret)) {
+		pos_ = pos;
+		err_ = err;
+	}
+	time_ = get_system_time();
+	sample_num_ += 1;
+	cond_.notify_all();
+}
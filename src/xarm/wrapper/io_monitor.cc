@@ -0,0 +1,277 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+#include <string.h>
+#include "xarm/core/instruction/servo3_config.h"
+#include "xarm/wrapper/io_monitor.h"
+
+IoMonitor::IoMonitor(XArmAPI *arm) {
+	arm_ = arm;
+	tgpio_ = true;
+	sample_num_ = 0;
+	last_state_ = 0;
+	for (int i = 0; i < PIN_NUM; i++) {
+		level_[i] = -1;
+		candidate_[i] = -1;
+		candidate_time_[i] = 0;
+		debounce_[i] = 0;
+		for (int j = 0; j < 2; j++) {
+			edge_num_[i][j] = 0;
+			edge_time_[i][j] = 0;
+		}
+		triggers_[i].armed = false;
+		triggers_[i].trans_id = -1;
+		triggers_[i].ret = UXBUS_STATE::NOT_READY;
+		triggers_[i].time = 0;
+	}
+}
+
+IoMonitor::~IoMonitor(void) {
+	stop();
+}
+
+int IoMonitor::start(fp32 freq, bool tgpio) {
+	int ret = arm_->_check_background_port();
+	if (ret != 0) return ret;
+	if (freq <= 0 || freq > 500) return UXBUS_STATE::ERR_PARAM;
+	if (poller_.is_running()) return 0;
+	{
+		std::lock_guard<std::mutex> locker(mutex_);
+		tgpio_ = tgpio;
+		sample_num_ = 0;
+		// the first sample gives the levels, not edges
+		for (int i = 0; i < PIN_NUM; i++) {
+			level_[i] = -1;
+			candidate_[i] = -1;
+		}
+	}
+	poller_.start("io_monitor", (long long)(1000000 / freq), std::bind(&IoMonitor::_poll, this));
+	return 0;
+}
+
+void IoMonitor::stop(void) {
+	poller_.stop();
+	std::lock_guard<std::mutex> locker(mutex_);
+	cond_.notify_all();
+}
+
+bool IoMonitor::is_running(void) {
+	return poller_.is_running();
+}
+
+int IoMonitor::set_debounce(int pin, int debounce) {
+	if (pin < -1 || pin >= PIN_NUM || debounce < 0) return UXBUS_STATE::ERR_PARAM;
+	std::lock_guard<std::mutex> locker(mutex_);
+	for (int i = 0; i < PIN_NUM; i++) {
+		if (pin == -1 || pin == i) debounce_[i] = debounce;
+	}
+	return 0;
+}
+
+int IoMonitor::register_edge_callback(int pin, int edge, void(*callback)(int pin, int level, long long time)) {
+	if (pin < 0 || pin >= PIN_NUM || edge < RISING || edge > BOTH || callback == NULL) return UXBUS_STATE::ERR_PARAM;
+	std::lock_guard<std::mutex> locker(mutex_);
+	for (size_t i = 0; i < callbacks_[pin].size(); i++) {
+		if (callbacks_[pin][i].callback == callback) {
+			callbacks_[pin][i].edge = edge;
+			return 0;
+		}
+	}
+	Callback cb = { edge, callback };
+	callbacks_[pin].push_back(cb);
+	return 0;
+}
+
+int IoMonitor::release_edge_callback(int pin, void(*callback)(int pin, int level, long long time)) {
+	if (pin < 0 || pin >= PIN_NUM) return UXBUS_STATE::ERR_PARAM;
+	std::lock_guard<std::mutex> locker(mutex_);
+	for (size_t i = callbacks_[pin].size(); i > 0; i--) {
+		if (callback == NULL || callbacks_[pin][i - 1].callback == callback) callbacks_[pin].erase(callbacks_[pin].begin() + (i - 1));
+	}
+	return 0;
+}
+
+int IoMonitor::get_level(int pin) {
+	if (pin < 0 || pin >= PIN_NUM) return -1;
+	std::lock_guard<std::mutex> locker(mutex_);
+	return level_[pin];
+}
+
+int IoMonitor::wait_edge(int pin, int edge, fp32 timeout, long long *time) {
+	if (pin < 0 || pin >= PIN_NUM || edge < RISING || edge > BOTH) return UXBUS_STATE::ERR_PARAM;
+	std::unique_lock<std::mutex> locker(mutex_);
+	long long rising_num = edge_num_[pin][0];
+	long long falling_num = edge_num_[pin][1];
+	bool is_rising = false, is_falling = false;
+	cond_.wait_for(locker, std::chrono::microseconds((long long)(timeout * 1000000)), [&] {
+		is_rising = (edge & RISING) && edge_num_[pin][0] != rising_num;
+		is_falling = (edge & FALLING) && edge_num_[pin][1] != falling_num;
+		return is_rising || is_falling || !poller_.is_running();
+	});
+	if (!is_rising && !is_falling) return UXBUS_STATE::ERR_TOUT;
+	if (time != NULL) {
+		// both when several edges came in one wake up, the last one
+		if (is_rising && is_falling) *time = edge_time_[pin][0] > edge_time_[pin][1] ? edge_time_[pin][0] : edge_time_[pin][1];
+		else *time = edge_time_[pin][is_rising ? 0 : 1];
+	}
+	return 0;
+}
+
+int IoMonitor::arm_position(int pin, int edge, fp32 pose[6], fp32 speed, fp32 acc, fp32 mvtime) {
+	return _arm(pin, edge, UXBUS_RG::MOVE_LINE, pose, speed, acc, mvtime);
+}
+
+int IoMonitor::arm_servo_angle(int pin, int edge, fp32 angles[7], fp32 speed, fp32 acc, fp32 mvtime) {
+	return _arm(pin, edge, UXBUS_RG::MOVE_JOINT, angles, speed, acc, mvtime);
+}
+
+int IoMonitor::arm_servo_angle_j(int pin, int edge, fp32 angles[7], fp32 speed, fp32 acc, fp32 mvtime) {
+	return _arm(pin, edge, UXBUS_RG::MOVE_SERVOJ, angles, speed, acc, mvtime);
+}
+
+void IoMonitor::disarm(int pin) {
+	if (pin < 0 || pin >= PIN_NUM) return;
+	std::lock_guard<std::mutex> locker(mutex_);
+	triggers_[pin].armed = false;
+}
+
+bool IoMonitor::is_armed(int pin) {
+	if (pin < 0 || pin >= PIN_NUM) return false;
+	std::lock_guard<std::mutex> locker(mutex_);
+	return triggers_[pin].armed;
+}
+
+int IoMonitor::get_trigger_state(int pin, long long *time) {
+	if (pin < 0 || pin >= PIN_NUM) return UXBUS_STATE::ERR_PARAM;
+	std::lock_guard<std::mutex> locker(mutex_);
+	if (time != NULL) *time = triggers_[pin].time;
+	return triggers_[pin].ret;
+}
+
+long long IoMonitor::get_sample_num(void) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	return sample_num_;
+}
+
+int IoMonitor::get_last_state(void) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	return last_state_;
+}
+
+int IoMonitor::_read(UxbusCmd *core, int raw[PIN_NUM]) {
+	XARM_TRACE_SCOPE("io_poll");
+	unsigned char state_data[34] = { 0 }, tgpio_data[4] = { 0 };
+	unsigned char tx[3] = { UXBUS_CONF::TGPIO_ID, (unsigned char)(SERVO3_RG::DIGITAL_IN >> 8), (unsigned char)(SERVO3_RG::DIGITAL_IN & 0xFF) };
+	int ret2 = 0;
+	int state_id = core->post_cmd<UXBUS_CMD::CGPIO_GET_STATE>();
+	int tgpio_id = tgpio_ ? core->post_cmd<UXBUS_CMD::TGPIO_R16B>(tx) : -1;
+	int ret = state_id < 0 ? UXBUS_STATE::ERR_NOTTCP : core->pend_cmd<UXBUS_CMD::CGPIO_GET_STATE>(state_id, state_data);
+	if (tgpio_) ret2 = tgpio_id < 0 ? UXBUS_STATE::ERR_NOTTCP : core->pend_cmd<UXBUS_CMD::TGPIO_R16B>(tgpio_id, tgpio_data);
+	bool state_ok = UxbusCmd::has_reply(ret);
+	bool tgpio_ok = tgpio_ && UxbusCmd::has_reply(ret2);
+	int ci = bin8_to_16(&state_data[2]);
+	int di = bin8_to_16(&state_data[4]);
+	int ti = bin8_to_32(tgpio_data);
+	for (int i = 0; i < 8; i++) {
+		raw[CI0 + i] = state_ok ? (ci >> i) & 0x01 : -1;
+		raw[DI0 + i] = state_ok ? (di >> i) & 0x01 : -1;
+	}
+	for (int i = 0; i < 2; i++) {
+		raw[TI0 + i] = tgpio_ok ? (ti >> i) & 0x01 : -1;
+	}
+	return ret != 0 ? ret : ret2;
+}
+
+int IoMonitor::_arm(int pin, int edge, int funcode, fp32 *target, fp32 speed, fp32 acc, fp32 mvtime) {
+	if (pin < 0 || pin >= PIN_NUM || edge < RISING || edge > BOTH) return UXBUS_STATE::ERR_PARAM;
+	if (!arm_->is_connected()) return -1;
+	unsigned char frame[UxbusCmd::MAX_FRAME_LEN];
+	int len = 0;
+	int ret = arm_->_encode_move(funcode, target, speed, acc, mvtime, frame, &len);
+	if (ret != 0) return ret;
+	if (len <= 0) return UXBUS_STATE::ERR_NOTTCP;
+	std::lock_guard<std::mutex> locker(mutex_);
+	Trigger &trigger = triggers_[pin];
+	memcpy(trigger.frame, frame, len);
+	trigger.len = len;
+	trigger.funcode = funcode;
+	trigger.edge = edge;
+	trigger.armed = true;
+	return 0;
+}
+
+int IoMonitor::_update(UxbusCmd *core, const int raw[PIN_NUM], long long now, int fired[PIN_NUM]) {
+	int fired_num = 0;
+	for (int i = 0; i < PIN_NUM; i++) {
+		if (raw[i] < 0) continue;
+		if (level_[i] < 0 || raw[i] == level_[i]) {
+			level_[i] = raw[i];
+			candidate_[i] = -1;
+			continue;
+		}
+		if (candidate_[i] != raw[i]) {
+			candidate_[i] = raw[i];
+			candidate_time_[i] = now;
+		}
+		if (now - candidate_time_[i] < debounce_[i]) continue;
+		level_[i] = raw[i];
+		candidate_[i] = -1;
+		int edge = raw[i] ? 0 : 1;
+		edge_num_[i][edge] += 1;
+		edge_time_[i][edge] = candidate_time_[i];
+		Trigger &trigger = triggers_[i];
+		if (trigger.armed && (trigger.edge & (raw[i] ? RISING : FALLING))) {
+			// the frame was encoded when armed, only the transaction id is written
+			trigger.armed = false;
+			if (trigger.funcode == UXBUS_RG::MOVE_SERVOJ && arm_->_is_servo_held()) {
+				trigger.trans_id = -1;
+				trigger.ret = UXBUS_STATE::REPORT_STALE;
+			}
+			else {
+				trigger.trans_id = core->send_frame(trigger.frame, trigger.len);
+				trigger.ret = trigger.trans_id < 0 ? UXBUS_STATE::ERR_NOTTCP : UXBUS_STATE::NOT_READY;
+			}
+			trigger.time = get_system_time();
+			if (trigger.trans_id >= 0) fired[fired_num++] = i;
+		}
+		for (size_t j = 0; j < callbacks_[i].size(); j++) {
+			if (callbacks_[i][j].edge & (raw[i] ? RISING : FALLING)) {
+				arm_->timer.AsyncWait(0, callbacks_[i][j].callback, i, raw[i], candidate_time_[i]);
+			}
+		}
+	}
+	return fired_num;
+}
+
+void IoMonitor::_poll(void) {
+	UxbusCmd *core = arm_->cmd_tcp_;
+	int raw[PIN_NUM], fired[PIN_NUM], trans_ids[PIN_NUM], funcodes[PIN_NUM], rets[PIN_NUM];
+	int ret = UXBUS_STATE::NOT_CONNECTED;
+	for (int i = 0; i < PIN_NUM; i++) raw[i] = -1;
+	if (arm_->is_connected()) ret = _read(core, raw);
+	long long now = get_system_time();
+	std::unique_lock<std::mutex> locker(mutex_);
+	last_state_ = ret;
+	int fired_num = _update(core, raw, now, fired);
+	sample_num_ += 1;
+	if (fired_num > 0) {
+		// the moves are on the way, their replies are collected out of the lock
+		for (int i = 0; i < fired_num; i++) {
+			trans_ids[i] = triggers_[fired[i]].trans_id;
+			funcodes[i] = triggers_[fired[i]].funcode;
+		}
+		locker.unlock();
+		for (int i = 0; i < fired_num; i++) rets[i] = arm_->_pend_move(core, funcodes[i], trans_ids[i]);
+		locker.lock();
+		for (int i = 0; i < fired_num; i++) {
+			// not when armed and sent again meanwhile
+			if (triggers_[fired[i]].trans_id == trans_ids[i]) triggers_[fired[i]].ret = rets[i];
+		}
+	}
+	cond_.notify_all();
+}
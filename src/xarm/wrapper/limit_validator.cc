@@ -0,0 +1,124 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+#include "xarm/core/instruction/uxbus_cmd_config.h"
+#include "xarm/wrapper/limit_validator.h"
+
+static const float PI = (float)3.14159265358979323846;
+// the targets converted from degrees may be a little over a range given in degrees
+static const float JOINT_EPS = (float)1e-4;
+static const float TCP_EPS = (float)1e-3;
+
+LimitValidator::LimitValidator(void) {
+	is_valid_ = false;
+	reduced_on_ = false;
+	fense_on_ = false;
+	has_jrange_ = false;
+	reduced_tcp_speed_ = 0;
+	reduced_joint_speed_ = 0;
+	for (int i = 0; i < 6; i++) boundary_[i] = 0;
+	for (int i = 0; i < 7; i++) {
+		reduced_jrange_[i][0] = -2 * PI;
+		reduced_jrange_[i][1] = 2 * PI;
+	}
+	set_axis(0);
+}
+
+void LimitValidator::set_axis(int axis) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	axis_ = axis;
+	for (int i = 0; i < 7; i++) {
+		joint_range_[i][0] = -2 * PI;
+		joint_range_[i][1] = 2 * PI;
+	}
+	joint_range_[1][0] = (float)-2.059;
+	joint_range_[1][1] = (float)2.0944;
+	if (axis == 7) {
+		joint_range_[3][0] = (float)-0.19198;
+		joint_range_[3][1] = (float)3.927;
+		joint_range_[5][0] = (float)-1.69297;
+		joint_range_[5][1] = PI;
+	}
+	else if (axis == 6) {
+		joint_range_[2][0] = (float)-3.927;
+		joint_range_[2][1] = (float)0.19198;
+		joint_range_[4][0] = (float)-1.69297;
+		joint_range_[4][1] = PI;
+	}
+	else if (axis == 5) {
+		joint_range_[2][0] = (float)-3.927;
+		joint_range_[2][1] = (float)0.19198;
+		joint_range_[3][0] = (float)-1.69297;
+		joint_range_[3][1] = PI;
+	}
+}
+
+int LimitValidator::get_axis(void) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	return axis_;
+}
+
+void LimitValidator::update(int reduced_on, const int xyz_list[6], float tcp_speed, float joint_speed, const float *jrange, int fense_on) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	reduced_on_ = reduced_on != 0;
+	fense_on_ = fense_on != 0;
+	for (int i = 0; i < 6; i++) boundary_[i] = (float)xyz_list[i];
+	reduced_tcp_speed_ = tcp_speed;
+	reduced_joint_speed_ = joint_speed;
+	has_jrange_ = jrange != NULL;
+	for (int i = 0; i < 7 && has_jrange_; i++) {
+		reduced_jrange_[i][0] = jrange[i * 2];
+		reduced_jrange_[i][1] = jrange[i * 2 + 1];
+	}
+	is_valid_ = true;
+}
+
+void LimitValidator::invalidate(void) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	is_valid_ = false;
+}
+
+bool LimitValidator::is_valid(void) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	return is_valid_;
+}
+
+int LimitValidator::check_joints(const float angles[7]) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	if (axis_ < 5 || axis_ > 7) return 0;
+	for (int i = 0; i < axis_; i++) {
+		if (angles[i] < joint_range_[i][0] - JOINT_EPS || angles[i] > joint_range_[i][1] + JOINT_EPS) return UXBUS_STATE::JOINT_LIMIT;
+		// an unset reduced range is all zeros
+		if (!reduced_on_ || !has_jrange_ || reduced_jrange_[i][0] >= reduced_jrange_[i][1]) continue;
+		if (angles[i] < reduced_jrange_[i][0] - JOINT_EPS || angles[i] > reduced_jrange_[i][1] + JOINT_EPS) return UXBUS_STATE::JOINT_LIMIT;
+	}
+	return 0;
+}
+
+int LimitValidator::check_pose(const float pose[6]) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	if (!fense_on_) return 0;
+	for (int i = 0; i < 3; i++) {
+		float max = boundary_[i * 2], min = boundary_[i * 2 + 1];
+		if (min >= max) continue;
+		if (pose[i] < min - TCP_EPS || pose[i] > max + TCP_EPS) return UXBUS_STATE::TCP_LIMIT;
+	}
+	return 0;
+}
+
+float LimitValidator::clamp_joint_speed(float speed) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	if (!reduced_on_ || reduced_joint_speed_ <= 0) return speed;
+	return speed > reduced_joint_speed_ ? reduced_joint_speed_ : speed;
+}
+
+float LimitValidator::clamp_tcp_speed(float speed) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	if (!reduced_on_ || reduced_tcp_speed_ <= 0) return speed;
+	return speed > reduced_tcp_speed_ ? reduced_tcp_speed_ : speed;
+}
@@ -0,0 +1,156 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+#include "xarm/core/instruction/servo3_config.h"
+#include "xarm/wrapper/modbus_device.h"
+#include "xarm/wrapper/modbus_transaction.h"
+
+ModbusDevice::ModbusDevice(int slave_id) {
+	slave_id_ = slave_id;
+	block_num_ = 0;
+	image_num_ = 0;
+	write_num_ = 0;
+	write_reg_num_ = 0;
+	write_ret_ = 0;
+}
+
+int ModbusDevice::get_slave_id(void) {
+	return slave_id_;
+}
+
+int ModbusDevice::add_block(int funcode, int addr, int num, int period) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	if (funcode != 0x03 && funcode != 0x04) return UXBUS_STATE::ERR_PARAM;
+	// a block is read by one request of the scheduler
+	if (num < 1 || num > ModbusTransaction::MAX_READ_REGS) return UXBUS_STATE::ERR_PARAM;
+	if (block_num_ >= MAX_BLOCKS || image_num_ + num > MAX_IMAGE_REGS) return UXBUS_STATE::ERR_PARAM;
+	Block &block = blocks_[block_num_++];
+	block.funcode = funcode;
+	block.addr = addr;
+	block.num = num;
+	block.period = period > 0 ? period : 0;
+	block.offset = image_num_;
+	block.next_time = 0;
+	block.time = 0;
+	block.ret = UXBUS_STATE::NOT_READY;
+	for (int i = 0; i < num; i++) image_[image_num_ + i] = 0;
+	image_num_ += num;
+	return 0;
+}
+
+int ModbusDevice::get_regs(int funcode, int addr, unsigned short *values, int num, long long *time) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	for (int i = 0; i < block_num_; i++) {
+		Block &block = blocks_[i];
+		if (block.funcode != funcode || addr < block.addr || addr + num > block.addr + block.num) continue;
+		for (int j = 0; j < num; j++) values[j] = image_[block.offset + addr - block.addr + j];
+		if (time != NULL) *time = block.time;
+		return block.ret;
+	}
+	return UXBUS_STATE::ERR_PARAM;
+}
+
+int ModbusDevice::write_regs(int addr, const unsigned short *values, int num) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	if (write_num_ >= MAX_WRITES || num < 1 || write_reg_num_ + num > MAX_WRITE_REGS) return UXBUS_STATE::ERR_PARAM;
+	Write &write = writes_[write_num_++];
+	write.addr = addr;
+	write.num = num;
+	write.offset = write_reg_num_;
+	for (int i = 0; i < num; i++) write_regs_[write_reg_num_ + i] = values[i];
+	write_reg_num_ += num;
+	write_ret_ = UXBUS_STATE::NOT_READY;
+	return 0;
+}
+
+int ModbusDevice::get_write_state(void) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	return write_ret_;
+}
+
+UfactoryGripperDevice::UfactoryGripperDevice(int slave_id) : ModbusDevice(slave_id) {
+	add_block(0x03, SERVO3_RG::CURR_POS, 2, 0);
+	add_block(0x03, SERVO3_RG::ERR_CODE, 1, 100);
+}
+
+int UfactoryGripperDevice::set_enable(bool enable) {
+	unsigned short values[1] = { (unsigned short)(enable ? 1 : 0) };
+	return write_regs(SERVO3_RG::CON_EN, values, 1);
+}
+
+int UfactoryGripperDevice::set_mode(int mode) {
+	unsigned short values[1] = { (unsigned short)mode };
+	return write_regs(SERVO3_RG::CON_MODE, values, 1);
+}
+
+int UfactoryGripperDevice::set_speed(int speed) {
+	unsigned short values[1] = { (unsigned short)speed };
+	return write_regs(SERVO3_RG::POS_SPD, values, 1);
+}
+
+int UfactoryGripperDevice::set_position(int pos) {
+	unsigned short values[2] = { (unsigned short)((pos >> 16) & 0xFFFF), (unsigned short)(pos & 0xFFFF) };
+	return write_regs(SERVO3_RG::TAGET_POS, values, 2);
+}
+
+int UfactoryGripperDevice::get_position(int *pos) {
+	unsigned short values[2];
+	int ret = get_regs(0x03, SERVO3_RG::CURR_POS, values, 2);
+	*pos = (int)(((unsigned int)values[0] << 16) | values[1]);
+	return ret;
+}
+
+int UfactoryGripperDevice::get_err_code(int *err) {
+	unsigned short values[1];
+	int ret = get_regs(0x03, SERVO3_RG::ERR_CODE, values, 1);
+	*err = values[0];
+	return ret;
+}
+
+// the registers of the Robotiq 2F grippers, two bytes each, the first one in the high byte
+static const int ROBOTIQ_OUTPUT = 0x03E8; // {action request, reserved}, {reserved, position request}, {speed, force}
+static const int ROBOTIQ_INPUT = 0x07D0; // {gripper status, reserved}, {fault status, position request echo}, {position, current}
+static const int ROBOTIQ_ACT = 0x01;
+static const int ROBOTIQ_GTO = 0x08;
+
+RobotiqGripperDevice::RobotiqGripperDevice(int slave_id) : ModbusDevice(slave_id) {
+	add_block(0x04, ROBOTIQ_INPUT, 3, 0);
+}
+
+int RobotiqGripperDevice::reset(void) {
+	unsigned short values[3] = { 0, 0, 0 };
+	return write_regs(ROBOTIQ_OUTPUT, values, 3);
+}
+
+int RobotiqGripperDevice::activate(void) {
+	int ret = reset();
+	if (ret != 0) return ret;
+	unsigned short values[3] = { ROBOTIQ_ACT << 8, 0, 0 };
+	return write_regs(ROBOTIQ_OUTPUT, values, 3);
+}
+
+int RobotiqGripperDevice::move(int pos, int speed, int force) {
+	if (pos < 0 || pos > 255 || speed < 0 || speed > 255 || force < 0 || force > 255) return UXBUS_STATE::ERR_PARAM;
+	unsigned short values[3] = { (ROBOTIQ_ACT | ROBOTIQ_GTO) << 8, (unsigned short)pos, (unsigned short)((speed << 8) | force) };
+	return write_regs(ROBOTIQ_OUTPUT, values, 3);
+}
+
+int RobotiqGripperDevice::get_status(int status[8]) {
+	unsigned short values[3];
+	int ret = get_regs(0x04, ROBOTIQ_INPUT, values, 3);
+	int gripper_status = values[0] >> 8;
+	status[0] = gripper_status & 0x01; // gACT
+	status[1] = (gripper_status >> 3) & 0x01; // gGTO
+	status[2] = (gripper_status >> 4) & 0x03; // gSTA
+	status[3] = (gripper_status >> 6) & 0x03; // gOBJ
+	status[4] = (values[1] >> 8) & 0x0F; // gFLT
+	status[5] = values[1] & 0xFF; // gPR
+	status[6] = values[2] >> 8; // gPO
+	status[7] = values[2] & 0xFF; // gCU
+	return ret;
+}
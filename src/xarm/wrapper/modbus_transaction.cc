@@ -0,0 +1,160 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+#include "xarm/wrapper/modbus_transaction.h"
+
+// the largest write in MAX_DATA_LEN bytes, as the modbus limits
+static const int MAX_WRITE_REGS = 123;
+// the unrouted replies of the tcp port are stashed up to 16, leave room for the other callers
+static const int MAX_IN_FLIGHT = 8;
+
+ModbusTransaction::ModbusTransaction(int slave_id) {
+	default_slave_id_ = slave_id;
+	clear();
+}
+
+void ModbusTransaction::clear(void) {
+	slave_id_ = default_slave_id_;
+	op_num_ = 0;
+	reg_num_ = 0;
+	request_num_ = 0;
+}
+
+void ModbusTransaction::select_slave(int slave_id) {
+	slave_id_ = slave_id;
+}
+
+int ModbusTransaction::_add(int funcode, int addr, int num) {
+	int max_num = funcode == 0x10 ? MAX_WRITE_REGS : MAX_READ_REGS;
+	// negative, the index of an op is not
+	if (op_num_ >= MAX_OPS || num < 1 || num > max_num || reg_num_ + num > MAX_REGS) return UXBUS_STATE::OUT_OF_RANGE;
+	if (addr < 0 || addr + num > 0x10000) return UXBUS_STATE::OUT_OF_RANGE;
+	Request *req = request_num_ > 0 ? &requests_[request_num_ - 1] : NULL;
+	// the registers of consecutive ops are consecutive in regs_ too
+	if (req == NULL || req->slave_id != slave_id_ || req->funcode != funcode || req->addr + req->num != addr || req->num + num > max_num) {
+		if (request_num_ >= MAX_REQUESTS) return UXBUS_STATE::OUT_OF_RANGE;
+		req = &requests_[request_num_++];
+		req->slave_id = (unsigned char)slave_id_;
+		req->funcode = (unsigned char)funcode;
+		req->addr = (unsigned short)addr;
+		req->num = 0;
+		req->offset = (unsigned short)reg_num_;
+	}
+	req->num += (unsigned short)num;
+	req->ret = UXBUS_STATE::NOT_READY;
+	Op &op = ops_[op_num_];
+	op.funcode = (unsigned char)funcode;
+	op.addr = (unsigned short)addr;
+	op.num = (unsigned short)num;
+	op.offset = (unsigned short)reg_num_;
+	op.request = (unsigned char)(request_num_ - 1);
+	for (int i = 0; i < num; i++) regs_[reg_num_ + i] = 0;
+	reg_num_ += num;
+	return op_num_++;
+}
+
+int ModbusTransaction::read_holding(int addr, int num) {
+	return _add(0x03, addr, num);
+}
+
+int ModbusTransaction::read_input(int addr, int num) {
+	return _add(0x04, addr, num);
+}
+
+int ModbusTransaction::write_regs(int addr, const unsigned short *values, int num) {
+	int op = _add(0x10, addr, num);
+	if (op < 0) return op;
+	for (int i = 0; i < num; i++) regs_[ops_[op].offset + i] = values[i];
+	return op;
+}
+
+int ModbusTransaction::write_u16(int addr, int value) {
+	unsigned short values[1] = { (unsigned short)(value & 0xFFFF) };
+	return write_regs(addr, values, 1);
+}
+
+int ModbusTransaction::write_u32(int addr, int value) {
+	unsigned short values[2] = { (unsigned short)((value >> 16) & 0xFFFF), (unsigned short)(value & 0xFFFF) };
+	return write_regs(addr, values, 2);
+}
+
+int ModbusTransaction::_encode(const Request &req, unsigned char *tx) {
+	tx[0] = req.slave_id;
+	tx[1] = req.funcode;
+	bin16_to_8(req.addr, &tx[2]);
+	bin16_to_8(req.num, &tx[4]);
+	if (req.funcode != 0x10) return 6;
+	tx[6] = (unsigned char)(req.num * 2);
+	for (int i = 0; i < req.num; i++) bin16_to_8(regs_[req.offset + i], &tx[7 + i * 2]);
+	return 7 + req.num * 2;
+}
+
+int ModbusTransaction::_decode(const Request &req, const unsigned char *rx) {
+	// rx: {tgpio id, slave id, function, byte count / address, registers...}
+	if (rx[2] != req.funcode) return UXBUS_STATE::ERR_FUN; // an exception reply has the function | 0x80
+	if (req.funcode == 0x10) return 0;
+	if (rx[3] != req.num * 2) return UXBUS_STATE::ERR_LENG;
+	for (int i = 0; i < req.num; i++) regs_[req.offset + i] = (unsigned short)bin8_to_16((unsigned char *)&rx[4 + i * 2]);
+	return 0;
+}
+
+int ModbusTransaction::execute(XArmAPI *arm) {
+	if (!arm->is_connected()) return UXBUS_STATE::NOT_CONNECTED;
+	UxbusCmd *core = arm->is_tcp_ ? (UxbusCmd *)arm->cmd_tcp_ : (UxbusCmd *)arm->cmd_ser_;
+	int window = arm->is_tcp_ ? MAX_IN_FLIGHT : 1; // see UxbusCmdSer
+	unsigned char tx[UXBUS_CONF::MAX_DATA_LEN];
+	unsigned char rx[UXBUS_CONF::MAX_DATA_LEN];
+	int trans_ids[MAX_IN_FLIGHT];
+	int code = 0;
+	for (int first = 0; first < request_num_; first += window) {
+		int last = first + window < request_num_ ? first + window : request_num_;
+		for (int i = first; i < last; i++) {
+			int len = _encode(requests_[i], tx);
+			trans_ids[i - first] = core->tgpio_post_modbus(tx, len);
+		}
+		for (int i = first; i < last; i++) {
+			int ret = UXBUS_STATE::ERR_NOTTCP;
+			if (trans_ids[i - first] >= 0) {
+				ret = core->tgpio_pend_modbus(trans_ids[i - first], rx);
+				if (UxbusCmd::has_reply(ret)) {
+					int ret2 = _decode(requests_[i], rx);
+					ret = ret2 != 0 ? ret2 : ret;
+				}
+			}
+			requests_[i].ret = ret;
+			if (code == 0) code = ret;
+		}
+	}
+	return code;
+}
+
+int ModbusTransaction::get_op_num(void) {
+	return op_num_;
+}
+
+int ModbusTransaction::get_request_num(void) {
+	return request_num_;
+}
+
+int ModbusTransaction::get_state(int op) {
+	if (op < 0 || op >= op_num_) return UXBUS_STATE::ERR_PARAM;
+	return requests_[ops_[op].request].ret;
+}
+
+int ModbusTransaction::get_u16(int op, int index) {
+	if (op < 0 || op >= op_num_ || index < 0 || index >= ops_[op].num) return 0;
+	return regs_[ops_[op].offset + index];
+}
+
+int ModbusTransaction::get_i16(int op, int index) {
+	return (short)get_u16(op, index);
+}
+
+int ModbusTransaction::get_i32(int op, int index) {
+	return (int)(((unsigned int)get_u16(op, index) << 16) | (unsigned int)get_u16(op, index + 1));
+}
@@ -0,0 +1,344 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+#include <chrono>
+#include "xarm/wrapper/online_trajectory_generator.h"
+
+static const double PI = 3.14159265358979323846;
+static const double ROT_SPEED = PI; // rad/s, cartesian space, no rotation speed is reported
+
+// distance covered by stopping from (v, a) as fast as possible
+static double stop_distance(double v, double a, double amax, double jmax) {
+	if (v + a * fabs(a) / (2 * jmax) < 0) return -stop_distance(-v, -a, amax, jmax);
+	// jerk -jmax down to -ap, hold -ap for t2, jerk +jmax back to 0 when v reaches 0
+	double ap = sqrt(fmax((2 * jmax * v + a * a) / 2, 0));
+	double t2 = 0;
+	if (ap > amax) {
+		ap = amax;
+		t2 = (v + (a * a - 2 * amax * amax) / (2 * jmax)) / amax;
+	}
+	double t1 = (a + ap) / jmax;
+	double t3 = ap / jmax;
+	double p1 = v * t1 + a * t1 * t1 / 2 - jmax * t1 * t1 * t1 / 6;
+	double v1 = v + a * t1 - jmax * t1 * t1 / 2;
+	double p2 = v1 * t2 - ap * t2 * t2 / 2;
+	double v2 = v1 - ap * t2;
+	double p3 = v2 * t3 - ap * t3 * t3 / 2 + jmax * t3 * t3 * t3 / 6;
+	return p1 + p2 + p3;
+}
+
+// can the axis still stop at the target after one cycle with this jerk
+static bool jerk_is_safe(double p, double v, double a, double j, double target, double vmax, double amax, double jmax, double dt) {
+	double p2 = p + v * dt + a * dt * dt / 2 + j * dt * dt * dt / 6;
+	double v2 = v + a * dt + j * dt * dt / 2;
+	double a2 = a + j * dt;
+	if (a2 > amax * (1 + 1e-9)) return false;
+	if (v2 + fmax(a2, 0) * fmax(a2, 0) / (2 * jmax) > vmax * (1 + 1e-9)) return false;
+	return p2 + stop_distance(v2, a2, amax, jmax) <= target + 1e-9;
+}
+
+// one cycle of one axis, the largest safe jerk towards the target
+static void otg_axis_step(double *p, double *v, double *a, double target, double vmax, double amax, double jmax, double dt) {
+	double s = (target < *p || (target == *p && *v < 0)) ? -1 : 1;
+	double sp = s * *p, sv = s * *v, sa = s * *a, st = s * target;
+	if (st - sp <= jmax * dt * dt * dt && fabs(sv) <= jmax * dt * dt && fabs(sa) <= jmax * dt) {
+		*p = target;
+		*v = 0;
+		*a = 0;
+		return;
+	}
+	double lo = fmax(-jmax, (-amax - sa) / dt);
+	double j;
+	if (jerk_is_safe(sp, sv, sa, jmax, st, vmax, amax, jmax, dt)) j = jmax;
+	else if (!jerk_is_safe(sp, sv, sa, lo, st, vmax, amax, jmax, dt)) j = lo;
+	else {
+		double hi = jmax;
+		for (int i = 0; i < 30; i++) {
+			double mid = (lo + hi) / 2;
+			if (jerk_is_safe(sp, sv, sa, mid, st, vmax, amax, jmax, dt)) lo = mid;
+			else hi = mid;
+		}
+		j = lo;
+	}
+	*p = s * (sp + sv * dt + sa * dt * dt / 2 + j * dt * dt * dt / 6);
+	*v = s * (sv + sa * dt + j * dt * dt / 2);
+	*a = s * (sa + j * dt);
+}
+
+OnlineTrajectoryGenerator::OnlineTrajectoryGenerator(XArmAPI *arm, int space, fp32 cycle_time) {
+	arm_ = arm;
+	space_ = space;
+	axis_num_ = space == CARTESIAN_SPACE ? 6 : 7;
+	cycle_time_ = cycle_time > 0 ? cycle_time : 0.004;
+	is_running_ = false;
+	last_error_ = 0;
+	is_reached_ = true;
+	speed_ = 0;
+	acc_ = 0;
+	jerk_ = 0;
+	rot_speed_ = 0;
+	rot_acc_ = 0;
+	rot_jerk_ = 0;
+	for (int i = 0; i < 7; i++) {
+		pos_[i] = 0;
+		vel_[i] = 0;
+		acc_state_[i] = 0;
+		target_[i] = 0;
+		scale_[i] = 1;
+	}
+}
+
+OnlineTrajectoryGenerator::~OnlineTrajectoryGenerator(void) {
+	stop();
+}
+
+int OnlineTrajectoryGenerator::start(void) {
+	if (!arm_->is_connected()) return UXBUS_STATE::NOT_CONNECTED;
+	if (is_running_) return 0;
+	if (thread_.joinable()) thread_.join();
+	UxbusCmd *core = arm_->is_tcp_ ? (UxbusCmd *)arm_->cmd_tcp_ : (UxbusCmd *)arm_->cmd_ser_;
+	float cur[7] = { 0 };
+	int ret = space_ == CARTESIAN_SPACE ? core->get_tcp_pose(cur) : core->get_joint_pose(cur);
+	if (ret != 0 && ret != UXBUS_STATE::WAR_CODE) return ret;
+	{
+		std::lock_guard<std::mutex> locker(mutex_);
+		for (int i = 0; i < 7; i++) {
+			pos_[i] = cur[i];
+			target_[i] = cur[i];
+			vel_[i] = 0;
+			acc_state_[i] = 0;
+			scale_[i] = 1;
+		}
+		is_reached_ = true;
+	}
+	last_error_ = 0;
+	is_running_ = true;
+	thread_ = std::thread(&OnlineTrajectoryGenerator::_servo_loop, this);
+	return 0;
+}
+
+void OnlineTrajectoryGenerator::stop(void) {
+	is_running_ = false;
+	if (thread_.joinable() && thread_.get_id() != std::this_thread::get_id()) thread_.join();
+}
+
+int OnlineTrajectoryGenerator::set_target(fp32 target[7]) {
+	fp32 checked[7] = { 0 };
+	for (int i = 0; i < axis_num_; i++) {
+		bool is_angle = space_ == JOINT_SPACE || i >= 3;
+		checked[i] = (fp32)(is_angle && !arm_->default_is_radian ? target[i] / RAD_DEGREE : target[i]);
+	}
+	int ret = 0;
+	if (space_ == JOINT_SPACE && arm_->check_joint_limit_) ret = arm_->_check_joint_limit(checked);
+	if (space_ == CARTESIAN_SPACE && arm_->check_tcp_limit_) ret = arm_->_check_tcp_limit(checked);
+	if (ret != 0) return ret;
+	std::lock_guard<std::mutex> locker(mutex_);
+	CollisionChecker *checker = arm_->collision_checker_;
+	if (space_ == JOINT_SPACE && checker != NULL) {
+		// the joints move together, close to the straight joint path from the current setpoint
+		fp32 from[7] = { 0 };
+		for (int i = 0; i < axis_num_; i++) from[i] = (fp32)pos_[i];
+		ret = checker->check_path(from, checked);
+		if (ret != 0) return ret;
+	}
+	for (int i = 0; i < axis_num_; i++) {
+		bool is_angle = space_ == JOINT_SPACE || i >= 3;
+		target_[i] = is_angle && !arm_->default_is_radian ? target[i] / RAD_DEGREE : target[i];
+		// the shortest way to the orientation
+		if (space_ == CARTESIAN_SPACE && i >= 3) {
+			while (target_[i] - pos_[i] > PI) target_[i] -= 2 * PI;
+			while (target_[i] - pos_[i] < -PI) target_[i] += 2 * PI;
+		}
+	}
+	_update_scales();
+	is_reached_ = false;
+	return 0;
+}
+
+void OnlineTrajectoryGenerator::set_limits(fp32 speed, fp32 acc, fp32 jerk) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	speed_ = speed > 0 ? speed : 0;
+	acc_ = acc > 0 ? acc : 0;
+	jerk_ = jerk > 0 ? jerk : 0;
+}
+
+void OnlineTrajectoryGenerator::set_rot_limits(fp32 speed, fp32 acc, fp32 jerk) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	rot_speed_ = speed > 0 ? speed : 0;
+	rot_acc_ = acc > 0 ? acc : 0;
+	rot_jerk_ = jerk > 0 ? jerk : 0;
+}
+
+bool OnlineTrajectoryGenerator::is_reached(void) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	return is_reached_;
+}
+
+int OnlineTrajectoryGenerator::wait_reached(fp32 timeout) {
+	long long start_time = get_system_time();
+	while (is_running_) {
+		if (is_reached()) return 0;
+		if (timeout > 0 && get_system_time() - start_time >= timeout * 1000) return UXBUS_STATE::ERR_TOUT;
+		sleep_milliseconds(5);
+	}
+	return last_error_ != 0 ? (int)last_error_ : (is_reached() ? 0 : UXBUS_STATE::NOT_READY);
+}
+
+void OnlineTrajectoryGenerator::get_setpoint(fp32 pos[7], fp32 *vel, fp32 *acc) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	for (int i = 0; i < 7; i++) {
+		double unit = (space_ == JOINT_SPACE || i >= 3) && !arm_->default_is_radian ? RAD_DEGREE : 1;
+		if (pos != NULL) pos[i] = (fp32)(pos_[i] * unit);
+		if (vel != NULL) vel[i] = (fp32)(vel_[i] * unit);
+		if (acc != NULL) acc[i] = (fp32)(acc_state_[i] * unit);
+	}
+}
+
+int OnlineTrajectoryGenerator::last_error(void) {
+	return last_error_;
+}
+
+void OnlineTrajectoryGenerator::_get_limits(double vmax[7], double amax[7], double jmax[7]) {
+	// the reported limits are in the units of the arm, except the rotation ones (rad)
+	double unit = space_ == JOINT_SPACE && !arm_->default_is_radian ? RAD_DEGREE : 1;
+	double v, a, j;
+	if (space_ == JOINT_SPACE) {
+		v = (speed_ > 0 ? speed_ : arm_->joint_speed_limit[1]) / unit;
+		a = (acc_ > 0 ? acc_ : arm_->joint_acc_limit[1]) / unit;
+		j = (jerk_ > 0 ? jerk_ : arm_->joint_jerk) / unit;
+	}
+	else {
+		v = speed_ > 0 ? speed_ : arm_->tcp_speed_limit[1];
+		a = acc_ > 0 ? acc_ : arm_->tcp_acc_limit[1];
+		j = jerk_ > 0 ? jerk_ : arm_->tcp_jerk;
+	}
+	for (int i = 0; i < 7; i++) {
+		vmax[i] = v;
+		amax[i] = a;
+		jmax[i] = j;
+	}
+	if (space_ == CARTESIAN_SPACE) {
+		// the rotation has its own limits, in rad like the reported ones
+		double rot_unit = arm_->default_is_radian ? 1 : RAD_DEGREE;
+		for (int i = 3; i < 6; i++) {
+			vmax[i] = rot_speed_ > 0 ? rot_speed_ / rot_unit : ROT_SPEED;
+			amax[i] = rot_acc_ > 0 ? rot_acc_ / rot_unit : arm_->max_rot_acc;
+			jmax[i] = rot_jerk_ > 0 ? rot_jerk_ / rot_unit : arm_->rot_jerk;
+		}
+	}
+}
+
+void OnlineTrajectoryGenerator::_update_scales(void) {
+	// joints: the farthest joint moves at the full limits, x/y/z and roll/pitch/yaw: the vector norm is limited
+	int groups[2][2] = { { 0, axis_num_ }, { 0, 0 } };
+	if (space_ == CARTESIAN_SPACE) {
+		groups[0][1] = 3;
+		groups[1][0] = 3;
+		groups[1][1] = 6;
+	}
+	for (int g = 0; g < 2; g++) {
+		double norm = 0;
+		for (int i = groups[g][0]; i < groups[g][1]; i++) {
+			double d = fabs(target_[i] - pos_[i]);
+			norm = space_ == JOINT_SPACE ? fmax(norm, d) : norm + d * d;
+		}
+		if (space_ == CARTESIAN_SPACE) norm = sqrt(norm);
+		for (int i = groups[g][0]; i < groups[g][1]; i++) {
+			// a floor, so an axis pushed away by a retarget can still brake
+			scale_[i] = norm > 0 ? fmax(fabs(target_[i] - pos_[i]) / norm, 1e-3) : 1;
+		}
+	}
+}
+
+void OnlineTrajectoryGenerator::_step(void) {
+	double vmax[7], amax[7], jmax[7];
+	_get_limits(vmax, amax, jmax);
+	bool reached = true;
+	for (int i = 0; i < axis_num_; i++) {
+		double k = scale_[i];
+		if (vmax[i] <= 0 || amax[i] <= 0 || jmax[i] <= 0) {
+			// no limit reported yet, hold
+			if (pos_[i] != target_[i]) reached = false;
+			continue;
+		}
+		otg_axis_step(&pos_[i], &vel_[i], &acc_state_[i], target_[i], vmax[i] * k, amax[i] * k, jmax[i] * k, cycle_time_);
+		if (pos_[i] != target_[i] || vel_[i] != 0 || acc_state_[i] != 0) reached = false;
+	}
+	is_reached_ = reached;
+}
+
+void OnlineTrajectoryGenerator::_servo_loop(void) {
+	trace_set_thread_name("servo_loop");
+	UxbusCmd *core = arm_->is_tcp_ ? (UxbusCmd *)arm_->cmd_tcp_ : (UxbusCmd *)arm_->cmd_ser_;
+	std::chrono::steady_clock::time_point next_time = std::chrono::steady_clock::now();
+	std::chrono::microseconds cycle((long long)(cycle_time_ * 1000000));
+	int ack_timeout = (int)(cycle_time_ * 1000) * 10 + 10;
+	int trans_id = -1;
+	int funcode = space_ == CARTESIAN_SPACE ? UXBUS_RG::MOVE_SERVO_CART : UXBUS_RG::MOVE_SERVOJ;
+	bool sent_reached = false;
+	while (is_running_) {
+		next_time += cycle;
+		{
+			// the work of the cycle, without the sleep until the next one
+			XARM_TRACE_SCOPE("servo_cycle");
+			if (!arm_->is_connected()) {
+				last_error_ = UXBUS_STATE::NOT_CONNECTED;
+				break;
+			}
+			if (arm_->has_error()) {
+				last_error_ = UXBUS_STATE::ERR_CODE;
+				break;
+			}
+			float tx[10] = { 0 };
+			bool send = false;
+			bool held = arm_->_is_servo_held();
+			{
+				std::lock_guard<std::mutex> locker(mutex_);
+				if (held) {
+					// on a stale report no setpoint is sent, the arm stops at the last one and the generator resumes from rest there
+					for (int i = 0; i < axis_num_; i++) {
+						vel_[i] = 0;
+						acc_state_[i] = 0;
+					}
+				}
+				else {
+					if (!is_reached_) sent_reached = false;
+					_step();
+					// keep quiet once the target is held
+					send = !sent_reached;
+					sent_reached = is_reached_;
+					for (int i = 0; i < axis_num_; i++) tx[i] = (float)pos_[i];
+				}
+			}
+			// the ack of the last setpoint is collected one cycle later, the loop never waits a round trip
+			if (trans_id >= 0) {
+				int ret = funcode == UXBUS_RG::MOVE_SERVO_CART ? core->pend_cmd<UXBUS_CMD::MOVE_SERVO_CART>(trans_id, NULL, ack_timeout)
+					: core->pend_cmd<UXBUS_CMD::MOVE_SERVOJ>(trans_id, NULL, ack_timeout);
+				trans_id = -1;
+				if (ret != 0 && ret != UXBUS_STATE::WAR_CODE) {
+					last_error_ = ret;
+					break;
+				}
+			}
+			if (send) {
+				trans_id = funcode == UXBUS_RG::MOVE_SERVO_CART ? core->post_cmd<UXBUS_CMD::MOVE_SERVO_CART>(tx)
+					: core->post_cmd<UXBUS_CMD::MOVE_SERVOJ>(tx);
+				if (trans_id < 0) {
+					last_error_ = UXBUS_STATE::NOT_CONNECTED;
+					break;
+				}
+			}
+		}
+		std::this_thread::sleep_until(next_time);
+	}
+	if (trans_id >= 0) {
+		if (funcode == UXBUS_RG::MOVE_SERVO_CART) core->pend_cmd<UXBUS_CMD::MOVE_SERVO_CART>(trans_id, NULL, ack_timeout);
+		else core->pend_cmd<UXBUS_CMD::MOVE_SERVOJ>(trans_id, NULL, ack_timeout);
+	}
+	is_running_ = false;
+}
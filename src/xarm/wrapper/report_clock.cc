@@ -0,0 +1,153 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+#include <math.h>
+#include "xarm/wrapper/report_clock.h"
+
+// an outage longer than that may have drifted by more than a period, the index of the next report is unknown
+#define MAX_OUTAGE_US 2000000LL
+// the reports moved to earlier periods for one arrival, more means the reports come faster than the fit
+#define MAX_SHIFT_NUM 8
+
+ReportClockEstimator::ReportClockEstimator(void) {
+	path_delay_us_ = 0;
+	reset();
+}
+
+void ReportClockEstimator::reset(void) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	_restart();
+	reset_num_ = 0;
+	last_arrival_us_ = 0;
+	last_acquire_us_ = 0;
+	kernel_stamp_ = false;
+}
+
+void ReportClockEstimator::_restart(void) {
+	next_ = 0;
+	count_ = 0;
+	last_index_ = -1;
+	fitted_ = false;
+	base_us_ = 0;
+	slope_ = 0;
+	queue_delay_us_ = 0;
+}
+
+void ReportClockEstimator::set_path_delay_us(long long path_delay_us) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	path_delay_us_ = path_delay_us > 0 ? path_delay_us : 0;
+}
+
+long long ReportClockEstimator::on_report(long long arrival_us, bool kernel_stamp) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	long long index = 0;
+	if (count_ > 0) {
+		// the stamps of the thread and of the kernel may cross when switching
+		if (arrival_us < last_arrival_us_) arrival_us = last_arrival_us_;
+		long long max_outage_us = fitted_ && slope_ * 8 > MAX_OUTAGE_US ? (long long)(slope_ * 8) : MAX_OUTAGE_US;
+		if (arrival_us - last_arrival_us_ > max_outage_us) {
+			_restart();
+			reset_num_ += 1;
+		}
+	}
+	if (count_ > 0) {
+		index = last_index_ + 1;
+		if (fitted_) {
+			// the arrivals delayed by less than 3/4 of a period get the index of their period
+			long long predicted = (long long)floor((arrival_us - base_us_) / slope_ + 0.25);
+			if (predicted > last_index_) index = predicted;
+			else if (_shift_back(predicted)) index = predicted;
+			else {
+				// the controller restarted or changed its period
+				_restart();
+				reset_num_ += 1;
+				index = 0;
+			}
+		}
+	}
+	index_[next_] = index;
+	arrival_[next_] = arrival_us;
+	next_ = (next_ + 1) % WINDOW_NUM;
+	if (count_ < WINDOW_NUM) count_ += 1;
+	last_index_ = index;
+	last_arrival_us_ = arrival_us;
+	kernel_stamp_ = kernel_stamp;
+	if (count_ >= MIN_NUM) _fit();
+	last_acquire_us_ = fitted_ ? (long long)floor(base_us_ + slope_ * index + 0.5) - path_delay_us_ : 0;
+	return last_acquire_us_;
+}
+
+bool ReportClockEstimator::_shift_back(long long index) {
+	// the reports come in order, the ones before were delayed into a later period than theirs,
+	//   an earlier period only lifts them over the envelope
+	long long need = index - 1;
+	int slot = (next_ + WINDOW_NUM - 1) % WINDOW_NUM;
+	for (int n = 0; n < count_; n++) {
+		if (index_[slot] <= need) return true;
+		if (n >= MAX_SHIFT_NUM) return false;
+		index_[slot] = need;
+		need -= 1;
+		slot = (slot + WINDOW_NUM - 1) % WINDOW_NUM;
+	}
+	return true;
+}
+
+void ReportClockEstimator::_fit(void) {
+	int first = count_ < WINDOW_NUM ? 0 : next_;
+	// relative to the oldest report, so the doubles keep the microseconds
+	long long x0 = index_[first];
+	long long y0 = arrival_[first];
+	double sum_x = 0, sum_y = 0;
+	int hull_num = 0;
+	for (int n = 0; n < count_; n++) {
+		int i = (first + n) % WINDOW_NUM;
+		double x = (double)(index_[i] - x0);
+		double y = (double)(arrival_[i] - y0);
+		sum_x += x;
+		sum_y += y;
+		// the lower hull turns counterclockwise
+		while (hull_num >= 2) {
+			int a = hull_[hull_num - 2], b = hull_[hull_num - 1];
+			double xa = (double)(index_[a] - x0), ya = (double)(arrival_[a] - y0);
+			double xb = (double)(index_[b] - x0), yb = (double)(arrival_[b] - y0);
+			if ((xb - xa) * (y - ya) - (yb - ya) * (x - xa) > 0) break;
+			hull_num -= 1;
+		}
+		hull_[hull_num++] = i;
+	}
+	if (hull_num < 2) return;
+	double mean_x = sum_x / count_;
+	int edge = 0;
+	while (edge < hull_num - 2 && (double)(index_[hull_[edge + 1]] - x0) < mean_x) edge += 1;
+	int a = hull_[edge], b = hull_[edge + 1];
+	double xa = (double)(index_[a] - x0), ya = (double)(arrival_[a] - y0);
+	double slope = ((double)(arrival_[b] - y0) - ya) / ((double)(index_[b] - x0) - xa);
+	// a burst of queued reports at the start can leave no rising edge yet
+	if (slope <= 0) return;
+	double base = ya - slope * xa;
+	slope_ = slope;
+	base_us_ = (double)y0 + base - slope * (double)x0;
+	queue_delay_us_ = (sum_y - count_ * (base + slope * mean_x)) / count_;
+	fitted_ = true;
+}
+
+void ReportClockEstimator::get_estimate(ClockEstimate *estimate) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	estimate->valid = fitted_;
+	estimate->kernel_stamp = kernel_stamp_;
+	estimate->sample_num = count_;
+	estimate->reset_num = reset_num_;
+	estimate->period_us = slope_;
+	estimate->nominal_period_us = slope_ >= 1000 ? floor(slope_ / 1000 + 0.5) * 1000 : slope_;
+	estimate->drift_ppm = fitted_ && estimate->nominal_period_us > 0 ? (slope_ / estimate->nominal_period_us - 1) * 1e6 : 0;
+	estimate->offset_us = fitted_ ? (long long)floor(base_us_ + 0.5) - path_delay_us_ : 0;
+	estimate->path_delay_us = path_delay_us_;
+	estimate->queue_delay_us = (long long)floor(queue_delay_us_ + 0.5);
+	estimate->last_arrival_us = last_arrival_us_;
+	estimate->last_acquire_us = last_acquire_us_;
+}
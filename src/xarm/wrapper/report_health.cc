@@ -0,0 +1,122 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+#include <math.h>
+#include <string.h>
+#include "xarm/wrapper/report_health.h"
+
+// the intervals kept in the window are clamped, so the sum of their squares can not overflow
+static const long long MAX_INTERVAL_US = 100000000;
+
+ReportHealthMonitor::ReportHealthMonitor(void) {
+	stale_us_ = 0;
+	reset();
+}
+
+void ReportHealthMonitor::reset(void) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	last_recv_us_ = 0;
+	stale_ = false;
+	next_ = 0;
+	count_ = 0;
+	sum_ = 0;
+	sum_sq_ = 0;
+	report_num_ = 0;
+	gap_num_ = 0;
+	stale_num_ = 0;
+	delay_us_ = 0;
+	last_interval_us_ = 0;
+	jitter_us_ = 0;
+	max_gap_us_ = 0;
+}
+
+void ReportHealthMonitor::set_stale_threshold(long long stale_us) { stale_us_ = stale_us; }
+
+long long ReportHealthMonitor::get_stale_threshold(void) { return stale_us_; }
+
+bool ReportHealthMonitor::on_report(long long recv_us, long long now_us) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	long long last_recv_us = last_recv_us_;
+	report_num_ += 1;
+	delay_us_ = now_us - recv_us;
+	if (last_recv_us > 0) {
+		long long interval = recv_us - last_recv_us;
+		if (interval < 0) interval = 0;
+		if (interval > max_gap_us_) max_gap_us_ = interval;
+		// a gap against the mean of the intervals before it
+		if (count_ >= 8 && interval > 2 * sum_ / count_) gap_num_ += 1;
+		if (report_num_ > 2) {
+			long long diff = interval - last_interval_us_;
+			jitter_us_ += ((diff < 0 ? -diff : diff) - jitter_us_) / 16;
+		}
+		last_interval_us_ = interval;
+
+		long long kept = interval < MAX_INTERVAL_US ? interval : MAX_INTERVAL_US;
+		if (count_ == WINDOW_NUM) {
+			sum_ -= intervals_[next_];
+			sum_sq_ -= intervals_[next_] * intervals_[next_];
+		}
+		else {
+			count_ += 1;
+		}
+		intervals_[next_] = kept;
+		sum_ += kept;
+		sum_sq_ += kept * kept;
+		next_ = (next_ + 1) % WINDOW_NUM;
+	}
+	last_recv_us_ = recv_us;
+	bool was_stale = stale_;
+	stale_ = false;
+	return was_stale;
+}
+
+bool ReportHealthMonitor::check(long long now_us) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	if (stale_ || !is_stale(now_us)) return false;
+	stale_ = true;
+	stale_num_ += 1;
+	return true;
+}
+
+long long ReportHealthMonitor::get_age_us(long long now_us) {
+	long long last_recv_us = last_recv_us_;
+	return last_recv_us > 0 ? now_us - last_recv_us : -1;
+}
+
+bool ReportHealthMonitor::is_stale(long long now_us) {
+	long long stale_us = stale_us_;
+	if (stale_us <= 0) return false;
+	long long last_recv_us = last_recv_us_;
+	// no report yet is stale too, nothing is known of the arm
+	return last_recv_us <= 0 || now_us - last_recv_us > stale_us;
+}
+
+void ReportHealthMonitor::get_health(ReportHealth *health, long long now_us, long long drop_num) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	memset(health, 0, sizeof(ReportHealth));
+	health->report_num = report_num_;
+	health->drop_num = drop_num;
+	health->gap_num = gap_num_;
+	health->stale_num = stale_num_;
+	health->age_us = get_age_us(now_us);
+	health->delay_us = delay_us_;
+	health->last_interval_us = last_interval_us_;
+	health->jitter_us = jitter_us_;
+	health->max_gap_us = max_gap_us_;
+	health->stale = is_stale(now_us);
+	if (count_ == 0) return;
+	health->mean_interval_us = sum_ / count_;
+	double var = (double)sum_sq_ / count_ - (double)sum_ / count_ * ((double)sum_ / count_);
+	health->std_interval_us = var > 0 ? (long long)sqrt(var) : 0;
+	health->min_interval_us = intervals_[0];
+	health->max_interval_us = intervals_[0];
+	for (int i = 1; i < count_; i++) {
+		if (intervals_[i] < health->min_interval_us) health->min_interval_us = intervals_[i];
+		if (intervals_[i] > health->max_interval_us) health->max_interval_us = intervals_[i];
+	}
+}
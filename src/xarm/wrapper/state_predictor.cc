@@ -0,0 +1,144 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+#include <math.h>
+#include <string.h>
+#include "xarm/wrapper/state_predictor.h"
+#include "xarm/core/instruction/uxbus_cmd_config.h"
+
+// the differences over a longer outage are not speeds
+#define MAX_REPORT_GAP_US 500000LL
+
+static const double PI_ = 3.14159265358979323846;
+
+static double wrap_angle_(double angle) {
+	while (angle > PI_) angle -= 2 * PI_;
+	while (angle < -PI_) angle += 2 * PI_;
+	return angle;
+}
+
+StatePredictor::StatePredictor(void) {
+	lock_ = 0;
+	horizon_us_ = 20000;
+	reset();
+}
+
+void StatePredictor::reset(void) {
+	memset(&last_, 0, sizeof(last_));
+	history_ = 0;
+	acquired_ = false;
+	error_next_ = 0;
+	error_num_ = 0;
+	unsigned int lock = lock_.load(std::memory_order_relaxed);
+	lock_.store(lock + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	model_ = last_;
+	lock_.store(lock + 2, std::memory_order_release);
+}
+
+void StatePredictor::set_horizon_us(long long horizon_us) {
+	horizon_us_ = horizon_us > 0 ? horizon_us : 0;
+}
+
+long long StatePredictor::get_horizon_us(void) {
+	return horizon_us_;
+}
+
+void StatePredictor::_extrapolate(const Model_ &model, double dt, float *angles, float *joint_speeds, float *position, float *tcp_speeds) {
+	for (int i = 0; i < 7; i++) {
+		angles[i] = (float)(model.angles[i] + model.joint_speeds[i] * dt + 0.5 * model.joint_acc[i] * dt * dt);
+		joint_speeds[i] = (float)(model.joint_speeds[i] + model.joint_acc[i] * dt);
+	}
+	for (int i = 0; i < 6; i++) {
+		double value = model.position[i] + model.tcp_speeds[i] * dt + 0.5 * model.tcp_acc[i] * dt * dt;
+		position[i] = (float)(i < 3 ? value : wrap_angle_(value));
+		tcp_speeds[i] = (float)(model.tcp_speeds[i] + model.tcp_acc[i] * dt);
+	}
+}
+
+void StatePredictor::update(long long report_us, bool acquired, const float *angles, const float *position, const float *joint_speeds) {
+	long long gap_us = report_us - last_.report_us;
+	// the acquisitions and the arrivals are apart by the delay of the reports, their differences are not speeds
+	if (!last_.valid || acquired != acquired_ || gap_us <= 0 || gap_us > MAX_REPORT_GAP_US) history_ = 0;
+	history_ += 1;
+	acquired_ = acquired;
+	double dt = gap_us / 1000000.0;
+
+	if (history_ >= 2) {
+		// how far the prediction of the last model is from this report
+		long long horizon_us = horizon_us_;
+		double pred_dt = (gap_us < horizon_us ? gap_us : horizon_us) / 1000000.0;
+		float pred_angles[7], pred_joint_speeds[7], pred_position[6], pred_tcp_speeds[6];
+		_extrapolate(last_, pred_dt, pred_angles, pred_joint_speeds, pred_position, pred_tcp_speeds);
+		float joint_error = 0, tcp_error = 0;
+		for (int i = 0; i < 7; i++) joint_error = fmaxf(joint_error, fabsf(pred_angles[i] - angles[i]));
+		for (int i = 0; i < 3; i++) tcp_error = fmaxf(tcp_error, fabsf(pred_position[i] - position[i]));
+		joint_errors_[error_next_] = joint_error;
+		tcp_errors_[error_next_] = tcp_error;
+		error_next_ = (error_next_ + 1) % ERROR_NUM;
+		if (error_num_ < ERROR_NUM) error_num_ += 1;
+	}
+
+	Model_ model;
+	model.report_us = report_us;
+	model.valid = true;
+	model.measured_speeds = joint_speeds != NULL;
+	for (int i = 0; i < 7; i++) {
+		model.angles[i] = angles[i];
+		if (joint_speeds != NULL) model.joint_speeds[i] = joint_speeds[i];
+		else model.joint_speeds[i] = history_ >= 2 ? (float)((angles[i] - last_.angles[i]) / dt) : 0;
+		// the speeds of the last model are differences too from the third report on
+		bool has_acc = joint_speeds != NULL && last_.measured_speeds ? history_ >= 2 : history_ >= 3;
+		model.joint_acc[i] = has_acc ? (float)((model.joint_speeds[i] - last_.joint_speeds[i]) / dt) : 0;
+	}
+	for (int i = 0; i < 6; i++) {
+		model.position[i] = position[i];
+		double diff = position[i] - last_.position[i];
+		if (i >= 3) diff = wrap_angle_(diff);
+		model.tcp_speeds[i] = history_ >= 2 ? (float)(diff / dt) : 0;
+		model.tcp_acc[i] = history_ >= 3 ? (float)((model.tcp_speeds[i] - last_.tcp_speeds[i]) / dt) : 0;
+	}
+	model.joint_error = 0;
+	model.tcp_error = 0;
+	for (int i = 0; i < error_num_; i++) {
+		model.joint_error = fmaxf(model.joint_error, joint_errors_[i]);
+		model.tcp_error = fmaxf(model.tcp_error, tcp_errors_[i]);
+	}
+	last_ = model;
+
+	unsigned int lock = lock_.load(std::memory_order_relaxed);
+	lock_.store(lock + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	model_ = model;
+	lock_.store(lock + 2, std::memory_order_release);
+}
+
+int StatePredictor::predict(long long time_us, PredictedState *state) {
+	Model_ model;
+	while (true) {
+		unsigned int lock = lock_.load(std::memory_order_acquire);
+		if (lock & 1) continue;
+		model = model_;
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (lock_.load(std::memory_order_relaxed) == lock) break;
+	}
+	if (!model.valid) return UXBUS_STATE::NOT_READY;
+	long long horizon_us = horizon_us_;
+	long long dt_us = time_us - model.report_us;
+	state->clamped = dt_us > horizon_us || dt_us < -horizon_us;
+	if (dt_us > horizon_us) dt_us = horizon_us;
+	if (dt_us < -horizon_us) dt_us = -horizon_us;
+	state->time_us = time_us;
+	state->report_us = model.report_us;
+	state->horizon_us = dt_us;
+	state->measured_speeds = model.measured_speeds;
+	state->joint_error = model.joint_error;
+	state->tcp_error = model.tcp_error;
+	_extrapolate(model, dt_us / 1000000.0, state->angles, state->joint_speeds, state->position, state->tcp_speeds);
+	return 0;
+}
@@ -0,0 +1,236 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+#include <string.h>
+#include <stddef.h>
+#include <stdlib.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include "xarm/core/instruction/uxbus_cmd_config.h"
+#include "xarm/wrapper/state_shm.h"
+
+// the reads of the last report before falling back to the previous one
+#define MAX_READ_TRIES 4
+
+static size_t shm_size_(unsigned int slot_num) {
+	return offsetof(RobotStateShm, slots) + sizeof(RobotStateShm::Slot) * slot_num;
+}
+
+StatePublisher::StatePublisher(void) {
+	shm_ = NULL;
+	is_local_ = false;
+	size_ = 0;
+	seq_ = 0;
+}
+
+StatePublisher::~StatePublisher(void) {
+	close();
+}
+
+int StatePublisher::open(const std::string &name, int slot_num) {
+	if (slot_num < 1 || slot_num > 1024) return UXBUS_STATE::ERR_PARAM;
+	close();
+#ifdef _WIN32
+	return -1;
+#else
+	int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+	if (fd < 0) return -1;
+	size_t size = shm_size_(slot_num);
+	if (ftruncate(fd, size) != 0) {
+		::close(fd);
+		return -1;
+	}
+	void *addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (addr == MAP_FAILED) return -1;
+	_init_segment(addr, size, slot_num);
+	name_ = name;
+	return 0;
+#endif
+}
+
+int StatePublisher::open_local(int slot_num) {
+	if (slot_num < 1 || slot_num > 1024) return UXBUS_STATE::ERR_PARAM;
+	close();
+	size_t size = shm_size_(slot_num);
+	void *addr = calloc(1, size);
+	if (addr == NULL) return -1;
+	_init_segment(addr, size, slot_num);
+	is_local_ = true;
+	return 0;
+}
+
+void StatePublisher::_init_segment(void *addr, size_t size, int slot_num) {
+	shm_ = (RobotStateShm *)addr;
+	// a reader checks the magic last, after the layout is written
+	shm_->magic = 0;
+	shm_->version = RobotStateShm::VERSION;
+	shm_->state_size = sizeof(RobotState);
+	shm_->slot_num = slot_num;
+	shm_->seq.store(0);
+	for (int i = 0; i < slot_num; i++) {
+		shm_->slots[i].lock.store(0);
+		memset(&shm_->slots[i].state, 0, sizeof(RobotState));
+	}
+	std::atomic_thread_fence(std::memory_order_release);
+	shm_->magic = RobotStateShm::MAGIC;
+	size_ = size;
+	seq_ = 0;
+}
+
+void StatePublisher::close(void) {
+	if (shm_ == NULL) return;
+	if (is_local_) {
+		free(shm_);
+		is_local_ = false;
+	}
+	else {
+#ifndef _WIN32
+		munmap(shm_, size_);
+		shm_unlink(name_.c_str());
+#endif
+	}
+	shm_ = NULL;
+}
+
+bool StatePublisher::is_open(void) {
+	return shm_ != NULL;
+}
+
+void StatePublisher::publish(RobotState &state) {
+	if (shm_ == NULL) return;
+	seq_ += 1;
+	state.seq = seq_;
+	RobotStateShm::Slot &slot = shm_->slots[(seq_ - 1) % shm_->slot_num];
+	unsigned int lock = slot.lock.load(std::memory_order_relaxed);
+	slot.lock.store(lock + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	memcpy(&slot.state, &state, sizeof(RobotState));
+	slot.lock.store(lock + 2, std::memory_order_release);
+	shm_->seq.store(seq_, std::memory_order_release);
+}
+
+const RobotState *StatePublisher::peek(unsigned int *lock) {
+	if (shm_ == NULL) return NULL;
+	while (true) {
+		long long seq = shm_->seq.load(std::memory_order_acquire);
+		if (seq == 0) return NULL;
+		RobotStateShm::Slot &slot = shm_->slots[(seq - 1) % shm_->slot_num];
+		*lock = slot.lock.load(std::memory_order_acquire);
+		// odd: the slot of the last report is already rewritten, take the new last one
+		if ((*lock & 1) == 0) return &slot.state;
+	}
+}
+
+bool StatePublisher::is_current(const RobotState *state, unsigned int lock) {
+	if (shm_ == NULL || state == NULL) return false;
+	const RobotStateShm::Slot *slot = (const RobotStateShm::Slot *)((const char *)state - offsetof(RobotStateShm::Slot, state));
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return slot->lock.load(std::memory_order_relaxed) == lock;
+}
+
+StateReader::StateReader(void) {
+	shm_ = NULL;
+	size_ = 0;
+	memset(&last_, 0, sizeof(last_));
+}
+
+StateReader::~StateReader(void) {
+	close();
+}
+
+int StateReader::open(const std::string &name) {
+	close();
+	memset(&last_, 0, sizeof(last_));
+#ifdef _WIN32
+	return -1;
+#else
+	int fd = shm_open(name.c_str(), O_RDONLY, 0);
+	if (fd < 0) return -1;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < shm_size_(1)) {
+		::close(fd);
+		return UXBUS_STATE::ERR_PARAM;
+	}
+	// the segment is 0644, the reader only loads the atomics
+	void *addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (addr == MAP_FAILED) return -1;
+	RobotStateShm *shm = (RobotStateShm *)addr;
+	bool ok = shm->magic == RobotStateShm::MAGIC;
+	std::atomic_thread_fence(std::memory_order_acquire);
+	ok = ok && shm->version == RobotStateShm::VERSION && shm->state_size == sizeof(RobotState)
+		&& shm->slot_num > 0 && shm_size_(shm->slot_num) <= (size_t)st.st_size;
+	if (!ok) {
+		munmap(addr, st.st_size);
+		return UXBUS_STATE::ERR_PARAM;
+	}
+	shm_ = shm;
+	size_ = st.st_size;
+	return 0;
+#endif
+}
+
+void StateReader::close(void) {
+#ifndef _WIN32
+	if (shm_ == NULL) return;
+	munmap(shm_, size_);
+	shm_ = NULL;
+#endif
+}
+
+bool StateReader::is_open(void) {
+	return shm_ != NULL;
+}
+
+long long StateReader::get_seq(void) {
+	if (shm_ == NULL) return 0;
+	return shm_->seq.load(std::memory_order_acquire);
+}
+
+bool StateReader::_read_slot(long long seq, RobotState *state) {
+	RobotStateShm::Slot &slot = shm_->slots[(seq - 1) % shm_->slot_num];
+	unsigned int lock = slot.lock.load(std::memory_order_acquire);
+	if (lock & 1) return false;
+	memcpy(state, &slot.state, sizeof(RobotState));
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if (slot.lock.load(std::memory_order_relaxed) != lock) return false;
+	return state->seq == seq;
+}
+
+int StateReader::get_latest(RobotState *state) {
+	if (shm_ == NULL) return -1;
+	for (int i = 0; i < MAX_READ_TRIES; i++) {
+		long long seq = get_seq();
+		if (seq == 0) return UXBUS_STATE::NOT_READY;
+		if (_read_slot(seq, state)) {
+			memcpy(&last_, state, sizeof(RobotState));
+			return 0;
+		}
+	}
+	// the ring was rewritten during every read, the older slots go first
+	if (last_.seq == 0) return UXBUS_STATE::ERR_TOUT;
+	memcpy(state, &last_, sizeof(RobotState));
+	return 0;
+}
+
+int StateReader::get_recent(RobotState *states, int num) {
+	if (shm_ == NULL) return 0;
+	long long seq = get_seq();
+	int count = 0;
+	for (int i = 0; i < num && seq - i > 0 && i < (int)shm_->slot_num; i++) {
+		// an old slot being rewritten is gone, so are the older ones
+		if (!_read_slot(seq - i, &states[count])) break;
+		count += 1;
+	}
+	return count;
+}
@@ -0,0 +1,140 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+#include "xarm/wrapper/tool_bus_scheduler.h"
+
+ToolBusScheduler::ToolBusScheduler(XArmAPI *arm) {
+	arm_ = arm;
+	device_num_ = 0;
+	cycle_num_ = 0;
+	last_state_ = 0;
+	last_request_num_ = 0;
+}
+
+ToolBusScheduler::~ToolBusScheduler(void) {
+	stop();
+}
+
+int ToolBusScheduler::add_device(ModbusDevice *device) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	for (int i = 0; i < device_num_; i++) {
+		if (devices_[i] == device) return 0;
+	}
+	if (device_num_ >= MAX_DEVICES) return UXBUS_STATE::ERR_PARAM;
+	devices_[device_num_++] = device;
+	return 0;
+}
+
+void ToolBusScheduler::remove_device(ModbusDevice *device) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	for (int i = 0; i < device_num_; i++) {
+		if (devices_[i] != device) continue;
+		for (int j = i + 1; j < device_num_; j++) devices_[j - 1] = devices_[j];
+		device_num_ -= 1;
+		break;
+	}
+}
+
+int ToolBusScheduler::start(int cycle) {
+	int ret = arm_->_check_background_port();
+	if (ret != 0) return ret;
+	if (cycle <= 0) return UXBUS_STATE::ERR_PARAM;
+	if (poller_.is_running()) return 0;
+	cycle_num_ = 0;
+	last_state_ = 0;
+	poller_.start("tool_bus_scheduler", cycle * 1000LL, std::bind(&ToolBusScheduler::_poll, this));
+	return 0;
+}
+
+void ToolBusScheduler::stop(void) {
+	poller_.stop();
+}
+
+bool ToolBusScheduler::is_running(void) {
+	return poller_.is_running();
+}
+
+long long ToolBusScheduler::get_cycle_num(void) {
+	return cycle_num_;
+}
+
+int ToolBusScheduler::get_last_state(void) {
+	return last_state_;
+}
+
+int ToolBusScheduler::get_last_request_num(void) {
+	return last_request_num_;
+}
+
+void ToolBusScheduler::_cycle(void) {
+	long long now = get_system_time();
+	trans_.clear();
+	for (int n = 0; n < device_num_; n++) {
+		// the first device turns every cycle, so a full transaction does not always leave out the same ones
+		int k = (int)((cycle_num_ + n) % device_num_);
+		ModbusDevice *device = devices_[k];
+		std::lock_guard<std::mutex> locker(device->mutex_);
+		trans_.select_slave(device->slave_id_);
+		// the writes go before the reads, the ones that do not fit wait for the next cycle
+		write_op_num_[k] = 0;
+		for (int i = 0; i < device->write_num_; i++) {
+			ModbusDevice::Write &write = device->writes_[i];
+			int op = trans_.write_regs(write.addr, &device->write_regs_[write.offset], write.num);
+			if (op < 0) break;
+			write_ops_[k][write_op_num_[k]++] = op;
+		}
+		for (int i = 0; i < ModbusDevice::MAX_BLOCKS; i++) {
+			block_ops_[k][i] = -1;
+			if (i >= device->block_num_ || device->blocks_[i].next_time > now) continue;
+			ModbusDevice::Block &block = device->blocks_[i];
+			// a read that does not fit (< 0) stays due
+			block_ops_[k][i] = block.funcode == 0x04 ? trans_.read_input(block.addr, block.num) : trans_.read_holding(block.addr, block.num);
+		}
+	}
+	if (trans_.get_op_num() == 0) return;
+	int ret = trans_.execute(arm_);
+	last_state_ = ret;
+	last_request_num_ = trans_.get_request_num();
+
+	for (int k = 0; k < device_num_; k++) {
+		ModbusDevice *device = devices_[k];
+		std::lock_guard<std::mutex> locker(device->mutex_);
+		int sent = write_op_num_[k];
+		if (sent > 0) {
+			int write_ret = 0;
+			for (int i = 0; i < sent && write_ret == 0; i++) write_ret = trans_.get_state(write_ops_[k][i]);
+			// drop the sent writes, the ones queued meanwhile stay
+			int reg_num = sent < device->write_num_ ? device->writes_[sent].offset : device->write_reg_num_;
+			for (int i = sent; i < device->write_num_; i++) {
+				device->writes_[i - sent] = device->writes_[i];
+				device->writes_[i - sent].offset -= reg_num;
+			}
+			for (int i = reg_num; i < device->write_reg_num_; i++) device->write_regs_[i - reg_num] = device->write_regs_[i];
+			device->write_num_ -= sent;
+			device->write_reg_num_ -= reg_num;
+			device->write_ret_ = device->write_num_ > 0 && write_ret == 0 ? UXBUS_STATE::NOT_READY : write_ret;
+		}
+		for (int i = 0; i < device->block_num_; i++) {
+			int op = block_ops_[k][i];
+			if (op < 0) continue;
+			ModbusDevice::Block &block = device->blocks_[i];
+			block.ret = trans_.get_state(op);
+			block.next_time = now + block.period;
+			if (!UxbusCmd::has_reply(block.ret)) continue;
+			block.time = now;
+			for (int j = 0; j < block.num; j++) device->image_[block.offset + j] = (unsigned short)trans_.get_u16(op, j);
+		}
+	}
+}
+
+void ToolBusScheduler::_poll(void) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	if (arm_->is_connected()) _cycle();
+	else last_state_ = UXBUS_STATE::NOT_CONNECTED;
+	cycle_num_ += 1;
+}
@@ -0,0 +1,548 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+#include <chrono>
+#include "xarm/wrapper/trajectory_planner.h"
+
+#define BLEND_SAMPLES 16
+
+TrajectoryPlanner::TrajectoryPlanner(int space, bool is_radian) {
+	space_ = space;
+	axis_num_ = space == CARTESIAN_SPACE ? 6 : 7;
+	angle_period_ = is_radian ? 360 / RAD_DEGREE : 360;
+	blend_radius_ = 0;
+	cycle_time_ = 0.004;
+	duration_ = 0;
+	has_limits_ = false;
+	for (int i = 0; i < 7; i++) {
+		speed_[i] = 0;
+		acc_[i] = 0;
+	}
+	for (int i = 0; i < 2; i++) {
+		part_speed_[i] = 0;
+		part_acc_[i] = 0;
+	}
+	for (int i = 0; i < 7; i++) scale_[i] = 1;
+}
+
+void TrajectoryPlanner::clear(void) {
+	for (int i = 0; i < 7; i++) {
+		waypoints_[i].clear();
+		setpoints_[i].clear();
+	}
+	duration_ = 0;
+}
+
+int TrajectoryPlanner::add_waypoint(const fp32 *point) {
+	int n = get_waypoint_num();
+	fp32 value[7];
+	for (int i = 0; i < axis_num_; i++) {
+		value[i] = point[i];
+		// the rotation from the last waypoint the short way round, the waypoints may leave (-180, 180]
+		if (space_ == CARTESIAN_SPACE && i >= 3 && n > 0) {
+			value[i] = (fp32)(waypoints_[i][n - 1] + _wrap_angle(point[i] - waypoints_[i][n - 1]));
+		}
+	}
+	if (n > 0) {
+		bool same = true;
+		for (int i = 0; i < axis_num_ && same; i++) same = waypoints_[i][n - 1] == value[i];
+		if (same) return 0;
+	}
+	for (int i = 0; i < axis_num_; i++) waypoints_[i].push_back(value[i]);
+	return 0;
+}
+
+int TrajectoryPlanner::get_waypoint_num(void) {
+	return (int)waypoints_[0].size();
+}
+
+void TrajectoryPlanner::set_limits(const fp32 *speed, const fp32 *acc) {
+	has_limits_ = true;
+	for (int i = 0; i < axis_num_; i++) {
+		speed_[i] = speed[i];
+		acc_[i] = acc[i];
+		if (speed_[i] <= 0 || acc_[i] <= 0) has_limits_ = false;
+	}
+	for (int i = 0; i < 7; i++) scale_[i] = 1;
+	if (space_ == CARTESIAN_SPACE) {
+		for (int i = 0; i < 2; i++) {
+			part_speed_[i] = fmin(speed_[i * 3], fmin(speed_[i * 3 + 1], speed_[i * 3 + 2]));
+			part_acc_[i] = fmin(acc_[i * 3], fmin(acc_[i * 3 + 1], acc_[i * 3 + 2]));
+		}
+		// a rotation counts as the mm the linear speed covers while the angular speed turns it
+		if (has_limits_) {
+			for (int i = 3; i < 6; i++) scale_[i] = part_speed_[0] / part_speed_[1];
+		}
+	}
+}
+
+// into (-period / 2, period / 2]
+double TrajectoryPlanner::_wrap_angle(double angle) {
+	angle = fmod(angle, angle_period_);
+	if (angle > angle_period_ / 2) angle -= angle_period_;
+	else if (angle <= -angle_period_ / 2) angle += angle_period_;
+	return angle;
+}
+
+// |dq/ds|, |d2q/ds2| and the limits of every scaled axis at a sample, in cartesian space followed by
+//   the linear and the angular part
+int TrajectoryPlanner::_limit_axes(int index, double *dq, double *ddq, double *speed, double *acc) {
+	for (int k = 0; k < axis_num_; k++) {
+		dq[k] = sdq_[k][index];
+		ddq[k] = sddq_[k][index];
+		speed[k] = speed_[k] * scale_[k];
+		acc[k] = acc_[k] * scale_[k];
+	}
+	if (space_ != CARTESIAN_SPACE) return axis_num_;
+	for (int i = 0; i < 2; i++) {
+		double dq2 = 0, ddq2 = 0;
+		for (int k = i * 3; k < i * 3 + 3; k++) {
+			dq2 += sdq_[k][index] * sdq_[k][index];
+			ddq2 += sddq_[k][index] * sddq_[k][index];
+		}
+		dq[axis_num_ + i] = sqrt(dq2);
+		ddq[axis_num_ + i] = sqrt(ddq2);
+		speed[axis_num_ + i] = part_speed_[i] * scale_[i * 3];
+		acc[axis_num_ + i] = part_acc_[i] * scale_[i * 3];
+	}
+	return axis_num_ + 2;
+}
+
+void TrajectoryPlanner::set_blend_radius(fp32 radius) {
+	blend_radius_ = radius > 0 ? radius : 0;
+}
+
+void TrajectoryPlanner::_add_sample(const double *q, const double *dq, const double *ddq, double ds, int blend, double tau, double dtau) {
+	for (int k = 0; k < axis_num_; k++) {
+		sq_[k].push_back(q[k]);
+		sdq_[k].push_back(fabs(dq[k]));
+		sddq_[k].push_back(fabs(ddq[k]));
+	}
+	sds_.push_back(ds);
+	sblend_.push_back(blend);
+	stau_.push_back(tau);
+	sdtau_.push_back(dtau);
+}
+
+// point, first and second derivative of a blend at tau
+void TrajectoryPlanner::_eval_blend(int blend, double tau, double *q, double *d1, double *d2) {
+	for (int k = 0; k < axis_num_; k++) {
+		double p0 = bp0_[k][blend], p1 = bp1_[k][blend], p2 = bp2_[k][blend];
+		q[k] = (1 - tau) * (1 - tau) * p0 + 2 * (1 - tau) * tau * p1 + tau * tau * p2;
+		if (d1 != NULL) d1[k] = 2 * (1 - tau) * (p1 - p0) + 2 * tau * (p2 - p1);
+		if (d2 != NULL) d2[k] = 2 * (p2 - 2 * p1 + p0);
+	}
+}
+
+// lines between the blends, every blend is a quadratic bezier from q[i] - r * u_in to q[i] + r * u_out
+void TrajectoryPlanner::_build_path(void) {
+	int n = get_waypoint_num();
+	for (int k = 0; k < 7; k++) {
+		sq_[k].clear();
+		sdq_[k].clear();
+		sddq_[k].clear();
+		bp0_[k].clear();
+		bp1_[k].clear();
+		bp2_[k].clear();
+	}
+	sds_.clear();
+	sblend_.clear();
+	stau_.clear();
+	sdtau_.clear();
+	bdtau0_.clear();
+	size_t reserve_num = (size_t)n * (BLEND_SAMPLES + 2);
+	for (int k = 0; k < axis_num_; k++) {
+		sq_[k].reserve(reserve_num);
+		sdq_[k].reserve(reserve_num);
+		sddq_[k].reserve(reserve_num);
+	}
+	sds_.reserve(reserve_num);
+	sblend_.reserve(reserve_num);
+	stau_.reserve(reserve_num);
+	sdtau_.reserve(reserve_num);
+	// the path is built on the scaled axes, mm and rad (or degrees) do not add up
+	std::vector<double> wp[7];
+	for (int k = 0; k < axis_num_; k++) {
+		wp[k].resize(n);
+		for (int i = 0; i < n; i++) wp[k][i] = waypoints_[k][i] * scale_[k];
+	}
+	std::vector<double> len(n - 1);
+	for (int i = 0; i < n - 1; i++) {
+		double d2 = 0;
+		for (int k = 0; k < axis_num_; k++) {
+			double d = wp[k][i + 1] - wp[k][i];
+			d2 += d * d;
+		}
+		len[i] = sqrt(d2);
+	}
+	double q[7], dq[7], ddq[7] = { 0 }, prev[7];
+	for (int k = 0; k < axis_num_; k++) {
+		q[k] = wp[k][0];
+		dq[k] = (wp[k][1] - wp[k][0]) / len[0];
+	}
+	_add_sample(q, dq, ddq, 0, -1, 0, 0);
+	double r_in = 0;
+	for (int i = 1; i < n; i++) {
+		// blend radius of the corner at waypoint i, at most half of both segments
+		double r_out = 0;
+		if (i < n - 1) r_out = fmin(blend_radius_, fmin(len[i - 1], len[i]) / 2);
+		double u_in[7], u_out[7];
+		for (int k = 0; k < axis_num_; k++) {
+			u_in[k] = (wp[k][i] - wp[k][i - 1]) / len[i - 1];
+			u_out[k] = i < n - 1 ? (wp[k][i + 1] - wp[k][i]) / len[i] : 0;
+		}
+		// the line up to the blend (or the waypoint)
+		for (int k = 0; k < axis_num_; k++) {
+			q[k] = wp[k][i] - r_out * u_in[k];
+			dq[k] = u_in[k];
+			ddq[k] = 0;
+		}
+		double line_len = len[i - 1] - r_in - r_out;
+		if (line_len > 0) _add_sample(q, dq, ddq, line_len, -1, 0, 0);
+		if (i == n - 1) break;
+		if (r_out <= 0) {
+			// a sharp corner, the arm stops there
+			for (int k = 0; k < axis_num_; k++) dq[k] = 0;
+			_add_sample(q, dq, ddq, 0, -1, 0, 0);
+			r_in = 0;
+			continue;
+		}
+		int blend = (int)bp0_[0].size();
+		for (int k = 0; k < axis_num_; k++) {
+			bp0_[k].push_back(q[k]);
+			bp1_[k].push_back(wp[k][i]);
+			bp2_[k].push_back(wp[k][i] + r_out * u_out[k]);
+			prev[k] = q[k];
+		}
+		for (int j = 0; j <= BLEND_SAMPLES; j++) {
+			double tau = (double)j / BLEND_SAMPLES;
+			double d1[7], d2[7], norm = 0, ds = 0;
+			_eval_blend(blend, tau, q, d1, d2);
+			for (int k = 0; k < axis_num_; k++) {
+				norm += d1[k] * d1[k];
+				ds += (q[k] - prev[k]) * (q[k] - prev[k]);
+				prev[k] = q[k];
+			}
+			norm = sqrt(norm);
+			// derivatives along the arc length: the tangent and the normal part of the second derivative
+			double dot = 0;
+			for (int k = 0; k < axis_num_; k++) {
+				dq[k] = d1[k] / norm;
+				dot += d2[k] * dq[k];
+			}
+			for (int k = 0; k < axis_num_; k++) ddq[k] = (d2[k] - dot * dq[k]) / (norm * norm);
+			if (j == 0) {
+				// the start of the blend is the end of the line (or of the previous blend), it takes the curvature
+				int last = (int)sds_.size() - 1;
+				for (int k = 0; k < axis_num_; k++) sddq_[k][last] = fmax(sddq_[k][last], fabs(ddq[k]));
+				bdtau0_.push_back(1 / norm);
+				continue;
+			}
+			_add_sample(q, dq, ddq, sqrt(ds), blend, tau, 1 / norm);
+		}
+		r_in = r_out;
+	}
+}
+
+// the highest speed reached over the interval ending at sample index, from speed v, when
+//   the path acc is the one left by the centripetal part at that speed:
+//   w^2 = v^2 + 2 * ds * (acc - ddq * w^2) / dq for every axis
+double TrajectoryPlanner::_reach_speed(int index, double v) {
+	double ds = sds_[index];
+	if (ds <= 0) return v;
+	double w2 = 1e30;
+	bool is_line = sblend_[index] < 0;
+	double dq[8], ddq[8], speed[8], acc[8], dq_prev[8], ddq_prev[8];
+	int num = _limit_axes(index, dq, ddq, speed, acc);
+	_limit_axes(index - 1, dq_prev, ddq_prev, speed, acc);
+	for (int k = 0; k < num; k++) {
+		if (dq[k] <= 1e-12) continue;
+		double curve = is_line ? 0 : fmax(ddq[k], ddq_prev[k]);
+		w2 = fmin(w2, (v * v + 2 * ds * acc[k] / dq[k]) / (1 + 2 * ds * curve / dq[k]));
+	}
+	return sqrt(fmax(w2, v * v));
+}
+
+// a line: accelerate from v0 to the peak speed, cruise, decelerate to v1, at the acc of the line
+// a blend: constant acc from v0 to v1
+void TrajectoryPlanner::_interval_speed(int index, double v0, double v1, double *peak, double *acc) {
+	double ds = sds_[index];
+	if (sblend_[index] >= 0) {
+		*peak = fmax(v0, v1);
+		*acc = (v1 * v1 - v0 * v0) / (2 * ds);
+		return;
+	}
+	double vmax = 1e30, amax = 1e30;
+	double dq[8], ddq[8], axis_speed[8], axis_acc[8];
+	int num = _limit_axes(index, dq, ddq, axis_speed, axis_acc);
+	for (int k = 0; k < num; k++) {
+		if (dq[k] <= 1e-12) continue;
+		vmax = fmin(vmax, axis_speed[k] / dq[k]);
+		amax = fmin(amax, axis_acc[k] / dq[k]);
+	}
+	*peak = fmax(fmin(vmax, sqrt((2 * amax * ds + v0 * v0 + v1 * v1) / 2)), fmax(v0, v1));
+	*acc = amax;
+}
+
+double TrajectoryPlanner::_interval_time(int index, double v0, double v1) {
+	double ds = sds_[index], peak, a;
+	_interval_speed(index, v0, v1, &peak, &a);
+	if (sblend_[index] >= 0) return v0 + v1 > 0 ? 2 * ds / (v0 + v1) : 0;
+	double d_acc = (peak * peak - v0 * v0) / (2 * a);
+	double d_dec = (peak * peak - v1 * v1) / (2 * a);
+	return (peak - v0) / a + (peak - v1) / a + fmax(ds - d_acc - d_dec, 0) / peak;
+}
+
+// the distance covered at time t of the interval
+double TrajectoryPlanner::_interval_dist(int index, double v0, double v1, double t) {
+	double ds = sds_[index], peak, a;
+	_interval_speed(index, v0, v1, &peak, &a);
+	double s;
+	if (sblend_[index] >= 0) {
+		s = v0 * t + a * t * t / 2;
+	}
+	else {
+		double t_acc = (peak - v0) / a;
+		double d_acc = (peak * peak - v0 * v0) / (2 * a);
+		double d_dec = (peak * peak - v1 * v1) / (2 * a);
+		double t_cruise = fmax(ds - d_acc - d_dec, 0) / peak;
+		if (t <= t_acc) s = v0 * t + a * t * t / 2;
+		else if (t <= t_acc + t_cruise) s = d_acc + peak * (t - t_acc);
+		else {
+			double td = t - t_acc - t_cruise;
+			s = ds - d_dec + peak * td - a * td * td / 2;
+		}
+	}
+	return fmin(fmax(s, 0), ds);
+}
+
+int TrajectoryPlanner::plan(fp32 cycle_time) {
+	for (int k = 0; k < 7; k++) setpoints_[k].clear();
+	duration_ = 0;
+	if (get_waypoint_num() < 2 || !has_limits_ || cycle_time <= 0) return UXBUS_STATE::ERR_PARAM;
+	cycle_time_ = cycle_time;
+	_build_path();
+
+	int num = (int)sds_.size();
+	std::vector<double> vlim(num);
+	std::vector<double> &vel = svel_;
+	vel.assign(num, 0);
+	for (int i = 0; i < num; i++) {
+		double v = 1e30;
+		bool stop = true;
+		double dq[8], ddq[8], speed[8], acc[8];
+		int limit_num = _limit_axes(i, dq, ddq, speed, acc);
+		for (int k = 0; k < limit_num; k++) {
+			if (dq[k] > 1e-12) v = fmin(v, speed[k] / dq[k]);
+			if (ddq[k] > 1e-12) v = fmin(v, sqrt(acc[k] / ddq[k]));
+			if (dq[k] != 0) stop = false;
+		}
+		vlim[i] = stop ? 0 : v;
+	}
+	vlim[0] = 0;
+	vlim[num - 1] = 0;
+
+	for (int i = 0; i < num - 1; i++) vel[i + 1] = fmin(vlim[i + 1], _reach_speed(i + 1, vel[i]));
+	for (int i = num - 1; i > 0; i--) vel[i - 1] = fmin(vel[i - 1], _reach_speed(i, vel[i]));
+
+	double total = 0;
+	for (int i = 1; i < num; i++) {
+		if (sds_[i] > 0) total += _interval_time(i, vel[i - 1], vel[i]);
+	}
+	for (int k = 0; k < axis_num_; k++) setpoints_[k].reserve((size_t)(total / cycle_time_) + 2);
+
+	// sample at the cycle
+	double t_seg_start = 0;
+	double t = 0;
+	double q[7];
+	for (int i = 0; i < num - 1; i++) {
+		double ds = sds_[i + 1];
+		double v0 = vel[i], v1 = vel[i + 1];
+		if (ds <= 0) continue;
+		double seg_time = _interval_time(i + 1, v0, v1);
+		int blend = sblend_[i + 1];
+		bool in_blend = blend >= 0 && sblend_[i] == blend;
+		double tau0 = in_blend ? stau_[i] : 0;
+		double tau1 = stau_[i + 1];
+		double m0 = (in_blend ? sdtau_[i] : (blend >= 0 ? bdtau0_[blend] : 0)) * ds;
+		double m1 = blend >= 0 ? sdtau_[i + 1] * ds : 0;
+		for (; t <= t_seg_start + seg_time; t += cycle_time_) {
+			double w = _interval_dist(i + 1, v0, v1, t - t_seg_start) / ds;
+			if (blend >= 0) {
+				// on the curve itself, the samples are only used for the speed,
+				//   tau(s) is the cubic hermite of its values and slopes at both samples
+				double w2 = w * w, w3 = w2 * w;
+				double tau = (2 * w3 - 3 * w2 + 1) * tau0 + (w3 - 2 * w2 + w) * m0 + (3 * w2 - 2 * w3) * tau1 + (w3 - w2) * m1;
+				if (tau < tau0 || tau > tau1) tau = tau0 + (tau1 - tau0) * w;
+				_eval_blend(blend, tau, q, NULL, NULL);
+				for (int k = 0; k < axis_num_; k++) setpoints_[k].push_back((fp32)q[k]);
+				continue;
+			}
+			for (int k = 0; k < axis_num_; k++) {
+				setpoints_[k].push_back((fp32)(sq_[k][i] + (sq_[k][i + 1] - sq_[k][i]) * w));
+			}
+		}
+		t_seg_start += seg_time;
+	}
+	for (int k = 0; k < axis_num_; k++) setpoints_[k].push_back((fp32)sq_[k][num - 1]);
+	if (space_ == CARTESIAN_SPACE) {
+		for (int k = 3; k < 6; k++) {
+			for (size_t j = 0; j < setpoints_[k].size(); j++) setpoints_[k][j] = (fp32)_wrap_angle(setpoints_[k][j] / scale_[k]);
+		}
+	}
+	duration_ = t_seg_start;
+	return 0;
+}
+
+fp32 TrajectoryPlanner::get_duration(void) {
+	return (fp32)duration_;
+}
+
+int TrajectoryPlanner::get_setpoint_num(void) {
+	return (int)setpoints_[0].size();
+}
+
+const fp32 *TrajectoryPlanner::get_axis_setpoints(int axis) {
+	if (axis < 0 || axis >= 7 || setpoints_[axis].empty()) return NULL;
+	return setpoints_[axis].data();
+}
+
+int TrajectoryPlanner::get_setpoint(int index, fp32 point[7]) {
+	if (index < 0 || index >= get_setpoint_num()) return UXBUS_STATE::ERR_PARAM;
+	for (int k = 0; k < 7; k++) point[k] = k < axis_num_ ? setpoints_[k][index] : 0;
+	return 0;
+}
+
+int TrajectoryPlanner::execute(XArmAPI *arm) {
+	if (!arm->is_connected()) return UXBUS_STATE::NOT_CONNECTED;
+	int num = get_setpoint_num();
+	if (num == 0) return UXBUS_STATE::ERR_PARAM;
+	UxbusCmd *core = arm->is_tcp_ ? (UxbusCmd *)arm->cmd_tcp_ : (UxbusCmd *)arm->cmd_ser_;
+	bool is_cart = space_ == CARTESIAN_SPACE;
+	int ret = 0;
+	// the whole trajectory is checked before the first setpoint, not stopped half way
+	bool check = is_cart ? arm->check_tcp_limit_ : arm->check_joint_limit_;
+	bool check_collision = !is_cart && arm->collision_checker_.load() != NULL;
+	for (int n = 0; n < num && (check || check_collision); n++) {
+		float point[7] = { 0 };
+		for (int k = 0; k < axis_num_; k++) {
+			bool is_angle = !is_cart || k >= 3;
+			point[k] = (float)(is_angle && !arm->default_is_radian ? setpoints_[k][n] / RAD_DEGREE : setpoints_[k][n]);
+		}
+		if (check) ret = is_cart ? arm->_check_tcp_limit(point) : arm->_check_joint_limit(point);
+		if (ret == 0 && check_collision) ret = arm->_check_collision(point, false);
+		if (ret != 0) return ret;
+	}
+	std::chrono::steady_clock::time_point next_time = std::chrono::steady_clock::now();
+	std::chrono::microseconds cycle((long long)(cycle_time_ * 1000000));
+	int ack_timeout = (int)(cycle_time_ * 1000) * 10 + 10;
+	int trans_id = -1;
+	for (int n = 0; n < num; n++) {
+		next_time += cycle;
+		if (!arm->is_connected()) return UXBUS_STATE::NOT_CONNECTED;
+		if (arm->has_error()) return UXBUS_STATE::ERR_CODE;
+		if (arm->_is_servo_held()) return UXBUS_STATE::REPORT_STALE;
+		float tx[10] = { 0 };
+		for (int k = 0; k < axis_num_; k++) {
+			bool is_angle = !is_cart || k >= 3;
+			tx[k] = (float)(is_angle && !arm->default_is_radian ? setpoints_[k][n] / RAD_DEGREE : setpoints_[k][n]);
+		}
+		// the ack of a setpoint is collected one cycle later
+		if (trans_id >= 0) {
+			ret = is_cart ? core->pend_cmd<UXBUS_CMD::MOVE_SERVO_CART>(trans_id, NULL, ack_timeout)
+				: core->pend_cmd<UXBUS_CMD::MOVE_SERVOJ>(trans_id, NULL, ack_timeout);
+			if (ret != 0 && ret != UXBUS_STATE::WAR_CODE) return ret;
+		}
+		trans_id = is_cart ? core->post_cmd<UXBUS_CMD::MOVE_SERVO_CART>(tx) : core->post_cmd<UXBUS_CMD::MOVE_SERVOJ>(tx);
+		if (trans_id < 0) return UXBUS_STATE::NOT_CONNECTED;
+		std::this_thread::sleep_until(next_time);
+	}
+	ret = is_cart ? core->pend_cmd<UXBUS_CMD::MOVE_SERVO_CART>(trans_id, NULL, ack_timeout)
+		: core->pend_cmd<UXBUS_CMD::MOVE_SERVOJ>(trans_id, NULL, ack_timeout);
+	return ret == UXBUS_STATE::WAR_CODE ? 0 : ret;
+}
+
+// Ramer-Douglas-Peucker: keep the waypoint farthest from the chord while it is out of tolerance
+void TrajectoryPlanner::_simplify(int first, int last, double tolerance, std::vector<char> &keep) {
+	std::vector<int> stack;
+	stack.push_back(first);
+	stack.push_back(last);
+	while (!stack.empty()) {
+		int b = stack.back();
+		stack.pop_back();
+		int a = stack.back();
+		stack.pop_back();
+		double chord[7], chord2 = 0;
+		for (int k = 0; k < axis_num_; k++) {
+			chord[k] = waypoints_[k][b] - waypoints_[k][a];
+			chord2 += chord[k] * chord[k];
+		}
+		double max_d2 = -1;
+		int index = -1;
+		for (int i = a + 1; i < b; i++) {
+			double w = 0;
+			for (int k = 0; k < axis_num_; k++) w += (waypoints_[k][i] - waypoints_[k][a]) * chord[k];
+			w = chord2 > 0 ? fmin(fmax(w / chord2, 0), 1) : 0;
+			double d2 = 0;
+			for (int k = 0; k < axis_num_; k++) {
+				double d = waypoints_[k][i] - (waypoints_[k][a] + w * chord[k]);
+				d2 += d * d;
+			}
+			if (d2 > max_d2) {
+				max_d2 = d2;
+				index = i;
+			}
+		}
+		if (index >= 0 && max_d2 > tolerance * tolerance) {
+			keep[index] = 1;
+			stack.push_back(a);
+			stack.push_back(index);
+			stack.push_back(index);
+			stack.push_back(b);
+		}
+	}
+}
+
+int TrajectoryPlanner::push_segments(TrajectoryStreamer *streamer, fp32 tolerance, fp32 speed, fp32 acc) {
+	int n = get_waypoint_num();
+	if (n < 2) return 0;
+	std::vector<char> keep(n, 0);
+	keep[0] = 1;
+	keep[n - 1] = 1;
+	_simplify(0, n - 1, tolerance > 0 ? tolerance : 0, keep);
+	std::vector<int> index;
+	for (int i = 0; i < n; i++) {
+		if (keep[i]) index.push_back(i);
+	}
+	int count = (int)index.size();
+	fp32 point[7] = { 0 };
+	for (int j = 1; j < count; j++) {
+		for (int k = 0; k < axis_num_; k++) point[k] = waypoints_[k][index[j]];
+		if (space_ == JOINT_SPACE) {
+			int ret = streamer->push_angles(point, speed, acc);
+			if (ret != 0) return ret;
+			continue;
+		}
+		// the blend of move_lineb must fit in half of both adjacent segments
+		double radius = 0;
+		if (j < count - 1) {
+			double l_in = 0, l_out = 0;
+			for (int k = 0; k < 3; k++) {
+				double d_in = waypoints_[k][index[j]] - waypoints_[k][index[j - 1]];
+				double d_out = waypoints_[k][index[j + 1]] - waypoints_[k][index[j]];
+				l_in += d_in * d_in;
+				l_out += d_out * d_out;
+			}
+			radius = fmin(blend_radius_, fmin(sqrt(l_in), sqrt(l_out)) / 2);
+		}
+		for (int k = 3; k < 6; k++) point[k] = (fp32)_wrap_angle(point[k]);
+		int ret = streamer->push_position(point, (fp32)radius, speed, acc);
+		if (ret != 0) return ret;
+	}
+	return count - 1;
+}
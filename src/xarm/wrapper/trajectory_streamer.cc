@@ -0,0 +1,278 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+#include "xarm/wrapper/trajectory_streamer.h"
+
+TrajectoryStreamer::TrajectoryStreamer(XArmAPI *arm, int target_depth, int max_in_flight) {
+	arm_ = arm;
+	target_depth_ = target_depth > 0 ? target_depth : 1;
+	// the unrouted replies of the tcp port are stashed up to 16
+	max_in_flight_ = max_in_flight < 1 ? 1 : (max_in_flight > 16 ? 16 : max_in_flight);
+	is_running_ = false;
+	acked_ = 0;
+	last_ack_time_ = 0;
+	last_error_ = 0;
+	has_last_angles_ = false;
+}
+
+TrajectoryStreamer::~TrajectoryStreamer(void) {
+	stop();
+}
+
+int TrajectoryStreamer::_push(const Segment &seg) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	pending_.push_back(seg);
+	cond_.notify_all();
+	return 0;
+}
+
+int TrajectoryStreamer::push_position(fp32 pose[6], fp32 radius, fp32 speed, fp32 acc, fp32 mvtime) {
+	Segment seg;
+	seg.funcode = radius >= 0 ? UXBUS_RG::MOVE_LINEB : UXBUS_RG::MOVE_LINE;
+	for (int i = 0; i < 6; i++) {
+		seg.data[i] = (float)(arm_->default_is_radian || i < 3 ? pose[i] : pose[i] / RAD_DEGREE);
+	}
+	seg.data[6] = speed > 0 ? speed : arm_->last_used_tcp_speed;
+	seg.data[7] = acc > 0 ? acc : arm_->last_used_tcp_acc;
+	seg.data[8] = mvtime;
+	seg.data[9] = radius;
+	if (arm_->check_tcp_limit_) {
+		int ret = arm_->_check_tcp_limit(seg.data);
+		if (ret != 0) return ret;
+		seg.data[6] = arm_->limit_validator_.clamp_tcp_speed(seg.data[6]);
+	}
+	{
+		// the joints at the end of a linear segment are not known
+		std::lock_guard<std::mutex> locker(mutex_);
+		has_last_angles_ = false;
+	}
+	return _push(seg);
+}
+
+int TrajectoryStreamer::push_angles(fp32 angles[7], fp32 speed, fp32 acc, fp32 mvtime) {
+	Segment seg;
+	seg.funcode = UXBUS_RG::MOVE_JOINT;
+	for (int i = 0; i < 7; i++) {
+		seg.data[i] = (float)(arm_->default_is_radian ? angles[i] : angles[i] / RAD_DEGREE);
+	}
+	speed = speed > 0 ? speed : arm_->last_used_joint_speed;
+	acc = acc > 0 ? acc : arm_->last_used_joint_acc;
+	seg.data[7] = (float)(arm_->default_is_radian ? speed : speed / RAD_DEGREE);
+	seg.data[8] = (float)(arm_->default_is_radian ? acc : acc / RAD_DEGREE);
+	seg.data[9] = mvtime;
+	if (arm_->check_joint_limit_) {
+		int ret = arm_->_check_joint_limit(seg.data);
+		if (ret != 0) return ret;
+		seg.data[7] = arm_->limit_validator_.clamp_joint_speed(seg.data[7]);
+	}
+	{
+		// the path from the target of the last joint segment, or from the current angles like set_servo_angle
+		std::lock_guard<std::mutex> locker(mutex_);
+		CollisionChecker *checker = arm_->collision_checker_;
+		if (checker != NULL) {
+			int ret = has_last_angles_ ? checker->check_path(last_angles_, seg.data) : arm_->_check_collision(seg.data, true);
+			if (ret != 0) return ret;
+		}
+		for (int i = 0; i < 7; i++) last_angles_[i] = seg.data[i];
+		has_last_angles_ = true;
+	}
+	return _push(seg);
+}
+
+int TrajectoryStreamer::start(void) {
+	if (!arm_->is_connected()) return UXBUS_STATE::NOT_CONNECTED;
+	if (is_running_) return 0;
+	if (thread_.joinable()) thread_.join();
+	last_error_ = 0;
+	acked_ = 0;
+	last_ack_time_ = 0;
+	ack_times_.clear();
+	is_running_ = true;
+	thread_ = std::thread(&TrajectoryStreamer::_stream_loop, this);
+	return 0;
+}
+
+void TrajectoryStreamer::stop(void) {
+	is_running_ = false;
+	cond_.notify_all();
+	if (thread_.joinable() && thread_.get_id() != std::this_thread::get_id()) thread_.join();
+	std::lock_guard<std::mutex> locker(mutex_);
+	pending_.clear();
+	has_last_angles_ = false;
+}
+
+int TrajectoryStreamer::wait_finish(bool wait_motion, fp32 timeout) {
+	long long start_time = get_system_time();
+	{
+		std::unique_lock<std::mutex> locker(mutex_);
+		while (is_running_ && (!pending_.empty() || !in_flight_.empty())) {
+			if (timeout > 0 && get_system_time() - start_time >= timeout * 1000) return UXBUS_STATE::ERR_TOUT;
+			cond_.wait_for(locker, std::chrono::milliseconds(20));
+		}
+	}
+	if (last_error_ != 0) return last_error_;
+	if (wait_motion && arm_->_is_state_reported()) {
+		// the segments in the command cache may not have started yet, a report after the last ack
+		//   shows the cache empty and the arm neither moving nor paused once they are done
+		while (arm_->is_connected() && !arm_->has_error() && arm_->state != 4) {
+			if (arm_->last_report_time_ > last_ack_time_ && arm_->cmd_num == 0 && arm_->state != 1 && arm_->state != 3) break;
+			if (timeout > 0 && get_system_time() - start_time >= timeout * 1000) return UXBUS_STATE::ERR_TOUT;
+			sleep_milliseconds(10);
+		}
+	}
+	else if (wait_motion) {
+		fp32 remaining = timeout;
+		if (timeout > 0) {
+			remaining = timeout - (fp32)(get_system_time() - start_time) / 1000;
+			if (remaining <= 0) return UXBUS_STATE::ERR_TOUT;
+		}
+		arm_->_wait_stop(remaining);
+	}
+	return last_error_;
+}
+
+int TrajectoryStreamer::pending(void) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	return (int)pending_.size();
+}
+
+int TrajectoryStreamer::in_flight(void) {
+	std::lock_guard<std::mutex> locker(mutex_);
+	return (int)in_flight_.size();
+}
+
+long long TrajectoryStreamer::acked(void) {
+	return acked_;
+}
+
+int TrajectoryStreamer::last_error(void) {
+	return last_error_;
+}
+
+void TrajectoryStreamer::_fail(int code) {
+	if (last_error_ == 0) last_error_ = code;
+	is_running_ = false;
+	std::lock_guard<std::mutex> locker(mutex_);
+	pending_.clear();
+	cond_.notify_all();
+}
+
+int TrajectoryStreamer::_post(UxbusCmd *core, const Segment &seg) {
+	XARM_TRACE_SCOPE_ARG("stream_post", seg.funcode);
+	switch (seg.funcode) {
+	case UXBUS_RG::MOVE_LINEB:
+		return core->post_cmd<UXBUS_CMD::MOVE_LINEB>(seg.data);
+	case UXBUS_RG::MOVE_LINE:
+		return core->post_cmd<UXBUS_CMD::MOVE_LINE>(seg.data);
+	default:
+		return core->post_cmd<UXBUS_CMD::MOVE_JOINT>(seg.data);
+	}
+}
+
+int TrajectoryStreamer::_reap(UxbusCmd *core) {
+	XARM_TRACE_SCOPE("stream_reap");
+	InFlight req = in_flight_.front();
+	int ret;
+	switch (req.funcode) {
+	case UXBUS_RG::MOVE_LINEB:
+		ret = core->pend_cmd<UXBUS_CMD::MOVE_LINEB>(req.trans_id);
+		break;
+	case UXBUS_RG::MOVE_LINE:
+		ret = core->pend_cmd<UXBUS_CMD::MOVE_LINE>(req.trans_id);
+		break;
+	default:
+		ret = core->pend_cmd<UXBUS_CMD::MOVE_JOINT>(req.trans_id);
+		break;
+	}
+	bool ok = ret == 0 || ret == UXBUS_STATE::WAR_CODE;
+	if (ok) {
+		acked_ += 1;
+		ack_times_.push_back(get_system_time());
+		last_ack_time_ = ack_times_.back();
+	}
+	{
+		std::lock_guard<std::mutex> locker(mutex_);
+		in_flight_.pop_front();
+		cond_.notify_all();
+	}
+	if (!ok) {
+		_fail(ret);
+		return ret;
+	}
+	return 0;
+}
+
+int TrajectoryStreamer::_depth(UxbusCmd *core) {
+	int cmdnum;
+	if (!arm_->is_tcp_) {
+		// no report on the serial port, ask the controller (nothing is in flight here)
+		ack_times_.clear();
+		if (core->get_cmdnum(&cmdnum) != 0) return target_depth_;
+		return cmdnum;
+	}
+	long long report_time;
+	do {
+		report_time = arm_->last_report_time_;
+		cmdnum = arm_->cmd_num;
+	} while (report_time != arm_->last_report_time_);
+	// the acks received before the last report are already in its cmd_num
+	while (!ack_times_.empty() && ack_times_.front() < report_time) ack_times_.pop_front();
+	return cmdnum + (int)in_flight_.size() + (int)ack_times_.size();
+}
+
+void TrajectoryStreamer::_stream_loop(void) {
+	trace_set_thread_name("trajectory_streamer");
+	UxbusCmd *core = arm_->is_tcp_ ? (UxbusCmd *)arm_->cmd_tcp_ : (UxbusCmd *)arm_->cmd_ser_;
+	int max_in_flight = arm_->is_tcp_ ? max_in_flight_ : 1; // see UxbusCmdSer
+	Segment seg;
+	while (is_running_) {
+		if (!arm_->is_connected()) {
+			_fail(UXBUS_STATE::NOT_CONNECTED);
+			break;
+		}
+		if (arm_->has_error()) {
+			_fail(UXBUS_STATE::ERR_CODE);
+			break;
+		}
+		bool has_seg;
+		{
+			std::lock_guard<std::mutex> locker(mutex_);
+			has_seg = !pending_.empty();
+			if (has_seg) seg = pending_.front();
+		}
+		int n_flight = (int)in_flight_.size();
+		if (has_seg && n_flight < max_in_flight && _depth(core) < target_depth_) {
+			int trans_id = _post(core, seg);
+			if (trans_id < 0) {
+				_fail(UXBUS_STATE::NOT_CONNECTED);
+				break;
+			}
+			InFlight req = { seg.funcode, trans_id };
+			std::lock_guard<std::mutex> locker(mutex_);
+			if (!pending_.empty()) pending_.pop_front();
+			in_flight_.push_back(req);
+			continue;
+		}
+		if (n_flight > 0) {
+			_reap(core);
+			continue;
+		}
+		if (!has_seg) {
+			std::unique_lock<std::mutex> locker(mutex_);
+			cond_.wait_for(locker, std::chrono::milliseconds(20), [this] { return !is_running_ || !pending_.empty(); });
+			continue;
+		}
+		// the command cache is full, wait for the controller to consume it
+		sleep_milliseconds(2);
+	}
+	// collect the acks of a stopped upload, so they do not linger in the port
+	while (!in_flight_.empty() && arm_->is_connected()) _reap(core);
+	std::lock_guard<std::mutex> locker(mutex_);
+	in_flight_.clear();
+	cond_.notify_all();
+}
@@ -13,19 +13,64 @@
 // #include <unistd.h>
 #include <string.h>
 #include "xarm/wrapper/xarm_api.h"
+#include "xarm/wrapper/gripper_poller.h"
+#include "xarm/wrapper/modbus_transaction.h"
+#include "xarm/wrapper/command_broker.h"
 
 using namespace std;
 
-static bool compare_version(int v1[3], int v2[3]) {
-	for (int i = 0; i < 3; i++) {
-		if (v1[i] > v2[i]) {
-			return true;
-		}
-		else if (v1[i] < v2[i]) {
-			return false;
+#ifdef _WIN32
+#include <direct.h>
+#define make_dir(path) _mkdir(path)
+#else
+#include <sys/stat.h>
+#define make_dir(path) mkdir(path, 0755)
+#endif
+
+static const int STOP_RETRY_INTERVAL = 20; // ms, emergency_stop and pause
+
+// the last "v<major>.<minor>.<revision>" of the version string, like "xArm6-v1.5.0"
+static bool parse_version_number(const char *v, int *major, int *minor, int *revision) {
+	bool found = false;
+	int a, b, c;
+	for (const char *p = v; *p != '\0'; p++) {
+		if ((*p == 'v' || *p == 'V') && p[1] >= '0' && p[1] <= '9' && sscanf(p + 1, "%d.%d.%d", &a, &b, &c) == 3) {
+			*major = a;
+			*minor = b;
+			*revision = c;
+			found = true;
 		}
 	}
-	return false;
+	return found;
+}
+
+// $XARM_CACHE_DIR, $HOME/.xarm or the given directory, empty if none is usable
+static std::string capability_cache_path(const std::string &cache_dir) {
+	std::string dir = cache_dir;
+	if (dir == "") {
+		const char *env = getenv("XARM_CACHE_DIR");
+		if (env != NULL && env[0] != '\0') dir = env;
+	}
+	if (dir == "") {
+#ifdef _WIN32
+		const char *home = getenv("USERPROFILE");
+#else
+		const char *home = getenv("HOME");
+#endif
+		if (home == NULL || home[0] == '\0') return "";
+		dir = std::string(home) + "/.xarm";
+	}
+	make_dir(dir.data());
+	return dir + "/capability_cache";
+}
+
+// a printable single-word field of the cache file
+static std::string cache_field(const char *data, int maxlen) {
+	std::string field;
+	for (int i = 0; i < maxlen && data[i] != '\0'; i++) {
+		field += (data[i] > ' ' && data[i] < 127) ? data[i] : '_';
+	}
+	return field == "" ? "-" : field;
 }
 
 XArmAPI::XArmAPI(
@@ -44,7 +89,7 @@ XArmAPI::XArmAPI(
 	default_is_radian = is_radian;
 	check_tcp_limit_ = check_tcp_limit;
 	_init();
-	printf("SDK_VERSION: %s\n", SDK_VERSION);
+	XARM_LOG_INFO("SDK_VERSION: %s", SDK_VERSION);
 	if (!do_not_open) {
 		connect();
 	}
@@ -52,6 +97,7 @@ XArmAPI::XArmAPI(
 
 XArmAPI::~XArmAPI() {
 	disconnect();
+	_release_tcp_ports();
 }
 
 void XArmAPI::_init(void) {
@@ -66,11 +112,37 @@ void XArmAPI::_init(void) {
 	is_old_protocol_ = false;
 	is_first_report_ = true;
 	is_sync_ = false;
+	is_closed_ = true;
+
+	auto_reconnect_ = true;
+	reconnect_timeout_ms_ = 1000;
+	min_backoff_ms_ = 100;
+	max_backoff_ms_ = 5000;
+	report_idle_timeout_ms_ = 3000;
+	last_set_mode_ = -1;
+	last_report_time_ = 0;
+	last_report_us_ = 0;
+	hold_servo_on_stale_ = false;
+	report_path_delay_us_ = -1;
+	move_start_us_ = 0;
+	collision_checker_ = NULL;
+	state_publisher_ = NULL;
+	gripper_poller_ = NULL;
+	memset(&conn_stats_, 0, sizeof(conn_stats_));
+	fast_connect_ = false;
+	broker_priority_ = -1;
+	caps_check_ = CAPS_CHECK_DONE;
+	memset(reported_version_, 0, sizeof(reported_version_));
+	caps_probe_id_ = -1;
+	caps_probe_tries_ = 0;
+	caps_probe_time_ = 0;
 
 	major_version_number_ = 0;
 	minor_version_number_ = 0;
 	revision_version_number_ = 0;
 	version_number = new int[3]{ major_version_number_, minor_version_number_, revision_version_number_ };
+	_update_capabilities();
+	report_caps_ = caps_;
 
 	mt_brake_ = 0;
 	mt_able_ = 0;
@@ -119,6 +191,7 @@ void XArmAPI::_init(void) {
 	teach_sensitivity = 0;
 	device_type = 7;
 	axis = 7;
+	axis_reported_ = false;
 	master_id = 0;
 	slave_id = 0;
 	motor_tid = 0;
@@ -224,6 +297,12 @@ inline void XArmAPI::_report_count_changed_callback(void) {
 	}
 }
 
+inline void XArmAPI::_report_stale_changed_callback(bool stale, int age_ms) {
+	for (u32 i = 0; i < report_stale_callbacks_.size(); i++) {
+		timer.AsyncWait(0, report_stale_callbacks_[i], stale, age_ms);
+	}
+}
+
 void XArmAPI::_update_old(unsigned char *rx_data) {
 	unsigned char *data_fp = &rx_data[4];
 	int sizeof_data = bin8_to_32(rx_data);
@@ -333,6 +412,8 @@ void XArmAPI::_update_old(unsigned char *rx_data) {
 		else if (device_type == 3) {
 			axis = 7;
 		}
+		if ((_axis >= 5 && _axis <= 7) || device_type == 3 || device_type == 5 || device_type == 6) axis_reported_ = true;
+		_sync_collision_axis();
 
 		memcpy(version, &data_fp[93], 30);
 
@@ -354,31 +435,38 @@ void XArmAPI::_update_old(unsigned char *rx_data) {
 		min_joint_speed_ = p2p_msg_[3];
 		max_joint_speed_ = p2p_msg_[4];
 		if (default_is_radian) {
-			joint_speed_limit[0] = min_joint_acc_;
-			joint_speed_limit[1] = max_joint_acc_;
-			joint_acc_limit[0] = min_joint_speed_;
-			joint_acc_limit[1] = max_joint_speed_;
+			joint_speed_limit[0] = min_joint_speed_;
+			joint_speed_limit[1] = max_joint_speed_;
+			joint_acc_limit[0] = min_joint_acc_;
+			joint_acc_limit[1] = max_joint_acc_;
 		}
 		else {
-			joint_speed_limit[0] = (float)(min_joint_acc_ * RAD_DEGREE);
-			joint_speed_limit[1] = (float)(max_joint_acc_ * RAD_DEGREE);
-			joint_acc_limit[0] = (float)(min_joint_speed_ * RAD_DEGREE);
-			joint_acc_limit[1] = (float)(max_joint_speed_ * RAD_DEGREE);
+			joint_speed_limit[0] = (float)(min_joint_speed_ * RAD_DEGREE);
+			joint_speed_limit[1] = (float)(max_joint_speed_ * RAD_DEGREE);
+			joint_acc_limit[0] = (float)(min_joint_acc_ * RAD_DEGREE);
+			joint_acc_limit[1] = (float)(max_joint_acc_ * RAD_DEGREE);
 		}
 
 		hex_to_nfp32(&data_fp[163], rot_msg_, 2);
 		rot_jerk = rot_msg_[0];
 		max_rot_acc = rot_msg_[1];
 
-		for (u32 i = 0; i < 17; i++) sv3msg_[i] = data_fp[171 + i];
+		for (u32 i = 0; i < 16; i++) sv3msg_[i] = data_fp[171 + i];
 	}
 }
 
 void XArmAPI::_update(unsigned char *rx_data) {
-	if (is_old_protocol_) {
-		_update_old(rx_data);
-		return;
-	}
+	XARM_TRACE_SCOPE("decode");
+	// the capabilities may be changed by another thread probing the version, one load per report
+	unsigned int caps = caps_;
+	report_caps_ = caps;
+	if (caps & CAP_OLD_PROTOCOL) _update_old(rx_data);
+	else if (caps & CAP_TCP_LOAD_MM) _update_new<true>(rx_data);
+	else _update_new<false>(rx_data);
+}
+
+template<bool TCP_LOAD_MM>
+void XArmAPI::_update_new(unsigned char *rx_data) {
 	unsigned char *data_fp = &rx_data[4];
 	int sizeof_data = bin8_to_32(rx_data);
 	if (sizeof_data >= 87) {
@@ -470,7 +558,7 @@ void XArmAPI::_update(unsigned char *rx_data) {
 		}
 		hex_to_nfp32(&data_fp[115], tcp_load, 4);
 
-		if (!compare_version(version_number, new int[3]{ 0, 2, 0 })) {
+		if (!TCP_LOAD_MM) {
 			tcp_load[1] = tcp_load[1] * 1000;
 			tcp_load[2] = tcp_load[2] * 1000;
 			tcp_load[3] = tcp_load[3] * 1000;
@@ -490,13 +578,20 @@ void XArmAPI::_update(unsigned char *rx_data) {
 
 		if (_axis >= 5 && _axis <= 7) {
 			axis = _axis;
+			axis_reported_ = true;
 		}
+		_sync_collision_axis();
 
 		// if ((device_type == 5 || device_type == 6) && axis == 7) {
 		//     axis = device_type;
 		// }
 
 		memcpy(version, &data_fp[151], 30);
+		if (caps_check_ == CAPS_CHECK_PENDING) {
+			// compared (and saved) by the supervisor, no file on the thread of the reports
+			memcpy(reported_version_, version, sizeof(reported_version_));
+			caps_check_ = CAPS_CHECK_REPORTED;
+		}
 
 		hex_to_nfp32(&data_fp[181], trs_msg_, 5);
 		tcp_jerk = trs_msg_[0];
@@ -516,29 +611,30 @@ void XArmAPI::_update(unsigned char *rx_data) {
 		min_joint_speed_ = p2p_msg_[3];
 		max_joint_speed_ = p2p_msg_[4];
 		if (default_is_radian) {
-			joint_speed_limit[0] = min_joint_acc_;
-			joint_speed_limit[1] = max_joint_acc_;
-			joint_acc_limit[0] = min_joint_speed_;
-			joint_acc_limit[1] = max_joint_speed_;
+			joint_speed_limit[0] = min_joint_speed_;
+			joint_speed_limit[1] = max_joint_speed_;
+			joint_acc_limit[0] = min_joint_acc_;
+			joint_acc_limit[1] = max_joint_acc_;
 		}
 		else {
-			joint_speed_limit[0] = (float)(min_joint_acc_ * RAD_DEGREE);
-			joint_speed_limit[1] = (float)(max_joint_acc_ * RAD_DEGREE);
-			joint_acc_limit[0] = (float)(min_joint_speed_ * RAD_DEGREE);
-			joint_acc_limit[1] = (float)(max_joint_speed_ * RAD_DEGREE);
+			joint_speed_limit[0] = (float)(min_joint_speed_ * RAD_DEGREE);
+			joint_speed_limit[1] = (float)(max_joint_speed_ * RAD_DEGREE);
+			joint_acc_limit[0] = (float)(min_joint_acc_ * RAD_DEGREE);
+			joint_acc_limit[1] = (float)(max_joint_acc_ * RAD_DEGREE);
 		}
 
 		hex_to_nfp32(&data_fp[221], rot_msg_, 2);
 		rot_jerk = rot_msg_[0];
 		max_rot_acc = rot_msg_[1];
 
-		for (u32 i = 0; i < 17; i++) sv3msg_[i] = data_fp[229 + i];
+		for (u32 i = 0; i < 16; i++) sv3msg_[i] = data_fp[229 + i];
 
 		if (sizeof_data >= 252) {
 			bool isChange = false;
 			for (u32 i = 0; i < 7; i++) {
 				if (temperatures[i] != data_fp[245 + i]) {
 					isChange = true;
+					temperatures[i] = data_fp[245 + i];
 				}
 			}
 			if (isChange) {
@@ -549,7 +645,7 @@ void XArmAPI::_update(unsigned char *rx_data) {
 			fp32 speeds[8];
 			hex_to_nfp32(&data_fp[252], speeds, 8);
 			realtime_tcp_speed = speeds[0];
-			realtime_joint_speeds = &speeds[1];
+			memcpy(realtime_joint_speeds, &speeds[1], sizeof(fp32) * 7);
 		}
 		if (sizeof_data >= 288) {
 			int cnt = bin8_to_32(&data_fp[284]);
@@ -571,51 +667,293 @@ void XArmAPI::_update(unsigned char *rx_data) {
 void XArmAPI::_recv_report_data(void) {
 	unsigned char rx_data[1280];
 	int ret;
-	int fail_count = 0;
-	while (is_connected()) {
+	while (!is_closed_) {
 		sleep_milliseconds(1);
-		if (fail_count > 5) break;
 		if (stream_tcp_report_->is_ok() != 0) {
-			fail_count += 1;
-			stream_tcp_report_->close_port();
-			stream_tcp_report_ = new SocketPort((char *)port_.data(), XARM_CONF::TCP_PORT_REPORT_RICH, 3, 512);
+			// the connection supervisor is in charge of reconnecting
 			sleep_milliseconds(10);
 			continue;
 		}
-		ret = stream_tcp_report_->read_frame(rx_data);
-		fail_count = 0;
+		long long arrival_us;
+		ret = stream_tcp_report_->read_frame(rx_data, &arrival_us);
 		if (ret != 0) continue;
+		XARM_TRACE_SCOPE("report");
+		XARM_LOG_HEX("report:", &rx_data[4], bin8_to_32(rx_data));
+		long long recv_time = get_system_time();
+		long long recv_us = get_steady_time_us();
+		int last_state = state;
 		_update(rx_data);
-	}
-	report_thread_.join();
+		// published after the decoding, so a reader of the time sees the matching cmd_num
+		if (state == 1 && last_state != 1) move_start_us_ = recv_us;
+		last_report_us_ = recv_us;
+		last_report_time_ = recv_time;
+		long long acquire_us = report_clock_.on_report(arrival_us, stream_tcp_report_->is_kernel_stamped());
+		_update_predictor(acquire_us > 0 ? acquire_us : arrival_us, acquire_us > 0, bin8_to_32(rx_data));
+		if (state_publisher_ != NULL) _publish_state(recv_time, acquire_us);
+		// the age the last report had when this one came, how long the state was stale
+		long long stale_age_us = report_health_.get_age_us(arrival_us);
+		if (report_health_.on_report(arrival_us, recv_us)) {
+			_report_stale_changed_callback(false, (int)(stale_age_us / 1000));
+		}
+	}
+}
+
+void XArmAPI::_publish_state(long long recv_time, long long acquire_us) {
+	StatePublisher *publisher = state_publisher_;
+	if (publisher == NULL) return;
+	RobotState st;
+	st.time = recv_time;
+	st.acquire_us = acquire_us;
+	st.state = state;
+	st.mode = mode;
+	st.cmd_num = cmd_num;
+	st.error_code = error_code;
+	st.warn_code = warn_code;
+	st.axis = axis;
+	st.mt_brake = mt_brake_;
+	st.mt_able = mt_able_;
+	st.count = count_;
+	// the shared memory is always in radians
+	fp32 unit = (fp32)(default_is_radian ? 1 : 1 / RAD_DEGREE);
+	for (int i = 0; i < 7; i++) {
+		st.temperatures[i] = temperatures[i];
+		st.angles[i] = angles[i] * unit;
+		st.joints_torque[i] = joints_torque[i];
+		st.realtime_joint_speeds[i] = realtime_joint_speeds[i];
+	}
+	for (int i = 0; i < 6; i++) {
+		st.position[i] = i < 3 ? position[i] : position[i] * unit;
+		st.tcp_offset[i] = i < 3 ? tcp_offset[i] : tcp_offset[i] * unit;
+		st.world_offset[i] = i < 3 ? world_offset[i] : world_offset[i] * unit;
+	}
+	for (int i = 0; i < 4; i++) st.tcp_load[i] = tcp_load[i];
+	st.realtime_tcp_speed = realtime_tcp_speed;
+	publisher->publish(st);
+}
+
+void XArmAPI::_update_predictor(long long report_us, bool acquired, int sizeof_data) {
+	fp32 unit = (fp32)(default_is_radian ? 1 : 1 / RAD_DEGREE);
+	float rad_angles[7], rad_position[6];
+	for (int i = 0; i < 7; i++) rad_angles[i] = angles[i] * unit;
+	for (int i = 0; i < 6; i++) rad_position[i] = i < 3 ? position[i] : position[i] * unit;
+	// the reports of the old protocol and the short ones have no joint speeds
+	bool has_speeds = !(report_caps_ & CAP_OLD_PROTOCOL) && sizeof_data >= 284;
+	state_predictor_.update(report_us, acquired, rad_angles, rad_position, has_speeds ? realtime_joint_speeds : NULL);
 }
 
 static void report_thread_handle_(void *arg) {
 	XArmAPI *my_this = (XArmAPI *)arg;
+	trace_set_thread_name("report");
 	my_this->_recv_report_data();
 	// pthread_exit(0);
 }
 
-void XArmAPI::_check_version(void) {
-	int count = 5;
-	unsigned char version_[40];
-	int ret = -1;
-	while ((ret < 0 || ret > 2) && count > 0) {
-		ret = get_version(version_);
-		sleep_milliseconds(100);
-		count -= 1;
+void XArmAPI::_record_drop(bool is_control, long long now) {
+	std::lock_guard<std::mutex> locker(stats_mutex_);
+	if (is_control) conn_stats_.control_drops += 1;
+	else conn_stats_.report_drops += 1;
+	conn_stats_.last_drop_time = now;
+	conn_stats_.connected_since = 0;
+}
+
+bool XArmAPI::_try_reconnect(SocketPort *port, long long down_since, int *backoff_ms, long long *next_try_time) {
+	int ret = port->reconnect(reconnect_timeout_ms_);
+	long long now = get_system_time();
+	std::lock_guard<std::mutex> locker(stats_mutex_);
+	conn_stats_.reconnect_attempts += 1;
+	if (ret != 0) {
+		conn_stats_.reconnect_failures += 1;
+		*next_try_time = now + *backoff_ms;
+		*backoff_ms = *backoff_ms * 2 > max_backoff_ms_ ? max_backoff_ms_ : *backoff_ms * 2;
+		return false;
 	}
-	std::string v((const char *)version_);
-	std::regex pattern(".*[vV](\\d+)[.](\\d+)[.](\\d+).*");
-	std::smatch result;
-	if (std::regex_match(v, result, pattern)) {
-		auto it = result.begin();
-		sscanf(std::string(*++it).data(), "%d", &major_version_number_);
-		sscanf(std::string(*++it).data(), "%d", &minor_version_number_);
-		sscanf(std::string(*++it).data(), "%d", &revision_version_number_);
+	conn_stats_.reconnect_successes += 1;
+	conn_stats_.last_reconnect_time = now;
+	conn_stats_.last_downtime = now - down_since;
+	conn_stats_.total_downtime += now - down_since;
+	*backoff_ms = min_backoff_ms_;
+	return true;
+}
+
+void XArmAPI::_supervise_connection(void) {
+	long long now = get_system_time();
+	bool control_up = stream_tcp_->is_ok() == 0;
+	bool report_up = stream_tcp_report_->is_ok() == 0;
+	long long control_down_since = now;
+	long long report_down_since = now;
+	long long control_next_try = now;
+	long long report_next_try = now;
+	int control_backoff = min_backoff_ms_;
+	int report_backoff = min_backoff_ms_;
+	int path_delay_ticks = 0;
+	if (!report_up) _record_drop(false, now);
+	while (!is_closed_) {
+		sleep_milliseconds(20);
+		if (is_closed_) break;
+		now = get_system_time();
+		bool changed = false;
+
+		if (control_up && stream_tcp_->is_ok() != 0) {
+			XARM_LOG_WARN("Warning: Tcp control connection lost");
+			control_up = false;
+			control_down_since = now;
+			control_next_try = now;
+			control_backoff = min_backoff_ms_;
+			_record_drop(true, now);
+			changed = true;
+		}
+		if (report_up && report_idle_timeout_ms_ > 0 && stream_tcp_report_->is_ok() == 0 && now - last_report_time_ > report_idle_timeout_ms_) {
+			// a half-open connection never fails on its own, a silent report channel is treated as lost
+			stream_tcp_report_->close_port();
+			std::lock_guard<std::mutex> locker(stats_mutex_);
+			conn_stats_.report_idle_timeouts += 1;
+		}
+		if (report_path_delay_us_ < 0 && ++path_delay_ticks >= 50) {
+			// the shortest round trip bounds the network part of the report delay, checked every second
+			path_delay_ticks = 0;
+			CommandStats stats;
+			if (cmd_tcp_ != NULL && cmd_tcp_->get_metrics()->get_stats(-1, &stats) == 0) report_clock_.set_path_delay_us(stats.min_us / 2);
+		}
+		if (report_health_.check(get_steady_time_us())) {
+			XARM_LOG_WARN("Warning: the reported state is stale");
+			_report_stale_changed_callback(true, (int)(report_health_.get_age_us(get_steady_time_us()) / 1000));
+		}
+		if (report_up && stream_tcp_report_->is_ok() != 0) {
+			XARM_LOG_WARN("Warning: Tcp report connection lost");
+			report_up = false;
+			report_down_since = now;
+			report_next_try = now;
+			report_backoff = min_backoff_ms_;
+			_record_drop(false, now);
+			changed = true;
+		}
+		if (changed) {
+			_report_connect_changed_callback();
+			cond_.notify_all();
+		}
+
+		if (caps_check_ == CAPS_CHECK_REPORTED) _check_capability_cache();
+		if (caps_check_ == CAPS_CHECK_STALE && control_up) _probe_capabilities(now);
+
+		if (!auto_reconnect_ || is_closed_) continue;
+		changed = false;
+		if (!control_up && now >= control_next_try) {
+			if (_try_reconnect(stream_tcp_, control_down_since, &control_backoff, &control_next_try)) {
+				XARM_LOG_INFO("Tcp control connection restored");
+				control_up = true;
+				changed = true;
+				// the settings may have been changed while the arm was unreachable
+				limit_validator_.invalidate();
+				if (last_set_mode_ >= 0) set_mode(last_set_mode_);
+			}
+		}
+		if (!report_up && now >= report_next_try) {
+			if (_try_reconnect(stream_tcp_report_, report_down_since, &report_backoff, &report_next_try)) {
+				XARM_LOG_INFO("Tcp report connection restored");
+				report_up = true;
+				changed = true;
+				is_first_report_ = true;
+				last_report_time_ = get_system_time();
+				report_clock_.reset();
+			}
+		}
+		if (changed) {
+			if (control_up && report_up) {
+				std::lock_guard<std::mutex> locker(stats_mutex_);
+				conn_stats_.connected_since = get_system_time();
+			}
+			_report_connect_changed_callback();
+		}
+	}
+}
+
+static void supervisor_thread_handle_(void *arg) {
+	XArmAPI *my_this = (XArmAPI *)arg;
+	trace_set_thread_name("supervisor");
+	my_this->_supervise_connection();
+}
+
+int XArmAPI::set_auto_reconnect(bool enable, int connect_timeout_ms, int min_backoff_ms, int max_backoff_ms, int report_idle_timeout_ms) {
+	auto_reconnect_ = enable;
+	reconnect_timeout_ms_ = connect_timeout_ms;
+	min_backoff_ms_ = min_backoff_ms > 0 ? min_backoff_ms : 1;
+	max_backoff_ms_ = max_backoff_ms > min_backoff_ms_ ? max_backoff_ms : min_backoff_ms_;
+	report_idle_timeout_ms_ = report_idle_timeout_ms;
+	return 0;
+}
+
+int XArmAPI::get_connection_stats(ConnectionStats *stats) {
+	std::lock_guard<std::mutex> locker(stats_mutex_);
+	memcpy(stats, &conn_stats_, sizeof(conn_stats_));
+	return 0;
+}
+
+int XArmAPI::set_report_staleness(int stale_ms, bool hold_servo) {
+	// the serial port has no reports to age
+	if (!is_tcp_) return UXBUS_STATE::ERR_NOTTCP;
+	report_health_.set_stale_threshold(stale_ms > 0 ? (long long)stale_ms * 1000 : 0);
+	hold_servo_on_stale_ = hold_servo;
+	return 0;
+}
+
+bool XArmAPI::is_report_stale(void) {
+	return report_health_.is_stale(get_steady_time_us());
+}
+
+bool XArmAPI::_is_servo_held(void) {
+	return hold_servo_on_stale_ && report_health_.is_stale(get_steady_time_us());
+}
+
+int XArmAPI::get_report_health(ReportHealth *health) {
+	long long drop_num = is_tcp_ && stream_tcp_report_ != NULL ? stream_tcp_report_->get_drop_num() : 0;
+	report_health_.get_health(health, get_steady_time_us(), drop_num);
+	return 0;
+}
+
+int XArmAPI::set_report_path_delay(int path_delay_us) {
+	report_path_delay_us_ = path_delay_us;
+	if (path_delay_us >= 0) report_clock_.set_path_delay_us(path_delay_us);
+	return 0;
+}
+
+int XArmAPI::get_clock_estimate(ClockEstimate *estimate) {
+	report_clock_.get_estimate(estimate);
+	return 0;
+}
+
+int XArmAPI::get_predicted_state(PredictedState *state, long long time_us) {
+	return state_predictor_.predict(time_us > 0 ? time_us : get_steady_time_us(), state);
+}
+
+int XArmAPI::set_prediction_horizon(int horizon_us) {
+	state_predictor_.set_horizon_us(horizon_us);
+	return 0;
+}
+
+int XArmAPI::get_command_stats(int funcode, CommandStats *stats) {
+	UxbusCmd *core = is_tcp_ ? (UxbusCmd *)cmd_tcp_ : (UxbusCmd *)cmd_ser_;
+	if (core == NULL) return UXBUS_STATE::NOT_CONNECTED;
+	return core->get_metrics()->get_stats(funcode, stats);
+}
+
+void XArmAPI::_release_tcp_ports(void) {
+	if (cmd_tcp_ != NULL) delete cmd_tcp_;
+	if (stream_tcp_ != NULL) delete stream_tcp_;
+	if (stream_tcp_report_ != NULL) delete stream_tcp_report_;
+	cmd_tcp_ = NULL;
+	stream_tcp_ = NULL;
+	stream_tcp_report_ = NULL;
+}
+
+void XArmAPI::_parse_version(const unsigned char *version_) {
+	char v[41] = { 0 };
+	memcpy(v, version_, 40);
+	cached_version_ = cache_field(v, 40);
+	if (parse_version_number(v, &major_version_number_, &minor_version_number_, &revision_version_number_)) {
+		is_old_protocol_ = false;
 	}
 	else {
-		std::vector<std::string> tmpList = split(v, "-");
+		std::vector<std::string> tmpList = split(std::string(v), "-");
 		int size = tmpList.size();
 		if (size >= 3) {
 			int year = atoi(tmpList[size - 3].c_str());
@@ -642,8 +980,34 @@ void XArmAPI::_check_version(void) {
 	version_number[0] = major_version_number_;
 	version_number[1] = minor_version_number_;
 	version_number[2] = revision_version_number_;
-	printf("is_old_protocol: %d\n", is_old_protocol_);
-	printf("version_number: %d.%d.%d\n", major_version_number_, minor_version_number_, revision_version_number_);
+	_update_capabilities();
+}
+
+bool XArmAPI::_version_ge(int major, int minor, int revision) {
+	return major_version_number_ > major || (major_version_number_ == major && minor_version_number_ > minor) || (major_version_number_ == major && minor_version_number_ == minor && revision_version_number_ >= revision);
+}
+
+void XArmAPI::_update_capabilities(void) {
+	unsigned int caps = 0;
+	if (is_old_protocol_) caps |= CAP_OLD_PROTOCOL;
+	if (_version_ge(0, 2, 1)) caps |= CAP_TCP_LOAD_MM;
+	if (_version_ge(1, 2, 11)) caps |= CAP_REDUCED_STATES_EXT;
+	// one word, the report thread selects its decoder from it
+	caps_ = caps;
+}
+
+void XArmAPI::_check_version(void) {
+	int count = 5;
+	unsigned char version_[40] = { 0 };
+	int ret = -1;
+	while ((ret < 0 || ret > 2) && count > 0) {
+		ret = get_version(version_);
+		sleep_milliseconds(100);
+		count -= 1;
+	}
+	_parse_version(version_);
+	XARM_LOG_INFO("is_old_protocol: %d", is_old_protocol_);
+	XARM_LOG_INFO("version_number: %d.%d.%d", major_version_number_, minor_version_number_, revision_version_number_);
 	if (check_robot_sn_) {
 		count = 5;
 		int err_warn[2];
@@ -654,10 +1018,158 @@ void XArmAPI::_check_version(void) {
 			sleep_milliseconds(100);
 			count -= 1;
 		}
-		printf("robot_sn: %s\n", sn);
+		XARM_LOG_INFO("robot_sn: %s", sn);
 	}
 }
 
+void XArmAPI::_fast_check_version(void) {
+	if (_load_capability_cache()) {
+		XARM_LOG_INFO("version_number: %d.%d.%d (cached)", major_version_number_, minor_version_number_, revision_version_number_);
+		return;
+	}
+	// version and sn in one round trip
+	unsigned char version_[40] = { 0 };
+	unsigned char sn_[40] = { 0 };
+	int funcodes[2] = { UXBUS_RG::GET_VERSION, UXBUS_RG::GET_ROBOT_SN };
+	int nums[2] = { 40, 40 };
+	unsigned char *datas[2] = { version_, sn_ };
+	int rets[2] = { -1, -1 };
+	int ret = cmd_tcp_->get_nu8_pipelined(2, funcodes, nums, datas, rets);
+	if (ret != 0 || rets[0] < 0 || rets[0] > 2) {
+		_check_version();
+		return;
+	}
+	_parse_version(version_);
+	if (rets[1] >= 0 && rets[1] <= 2) {
+		memcpy(sn, sn_, 40);
+	}
+	XARM_LOG_INFO("is_old_protocol: %d", is_old_protocol_);
+	XARM_LOG_INFO("version_number: %d.%d.%d", major_version_number_, minor_version_number_, revision_version_number_);
+	cached_report_version_ = "";
+	_save_capability_cache();
+	caps_check_ = CAPS_CHECK_PENDING;
+}
+
+bool XArmAPI::_load_capability_cache(void) {
+	std::string path = capability_cache_path(cache_dir_);
+	if (path == "") return false;
+	FILE *fp = fopen(path.data(), "r");
+	if (fp == NULL) return false;
+	char line[512];
+	bool found = false;
+	while (!found && fgets(line, sizeof(line), fp) != NULL) {
+		std::vector<std::string> fields = split(std::string(strtok(line, "\r\n") == NULL ? "" : line), "\t");
+		// by address, the sn of the line is the one probed last there
+		if (fields.size() < 8 || fields[0] != port_) continue;
+		major_version_number_ = atoi(fields[3].c_str());
+		minor_version_number_ = atoi(fields[4].c_str());
+		revision_version_number_ = atoi(fields[5].c_str());
+		is_old_protocol_ = atoi(fields[6].c_str()) != 0;
+		memset(sn, 0, sizeof(sn));
+		if (fields[1] != "-") strncpy((char *)sn, fields[1].c_str(), sizeof(sn) - 1);
+		cached_version_ = fields[2] == "-" ? "" : fields[2];
+		cached_report_version_ = fields[7] == "-" ? "" : fields[7];
+		found = true;
+	}
+	fclose(fp);
+	if (!found) return false;
+	version_number[0] = major_version_number_;
+	version_number[1] = minor_version_number_;
+	version_number[2] = revision_version_number_;
+	_update_capabilities();
+	caps_check_ = CAPS_CHECK_PENDING;
+	return true;
+}
+
+void XArmAPI::_save_capability_cache(void) {
+	std::string path = capability_cache_path(cache_dir_);
+	if (path == "") return;
+	std::vector<std::string> lines;
+	char line[512];
+	FILE *fp = fopen(path.data(), "r");
+	if (fp != NULL) {
+		while (fgets(line, sizeof(line), fp) != NULL) {
+			std::string l(line);
+			if (l.compare(0, port_.size() + 1, port_ + "\t") != 0) lines.push_back(l);
+		}
+		fclose(fp);
+	}
+	fp = fopen(path.data(), "w");
+	if (fp == NULL) return;
+	for (u32 i = 0; i < lines.size(); i++) fputs(lines[i].c_str(), fp);
+	std::string sn_ = cache_field((const char *)sn, sizeof(sn));
+	fprintf(fp, "%s\t%s\t%s\t%d\t%d\t%d\t%d\t%s\n", port_.c_str(), sn_.c_str(),
+		cached_version_ == "" ? "-" : cached_version_.c_str(),
+		major_version_number_, minor_version_number_, revision_version_number_, is_old_protocol_ ? 1 : 0,
+		cached_report_version_ == "" ? "-" : cached_report_version_.c_str());
+	fclose(fp);
+}
+
+void XArmAPI::_check_capability_cache(void) {
+	std::string v = cache_field((const char *)reported_version_, sizeof(reported_version_));
+	if (cached_report_version_ == "") {
+		cached_report_version_ = v;
+		caps_check_ = CAPS_CHECK_DONE;
+		_save_capability_cache();
+	}
+	else if (cached_report_version_ == v) {
+		caps_check_ = CAPS_CHECK_DONE;
+	}
+	else {
+		// the firmware was changed since the cache was written, probe again (done by the supervisor)
+		XARM_LOG_INFO("The firmware changed since the capabilities were cached, checking again");
+		caps_probe_id_ = -1;
+		caps_probe_tries_ = 0;
+		caps_check_ = CAPS_CHECK_STALE;
+	}
+}
+
+void XArmAPI::_probe_capabilities(long long now) {
+	// the version is posted and its reply collected by the next rounds, the supervision goes on meanwhile
+	UxbusCmd *core = cmd_tcp_;
+	if (caps_probe_id_ >= 0) {
+		unsigned char frame[UxbusCmd::MAX_FRAME_LEN];
+		int len = 0;
+		int ret = core->recv_frame(caps_probe_id_, frame, &len, 0);
+		if (ret == UXBUS_STATE::ERR_TOUT && now - caps_probe_time_ < UXBUS_CONF::GET_TIMEOUT) return;
+		caps_probe_id_ = -1;
+		if (ret == UXBUS_STATE::ERR_TOUT) core->get_metrics()->record_timeout(UXBUS_RG::GET_VERSION);
+		// {trans id, prot, len, funcode, state, data}, the errors and the warnings of the arm still have the version
+		if (ret == 0 && len > 8 && frame[6] == UXBUS_RG::GET_VERSION) {
+			unsigned char version_[40] = { 0 };
+			memcpy(version_, &frame[8], len - 8 < 40 ? len - 8 : 40);
+			// caps_ is published whole, the report thread decodes the next report with it
+			_parse_version(version_);
+			XARM_LOG_INFO("version_number: %d.%d.%d", major_version_number_, minor_version_number_, revision_version_number_);
+			cached_report_version_ = "";
+			_save_capability_cache();
+			caps_check_ = CAPS_CHECK_PENDING;
+			return;
+		}
+	}
+	if (caps_probe_tries_ >= 5) {
+		// the cached capabilities are kept until the next connect
+		XARM_LOG_WARN("Warning: the version could not be read, the cached capabilities are kept");
+		caps_check_ = CAPS_CHECK_DONE;
+		return;
+	}
+	caps_probe_tries_ += 1;
+	caps_probe_id_ = core->post_cmd<UXBUS_CMD::GET_VERSION>();
+	caps_probe_time_ = now;
+}
+
+int XArmAPI::set_fast_connect(bool enable, const std::string &cache_dir) {
+	fast_connect_ = enable;
+	cache_dir_ = cache_dir;
+	return 0;
+}
+
+int XArmAPI::set_command_broker(const std::string &path, int priority) {
+	broker_path_ = path;
+	broker_priority_ = priority > 255 ? 255 : priority;
+	return 0;
+}
+
 void XArmAPI::_check_is_pause(void) {
 	if (check_is_pause_ && state == 3) {
 		std::unique_lock<std::mutex> locker(mutex_);
@@ -668,47 +1180,11 @@ void XArmAPI::_check_is_pause(void) {
 
 bool XArmAPI::version_is_ge(int major, int minor, int revision) {
 	if (major_version_number_ == 0 && minor_version_number_ == 0 && revision_version_number_ == 0) {
-		unsigned char version_[40];
+		unsigned char version_[40] = { 0 };
 		get_version(version_);
-		std::string v((const char *)version_);
-		std::regex pattern(".*[vV](\\d+)[.](\\d+)[.](\\d+)");
-		std::smatch result;
-		if (std::regex_match(v, result, pattern)) {
-			auto it = result.begin();
-			sscanf(std::string(*++it).data(), "%d", &major_version_number_);
-			sscanf(std::string(*++it).data(), "%d", &minor_version_number_);
-			sscanf(std::string(*++it).data(), "%d", &revision_version_number_);
-		}
-		else {
-			std::vector<std::string> tmpList = split(v, "-");
-			int size = tmpList.size();
-			if (size >= 3) {
-				int year = atoi(tmpList[size - 3].c_str());
-				int month = atoi(tmpList[size - 2].c_str());
-				if (year < 2019) is_old_protocol_ = true;
-				else if (year == 2019) {
-					is_old_protocol_ = month >= 2 ? false : true;
-				}
-				else {
-					is_old_protocol_ = false;
-				}
-			}
-			if (is_old_protocol_) {
-				major_version_number_ = 0;
-				minor_version_number_ = 0;
-				revision_version_number_ = 1;
-			}
-			else {
-				major_version_number_ = 0;
-				minor_version_number_ = 1;
-				revision_version_number_ = 0;
-			}
-		}
-		version_number[0] = major_version_number_;
-		version_number[1] = minor_version_number_;
-		version_number[2] = revision_version_number_;
+		_parse_version(version_);
 	}
-	return major_version_number_ > major || (major_version_number_ == major && minor_version_number_ > minor) || (major_version_number_ == major && minor_version_number_ == minor && revision_version_number_ >= revision);
+	return _version_ge(major, minor, revision);
 }
 
 int XArmAPI::connect(const std::string &port) {
@@ -717,36 +1193,74 @@ int XArmAPI::connect(const std::string &port) {
 		port_ = port;
 	}
 	if (port_ == "") {
-		printf("can not connect to port/ip: %s\n", port_.data());
+		XARM_LOG_ERROR("can not connect to port/ip: %s", port_.data());
 		return -1;
 	}
 	// std::regex pattern("(\\d|\\d{1,2}|(1\\d{1,2})|2[0-5]{1,2})[.](\\d|\\d{1,2}|(1\\d{1,2})|2[0-5]{1,2})[.](\\d|\\d{1,2}|(1\\d{1,2})|2[0-5]{1,2})[.](\\d|\\d{1,2}|(1\\d{1,2})|2[0-5]{1,2})");
 	std::regex pattern("(?:(?:25[0-5]|2[0-4][0-9]|[01]?[0-9][0-9]?)[.]){3}(?:25[0-5]|2[0-4][0-9]|[01]?[0-9][0-9]?)");
+	// the supervisor may still be reconnecting a previous connection
+	disconnect();
 	is_ready_ = true;
+	limit_validator_.invalidate();
 	if (port_ == "localhost" || std::regex_match(port_, pattern)) {
 		is_tcp_ = true;
-		stream_tcp_ = new SocketPort((char *)port_.data(), XARM_CONF::TCP_PORT_CONTROL, 3, 128);
+		_release_tcp_ports();
+		// in fast connect mode the report channel is opened while the control channel is set up
+		std::thread report_connector;
+		if (fast_connect_) {
+			report_connector = std::thread([this] {
+				stream_tcp_report_ = new SocketPort((char *)port_.data(), XARM_CONF::TCP_PORT_REPORT_RICH, 3, 512, reconnect_timeout_ms_);
+			});
+		}
+		std::string control_addr = broker_path_ == "" ? port_ : "unix:" + broker_path_;
+		stream_tcp_ = new SocketPort((char *)control_addr.data(), XARM_CONF::TCP_PORT_CONTROL, 16, 128, reconnect_timeout_ms_);
 		if (stream_tcp_->is_ok() != 0) {
-			printf("Error: Tcp control connection failed\n");
+			if (report_connector.joinable()) report_connector.join();
+			XARM_LOG_ERROR("Error: Tcp control connection failed");
 			return -2;
 		}
+		if (broker_path_ != "" && broker_priority_ >= 0) {
+			unsigned char frame[8] = { 0, 0, 0, CommandBroker::PROT_BROKER, 0, 2, CommandBroker::SET_PRIORITY, (unsigned char)broker_priority_ };
+			stream_tcp_->write_frame(frame, 8);
+		}
 		cmd_tcp_ = new UxbusCmdTcp((SocketPort *)stream_tcp_);
-		printf("Tcp control connection successful\n");
+		metrics_register(port_.c_str(), cmd_tcp_->get_metrics());
+		XARM_LOG_INFO("Tcp control connection successful");
 
-		sleep_milliseconds(200);
-		_check_version();
+		if (fast_connect_) {
+			_fast_check_version();
+			report_connector.join();
+		}
+		else {
+			sleep_milliseconds(200);
+			_check_version();
+			stream_tcp_report_ = new SocketPort((char *)port_.data(), XARM_CONF::TCP_PORT_REPORT_RICH, 3, 512, reconnect_timeout_ms_);
+		}
 
-		stream_tcp_report_ = new SocketPort((char *)port_.data(), XARM_CONF::TCP_PORT_REPORT_RICH, 3, 512);
+		// the kernel stamps are free of the delay of the receive thread, used where available
+		stream_tcp_report_->set_recv_stamp(true);
+		int ret = 0;
 		if (stream_tcp_report_->is_ok() != 0) {
-			_report_connect_changed_callback();
-			printf("Error: Tcp report connection failed\n");
-			return -3;
+			XARM_LOG_ERROR("Error: Tcp report connection failed");
+			ret = -3;
+		}
+		else {
+			XARM_LOG_INFO("Tcp report connection successful");
+			std::lock_guard<std::mutex> locker(stats_mutex_);
+			conn_stats_.connected_since = get_system_time();
 		}
 		_report_connect_changed_callback();
-		printf("Tcp report connection successful\n");
+		is_closed_ = false;
+		last_report_time_ = get_system_time();
+		report_health_.reset();
+		report_clock_.reset();
+		state_predictor_.reset();
+		axis_reported_ = false;
 		// report_thread_ = thread_init(report_thread_handle_, this);
 		report_thread_ = std::thread(report_thread_handle_, this);
-		report_thread_.detach();
+		// the supervisor also reconnects the report channel if the first attempt failed
+		supervisor_thread_ = std::thread(supervisor_thread_handle_, this);
+		if (ret != 0) return ret;
 
 		// stream_tcp_report_ = new SocketPort(server_ip, XARM_CONF::TCP_PORT_REPORT_NORM, 3, 512);
 		// stream_tcp_report_ = new SocketPort(server_ip, XARM_CONF::TCP_PORT_REPORT_RICH, 3, 512);
@@ -756,6 +1270,7 @@ int XArmAPI::connect(const std::string &port) {
 		is_tcp_ = false;
 		stream_ser_ = new SerialPort((const char *)port_.data(), XARM_CONF::SERIAL_BAUD, 3, 128);
 		cmd_ser_ = new UxbusCmdSer((SerialPort *)stream_ser_);
+		metrics_register(port_.c_str(), cmd_ser_->get_metrics());
 		sleep_milliseconds(200);
 		_check_version();
 	}
@@ -764,6 +1279,11 @@ int XArmAPI::connect(const std::string &port) {
 }
 
 void XArmAPI::disconnect(void) {
+	is_closed_ = true;
+	// stop the supervisor first, otherwise it would reopen the channels closed below
+	if (supervisor_thread_.joinable() && supervisor_thread_.get_id() != std::this_thread::get_id()) {
+		supervisor_thread_.join();
+	}
 	if (stream_tcp_ != NULL) {
 		stream_tcp_->close_port();
 	}
@@ -773,7 +1293,11 @@ void XArmAPI::disconnect(void) {
 	if (stream_tcp_report_ != NULL) {
 		stream_tcp_report_->close_port();
 	}
+	if (report_thread_.joinable() && report_thread_.get_id() != std::this_thread::get_id()) {
+		report_thread_.join();
+	}
 	is_ready_ = false;
+	cond_.notify_all();
 }
 
 int XArmAPI::get_version(unsigned char version_[40]) {
@@ -913,13 +1437,13 @@ int XArmAPI::motion_enable(bool enable, int servo_id) {
 	get_state(&state);
 	if (state == 4) {
 		if (is_ready_) {
-			printf("[motion_enable], xArm is not ready to move\n");
+			XARM_LOG_INFO("[motion_enable], xArm is not ready to move");
 		}
 		is_ready_ = false;
 	}
 	else {
 		if (!is_ready_) {
-			printf("[motion_enable], xArm is ready to move\n");
+			XARM_LOG_INFO("[motion_enable], xArm is ready to move");
 		}
 		is_ready_ = true;
 	}
@@ -929,7 +1453,13 @@ int XArmAPI::motion_enable(bool enable, int servo_id) {
 int XArmAPI::set_state(int state_) {
 	if (!is_connected()) return -1;
 	int ret = 0;
-	if (is_tcp_) {
+	if (state_ == 3 && _is_state_reported()) {
+		// as emergency_stop, a stopped arm is not paused but stays stopped
+		long long start_time = get_system_time();
+		while (state != 3 && state != 4 && get_system_time() - start_time < 3000) _post_urgent_state(3);
+		ret = state == 3 || state == 4 ? 0 : UXBUS_STATE::ERR_TOUT;
+	}
+	else if (is_tcp_) {
 		ret = cmd_tcp_->set_state(state_);
 	}
 	else {
@@ -939,13 +1469,13 @@ int XArmAPI::set_state(int state_) {
 	if (state == 4) {
 		// is_sync_ = false;
 		if (is_ready_) {
-			printf("[set_state], xArm is not ready to move\n");
+			XARM_LOG_INFO("[set_state], xArm is not ready to move");
 		}
 		is_ready_ = false;
 	}
 	else {
 		if (!is_ready_) {
-			printf("[set_state], xArm is ready to move\n");
+			XARM_LOG_INFO("[set_state], xArm is ready to move");
 		}
 		is_ready_ = true;
 	}
@@ -954,6 +1484,7 @@ int XArmAPI::set_state(int state_) {
 
 int XArmAPI::set_mode(int mode_) {
 	if (!is_connected()) return -1;
+	last_set_mode_ = mode_;
 	int ret = 0;
 	if (is_tcp_) {
 		ret = cmd_tcp_->set_mode(mode_);
@@ -998,13 +1529,13 @@ int XArmAPI::clean_error(void) {
 	get_state(&state);
 	if (state == 4) {
 		if (is_ready_) {
-			printf("[clean_error], xArm is not ready to move\n");
+			XARM_LOG_INFO("[clean_error], xArm is not ready to move");
 		}
 		is_ready_ = false;
 	}
 	else {
 		if (!is_ready_) {
-			printf("[clean_error], xArm is ready to move\n");
+			XARM_LOG_INFO("[clean_error], xArm is ready to move");
 		}
 		is_ready_ = true;
 	}
@@ -1042,6 +1573,7 @@ int XArmAPI::set_pause_time(fp32 sltime) {
 }
 
 void XArmAPI::_wait_stop(fp32 timeout) {
+	XARM_TRACE_SCOPE("wait_stop");
 	is_stop_ = false;
 	// fp32 base_angles[7];
 	// memcpy(base_angles, angles, 7 * sizeof(fp32));
@@ -1085,21 +1617,27 @@ int XArmAPI::set_position(fp32 pose[6], fp32 radius, fp32 speed, fp32 acc, fp32
 		last_used_position[i] = pose[i];
 		mvpose[i] = (float)(default_is_radian || i < 3 ? last_used_position[i] : last_used_position[i] / RAD_DEGREE);
 	}
+	fp32 speed_ = last_used_tcp_speed;
+	if (check_tcp_limit_) {
+		ret = _check_tcp_limit(mvpose);
+		if (ret != 0) return ret;
+		speed_ = limit_validator_.clamp_tcp_speed(speed_);
+	}
 
 	if (radius >= 0) {
 		if (is_tcp_) {
-			ret = cmd_tcp_->move_lineb(mvpose, last_used_tcp_speed, last_used_tcp_acc, mvtime, radius);
+			ret = cmd_tcp_->move_lineb(mvpose, speed_, last_used_tcp_acc, mvtime, radius);
 		}
 		else {
-			ret = cmd_ser_->move_lineb(mvpose, last_used_tcp_speed, last_used_tcp_acc, mvtime, radius);
+			ret = cmd_ser_->move_lineb(mvpose, speed_, last_used_tcp_acc, mvtime, radius);
 		}
 	}
 	else {
 		if (is_tcp_) {
-			ret = cmd_tcp_->move_line(mvpose, last_used_tcp_speed, last_used_tcp_acc, mvtime);
+			ret = cmd_tcp_->move_line(mvpose, speed_, last_used_tcp_acc, mvtime);
 		}
 		else {
-			ret = cmd_ser_->move_line(mvpose, last_used_tcp_speed, last_used_tcp_acc, mvtime);
+			ret = cmd_ser_->move_line(mvpose, speed_, last_used_tcp_acc, mvtime);
 		}
 	}
 	if (wait && (ret == 0 || ret == UXBUS_STATE::WAR_CODE)) {
@@ -1158,7 +1696,13 @@ int XArmAPI::set_servo_angle(fp32 angs[7], fp32 speed, fp32 acc, fp32 mvtime, bo
 	}
 	fp32 speed_ = (float)(default_is_radian ? last_used_joint_speed : last_used_joint_speed / RAD_DEGREE);
 	fp32 acc_ = (float)(default_is_radian ? last_used_joint_acc : last_used_joint_acc / RAD_DEGREE);
-
+	if (check_joint_limit_) {
+		ret = _check_joint_limit(mvjoint);
+		if (ret != 0) return ret;
+		speed_ = limit_validator_.clamp_joint_speed(speed_);
+	}
+	ret = _check_collision(mvjoint, true);
+	if (ret != 0) return ret;
 
 	if (is_tcp_) {
 		ret = cmd_tcp_->move_joint(mvjoint, speed_, acc_, mvtime);
@@ -1189,11 +1733,18 @@ int XArmAPI::set_servo_angle(int servo_id, fp32 angle, bool wait, fp32 timeout)
 
 int XArmAPI::set_servo_angle_j(fp32 angs[7], fp32 speed, fp32 acc, fp32 mvtime) {
 	if (!is_connected()) return -1;
+	if (_is_servo_held()) return UXBUS_STATE::REPORT_STALE;
 	int ret = 0;
 	fp32 mvjoint[7];
 	for (u32 i = 0; i < 7; i++) {
 		mvjoint[i] = (float)(default_is_radian ? angs[i] : angs[i] / RAD_DEGREE);
 	}
+	if (check_joint_limit_) {
+		ret = _check_joint_limit(mvjoint);
+		if (ret != 0) return ret;
+	}
+	ret = _check_collision(mvjoint, false);
+	if (ret != 0) return ret;
 
 	if (is_tcp_) {
 		ret = cmd_tcp_->move_servoj(mvjoint, last_used_joint_speed, last_used_joint_acc, mvtime);
@@ -1207,11 +1758,16 @@ int XArmAPI::set_servo_angle_j(fp32 angs[7], fp32 speed, fp32 acc, fp32 mvtime)
 
 int XArmAPI::set_servo_cartesian(fp32 pose[6], fp32 speed, fp32 acc, fp32 mvtime) {
 	if (!is_connected()) return -1;
+	if (_is_servo_held()) return UXBUS_STATE::REPORT_STALE;
 	int ret = 0;
 	fp32 mvpose[6];
 	for (u32 i = 0; i < 6; i++) {
 		mvpose[i] = (float)(i < 3 || default_is_radian ? pose[i] : pose[i] / RAD_DEGREE);
 	}
+	if (check_tcp_limit_) {
+		ret = _check_tcp_limit(mvpose);
+		if (ret != 0) return ret;
+	}
 
 	if (is_tcp_) {
 		ret = cmd_tcp_->move_servo_cartesian(mvpose, last_used_tcp_speed, last_used_tcp_acc, mvtime);
@@ -1300,9 +1856,14 @@ void XArmAPI::reset(bool wait, fp32 timeout) {
 
 void XArmAPI::emergency_stop(void) {
 	long long start_time = get_system_time();
+	int value = 4;
 	while (state != 4 && get_system_time() - start_time < 3000) {
-		set_state(4);
-		sleep_milliseconds(100);
+		if (!_is_state_reported()) {
+			set_state(4);
+			sleep_milliseconds(100);
+			continue;
+		}
+		_post_urgent_state(value);
 	}
 	is_stop_ = true;
 	sleep_finish_time_ = 0;
@@ -1313,6 +1874,18 @@ void XArmAPI::emergency_stop(void) {
 	// }
 }
 
+bool XArmAPI::_is_state_reported(void) {
+	return is_tcp_ && is_connected() && stream_tcp_report_ != NULL && stream_tcp_report_->is_ok() == 0;
+}
+
+void XArmAPI::_post_urgent_state(int value) {
+	// written ahead of the other requests, without waiting for the reply,
+	//   the caller sends it again at a short interval until a report shows the state
+	cmd_tcp_->post_urgent<UXBUS_CMD::SET_STATE>(&value, false);
+	std::unique_lock<std::mutex> locker(mutex_);
+	cond_.wait_for(locker, std::chrono::milliseconds(STOP_RETRY_INTERVAL), [this, value] { return state == value; });
+}
+
 int XArmAPI::get_inverse_kinematics(fp32 source_pose[6], fp32 target_angles[7]) {
 	if (!is_connected()) return -1;
 	fp32 pose[6];
@@ -1385,6 +1958,129 @@ int XArmAPI::is_joint_limit(fp32 source_angles[7], int *limit) {
 	return ret;
 }
 
+void XArmAPI::_refresh_limits(void) {
+	// the ranges of the model are not checked before a report gave it
+	int model_axis = axis_reported_ ? axis : 0;
+	if (limit_validator_.get_axis() != model_axis) {
+		limit_validator_.set_axis(model_axis);
+	}
+	if (limit_validator_.is_valid()) return;
+	int on = 0, fense_on = 0, rebound_on = 0;
+	int xyz_list[6] = { 0 };
+	float tcp_speed = 0, joint_speed = 0;
+	float jrange[14] = { 0 };
+	bool has_jrange = (caps_ & CAP_REDUCED_STATES_EXT) != 0;
+	int rx_len = has_jrange ? 79 : 21;
+	int ret;
+	if (is_tcp_) {
+		ret = cmd_tcp_->get_reduced_states(&on, xyz_list, &tcp_speed, &joint_speed, jrange, &fense_on, &rebound_on, rx_len);
+	}
+	else {
+		ret = cmd_ser_->get_reduced_states(&on, xyz_list, &tcp_speed, &joint_speed, jrange, &fense_on, &rebound_on, rx_len);
+	}
+	// without the reduced states only the joint ranges of the model are checked, do not ask again on every command
+	if (!UxbusCmd::has_reply(ret)) {
+		on = 0;
+		fense_on = 0;
+	}
+	limit_validator_.update(on, xyz_list, tcp_speed, joint_speed, has_jrange ? jrange : NULL, fense_on);
+}
+
+int XArmAPI::_check_joint_limit(fp32 angles[7]) {
+	_refresh_limits();
+	return limit_validator_.check_joints(angles);
+}
+
+int XArmAPI::_check_tcp_limit(fp32 pose[6]) {
+	_refresh_limits();
+	return limit_validator_.check_pose(pose);
+}
+
+int XArmAPI::_check_collision(fp32 target[7], bool from_current) {
+	CollisionChecker *checker = collision_checker_;
+	if (checker == NULL) return 0;
+	if (!from_current) return checker->check(target);
+	fp32 current[7];
+	for (int i = 0; i < 7; i++) {
+		current[i] = (float)(default_is_radian ? angles[i] : angles[i] / RAD_DEGREE);
+	}
+	return checker->check_path(current, target);
+}
+
+int XArmAPI::_encode_move(int funcode, fp32 *target, fp32 speed, fp32 acc, fp32 mvtime, unsigned char *frame, int *len) {
+	int ret = 0;
+	fp32 tx[10];
+	*len = -1;
+	if (funcode == UXBUS_RG::MOVE_SERVOJ && _is_servo_held()) return UXBUS_STATE::REPORT_STALE;
+	if (funcode == UXBUS_RG::MOVE_LINE) {
+		for (int i = 0; i < 6; i++) {
+			tx[i] = (float)(default_is_radian || i < 3 ? target[i] : target[i] / RAD_DEGREE);
+		}
+		tx[6] = speed > 0 ? speed : last_used_tcp_speed;
+		if (check_tcp_limit_) {
+			ret = _check_tcp_limit(tx);
+			if (ret != 0) return ret;
+			tx[6] = limit_validator_.clamp_tcp_speed(tx[6]);
+		}
+		tx[7] = acc > 0 ? acc : last_used_tcp_acc;
+		tx[8] = mvtime;
+	}
+	else {
+		for (int i = 0; i < 7; i++) {
+			tx[i] = (float)(default_is_radian ? target[i] : target[i] / RAD_DEGREE);
+		}
+		speed = speed > 0 ? speed : last_used_joint_speed;
+		acc = acc > 0 ? acc : last_used_joint_acc;
+		if (funcode == UXBUS_RG::MOVE_JOINT) {
+			tx[7] = (float)(default_is_radian ? speed : speed / RAD_DEGREE);
+			tx[8] = (float)(default_is_radian ? acc : acc / RAD_DEGREE);
+		}
+		else {
+			// the servo moves ignore the speed and the acceleration, same as set_servo_angle_j
+			tx[7] = speed;
+			tx[8] = acc;
+		}
+		tx[9] = mvtime;
+		if (check_joint_limit_) {
+			ret = _check_joint_limit(tx);
+			if (ret != 0) return ret;
+			if (funcode == UXBUS_RG::MOVE_JOINT) tx[7] = limit_validator_.clamp_joint_speed(tx[7]);
+		}
+		// the start is not known yet, the target only
+		ret = _check_collision(tx, false);
+		if (ret != 0) return ret;
+	}
+	UxbusCmd *core = is_tcp_ ? (UxbusCmd *)cmd_tcp_ : (UxbusCmd *)cmd_ser_;
+	switch (funcode) {
+	case UXBUS_RG::MOVE_LINE:
+		*len = core->build_frame<UXBUS_CMD::MOVE_LINE>(tx, frame);
+		break;
+	case UXBUS_RG::MOVE_JOINT:
+		*len = core->build_frame<UXBUS_CMD::MOVE_JOINT>(tx, frame);
+		break;
+	default:
+		*len = core->build_frame<UXBUS_CMD::MOVE_SERVOJ>(tx, frame);
+		break;
+	}
+	return 0;
+}
+
+int XArmAPI::_pend_move(UxbusCmd *core, int funcode, int trans_id) {
+	switch (funcode) {
+	case UXBUS_RG::MOVE_LINE:
+		return core->pend_cmd<UXBUS_CMD::MOVE_LINE>(trans_id);
+	case UXBUS_RG::MOVE_JOINT:
+		return core->pend_cmd<UXBUS_CMD::MOVE_JOINT>(trans_id);
+	default:
+		return core->pend_cmd<UXBUS_CMD::MOVE_SERVOJ>(trans_id);
+	}
+}
+
+int XArmAPI::_check_background_port(void) {
+	if (!is_connected()) return UXBUS_STATE::NOT_CONNECTED;
+	return is_tcp_ ? 0 : UXBUS_STATE::ERR_NOTTCP;
+}
+
 int XArmAPI::set_collision_sensitivity(int sensitivity) {
 	_check_is_pause();
 	if (!is_connected()) return -1;
@@ -1470,7 +2166,7 @@ int XArmAPI::set_tcp_load(fp32 weight, fp32 center_of_gravity[3]) {
 	if (!is_connected()) return -1;
 	int ret = 0;
 	float _gravity[3];
-	if (compare_version(version_number, new int[3]{ 0, 2, 0 })) {
+	if (caps_ & CAP_TCP_LOAD_MM) {
 		_gravity[0] = center_of_gravity[0];
 		_gravity[1] = center_of_gravity[1];
 		_gravity[2] = center_of_gravity[2];
@@ -1616,6 +2312,27 @@ int XArmAPI::set_gripper_position(fp32 pos, bool wait, fp32 timeout) {
 	else {
 		ret = cmd_ser_->gripper_modbus_set_pos(pos);
 	}
+	if (wait) {
+		GripperPoller *poller = NULL;
+		{
+			// the poller is only taken under the lock, the waits on it run in parallel
+			std::lock_guard<std::mutex> locker(gripper_poller_mutex_);
+			if (gripper_poller_ != NULL && gripper_poller_->is_running()) {
+				poller = gripper_poller_;
+				poller->wait_num_ += 1;
+			}
+		}
+		if (poller != NULL) {
+			int ret2 = poller->wait_position(pos, 1, timeout);
+			{
+				std::lock_guard<std::mutex> locker(gripper_poller_mutex_);
+				poller->wait_num_ -= 1;
+				poller->wait_cond_.notify_all();
+			}
+			// as the polling wait below, a timeout is not an error
+			return (ret2 != 0 && ret2 != UXBUS_STATE::ERR_TOUT) ? ret2 : ret;
+		}
+	}
 	if (wait) {
 		int ret2 = 0;
 		ret2 = get_gripper_position(&pos_tmp);
@@ -1672,7 +2389,7 @@ int XArmAPI::set_gripper_position(fp32 pos, bool wait, fp32 timeout) {
 
 				}
 				if (count >= 5) {
-					printf("gripper target: %f, current: %f\n", pos, cur_pos);
+					XARM_LOG_DEBUG("gripper target: %f, current: %f", pos, cur_pos);
 					break;
 				}
 			}
@@ -1863,6 +2580,7 @@ int XArmAPI::set_reduced_mode(bool on) {
 	else {
 		ret = cmd_ser_->set_reduced_mode(int(on));
 	}
+	limit_validator_.invalidate();
 	return ret;
 }
 
@@ -1875,6 +2593,7 @@ int XArmAPI::set_reduced_max_tcp_speed(float speed) {
 	else {
 		ret = cmd_ser_->set_reduced_linespeed(speed);
 	}
+	limit_validator_.invalidate();
 	return ret;
 }
 
@@ -1887,6 +2606,7 @@ int XArmAPI::set_reduced_max_joint_speed(float speed) {
 	else {
 		ret = cmd_ser_->set_reduced_jointspeed(default_is_radian ? speed : (float)(speed / RAD_DEGREE));
 	}
+	limit_validator_.invalidate();
 	return ret;
 }
 
@@ -1906,15 +2626,15 @@ int XArmAPI::get_reduced_states(int *on, int *xyz_list, float *tcp_speed, float
 	if (!is_connected()) return -1;
 	int ret = 0;
 	if (is_tcp_) {
-		ret = cmd_tcp_->get_reduced_states(on, xyz_list, tcp_speed, joint_speed, jrange, fense_is_on, collision_rebound_is_on, version_is_ge() ? 79 : 21);
+		ret = cmd_tcp_->get_reduced_states(on, xyz_list, tcp_speed, joint_speed, jrange, fense_is_on, collision_rebound_is_on, (caps_ & CAP_REDUCED_STATES_EXT) ? 79 : 21);
 	}
 	else {
-		ret = cmd_ser_->get_reduced_states(on, xyz_list, tcp_speed, joint_speed, jrange, fense_is_on, collision_rebound_is_on, version_is_ge() ? 79 : 21);
+		ret = cmd_ser_->get_reduced_states(on, xyz_list, tcp_speed, joint_speed, jrange, fense_is_on, collision_rebound_is_on, (caps_ & CAP_REDUCED_STATES_EXT) ? 79 : 21);
 	}
 	if (!default_is_radian) {
 		*joint_speed = (float)(*joint_speed * RAD_DEGREE);
 	}
-	if (version_is_ge()) {
+	if (caps_ & CAP_REDUCED_STATES_EXT) {
 		if (jrange != NULL && !default_is_radian) {
 			for (u32 i = 0; i < 14; i++) {
 				jrange[i] = (float)(jrange[i] * RAD_DEGREE);
@@ -1933,6 +2653,7 @@ int XArmAPI::set_reduced_tcp_boundary(int boundary[6]) {
 	else {
 		ret = cmd_ser_->set_xyz_limits(boundary);
 	}
+	limit_validator_.invalidate();
 	return ret;
 }
 
@@ -1949,6 +2670,7 @@ int XArmAPI::set_reduced_joint_range(float jrange[14]) {
 	else {
 		ret = cmd_ser_->set_reduced_jrange(joint_range);
 	}
+	limit_validator_.invalidate();
 	return ret;
 }
 
@@ -1961,6 +2683,7 @@ int XArmAPI::set_fense_mode(bool on) {
 	else {
 		ret = cmd_ser_->set_fense_on(int(on));
 	}
+	limit_validator_.invalidate();
 	return ret;
 }
 
@@ -1976,6 +2699,20 @@ int XArmAPI::set_collision_rebound(bool on) {
 	return ret;
 }
 
+void XArmAPI::set_collision_checker(CollisionChecker *checker) {
+	collision_checker_ = checker;
+	_sync_collision_axis();
+}
+
+void XArmAPI::_sync_collision_axis(void) {
+	CollisionChecker *checker = collision_checker_;
+	if (checker != NULL && axis_reported_ && checker->get_axis() != axis) checker->set_axis(axis);
+}
+
+void XArmAPI::set_state_publisher(StatePublisher *publisher) {
+	state_publisher_ = publisher;
+}
+
 int XArmAPI::set_world_offset(float pose_offset[6]) {
 	_check_is_pause();
 	if (!is_connected()) return -1;
@@ -2221,6 +2958,10 @@ int XArmAPI::register_count_changed_callback(void(*callback)(int cmdnum)) {
 	return _register_event_callback(count_changed_callbacks_, callback);
 }
 
+int XArmAPI::register_report_stale_callback(void(*callback)(bool stale, int age_ms)) {
+	return _register_event_callback(report_stale_callbacks_, callback);
+}
+
 int XArmAPI::release_report_location_callback(void(*callback)(const fp32 *pose, const fp32 *angles)) {
 	return _release_event_callback(report_location_callbacks_, callback);
 }
@@ -2256,6 +2997,10 @@ int XArmAPI::release_count_changed_callback(void(*callback)(int)) {
 	return _release_event_callback(count_changed_callbacks_, callback);
 }
 
+int XArmAPI::release_report_stale_callback(void(*callback)(bool, int)) {
+	return _release_event_callback(report_stale_callbacks_, callback);
+}
+
 int XArmAPI::get_suction_cup(int *val) {
 	int io1;
 	return get_tgpio_digital(val, &io1);
@@ -2300,29 +3045,17 @@ int XArmAPI::set_suction_cup(bool on, bool wait, float timeout) {
 }
 
 int XArmAPI::get_gripper_version(unsigned char versions[3]) {
-	int ret1, ret2, ret3;
-	unsigned char val1[5], val2[5], val3[5];
-	int code;
 	versions[0] = 0;
 	versions[1] = 0;
 	versions[2] = 0;
-	if (is_tcp_) {
-		ret1 = cmd_tcp_->gripper_modbus_r16s(0x0801, 1, val1);
-		ret2 = cmd_tcp_->gripper_modbus_r16s(0x0802, 1, val2);
-		ret3 = cmd_tcp_->gripper_modbus_r16s(0x0803, 1, val3);
-	}
-	else {
-		ret1 = cmd_ser_->gripper_modbus_r16s(0x0801, 1, val1);
-		ret2 = cmd_ser_->gripper_modbus_r16s(0x0802, 1, val2);
-		ret3 = cmd_ser_->gripper_modbus_r16s(0x0803, 1, val3);
+	// the three registers in one request
+	ModbusTransaction trans(UXBUS_CONF::GRIPPER_ID);
+	int op = trans.read_holding(0x0801, 3);
+	int ret = trans.execute(this);
+	if (ret == 0) {
+		for (int i = 0; i < 3; i++) { versions[i] = (unsigned char)trans.get_u16(op, i); }
 	}
-	if (ret1 == 0) { versions[0] = (unsigned char)bin8_to_16(&val1[4]); }
-	else { code = ret1; }
-	if (ret2 == 0) { versions[1] = (unsigned char)bin8_to_16(&val2[4]); }
-	else { code = ret2; }
-	if (ret3 == 0) { versions[2] = (unsigned char)bin8_to_16(&val3[4]); }
-	else { code = ret3; }
-	return code;
+	return ret;
 }
 
 int XArmAPI::get_servo_version(unsigned char versions[3], int servo_id) {
@@ -0,0 +1,294 @@
+/*
+# Software License Agreement (MIT License)
+#
+# Copyright (c) 2019, UFACTORY, Inc.
+# All rights reserved.
+#
+# Author: Vinman <vinman.wen@ufactory.cc> <vinman.cub@gmail.com>
+*/
+#include <string.h>
+#include "xarm/wrapper/xarm_api.h"
+#include "xarm/wrapper/xarm_c_api.h"
+
+struct XArmInstance {
+	XArmAPI *api;
+	StatePublisher states; // the reports of the arm in the memory of the process, for the report getters
+};
+
+// the report getters copy under the seqlock of the slot, a copy is only retried when its slot was rewritten meanwhile
+static int read_report_(XArmHandle arm, RobotState *state) {
+	if (arm == NULL) return -1;
+	while (true) {
+		unsigned int lock;
+		const RobotState *latest = arm->states.peek(&lock);
+		if (latest == NULL) return UXBUS_STATE::NOT_READY;
+		memcpy(state, latest, sizeof(RobotState));
+		if (arm->states.is_current(latest, lock)) return 0;
+	}
+}
+
+XArmHandle XARM_CALL xarm_create(const char *port, int is_radian, int do_not_open,
+	int check_tcp_limit, int check_joint_limit, int check_cmdnum_limit,
+	int check_robot_sn, int check_is_ready, int check_is_pause) {
+	XArmInstance *arm = new XArmInstance;
+	// the publisher is open before the arm connects, so the first report is kept
+	arm->states.open_local();
+	arm->api = new XArmAPI(port == NULL ? "" : port, is_radian != 0, true,
+		check_tcp_limit != 0, check_joint_limit != 0, check_cmdnum_limit != 0,
+		check_robot_sn != 0, check_is_ready != 0, check_is_pause != 0);
+	arm->api->set_state_publisher(&arm->states);
+	if (!do_not_open) arm->api->connect();
+	return arm;
+}
+
+void XARM_CALL xarm_destroy(XArmHandle arm) {
+	if (arm == NULL) return;
+	// joins the report thread, nothing is published after
+	delete arm->api;
+	delete arm;
+}
+
+int XARM_CALL xarm_connect(XArmHandle arm, const char *port) {
+	if (arm == NULL) return -1;
+	return arm->api->connect(port == NULL ? "" : port);
+}
+
+int XARM_CALL xarm_disconnect(XArmHandle arm) {
+	if (arm == NULL) return -1;
+	arm->api->disconnect();
+	return 0;
+}
+
+int XARM_CALL xarm_is_connected(XArmHandle arm) {
+	if (arm == NULL) return 0;
+	return arm->api->is_connected() ? 1 : 0;
+}
+
+int XARM_CALL xarm_motion_enable(XArmHandle arm, int enable, int servo_id) {
+	if (arm == NULL) return -1;
+	return arm->api->motion_enable(enable != 0, servo_id);
+}
+
+int XARM_CALL xarm_set_mode(XArmHandle arm, int mode) {
+	if (arm == NULL) return -1;
+	return arm->api->set_mode(mode);
+}
+
+int XARM_CALL xarm_set_state(XArmHandle arm, int state) {
+	if (arm == NULL) return -1;
+	return arm->api->set_state(state);
+}
+
+int XARM_CALL xarm_clean_warn(XArmHandle arm) {
+	if (arm == NULL) return -1;
+	return arm->api->clean_warn();
+}
+
+int XARM_CALL xarm_clean_error(XArmHandle arm) {
+	if (arm == NULL) return -1;
+	return arm->api->clean_error();
+}
+
+int XARM_CALL xarm_emergency_stop(XArmHandle arm) {
+	if (arm == NULL) return -1;
+	arm->api->emergency_stop();
+	return 0;
+}
+
+int XARM_CALL xarm_reset(XArmHandle arm, int wait, float timeout) {
+	if (arm == NULL) return -1;
+	arm->api->reset(wait != 0, timeout);
+	return 0;
+}
+
+int XARM_CALL xarm_set_position(XArmHandle arm, float pose[6], float radius, float speed, float acc, float mvtime, int wait, float timeout) {
+	if (arm == NULL) return -1;
+	return arm->api->set_position(pose, radius, speed, acc, mvtime, wait != 0, timeout);
+}
+
+int XARM_CALL xarm_set_tool_position(XArmHandle arm, float pose[6], float speed, float acc, float mvtime, int wait, float timeout) {
+	if (arm == NULL) return -1;
+	return arm->api->set_tool_position(pose, speed, acc, mvtime, wait != 0, timeout);
+}
+
+int XARM_CALL xarm_set_servo_angle(XArmHandle arm, float angles[7], float speed, float acc, float mvtime, int wait, float timeout) {
+	if (arm == NULL) return -1;
+	return arm->api->set_servo_angle(angles, speed, acc, mvtime, wait != 0, timeout);
+}
+
+int XARM_CALL xarm_set_servo_angle_j(XArmHandle arm, float angles[7], float speed, float acc, float mvtime) {
+	if (arm == NULL) return -1;
+	return arm->api->set_servo_angle_j(angles, speed, acc, mvtime);
+}
+
+int XARM_CALL xarm_set_servo_cartesian(XArmHandle arm, float pose[6], float speed, float acc, float mvtime) {
+	if (arm == NULL) return -1;
+	return arm->api->set_servo_cartesian(pose, speed, acc, mvtime);
+}
+
+int XARM_CALL xarm_move_gohome(XArmHandle arm, float speed, float acc, float mvtime, int wait, float timeout) {
+	if (arm == NULL) return -1;
+	return arm->api->move_gohome(speed, acc, mvtime, wait != 0, timeout);
+}
+
+int XARM_CALL xarm_set_tcp_offset(XArmHandle arm, float pose_offset[6]) {
+	if (arm == NULL) return -1;
+	return arm->api->set_tcp_offset(pose_offset);
+}
+
+int XARM_CALL xarm_set_tcp_load(XArmHandle arm, float weight, float center_of_gravity[3]) {
+	if (arm == NULL) return -1;
+	return arm->api->set_tcp_load(weight, center_of_gravity);
+}
+
+int XARM_CALL xarm_set_gripper_enable(XArmHandle arm, int enable) {
+	if (arm == NULL) return -1;
+	return arm->api->set_gripper_enable(enable != 0);
+}
+
+int XARM_CALL xarm_set_gripper_mode(XArmHandle arm, int mode) {
+	if (arm == NULL) return -1;
+	return arm->api->set_gripper_mode(mode);
+}
+
+int XARM_CALL xarm_set_gripper_speed(XArmHandle arm, float speed) {
+	if (arm == NULL) return -1;
+	return arm->api->set_gripper_speed(speed);
+}
+
+int XARM_CALL xarm_set_gripper_position(XArmHandle arm, float pos, int wait, float timeout) {
+	if (arm == NULL) return -1;
+	return arm->api->set_gripper_position(pos, wait != 0, timeout);
+}
+
+int XARM_CALL xarm_get_gripper_position(XArmHandle arm, float *pos) {
+	if (arm == NULL) return -1;
+	return arm->api->get_gripper_position(pos);
+}
+
+int XARM_CALL xarm_get_tgpio_digital(XArmHandle arm, int *io0_value, int *io1_value) {
+	if (arm == NULL) return -1;
+	return arm->api->get_tgpio_digital(io0_value, io1_value);
+}
+
+int XARM_CALL xarm_set_tgpio_digital(XArmHandle arm, int ionum, int value) {
+	if (arm == NULL) return -1;
+	return arm->api->set_tgpio_digital(ionum, value);
+}
+
+int XARM_CALL xarm_get_cgpio_digital(XArmHandle arm, int *digitals) {
+	if (arm == NULL) return -1;
+	return arm->api->get_cgpio_digital(digitals);
+}
+
+int XARM_CALL xarm_get_cgpio_analog(XArmHandle arm, int ionum, float *value) {
+	if (arm == NULL) return -1;
+	return arm->api->get_cgpio_analog(ionum, value);
+}
+
+int XARM_CALL xarm_set_cgpio_digital(XArmHandle arm, int ionum, int value) {
+	if (arm == NULL) return -1;
+	return arm->api->set_cgpio_digital(ionum, value);
+}
+
+int XARM_CALL xarm_set_cgpio_analog(XArmHandle arm, int ionum, int value) {
+	if (arm == NULL) return -1;
+	return arm->api->set_cgpio_analog(ionum, value);
+}
+
+int XARM_CALL xarm_get_version(XArmHandle arm, unsigned char version[40]) {
+	if (arm == NULL) return -1;
+	return arm->api->get_version(version);
+}
+
+int XARM_CALL xarm_get_state(XArmHandle arm, int *state) {
+	if (arm == NULL) return -1;
+	return arm->api->get_state(state);
+}
+
+int XARM_CALL xarm_get_cmdnum(XArmHandle arm, int *cmdnum) {
+	if (arm == NULL) return -1;
+	return arm->api->get_cmdnum(cmdnum);
+}
+
+int XARM_CALL xarm_get_err_warn_code(XArmHandle arm, int err_warn[2]) {
+	if (arm == NULL) return -1;
+	return arm->api->get_err_warn_code(err_warn);
+}
+
+int XARM_CALL xarm_get_position(XArmHandle arm, float pose[6]) {
+	if (arm == NULL) return -1;
+	return arm->api->get_position(pose);
+}
+
+int XARM_CALL xarm_get_servo_angle(XArmHandle arm, float angles[7]) {
+	if (arm == NULL) return -1;
+	return arm->api->get_servo_angle(angles);
+}
+
+int XARM_CALL xarm_get_report(XArmHandle arm, RobotState *state) {
+	return read_report_(arm, state);
+}
+
+int XARM_CALL xarm_get_joint_states(XArmHandle arm, float angles[7], float speeds[7], float torques[7], float temperatures[7]) {
+	RobotState st;
+	int ret = read_report_(arm, &st);
+	if (ret != 0) return ret;
+	if (angles != NULL) memcpy(angles, st.angles, sizeof(st.angles));
+	if (speeds != NULL) memcpy(speeds, st.realtime_joint_speeds, sizeof(st.realtime_joint_speeds));
+	if (torques != NULL) memcpy(torques, st.joints_torque, sizeof(st.joints_torque));
+	if (temperatures != NULL) memcpy(temperatures, st.temperatures, sizeof(st.temperatures));
+	return 0;
+}
+
+int XARM_CALL xarm_get_tcp_states(XArmHandle arm, float position[6], float *speed, float offset[6], float load[4]) {
+	RobotState st;
+	int ret = read_report_(arm, &st);
+	if (ret != 0) return ret;
+	if (position != NULL) memcpy(position, st.position, sizeof(st.position));
+	if (speed != NULL) *speed = st.realtime_tcp_speed;
+	if (offset != NULL) memcpy(offset, st.tcp_offset, sizeof(st.tcp_offset));
+	if (load != NULL) memcpy(load, st.tcp_load, sizeof(st.tcp_load));
+	return 0;
+}
+
+int XARM_CALL xarm_get_positions(XArmHandle *arms, int num, float *poses, int *rets) {
+	int count = 0;
+	RobotState st;
+	for (int i = 0; i < num; i++) {
+		int ret = read_report_(arms[i], &st);
+		if (rets != NULL) rets[i] = ret;
+		if (ret != 0) continue;
+		memcpy(&poses[i * 6], st.position, sizeof(st.position));
+		count += 1;
+	}
+	return count;
+}
+
+int XARM_CALL xarm_get_servo_angles(XArmHandle *arms, int num, float *angles, int *rets) {
+	int count = 0;
+	RobotState st;
+	for (int i = 0; i < num; i++) {
+		int ret = read_report_(arms[i], &st);
+		if (rets != NULL) rets[i] = ret;
+		if (ret != 0) continue;
+		memcpy(&angles[i * 7], st.angles, sizeof(st.angles));
+		count += 1;
+	}
+	return count;
+}
+
+int XARM_CALL xarm_get_predicted_state(XArmHandle arm, long long time_us, PredictedState *state) {
+	if (arm == NULL) return -1;
+	return arm->api->get_predicted_state(state, time_us);
+}
+
+const RobotState * XARM_CALL xarm_get_latest_state(XArmHandle arm, unsigned int *lock) {
+	if (arm == NULL) return NULL;
+	return arm->states.peek(lock);
+}
+
+int XARM_CALL xarm_is_state_current(XArmHandle arm, const RobotState *state, unsigned int lock) {
+	if (arm == NULL) return 0;
+	return arm->states.is_current(state, lock) ? 1 : 0;
+}